@@ -1,16 +1,134 @@
+#include "ASTBuilder.hpp"
 #include "SyntaxParser.hpp"
+#include "TChannel.hpp"
 #include "TByteCodeBuilder.hpp"
+#include "TGreenThreads.hpp"
+#include "TInterpreter.hpp"
+#include "TListObject.hpp"
+#include "TMappedFile.hpp"
+#include "TMatrixObject.hpp"
+#include "TModuleFile.hpp"
+#include "TParallelList.hpp"
+#include "TRuntime.hpp"
+#include "TScheduler.hpp"
+#include "TThreadPool.hpp"
+#include "TStringObject.hpp"
 #include "VM.hpp"
+#include "VectorKernels.hpp"
 #include "ast.hpp"
 #include "environment.hpp"
 #include "evaluator.hpp"
 #include "lexer.hpp"
 #include "parser.hpp"
 #include "repl.hpp"
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
 #include <iostream>
 #include <memory>
+#include <new>
 #include <sstream>
+#include <thread>
+#include <vector>
+
+// Every allocation through operator new is counted, see AST_build and
+// Eval_fibonacci. All forms are replaced, so that every delete frees memory
+// its own new took from malloc.
+static std::atomic<size_t> nAllocations{0};
+
+static void *countedAlloc(size_t size, size_t alignment = 0)
+{
+    nAllocations.fetch_add(1, std::memory_order_relaxed);
+    size = size == 0 ? 1 : size;
+    if (alignment > alignof(std::max_align_t))
+    {
+        // aligned_alloc wants a multiple of the alignment.
+        return std::aligned_alloc(alignment,
+                                  (size + alignment - 1) & ~(alignment - 1));
+    }
+    return std::malloc(size);
+}
+
+static void *countedNew(size_t size, size_t alignment = 0)
+{
+    if (void *p = countedAlloc(size, alignment))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new(size_t size)
+{
+    return countedNew(size);
+}
+void *operator new[](size_t size)
+{
+    return countedNew(size);
+}
+void *operator new(size_t size, std::align_val_t alignment)
+{
+    return countedNew(size, static_cast<size_t>(alignment));
+}
+void *operator new[](size_t size, std::align_val_t alignment)
+{
+    return countedNew(size, static_cast<size_t>(alignment));
+}
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    return countedAlloc(size);
+}
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    return countedAlloc(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+void operator delete[](void *p, size_t) noexcept
+{
+    std::free(p);
+}
+void operator delete(void *p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+void operator delete[](void *p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+void operator delete(void *p, size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+void operator delete[](void *p, size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+    std::free(p);
+}
+void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+    std::free(p);
+}
 
 struct BenchmarkCase
 {
@@ -57,10 +175,10 @@ static void VM_fibonacci35()
 
     TByteCodeBuilder builder(sp.tokens());
     auto module = std::make_shared<TModule>();
-    constantValueTable.clear();
     builder.build(module.get());
 
-    VM vm;
+    TRuntime runtime;
+    VM vm(runtime);
     vm.runModule(module);
     auto stop = std::chrono::high_resolution_clock::now();
     auto duration_us =
@@ -87,10 +205,10 @@ static void VM_fibonacci33()
 
     TByteCodeBuilder builder(sp.tokens());
     auto module = std::make_shared<TModule>();
-    constantValueTable.clear();
     builder.build(module.get());
 
-    VM vm;
+    TRuntime runtime;
+    VM vm(runtime);
     vm.runModule(module);
     auto stop = std::chrono::high_resolution_clock::now();
     auto duration_us =
@@ -105,10 +223,876 @@ static void VM_fibonacci33()
               << seconds << ":" << milliseconds << "] [m:s:ms]" << std::endl;
 }
 
+// Appends one short piece at a time, the way a report is assembled by a
+// script. Doubling the number of pieces should roughly double the time.
+static void StringBuilder_concat(int pieces)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    auto *piece = TStringObject::createConstantObject(std::string("row;"));
+    auto *empty = TStringObject::createConstantObject(std::string(""));
+    auto *result = empty;
+    for (int i = 0; i < pieces; ++i)
+    {
+        result = TStringObject::add(*result, *piece);
+    }
+    auto length = result->value().size();
+
+    auto stop = std::chrono::high_resolution_clock::now();
+    auto duration_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(stop - start)
+            .count();
+
+    std::cout << "string concat x" << pieces << " (" << length
+              << " bytes) - Execution time: [" << duration_ms << "] [ms]"
+              << std::endl;
+
+    TMemoryList::current().freeList();
+    delete piece;
+    delete empty;
+}
+
+static void List_scan(int n, bool mixed)
+{
+    auto *list = TListObject::createObject();
+    if (mixed)
+    {
+        list->append(true);
+    }
+    for (int i = 0; i < n; ++i)
+    {
+        list->append(i);
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    int64_t sum = 0;
+    if (list->storage() == TListStorage::lsInteger)
+    {
+        const int64_t *data = list->intData();
+        for (size_t i = 0; i < list->size(); ++i)
+        {
+            sum += data[i];
+        }
+    }
+    else
+    {
+        for (size_t i = 1; i < list->size(); ++i)
+        {
+            sum += list->get(static_cast<int>(i)).ivalue();
+        }
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+    auto duration_us =
+        std::chrono::duration_cast<std::chrono::microseconds>(stop - start)
+            .count();
+
+    size_t itemSize = mixed ? sizeof(TListItem) : sizeof(int64_t);
+    size_t bytes = list->size() * itemSize;
+    std::cout << (mixed ? "mixed" : "packed int") << " list x" << n << " ("
+              << bytes / (1024 * 1024) << " MiB, sum " << sum
+              << ") - Scan time: [" << duration_us << "] [us]" << std::endl;
+
+    TMemoryList::current().freeList();
+}
+
+static void Reduction_kernels(int n)
+{
+    std::vector<double> x(n), y(n);
+    for (int i = 0; i < n; ++i)
+    {
+        x[i] = i * 0.5;
+        y[i] = 1.0 / (i + 1);
+    }
+
+    for (auto isa : {TKernelIsa::Scalar, TKernelIsa::SSE2, TKernelIsa::AVX2})
+    {
+        if (!TVectorKernels::isSupported(isa))
+        {
+            continue;
+        }
+        const auto &kernels = TVectorKernels::get(isa);
+        auto start = std::chrono::high_resolution_clock::now();
+        double result = kernels.dotd(x.data(), y.data(), n) +
+                        kernels.sumd(x.data(), n);
+        auto stop = std::chrono::high_resolution_clock::now();
+        auto duration_us =
+            std::chrono::duration_cast<std::chrono::microseconds>(stop - start)
+                .count();
+        std::cout << "dot + sum x" << n << " [" << TKernelIsaToStr(isa)
+                  << "] (" << result << ") - Execution time: [" << duration_us
+                  << "] [us]" << std::endl;
+    }
+}
+
+static void Matrix_multiply(size_t n)
+{
+    auto *a = TMatrixObject::identity(n);
+    auto *b = TMatrixObject::identity(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        a->set(i, (i + 1) % n, 0.5);
+        b->set((i + 3) % n, i, 2.0);
+    }
+
+    // Row-major triple loop, the access pattern of nested list matrices.
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<double> naive(n * n, 0.);
+    for (size_t i = 0; i < n; ++i)
+        for (size_t j = 0; j < n; ++j)
+            for (size_t k = 0; k < n; ++k)
+                naive[i * n + j] += a->data()[i * n + k] * b->data()[k * n + j];
+    auto stop = std::chrono::high_resolution_clock::now();
+    auto naive_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(stop - start)
+            .count();
+
+    start = std::chrono::high_resolution_clock::now();
+    TMatrixObject::multiply(a, b);
+    stop = std::chrono::high_resolution_clock::now();
+    auto blocked_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(stop - start)
+            .count();
+
+    start = std::chrono::high_resolution_clock::now();
+    TMatrixObject::multiply(a, b, &TThreadPool::shared());
+    stop = std::chrono::high_resolution_clock::now();
+    auto parallel_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(stop - start)
+            .count();
+
+    std::cout << "matmul " << n << "x" << n << " - naive: [" << naive_ms
+              << "] blocked: [" << blocked_ms << "] blocked on "
+              << TThreadPool::shared().size() + 1 << " threads: ["
+              << parallel_ms << "] [ms]" << std::endl;
+
+    TMemoryList::current().freeList();
+}
+
+// One runtime and VM per thread, each compiling and running its own copy of
+// fibonacci(33). With enough cores the wall time should stay close to that
+// of a single run.
+static void VM_parallelRuntimes(size_t nThreads)
+{
+    auto runOne = [] {
+        std::istringstream iss(inputFibonacci33());
+        Scanner sc(iss);
+        SyntaxParser sp(sc);
+        sp.syntaxCheck();
+
+        TByteCodeBuilder builder(sp.tokens());
+        auto module = std::make_shared<TModule>();
+        builder.build(module.get());
+
+        TRuntime runtime;
+        VM vm(runtime);
+        vm.runModule(module);
+    };
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < nThreads; ++i)
+    {
+        threads.emplace_back(runOne);
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+    auto duration_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(stop - start)
+            .count();
+
+    std::cout << "fibonacci(33) on " << nThreads
+              << " isolated runtimes - Execution time: [" << duration_ms
+              << "] [ms]" << std::endl;
+}
+
+static std::shared_ptr<const TModule> compileModule(const std::string &input)
+{
+    std::istringstream iss(input);
+    Scanner sc(iss);
+    SyntaxParser sp(sc);
+    sp.syntaxCheck();
+
+    TByteCodeBuilder builder(sp.tokens());
+    auto module = std::make_shared<TModule>();
+    builder.build(module.get());
+    return module;
+}
+
+// A small rules script evaluated nRuns times spread over nThreads, once
+// compiling it for every run and once running a single shared module in a
+// fresh execution context per run.
+static void Module_sharedRuns(size_t nThreads, size_t nRuns)
+{
+    const std::string rules = "let limit = 100; let price = 42.5;\n"
+                              "let discount = price * 0.1;\n"
+                              "let label = \"gold\" + \"-tier\";\n"
+                              "price - discount < limit\n";
+
+    auto measure = [nThreads, nRuns](const std::function<void()> &run) {
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < nThreads; ++t)
+        {
+            threads.emplace_back([&run, nThreads, nRuns] {
+                for (size_t i = 0; i < nRuns / nThreads; ++i)
+                {
+                    run();
+                }
+            });
+        }
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+        auto stop = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration_cast<std::chrono::milliseconds>(stop -
+                                                                     start)
+            .count();
+    };
+
+    auto compiled_ms = measure([&rules] {
+        thread_local TRuntime runtime;
+        VM vm(runtime);
+        vm.runModule(compileModule(rules));
+        runtime.heap().freeList();
+    });
+
+    auto module = compileModule(rules);
+    auto shared_ms = measure([&module] {
+        thread_local TRuntime runtime;
+        TExecutionContext context(module);
+        VM vm(runtime);
+        vm.runModule(context);
+        runtime.heap().freeList();
+    });
+
+    std::cout << "rules script x" << nRuns << " on " << nThreads
+              << " threads - compile per run: [" << compiled_ms
+              << "] shared module: [" << shared_ms << "] [ms]" << std::endl;
+}
+
+// A fixed batch of fibonacci(27) jobs on schedulers of 1 up to nWorkers
+// workers. With a core per worker the throughput should grow about
+// linearly with the number of workers.
+static void Scheduler_fibonacci(size_t nWorkers)
+{
+    auto module = std::make_shared<TModule>();
+    module->symboltable().addSymbol("n");
+    {
+        std::istringstream iss("fn fibonacci(n)\n"
+                               "    if n < 2 then\n"
+                               "        return n\n"
+                               "    end\n"
+                               "    return fibonacci(n - 1) + "
+                               "fibonacci(n - 2)\n"
+                               "end;\n"
+                               "fibonacci(n);\n");
+        Scanner sc(iss);
+        SyntaxParser sp(sc);
+        sp.syntaxCheck();
+        TByteCodeBuilder builder(sp.tokens());
+        builder.build(module.get());
+    }
+
+    std::vector<size_t> workerCounts;
+    for (size_t workers = 1; workers < nWorkers; workers *= 2)
+    {
+        workerCounts.push_back(workers);
+    }
+    workerCounts.push_back(nWorkers);
+
+    const size_t nJobs = 4 * nWorkers;
+    double baseline = 0.;
+    for (size_t workers : workerCounts)
+    {
+        TScheduler scheduler(workers);
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<std::future<TScriptResult>> results;
+        for (size_t i = 0; i < nJobs; ++i)
+        {
+            results.push_back(scheduler.submit({module, {{"n", 27}}}));
+        }
+        std::chrono::nanoseconds wait{0};
+        size_t stolen = 0;
+        for (auto &result : results)
+        {
+            auto stats = result.get().stats;
+            wait += stats.queueWait;
+            stolen += stats.stolen ? 1 : 0;
+        }
+        auto stop = std::chrono::high_resolution_clock::now();
+        double seconds = std::chrono::duration<double>(stop - start).count();
+        double jobsPerSecond = nJobs / seconds;
+        if (workers == 1)
+        {
+            baseline = jobsPerSecond;
+        }
+
+        std::cout << "scheduler fibonacci(27) x" << nJobs << " on " << workers
+                  << " workers - " << jobsPerSecond << " jobs/s, speedup "
+                  << jobsPerSecond / baseline << ", mean queue wait "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(
+                         wait / nJobs)
+                         .count()
+                  << " ms, " << stolen << " stolen" << std::endl;
+    }
+}
+
+// nThreads runs of fibonacci(20) interleaved on this one thread, each given
+// quanta of 1000 instructions.
+static void GreenThreads_fibonacci(size_t nThreads)
+{
+    auto module = compileModule("fn fibonacci(n)\n"
+                                "    if n < 2 then\n"
+                                "        return n\n"
+                                "    end\n"
+                                "    return fibonacci(n - 1) + "
+                                "fibonacci(n - 2)\n"
+                                "end;\n"
+                                "fibonacci(20);\n");
+
+    auto start = std::chrono::high_resolution_clock::now();
+    TRuntime runtime;
+    TGreenThreads threads(runtime, 1000);
+    for (size_t i = 0; i < nThreads; ++i)
+    {
+        threads.spawn(module);
+    }
+    threads.runAll();
+    auto stop = std::chrono::high_resolution_clock::now();
+    auto duration_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(stop - start)
+            .count();
+
+    std::cout << "fibonacci(20) on " << nThreads
+              << " green threads - Execution time: [" << duration_ms
+              << "] [ms], turns per thread " << threads.turns(0) << std::endl;
+}
+
+static void ParallelList_map(size_t nThreads)
+{
+    auto module = compileModule("fn fibonacci(n)\n"
+                                "    if n < 2 then\n"
+                                "        return n\n"
+                                "    end\n"
+                                "    return fibonacci(n - 1) + "
+                                "fibonacci(n - 2)\n"
+                                "end;\n");
+    TExecutionContext context(module);
+    int fibonacci = 0;
+    context.globals().find("fibonacci", fibonacci);
+
+    TRuntime runtime;
+    TRuntime::TScope scope(runtime);
+    auto *list = TListObject::createObject();
+    for (int i = 0; i < 512; ++i)
+    {
+        list->append(10 + i % 10);
+    }
+
+    TThreadPool pool(nThreads - 1);
+    auto start = std::chrono::high_resolution_clock::now();
+    TParallelList::map(context, fibonacci, list, pool);
+    auto stop = std::chrono::high_resolution_clock::now();
+    auto duration_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(stop - start)
+            .count();
+
+    std::cout << "pmap(fibonacci, 512 elements) on " << nThreads
+              << " threads - Execution time: [" << duration_ms << "] [ms]"
+              << std::endl;
+}
+
+// Messages per second between two isolates, each with its own runtime.
+static void Channel_throughput(size_t nMessages, bool strings)
+{
+    TChannel channel(1024);
+    auto start = std::chrono::high_resolution_clock::now();
+    std::thread producer([&channel, nMessages, strings] {
+        TRuntime runtime;
+        TRuntime::TScope scope(runtime);
+        auto *text = TStringObject::createStringObject(std::string("record"));
+        for (size_t i = 0; i < nMessages; ++i)
+        {
+            TMachineStackRecord record;
+            if (strings)
+            {
+                record.setValue(text);
+            }
+            else
+            {
+                record.setValue(static_cast<int>(i));
+            }
+            channel.send(TMessage::pack(record));
+        }
+        channel.close();
+    });
+    std::thread consumer([&channel] {
+        TRuntime runtime;
+        TRuntime::TScope scope(runtime);
+        TMessage message;
+        while (channel.recv(message))
+        {
+            message.unpack();
+        }
+    });
+    producer.join();
+    consumer.join();
+    auto stop = std::chrono::high_resolution_clock::now();
+    double seconds = std::chrono::duration<double>(stop - start).count();
+
+    std::cout << nMessages << (strings ? " string" : " integer")
+              << " messages between two isolates - Throughput: ["
+              << static_cast<long>(nMessages / seconds) << "] [msg/s]"
+              << std::endl;
+}
+
+// A script function summing a host array of n doubles, once passed as a
+// view and once copied into a list first.
+static void Interpreter_hostArray(size_t n)
+{
+    std::vector<double> data(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        data[i] = i * 0.5;
+    }
+    TInterpreter interpreter;
+    interpreter.load("fn total(xs)\n"
+                     "    return sum(xs)\n"
+                     "end\n");
+    auto measure_us = [](const std::function<void()> &run) {
+        auto start = std::chrono::high_resolution_clock::now();
+        run();
+        auto stop = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration_cast<std::chrono::microseconds>(stop -
+                                                                     start)
+            .count();
+    };
+
+    double viewResult = 0;
+    auto view_us = measure_us([&] {
+        viewResult =
+            interpreter.call("total", {std::span<const double>(data)})
+                .dvalue();
+    });
+
+    auto copy_us = measure_us([&] {
+        TRuntime::TScope scope(interpreter.runtime());
+        auto *list = TListObject::createObject();
+        for (auto x : data)
+        {
+            list->append(x);
+        }
+    });
+
+    std::cout << "sum over a host array x" << n << " (" << viewResult
+              << ") - view: [" << view_us << "] [us] - copy into a list: ["
+              << copy_us << "] [us]" << std::endl;
+}
+
+// Per-row cost of evaluating a formula over n rows: one call() per row, a
+// batch run a row at a time and a batch run a block of rows per
+// instruction. The identity function shows the cost of the call itself.
+static void Interpreter_batch(size_t n)
+{
+    std::vector<double> x(n), y(n), results(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        x[i] = i * 0.5;
+        y[i] = 1.0 / (i + 1);
+    }
+    TInterpreter interpreter;
+    interpreter.load("fn formula(x, y)\n"
+                     "    if x > y then\n"
+                     "        return x * y + 1.0\n"
+                     "    end\n"
+                     "    return x - y\n"
+                     "end;\n"
+                     "fn identity(x, y)\n"
+                     "    return x\n"
+                     "end;\n");
+    std::vector<TBatchColumn> columns = {std::span<const double>(x),
+                                         std::span<const double>(y)};
+
+    auto nsPerRow = [n](const std::function<void()> &run) {
+        auto start = std::chrono::high_resolution_clock::now();
+        run();
+        auto stop = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(stop -
+                                                                    start)
+                   .count() /
+               static_cast<double>(n);
+    };
+
+    for (const char *name : {"identity", "formula"})
+    {
+        auto function = interpreter.function(name);
+        auto perCall = nsPerRow([&] {
+            for (size_t i = 0; i < n; ++i)
+            {
+                results[i] =
+                    interpreter.call(function, {x[i], y[i]}).dvalue();
+            }
+        });
+        auto scalar = nsPerRow([&] {
+            interpreter.callBatch(function, columns, results,
+                                  TBatchMode::Scalar);
+        });
+        auto vectorized = nsPerRow([&] {
+            interpreter.callBatch(function, columns, results,
+                                  TBatchMode::Vectorized);
+        });
+        std::cout << name << "(x, y) over " << n << " rows - call: ["
+                  << perCall << "] [ns/row] - batch: [" << scalar
+                  << "] [ns/row] - vectorized batch: [" << vectorized
+                  << "] [ns/row]" << std::endl;
+    }
+}
+
+// A generated module of nFunctions rule functions.
+static std::string ruleModule(int nFunctions)
+{
+    std::string input;
+    for (int i = 0; i < nFunctions; ++i)
+    {
+        auto n = std::to_string(i);
+        input += "fn rule" + n + "(x, y)\n"
+                 "    let t = x * " + n + ".5 - y / 3.25\n"
+                 "    if t > 100.0 and y < " + n + " then\n"
+                 "        return t * 0.75 + \"r" + n + "\"\n"
+                 "    end\n"
+                 "    return t - 1.0\n"
+                 "end;\n";
+    }
+    return input;
+}
+
+// Building the rule module, compiling the bodies in sequence and on the
+// shared pool.
+static void Module_parallelBuild(int nFunctions)
+{
+    std::string input = ruleModule(nFunctions);
+    std::istringstream iss(input);
+    Scanner sc(iss);
+    SyntaxParser sp(sc);
+    sp.syntaxCheck();
+
+    auto build_ms = [&sp](TThreadPool *pool) {
+        TByteCodeBuilder builder(sp.tokens());
+        TModule module;
+        auto start = std::chrono::high_resolution_clock::now();
+        if (pool)
+        {
+            builder.build(&module, *pool);
+        }
+        else
+        {
+            builder.build(&module);
+        }
+        auto stop = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration_cast<std::chrono::milliseconds>(stop -
+                                                                     start)
+            .count();
+    };
+    auto sequential = build_ms(nullptr);
+    auto parallel = build_ms(&TThreadPool::shared());
+
+    std::cout << "build of " << nFunctions << " functions - sequential: ["
+              << sequential << "] [ms] - on "
+              << TThreadPool::shared().size() + 1 << " threads: [" << parallel
+              << "] [ms]" << std::endl;
+}
+
+// Cold start of the rule module: compiling the source against loading the
+// module file saved from it.
+static void Module_coldStart(int nFunctions)
+{
+    std::string source = ruleModule(nFunctions);
+    auto path =
+        (std::filesystem::temp_directory_path() / "daewoo_rules.dwc").string();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    auto compiled = TInterpreter::compile(source);
+    auto stop = std::chrono::high_resolution_clock::now();
+    auto compile_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(stop - start)
+            .count();
+
+    TModuleFile::save(*compiled, source, path);
+    start = std::chrono::high_resolution_clock::now();
+    auto loaded = TModuleFile::load(path, source);
+    stop = std::chrono::high_resolution_clock::now();
+    auto load_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(stop - start)
+            .count();
+    std::filesystem::remove(path);
+
+    std::cout << "cold start of " << nFunctions << " functions - compile: ["
+              << compile_ms << "] [ms] - load module file: [" << load_ms
+              << "] [ms]" << (loaded ? "" : " (rejected)") << std::endl;
+}
+
+// Starting the rule module and calling one function in a hundred, with
+// every body compiled up front and with bodies compiled on first call.
+static void Module_lazyStart(int nFunctions)
+{
+    std::string source = ruleModule(nFunctions);
+    auto start_ms = [&source, nFunctions](TCompileMode mode) {
+        auto start = std::chrono::high_resolution_clock::now();
+        TInterpreter interpreter;
+        interpreter.load(source, mode);
+        for (int i = 0; i < nFunctions; i += 100)
+        {
+            interpreter.call("rule" + std::to_string(i), {0.0, 2.0});
+        }
+        auto stop = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration_cast<std::chrono::milliseconds>(stop -
+                                                                     start)
+            .count();
+    };
+    auto eager = start_ms(TCompileMode::Eager);
+    auto lazy = start_ms(TCompileMode::Lazy);
+
+    std::cout << "start of " << nFunctions
+              << " functions calling 1% - eager: [" << eager
+              << "] [ms] - lazy: [" << lazy << "] [ms]" << std::endl;
+}
+
+// Scanning the rule module, read from a stream and from a mapped file,
+// setting up the scanner included.
+static void Scanner_throughput(int nFunctions)
+{
+    std::string source = ruleModule(nFunctions);
+    auto path =
+        (std::filesystem::temp_directory_path() / "daewoo_rules.dw").string();
+    std::ofstream(path, std::ios::binary) << source;
+
+    auto scan_mbs = [&source](const auto &makeScanner) {
+        auto start = std::chrono::high_resolution_clock::now();
+        Scanner sc = makeScanner();
+        do
+        {
+            sc.nextToken();
+        } while (sc.token().code() != TokenCode::tEndofStream);
+        auto stop = std::chrono::high_resolution_clock::now();
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                      stop - start)
+                      .count();
+        return static_cast<double>(source.size()) / std::max<long>(us, 1);
+    };
+    std::istringstream iss(source);
+    auto stream = scan_mbs([&iss] { return Scanner(iss); });
+    auto file = scan_mbs([&path] { return Scanner(TMappedFile::open(path)); });
+    std::filesystem::remove(path);
+
+    std::cout << "scanning " << source.size() / 1'000'000 << " MB - stream: ["
+              << stream << "] [MB/s] - mapped file: [" << file << "] [MB/s]"
+              << std::endl;
+}
+
+// Scanning the rule module in chunks, on the calling thread alone and with
+// up to one thread per core.
+static void Scanner_parallel(int nFunctions)
+{
+    std::string source = ruleModule(nFunctions);
+    std::cout << "scanning " << source.size() / 1'000'000
+              << " MB in chunks -";
+    for (size_t nThreads = 1;; nThreads *= 2)
+    {
+        TThreadPool pool(nThreads - 1);
+        auto start = std::chrono::high_resolution_clock::now();
+        Scanner sc{std::string_view(source)};
+        sc.scanAll(pool);
+        do
+        {
+            sc.nextToken();
+        } while (sc.token().code() != TokenCode::tEndofStream);
+        auto stop = std::chrono::high_resolution_clock::now();
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                      stop - start)
+                      .count();
+        std::cout << " " << nThreads << " threads: ["
+                  << static_cast<double>(source.size()) /
+                         std::max<long>(us, 1)
+                  << "] [MB/s]";
+        if (nThreads >= std::thread::hardware_concurrency())
+        {
+            break;
+        }
+    }
+    std::cout << std::endl;
+}
+
+// Building the syntax tree of the rule module and freeing it, with the
+// allocations either takes.
+static void AST_build(int nFunctions)
+{
+    std::string source = ruleModule(nFunctions);
+    Scanner sc{std::string_view(source)};
+    SyntaxParser sp(sc);
+    sp.syntaxCheck();
+
+    ASTBuilder builder(sp.tokens());
+    size_t before = nAllocations;
+    auto start = std::chrono::high_resolution_clock::now();
+    auto program = builder.build();
+    auto built = std::chrono::high_resolution_clock::now();
+    size_t buildAllocations = nAllocations - before;
+    program.reset();
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    auto ms = [](auto from, auto to) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(to -
+                                                                     from)
+                   .count() /
+               1000.0;
+    };
+    std::cout << "syntax tree of " << nFunctions << " functions - build: ["
+              << ms(start, built) << "] [ms] [" << buildAllocations
+              << "] [allocations] - teardown: [" << ms(built, stop)
+              << "] [ms]" << std::endl;
+}
+
+// Filling the token table of the rule module: scanning, the syntax check
+// and interning the identifiers.
+static void Parser_tokens(int nFunctions)
+{
+    std::string source = ruleModule(nFunctions);
+    auto start = std::chrono::high_resolution_clock::now();
+    Scanner sc{std::string_view(source)};
+    SyntaxParser sp(sc);
+    sp.syntaxCheck();
+    auto stop = std::chrono::high_resolution_clock::now();
+    auto ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(stop - start)
+            .count();
+
+    std::cout << "parsing " << sp.tokens().count() << " tokens, "
+              << sp.tokens().atoms().size() << " distinct identifiers: ["
+              << ms << "] [ms]" << std::endl;
+}
+
+// Compiling modules of 10^3 to 10^6 globals, each reading an earlier one.
+// Prints one point per module size, build time against symbol count.
+static void Module_symbolScaling()
+{
+    for (int nSymbols = 1'000; nSymbols <= 1'000'000; nSymbols *= 10)
+    {
+        std::string input = "let s0 = 0;\n";
+        for (int i = 1; i < nSymbols; ++i)
+        {
+            input += "let s" + std::to_string(i) + " = s" +
+                     std::to_string(i / 2) + " + 1;\n";
+        }
+        auto start = std::chrono::high_resolution_clock::now();
+        TInterpreter::compile(input);
+        auto stop = std::chrono::high_resolution_clock::now();
+        auto ms =
+            std::chrono::duration_cast<std::chrono::milliseconds>(stop - start)
+                .count();
+
+        std::cout << "compiling " << nSymbols << " symbols: [" << ms
+                  << "] [ms] - per symbol: [" << ms * 1'000'000 / nSymbols
+                  << "] [ns]" << std::endl;
+    }
+}
+
+// Lexing and parsing a program of a few MB with the tree-walking
+// interpreter's parser.
+static void Parser_largeProgram(int nFunctions)
+{
+    std::string input;
+    for (int i = 0; i < nFunctions; ++i)
+    {
+        // Identifiers are letters only.
+        std::string name = "rule";
+        for (int k = i; k > 0; k /= 26)
+        {
+            name += static_cast<char>('a' + k % 26);
+        }
+        input += "let " + name + " = fn(x, y) { if (x < y) { return x * " +
+                 std::to_string(i) + " + y; } else { return y - x; } };\n";
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    Lexer l(input);
+    Parser p(l);
+    auto program = p.parseProgram();
+    auto stop = std::chrono::high_resolution_clock::now();
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(stop -
+                                                                   start)
+                  .count();
+
+    std::cout << "parsing " << input.size() / 1'000'000 << " MB, "
+              << program->size() << " statements: [" << us / 1000
+              << "] [ms] - ["
+              << static_cast<double>(input.size()) / std::max<long>(us, 1)
+              << "] [MB/s]" << std::endl;
+}
+
+// Calls and variable reads in the tree-walking interpreter, with the
+// allocations they take: fib(n) makes about 1.6^n calls, each reading its
+// parameter and the global fib.
+static void Eval_fibonacci(int n)
+{
+    std::string input = "let fib = fn(n) { if (n < 2) { return n; } "
+                        "fib(n - 1) + fib(n - 2); }; fib(" +
+                        std::to_string(n) + ");";
+    Lexer l(input);
+    Parser p(l);
+    auto program = p.parseProgram();
+    auto env = std::make_shared<Environment>();
+
+    size_t before = nAllocations;
+    auto start = std::chrono::high_resolution_clock::now();
+    auto result = Eval(program.get(), env);
+    auto stop = std::chrono::high_resolution_clock::now();
+    size_t allocations = nAllocations - before;
+    auto ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(stop - start)
+            .count();
+
+    std::cout << "tree-walking fib(" << n << ") = " << inspect(result)
+              << ": [" << ms << "] [ms] [" << allocations
+              << "] [allocations]" << std::endl;
+}
+
 int main(void)
 {
     VM_fibonacci35();
     VM_fibonacci33();
+    StringBuilder_concat(500'000);
+    StringBuilder_concat(1'000'000);
+    List_scan(10'000'000, false);
+    List_scan(10'000'000, true);
+    Reduction_kernels(10'000'000);
+    Matrix_multiply(200);
+    Matrix_multiply(1000);
+    VM_parallelRuntimes(1);
+    VM_parallelRuntimes(std::max(1u, std::thread::hardware_concurrency()));
+    Module_sharedRuns(std::max(1u, std::thread::hardware_concurrency()),
+                      100'000);
+    Scheduler_fibonacci(TScheduler::defaultWorkers());
+    GreenThreads_fibonacci(1);
+    GreenThreads_fibonacci(1000);
+    ParallelList_map(1);
+    ParallelList_map(std::max(1u, std::thread::hardware_concurrency()));
+    Channel_throughput(1'000'000, false);
+    Channel_throughput(1'000'000, true);
+    Interpreter_hostArray(10'000'000);
+    Interpreter_batch(1'000'000);
+    Module_parallelBuild(20'000);
+    Module_coldStart(20'000);
+    Module_lazyStart(20'000);
+    Scanner_throughput(100'000);
+    Scanner_parallel(300'000);
+    Parser_tokens(100'000);
+    AST_build(20'000);
+    Module_symbolScaling();
+    Parser_largeProgram(50'000);
+    Eval_fibonacci(25);
 
     return 0;
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "ASTBuilder.hpp"
 #include <memory>
+#include <span>
 #include <stdexcept>
 
 #include "ASTNode.hpp"
@@ -18,17 +19,19 @@ std::unique_ptr<ASTProgram> ASTBuilder::build()
 
     if (code() != TokenCode::tEndofStream)
     {
-        return std::make_unique<ASTProgram>(statementList());
+        arena_ = std::make_unique<TArena>();
+        auto statements = statementList();
+        return std::make_unique<ASTProgram>(std::move(arena_), statements);
     }
 
     return nullptr;
 }
 
 // statementList = statement { [ ';' ] statement }
-std::unique_ptr<ASTNodeList> ASTBuilder::statementList()
+const ASTNodeList *ASTBuilder::statementList()
 {
-    auto stat = std::make_unique<ASTNodeList>(ASTNodeType::ntStatementList);
-    stat->add(statement());
+    size_t first = pending_.size();
+    pending_.push_back(statement());
 
     while (true)
     {
@@ -38,11 +41,19 @@ std::unique_ptr<ASTNodeList> ASTBuilder::statementList()
         if (code() == TokenCode::tEnd || code() == TokenCode::tElse ||
             code() == TokenCode::tEndofStream)
         {
-            return stat;
+            return makeList(ASTNodeType::ntStatementList, first);
         }
-        stat->add(statement());
+        pending_.push_back(statement());
     }
-    return stat;
+}
+
+// The nodes pending from first on become the items of a list.
+const ASTNodeList *ASTBuilder::makeList(ASTNodeType type, size_t first)
+{
+    auto items = arena_->copy(
+        std::span<const ASTNode *const>(pending_).subspan(first));
+    pending_.resize(first);
+    return make<ASTNodeList>(type, items);
 }
 
 // Expect works in the following way. If the function finds the expected
@@ -54,13 +65,13 @@ std::unique_ptr<ASTNodeList> ASTBuilder::statementList()
 // to the next caller. This means that the error node will get inserted into the ast tree
 // At compilation, if an error node is encountered the compiler can report the error at
 // that point in time.
-std::unique_ptr<ASTNode> ASTBuilder::expect(TokenCode tc)
+const ASTNode *ASTBuilder::expect(TokenCode tc)
 {
     if (code() != tc)
     {
-        return std::make_unique<ASTErrorNode>("expecting " + tokenToString(tc),
-                                              lineNumber(),
-                                              columnNumber());
+        return make<ASTErrorNode>(arena_->copy("expecting " + tokenToString(tc)),
+                                  lineNumber(),
+                                  columnNumber());
     }
     else
     {
@@ -70,7 +81,7 @@ std::unique_ptr<ASTNode> ASTBuilder::expect(TokenCode tc)
 }
 
 // statement = assignment | endOfStream | exprStatement | ifStatement | returnStatement | function | letStatement
-std::unique_ptr<ASTNode> ASTBuilder::statement()
+const ASTNode *ASTBuilder::statement()
 {
     switch (code())
     {
@@ -112,30 +123,29 @@ std::unique_ptr<ASTNode> ASTBuilder::statement()
 // AST:
 // (exprStatement) -> (identifier) and (expression)
 // OR (exprStatement) -> (expression)
-std::unique_ptr<ASTNode> ASTBuilder::exprStatement()
+const ASTNode *ASTBuilder::exprStatement()
 {
     auto node = expression();
     if (code() == TokenCode::tAssign)
     {
         nextToken();
-        auto expressionNode =
-            std::make_unique<ASTExpression>(expression(), lineNumber());
+        [[maybe_unused]] auto expressionNode =
+            make<ASTExpression>(expression(), lineNumber());
         // if node.nodeType <> ntPrimary then
         if (node->type() != ASTNodeType::ntPrimary)
         {
-            return std::make_unique<ASTErrorNode>(
+            return make<ASTErrorNode>(
                 "Expecting an identifier on the left-hand side",
                 lineNumber(),
                 columnNumber());
         }
 
         return nullptr; // temp
-        // return std::make_unique<ASTAssignment>(std::move(node), std::move(expressionNode), lineNumber());
+        // return make<ASTAssignment>(node, expressionNode, lineNumber());
     }
     else
     {
-        return std::make_unique<ASTExpressionStatement>(std::move(node),
-                                                        lineNumber());
+        return make<ASTExpressionStatement>(node, lineNumber());
     }
 }
 
@@ -143,7 +153,7 @@ std::unique_ptr<ASTNode> ASTBuilder::exprStatement()
 // ifEnd = END | ELSE statementList END
 // AST:
 // (if) -> (condition) and (thenStatementList) and (elseStatementList)
-std::unique_ptr<ASTNode> ASTBuilder::ifStatement()
+const ASTNode *ASTBuilder::ifStatement()
 {
     expect(TokenCode::tIf);
     auto condition = expression();
@@ -155,69 +165,63 @@ std::unique_ptr<ASTNode> ASTBuilder::ifStatement()
         nextToken();
         auto listOfElseStatements = statementList();
         expect(TokenCode::tEnd);
-        return std::make_unique<ASTIf>(std::move(condition),
-                                       std::move(listOfStatements),
-                                       std::move(listOfElseStatements),
-                                       lineNumber());
+        return make<ASTIf>(condition,
+                           listOfStatements,
+                           listOfElseStatements,
+                           lineNumber());
     }
     else
     {
         expect(TokenCode::tEnd);
-        return std::make_unique<ASTIf>(std::move(condition),
-                                       std::move(listOfStatements),
-                                       nullptr,
-                                       lineNumber());
+        return make<ASTIf>(condition, listOfStatements, nullptr, lineNumber());
     }
 }
 
 // letStatement = "let" identifier '=' expression
-std::unique_ptr<ASTNode> ASTBuilder::letStatement()
+const ASTNode *ASTBuilder::letStatement()
 {
     expect(TokenCode::tLet);
     auto lhs = variable();
     expect(TokenCode::tAssign);
     auto rhs = expression();
 
-    return std::make_unique<ASTLetStatement>(std::move(lhs),
-                                             std::move(rhs),
-                                             lineNumber());
+    return make<ASTLetStatement>(lhs, rhs, lineNumber());
 }
 
-std::unique_ptr<ASTNode> ASTBuilder::returnStmt()
+const ASTNode *ASTBuilder::returnStmt()
 {
     if (!inUserFunctionParsing)
     {
-        return std::make_unique<ASTErrorNode>(
+        return make<ASTErrorNode>(
             "You cannot use a return statement outside a user function",
             lineNumber(),
             columnNumber());
     }
     expect(TokenCode::tReturn);
-    return std::make_unique<ASTReturn>(
-        std::make_unique<ASTExpression>(expression(), lineNumber()),
-        lineNumber());
+    return make<ASTReturn>(make<ASTExpression>(expression(), lineNumber()),
+                           lineNumber());
 }
 
 // function = function identifier '(' argumentList ')' statementList
-std::unique_ptr<ASTNode> ASTBuilder::parseUserDefinedFunction()
+const ASTNode *ASTBuilder::parseUserDefinedFunction()
 {
-    std::string functionName;
+    std::string_view functionName;
     nextToken();
     if (code() == TokenCode::tIdentifier)
     {
-        functionName = sc_.token().tString();
+        functionName = arena_->copy(sc_.token().tString());
     }
     else
     {
-        return std::make_unique<ASTErrorNode>("expecting function name",
-                                              lineNumber(),
-                                              columnNumber());
+        return make<ASTErrorNode>("expecting function name",
+                                  lineNumber(),
+                                  columnNumber());
     }
 
     globalVariableList.clear();
     enterUserFunctionScope();
     nextToken();
-    std::unique_ptr<ASTNodeList> argList;
+    const ASTNodeList *argList = nullptr;
 
     if (code() == TokenCode::tLeftParenthesis)
     {
@@ -231,15 +235,15 @@ std::unique_ptr<ASTNode> ASTBuilder::parseUserDefinedFunction()
     globalVariableList.clear();
     expect(TokenCode::tEnd);
 
-    return std::make_unique<ASTUserFunction>(std::string(""),
-                                             functionName,
-                                             std::move(argList),
-                                             std::move(statementListNode),
-                                             lineNumber());
+    return make<ASTUserFunction>(std::string_view(),
+                                 functionName,
+                                 argList,
+                                 statementListNode,
+                                 lineNumber());
 }
 
 // expression = simpleExpression | simpleExpression relationalOp simpleExpression
-std::unique_ptr<ASTNode> ASTBuilder::expression()
+const ASTNode *ASTBuilder::expression()
 {
     auto leftNode = relationalOperators();
     while (code() == TokenCode::tOr || code() == TokenCode::tAnd)
@@ -249,17 +253,17 @@ std::unique_ptr<ASTNode> ASTBuilder::expression()
         auto rightNode = relationalOperators();
         if (op == TokenCode::tOr)
         {
-            leftNode = std::make_unique<ASTBinOp>(std::move(leftNode),
-                                                  std::move(rightNode),
-                                                  ASTNodeType::ntOR,
-                                                  lineNumber());
+            leftNode = make<ASTBinOp>(leftNode,
+                                      rightNode,
+                                      ASTNodeType::ntOR,
+                                      lineNumber());
         }
         else if (op == TokenCode::tAnd)
         {
-            leftNode = std::make_unique<ASTBinOp>(std::move(leftNode),
-                                                  std::move(rightNode),
-                                                  ASTNodeType::ntAND,
-                                                  lineNumber());
+            leftNode = make<ASTBinOp>(leftNode,
+                                      rightNode,
+                                      ASTNodeType::ntAND,
+                                      lineNumber());
         }
     }
     return leftNode;
@@ -268,40 +272,40 @@ std::unique_ptr<ASTNode> ASTBuilder::expression()
 // argumentList = argument { ',' argument }
 // AST:
 // nodeList -> (arg) and (arg) and (arg) and ....
-std::unique_ptr<ASTNodeList> ASTBuilder::functionArgumentList()
+const ASTNodeList *ASTBuilder::functionArgumentList()
 {
-    auto alist = std::make_unique<ASTNodeList>(ASTNodeType::ntNodeList);
+    size_t first = pending_.size();
     if (code() == TokenCode::tIdentifier)
     {
-        alist->add(functionArgument());
+        pending_.push_back(functionArgument());
     }
 
     while (code() == TokenCode::tComma)
     {
         nextToken();
-        alist->add(functionArgument());
+        pending_.push_back(functionArgument());
     }
 
-    return alist;
+    return makeList(ASTNodeType::ntNodeList, first);
 }
 
 // argument = identifier | REF identifier
-std::unique_ptr<ASTNode> ASTBuilder::functionArgument()
+const ASTNode *ASTBuilder::functionArgument()
 {
     return variable();
 }
 
 // Parse a function argument in a function definition
-std::unique_ptr<ASTIdentifier> ASTBuilder::variable()
+const ASTIdentifier *ASTBuilder::variable()
 {
-    auto ret =
-        std::make_unique<ASTIdentifier>(sc_.token().tString(), lineNumber());
+    auto ret = make<ASTIdentifier>(arena_->copy(sc_.token().tString()),
+                                   lineNumber());
     nextToken();
     return ret;
 }
 
 // expression = simpleExpression | simpleExpression relationalOp simpleExpression
-std::unique_ptr<ASTNode> ASTBuilder::relationalOperators()
+const ASTNode *ASTBuilder::relationalOperators()
 {
     auto leftNode = simpleExpression();
     while (code() == TokenCode::tLessThan ||
@@ -316,52 +320,52 @@ std::unique_ptr<ASTNode> ASTBuilder::relationalOperators()
 
         if (op == TokenCode::tEquivalence)
         {
-            leftNode = std::make_unique<ASTBinOp>(std::move(leftNode),
-                                                  std::move(rightNode),
-                                                  ASTNodeType::ntEQ,
-                                                  lineNumber());
+            leftNode = make<ASTBinOp>(leftNode,
+                                      rightNode,
+                                      ASTNodeType::ntEQ,
+                                      lineNumber());
         }
         else if (op == TokenCode::tLessThan)
         {
-            leftNode = std::make_unique<ASTBinOp>(std::move(leftNode),
-                                                  std::move(rightNode),
-                                                  ASTNodeType::ntLT,
-                                                  lineNumber());
+            leftNode = make<ASTBinOp>(leftNode,
+                                      rightNode,
+                                      ASTNodeType::ntLT,
+                                      lineNumber());
         }
         else if (op == TokenCode::tMoreThan)
         {
-            leftNode = std::make_unique<ASTBinOp>(std::move(leftNode),
-                                                  std::move(rightNode),
-                                                  ASTNodeType::ntGT,
-                                                  lineNumber());
+            leftNode = make<ASTBinOp>(leftNode,
+                                      rightNode,
+                                      ASTNodeType::ntGT,
+                                      lineNumber());
         }
         else if (op == TokenCode::tMoreThanOrEqual)
         {
-            leftNode = std::make_unique<ASTBinOp>(std::move(leftNode),
-                                                  std::move(rightNode),
-                                                  ASTNodeType::ntGE,
-                                                  lineNumber());
+            leftNode = make<ASTBinOp>(leftNode,
+                                      rightNode,
+                                      ASTNodeType::ntGE,
+                                      lineNumber());
         }
         else if (op == TokenCode::tLessThanOrEqual)
         {
-            leftNode = std::make_unique<ASTBinOp>(std::move(leftNode),
-                                                  std::move(rightNode),
-                                                  ASTNodeType::ntLE,
-                                                  lineNumber());
+            leftNode = make<ASTBinOp>(leftNode,
+                                      rightNode,
+                                      ASTNodeType::ntLE,
+                                      lineNumber());
         }
         else if (op == TokenCode::tNotEqual)
         {
-            leftNode = std::make_unique<ASTBinOp>(std::move(leftNode),
-                                                  std::move(rightNode),
-                                                  ASTNodeType::ntNE,
-                                                  lineNumber());
+            leftNode = make<ASTBinOp>(leftNode,
+                                      rightNode,
+                                      ASTNodeType::ntNE,
+                                      lineNumber());
         }
     }
     return leftNode;
 }
 
 // expression = term { ('+' | '-' | MOD | DIV) power }
-std::unique_ptr<ASTNode> ASTBuilder::simpleExpression()
+const ASTNode *ASTBuilder::simpleExpression()
 {
     auto leftNode = term();
     while (code() == TokenCode::tPlus || code() == TokenCode::tMinus)
@@ -371,24 +375,24 @@ std::unique_ptr<ASTNode> ASTBuilder::simpleExpression()
         auto rightNode = term();
         if (op == TokenCode::tPlus)
         {
-            leftNode = std::make_unique<ASTBinOp>(std::move(leftNode),
-                                                  std::move(rightNode),
-                                                  ASTNodeType::ntAdd,
-                                                  lineNumber());
+            leftNode = make<ASTBinOp>(leftNode,
+                                      rightNode,
+                                      ASTNodeType::ntAdd,
+                                      lineNumber());
         }
         else
         {
-            leftNode = std::make_unique<ASTBinOp>(std::move(leftNode),
-                                                  std::move(rightNode),
-                                                  ASTNodeType::ntSub,
-                                                  lineNumber());
+            leftNode = make<ASTBinOp>(leftNode,
+                                      rightNode,
+                                      ASTNodeType::ntSub,
+                                      lineNumber());
         }
     }
     return leftNode;
 }
 
 // term = power { ('*', '/', MOD, DIV) power }
-std::unique_ptr<ASTNode> ASTBuilder::term()
+const ASTNode *ASTBuilder::term()
 {
     auto leftNode = power();
     while (code() == TokenCode::tMult || code() == TokenCode::tDivide)
@@ -399,24 +403,24 @@ std::unique_ptr<ASTNode> ASTBuilder::term()
 
         if (op == TokenCode::tMult)
         {
-            leftNode = std::make_unique<ASTBinOp>(std::move(leftNode),
-                                                  std::move(rightNode),
-                                                  ASTNodeType::ntMult,
-                                                  lineNumber());
+            leftNode = make<ASTBinOp>(leftNode,
+                                      rightNode,
+                                      ASTNodeType::ntMult,
+                                      lineNumber());
         }
         else if (op == TokenCode::tDivide)
         {
-            leftNode = std::make_unique<ASTBinOp>(std::move(leftNode),
-                                                  std::move(rightNode),
-                                                  ASTNodeType::ntDiv,
-                                                  lineNumber());
+            leftNode = make<ASTBinOp>(leftNode,
+                                      rightNode,
+                                      ASTNodeType::ntDiv,
+                                      lineNumber());
         }
     }
     return leftNode;
 }
 
 // power = {'+' | '-'} factor [ '^' power ]
-std::unique_ptr<ASTNode> ASTBuilder::power()
+const ASTNode *ASTBuilder::power()
 {
     int unaryMinus_count = 0;
     while (code() == TokenCode::tMinus || code() == TokenCode::tPlus)
@@ -434,54 +438,52 @@ std::unique_ptr<ASTNode> ASTBuilder::power()
     {
         nextToken();
         auto rightNode = power();
-        leftNode = std::make_unique<ASTPowerOp>(std::move(leftNode),
-                                                std::move(rightNode),
-                                                lineNumber());
+        leftNode = make<ASTPowerOp>(leftNode, rightNode, lineNumber());
     }
 
     for (int i = 0; i < unaryMinus_count; ++i)
     {
-        leftNode = std::make_unique<ASTUniOp>(std::move(leftNode),
-                                              ASTNodeType::ntUnaryMinus,
-                                              lineNumber());
+        leftNode = make<ASTUniOp>(leftNode,
+                                  ASTNodeType::ntUnaryMinus,
+                                  lineNumber());
     }
     return leftNode;
 }
 
 // primary => factor primaryPlus
-std::unique_ptr<ASTNode> ASTBuilder::primary()
+const ASTNode *ASTBuilder::primary()
 {
-    return std::make_unique<ASTPrimary>(factor(), primaryPlus(), lineNumber());
+    // Arguments are evaluated in no particular order, the factor comes first.
+    auto factorNode = factor();
+    return make<ASTPrimary>(factorNode, primaryPlus(), lineNumber());
 }
 
 // factor = '(' expression ')' | variable | number | string | NOT factor | functionCall
-std::unique_ptr<ASTNode> ASTBuilder::factor()
+const ASTNode *ASTBuilder::factor()
 {
     if (code() == TokenCode::tInteger)
     {
-        auto result =
-            std::make_unique<ASTInteger>(token().tInt(), lineNumber());
+        auto result = make<ASTInteger>(token().tInt(), lineNumber());
         nextToken();
         return result;
     }
     else if (code() == TokenCode::tFloat)
     {
-        auto result =
-            std::make_unique<ASTFloat>(token().tFloat(), lineNumber());
+        auto result = make<ASTFloat>(token().tFloat(), lineNumber());
         nextToken();
         return result;
     }
     else if (code() == TokenCode::tIdentifier)
     {
-        auto result =
-            std::make_unique<ASTIdentifier>(token().tString(), lineNumber());
+        auto result = make<ASTIdentifier>(arena_->copy(token().tString()),
+                                          lineNumber());
         nextToken();
         return result;
     }
     else if (code() == TokenCode::tString)
     {
-        auto result =
-            std::make_unique<ASTString>(token().tString(), lineNumber());
+        auto result = make<ASTString>(arena_->copy(token().tString()),
+                                      lineNumber());
         nextToken();
         return result;
     }
@@ -493,17 +495,17 @@ std::unique_ptr<ASTNode> ASTBuilder::factor()
         {
             return node;
         }
-        return std::make_unique<ASTNotOp>(std::move(node), lineNumber());
+        return make<ASTNotOp>(node, lineNumber());
     }
     else if (code() == TokenCode::tFalse)
     {
-        auto result = std::make_unique<ASTBoolean>(false, lineNumber());
+        auto result = make<ASTBoolean>(false, lineNumber());
         nextToken();
         return result;
     }
     else if (code() == TokenCode::tTrue)
     {
-        auto result = std::make_unique<ASTBoolean>(true, lineNumber());
+        auto result = make<ASTBoolean>(true, lineNumber());
         nextToken();
         return result;
     }
@@ -515,7 +517,7 @@ std::unique_ptr<ASTNode> ASTBuilder::factor()
         {
             return node;
         }
-        return std::make_unique<ASTNotOp>(std::move(node), lineNumber());
+        return make<ASTNotOp>(node, lineNumber());
     }
     else if (code() == TokenCode::tLeftParenthesis)
     {
@@ -530,36 +532,35 @@ std::unique_ptr<ASTNode> ASTBuilder::factor()
     }
     else if (code() == TokenCode::tError)
     {
-        return std::make_unique<ASTErrorNode>("Expecting a factor...",
-                                              lineNumber(),
-                                              columnNumber());
+        return make<ASTErrorNode>("Expecting a factor...",
+                                  lineNumber(),
+                                  columnNumber());
     }
     else
     {
-        return std::make_unique<ASTErrorNode>("Expecting a factor...",
-                                              lineNumber(),
-                                              columnNumber());
+        return make<ASTErrorNode>("Expecting a factor...",
+                                  lineNumber(),
+                                  columnNumber());
     }
 }
 
-std::unique_ptr<ASTNode> ASTBuilder::primaryPlus()
+const ASTNode *ASTBuilder::primaryPlus()
 {
     if (code() == TokenCode::tLeftParenthesis)
     {
         nextToken();
-        return std::make_unique<ASTPrimaryFunction>(parseFunctionCall(),
-                                                    primaryPlus(),
-                                                    lineNumber());
+        auto argList = parseFunctionCall();
+        return make<ASTPrimaryFunction>(argList, primaryPlus(), lineNumber());
     }
     else
     {
-        return std::make_unique<ASTNull>();
+        return make<ASTNull>();
     }
 }
 
-std::unique_ptr<ASTNodeList> ASTBuilder::parseFunctionCall()
+const ASTNodeList *ASTBuilder::parseFunctionCall()
 {
-    std::unique_ptr<ASTNodeList> result = nullptr;
+    const ASTNodeList *result = nullptr;
     if (code() != TokenCode::tRightParenthesis)
     {
         result = expressionList();
@@ -568,22 +569,22 @@ std::unique_ptr<ASTNodeList> ASTBuilder::parseFunctionCall()
     expect(TokenCode::tRightParenthesis);
     if (result == nullptr)
     {
-        result = std::make_unique<ASTNodeList>(ASTNodeType::ntNodeList);
+        result = makeList(ASTNodeType::ntNodeList, pending_.size());
     }
     return result;
 }
 
 // argumentList = expression { ',' expression }
 // Returns the number of expressions that were parsed
-std::unique_ptr<ASTNodeList> ASTBuilder::expressionList()
+const ASTNodeList *ASTBuilder::expressionList()
 {
-    auto nodeList = std::make_unique<ASTNodeList>(ASTNodeType::ntNodeList);
-    nodeList->add(expression());
+    size_t first = pending_.size();
+    pending_.push_back(expression());
 
     while (code() == TokenCode::tComma)
     {
         nextToken();
-        nodeList->add(expression());
+        pending_.push_back(expression());
     }
-    return nodeList;
+    return makeList(ASTNodeType::ntNodeList, first);
 }
\ No newline at end of file
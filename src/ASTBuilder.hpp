@@ -2,39 +2,50 @@
 #define ASTCONSTRUCT_HPP_INCLUDED
 
 #include "ASTNode.hpp"
+#include "TArena.hpp"
 #include "Token.hpp"
 #include "TokenTable.hpp"
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 class ASTBuilder
 {
 public:
     explicit ASTBuilder(TokensTable &sc);
+    // The nodes are allocated in an arena the program owns.
     std::unique_ptr<ASTProgram> build();
 
 private:
-    std::unique_ptr<ASTNode> expect(TokenCode tc);
+    template <typename T, typename... Args>
+    T *make(Args &&...args)
+    {
+        return arena_->make<T>(std::forward<Args>(args)...);
+    }
+    const ASTNodeList *makeList(ASTNodeType type, size_t first);
+    const ASTNode *expect(TokenCode tc);
 
-    std::unique_ptr<ASTNodeList> statementList();
-    std::unique_ptr<ASTNodeList> functionArgumentList();
-    std::unique_ptr<ASTNode> statement();
-    std::unique_ptr<ASTNode> ifStatement();
-    std::unique_ptr<ASTNode> returnStmt();
-    std::unique_ptr<ASTNode> parseUserDefinedFunction();
-    std::unique_ptr<ASTNode> exprStatement();
-    std::unique_ptr<ASTNode> expression();
-    std::unique_ptr<ASTNode> functionArgument();
-    std::unique_ptr<ASTIdentifier> variable();
-    std::unique_ptr<ASTNode> relationalOperators();
-    std::unique_ptr<ASTNode> simpleExpression();
-    std::unique_ptr<ASTNode> term();
-    std::unique_ptr<ASTNode> power();
-    std::unique_ptr<ASTNode> primary();
-    std::unique_ptr<ASTNode> factor();
-    std::unique_ptr<ASTNode> primaryPlus();
-    std::unique_ptr<ASTNodeList> parseFunctionCall();
-    std::unique_ptr<ASTNodeList> expressionList();
-    std::unique_ptr<ASTNode> letStatement();
+    const ASTNodeList *statementList();
+    const ASTNodeList *functionArgumentList();
+    const ASTNode *statement();
+    const ASTNode *ifStatement();
+    const ASTNode *returnStmt();
+    const ASTNode *parseUserDefinedFunction();
+    const ASTNode *exprStatement();
+    const ASTNode *expression();
+    const ASTNode *functionArgument();
+    const ASTIdentifier *variable();
+    const ASTNode *relationalOperators();
+    const ASTNode *simpleExpression();
+    const ASTNode *term();
+    const ASTNode *power();
+    const ASTNode *primary();
+    const ASTNode *factor();
+    const ASTNode *primaryPlus();
+    const ASTNodeList *parseFunctionCall();
+    const ASTNodeList *expressionList();
+    const ASTNode *letStatement();
 
     void enterUserFunctionScope()
     {
@@ -66,6 +77,9 @@ private:
     }
 
     TokensTable &sc_;
+    std::unique_ptr<TArena> arena_;
+    // The items of the lists being built, innermost last.
+    std::vector<const ASTNode *> pending_;
     bool inUserFunctionParsing = false;
     std::vector<std::string> globalVariableList;
 };
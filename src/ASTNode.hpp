@@ -2,9 +2,15 @@
 #define ASTNODE_HPP_INCLUDED
 
 #include "ASTNodeTypes.hpp"
+#include "TArena.hpp"
+#include <cstddef>
 #include <memory>
-#include <vector>
+#include <span>
+#include <stdexcept>
+#include <string_view>
 
+// Nodes live in the arena of their ASTProgram and point to their children
+// without owning them, the whole tree is freed with the arena.
 class ASTNode
 {
 public:
@@ -30,47 +36,50 @@ protected:
 class ASTNodeList : public ASTNode
 {
 public:
-    ASTNodeList(ASTNodeType type) : ASTNode(type, 0)
+    // The items are an array of the arena.
+    ASTNodeList(ASTNodeType type, std::span<const ASTNode *const> items)
+        : ASTNode(type, 0), list_(items)
     {
     }
-    void add(std::unique_ptr<ASTNode> n)
-    {
-        list_.emplace_back(std::move(n));
-    }
     size_t size() const
     {
         return list_.size();
     }
-    auto begin()
+    auto begin() const
     {
         return list_.begin();
     }
-    auto end()
+    auto end() const
     {
         return list_.end();
     }
     auto cbegin() const
     {
-        return list_.cbegin();
+        return list_.begin();
     }
     auto cend() const
     {
-        return list_.cend();
+        return list_.end();
     }
     const ASTNode *at(size_t index) const
     {
-        return list_.at(index).get();
+        if (index >= list_.size())
+        {
+            throw std::out_of_range("ASTNodeList::at");
+        }
+        return list_[index];
     }
 
 private:
-    std::vector<std::unique_ptr<ASTNode>> list_;
+    std::span<const ASTNode *const> list_;
 };
 
 class ASTProgram : public ASTNode
 {
 public:
-    ASTProgram(std::unique_ptr<ASTNodeList> statements)
-        : ASTNode(ASTNodeType::ntProgram, 0), statements_(std::move(statements))
+    ASTProgram(std::unique_ptr<TArena> arena, const ASTNodeList *statements)
+        : ASTNode(ASTNodeType::ntProgram, 0), arena_(std::move(arena)),
+          statements_(statements)
     {
     }
 
@@ -78,247 +87,236 @@ public:
     {
         return statements_->size();
     }
-    auto begin()
-    {
-        return statements_->begin();
-    }
-    auto end()
-    {
-        return statements_->end();
-    }
     auto begin() const
     {
-        return statements_->cbegin();
+        return statements_->begin();
     }
     auto end() const
     {
-        return statements_->cend();
+        return statements_->end();
     }
     auto at(size_t index) const
     {
         return statements_->at(index);
     }
+    const TArena &arena() const
+    {
+        return *arena_;
+    }
 
 private:
-    std::unique_ptr<ASTNodeList> statements_;
+    std::unique_ptr<TArena> arena_;
+    const ASTNodeList *statements_;
 };
 
 class ASTErrorNode : public ASTNode
 {
 public:
-    ASTErrorNode(const std::string &msg, int lineNumber, int columnNumber)
+    ASTErrorNode(std::string_view msg, int lineNumber, int columnNumber)
         : ASTNode(ASTNodeType::ntError, lineNumber), errorMsg_(msg),
           columnNumber_(columnNumber)
     {
     }
 
 private:
-    std::string errorMsg_;
+    std::string_view errorMsg_;
     int columnNumber_ = 0;
 };
 
 class ASTPrimary : public ASTNode
 {
 public:
-    ASTPrimary(std::unique_ptr<ASTNode> factor,
-               std::unique_ptr<ASTNode> primaryPlus,
+    ASTPrimary(const ASTNode *factor,
+               const ASTNode *primaryPlus,
                int linenumber)
-        : ASTNode(ASTNodeType::ntPrimary, linenumber),
-          factor_(std::move(factor)), primaryPlus_(std::move(primaryPlus))
+        : ASTNode(ASTNodeType::ntPrimary, linenumber), factor_(factor),
+          primaryPlus_(primaryPlus)
     {
     }
     const ASTNode *factor() const
     {
-        return factor_.get();
+        return factor_;
     }
     const ASTNode *primaryPlus() const
     {
-        return primaryPlus_.get();
+        return primaryPlus_;
     }
 
 private:
-    std::unique_ptr<ASTNode> factor_;
-    std::unique_ptr<ASTNode> primaryPlus_;
+    const ASTNode *factor_;
+    const ASTNode *primaryPlus_;
 };
 
 class ASTExpression : public ASTNode
 {
 public:
-    ASTExpression(std::unique_ptr<ASTNode> expr, int lineNumber)
-        : ASTNode(ASTNodeType::ntExpression, lineNumber),
-          expression_(std::move(expr))
+    ASTExpression(const ASTNode *expr, int lineNumber)
+        : ASTNode(ASTNodeType::ntExpression, lineNumber), expression_(expr)
     {
     }
 
 private:
-    std::unique_ptr<ASTNode> expression_;
+    const ASTNode *expression_;
 };
 
 class ASTIdentifier : public ASTNode
 {
 public:
-    ASTIdentifier(const std::string &symbol, int linenumber)
+    ASTIdentifier(std::string_view symbol, int linenumber)
         : ASTNode(ASTNodeType::ntIdentifier, linenumber), symbolName_(symbol)
     {
     }
 
-    const std::string &value() const
+    std::string_view value() const
     {
         return symbolName_;
     }
 
 private:
-    std::string symbolName_;
+    std::string_view symbolName_;
 };
 
 class ASTLetStatement : public ASTNode
 {
 public:
-    ASTLetStatement(std::unique_ptr<ASTIdentifier> lhs,
-                    std::unique_ptr<ASTNode> rhs,
+    ASTLetStatement(const ASTIdentifier *lhs,
+                    const ASTNode *rhs,
                     int lineNumber)
-        : ASTNode(ASTNodeType::ntAssignment, lineNumber),
-          leftSide_(std::move(lhs)), rightSide_(std::move(rhs))
+        : ASTNode(ASTNodeType::ntAssignment, lineNumber), leftSide_(lhs),
+          rightSide_(rhs)
     {
     }
 
-    const std::string &identifierValue() const
+    std::string_view identifierValue() const
     {
         return leftSide_->value();
     }
     const ASTNode *rhs() const
     {
-        return rightSide_.get();
+        return rightSide_;
     }
 
 private:
-    std::unique_ptr<ASTIdentifier> leftSide_;
-    std::unique_ptr<ASTNode> rightSide_;
+    const ASTIdentifier *leftSide_;
+    const ASTNode *rightSide_;
 };
 
 class ASTAssignment : public ASTNode
 {
 public:
-    ASTAssignment(std::unique_ptr<ASTPrimary> lhs,
-                  std::unique_ptr<ASTNode> rhs,
+    ASTAssignment(const ASTPrimary *lhs,
+                  const ASTNode *rhs,
                   int lineNumber)
-        : ASTNode(ASTNodeType::ntAssignment, lineNumber),
-          leftSide_(std::move(lhs)), rightSide_(std::move(rhs))
+        : ASTNode(ASTNodeType::ntAssignment, lineNumber), leftSide_(lhs),
+          rightSide_(rhs)
     {
     }
 
 private:
-    std::unique_ptr<ASTPrimary> leftSide_;
-    std::unique_ptr<ASTNode> rightSide_;
+    const ASTPrimary *leftSide_;
+    const ASTNode *rightSide_;
 };
 
 class ASTExpressionStatement : public ASTNode
 {
 public:
-    ASTExpressionStatement(std::unique_ptr<ASTNode> expr, int lineNumber)
+    ASTExpressionStatement(const ASTNode *expr, int lineNumber)
         : ASTNode(ASTNodeType::ntExpressionStatement, lineNumber),
-          expression_(std::move(expr))
+          expression_(expr)
     {
     }
 
     const ASTNode *expression() const
     {
-        return expression_.get();
+        return expression_;
     }
 
 private:
-    std::unique_ptr<ASTNode> expression_;
+    const ASTNode *expression_;
 };
 
 class ASTIf : public ASTNode
 {
 public:
-    ASTIf(std::unique_ptr<ASTNode> condition,
-          std::unique_ptr<ASTNode> thenStmt,
-          std::unique_ptr<ASTNode> elseStmt,
+    ASTIf(const ASTNode *condition,
+          const ASTNode *thenStmt,
+          const ASTNode *elseStmt,
           int lineNumber)
-        : ASTNode(ASTNodeType::ntIf, lineNumber),
-          condition_(std::move(condition)),
-          thenStatementList_(std::move(thenStmt)),
-          elseStatementList_(std::move(elseStmt))
+        : ASTNode(ASTNodeType::ntIf, lineNumber), condition_(condition),
+          thenStatementList_(thenStmt), elseStatementList_(elseStmt)
     {
     }
 
 private:
-    std::unique_ptr<ASTNode> condition_;
-    std::unique_ptr<ASTNode> thenStatementList_;
-    std::unique_ptr<ASTNode> elseStatementList_;
+    const ASTNode *condition_;
+    const ASTNode *thenStatementList_;
+    const ASTNode *elseStatementList_;
 };
 
 class ASTReturn : public ASTNode
 {
 public:
-    ASTReturn(std::unique_ptr<ASTExpression> expr, int linenumber)
-        : ASTNode(ASTNodeType::ntReturn, linenumber),
-          expression_(std::move(expr))
+    ASTReturn(const ASTExpression *expr, int linenumber)
+        : ASTNode(ASTNodeType::ntReturn, linenumber), expression_(expr)
     {
     }
 
 private:
-    std::unique_ptr<ASTExpression> expression_;
+    const ASTExpression *expression_;
 };
 
 class ASTBinOp : public ASTNode
 {
 public:
-    ASTBinOp(std::unique_ptr<ASTNode> lhs,
-             std::unique_ptr<ASTNode> rhs,
+    ASTBinOp(const ASTNode *lhs,
+             const ASTNode *rhs,
              ASTNodeType nodeType,
              int linenumber)
-        : ASTNode(nodeType, linenumber), left_(std::move(lhs)),
-          right_(std::move(rhs))
+        : ASTNode(nodeType, linenumber), left_(lhs), right_(rhs)
     {
     }
     const auto *lhs() const
     {
-        return left_.get();
+        return left_;
     }
     const auto *rhs() const
     {
-        return right_.get();
+        return right_;
     }
 
 private:
-    std::unique_ptr<ASTNode> left_;
-    std::unique_ptr<ASTNode> right_;
+    const ASTNode *left_;
+    const ASTNode *right_;
 };
 
 class ASTPowerOp : public ASTNode
 {
 public:
-    ASTPowerOp(std::unique_ptr<ASTNode> lhs,
-               std::unique_ptr<ASTNode> rhs,
-               int linenumber)
-        : ASTNode(ASTNodeType::ntPower, linenumber), left_(std::move(lhs)),
-          right_(std::move(rhs))
+    ASTPowerOp(const ASTNode *lhs, const ASTNode *rhs, int linenumber)
+        : ASTNode(ASTNodeType::ntPower, linenumber), left_(lhs), right_(rhs)
     {
     }
 
 private:
-    std::unique_ptr<ASTNode> left_;
-    std::unique_ptr<ASTNode> right_;
+    const ASTNode *left_;
+    const ASTNode *right_;
 };
 
 class ASTUniOp : public ASTNode
 {
 public:
-    ASTUniOp(std::unique_ptr<ASTNode> left, ASTNodeType type, int linenumber)
-        : ASTNode(type, linenumber), left_(std::move(left))
+    ASTUniOp(const ASTNode *left, ASTNodeType type, int linenumber)
+        : ASTNode(type, linenumber), left_(left)
     {
     }
 
     const auto *left() const
     {
-        return left_.get();
+        return left_;
     }
 
 private:
-    std::unique_ptr<ASTNode> left_;
+    const ASTNode *left_;
 };
 
 class ASTPrimaryOp : public ASTNode
@@ -362,33 +360,33 @@ private:
 class ASTString : public ASTNode
 {
 public:
-    ASTString(const std::string &value, int lineNumber)
+    ASTString(std::string_view value, int lineNumber)
         : ASTNode(ASTNodeType::ntString, lineNumber), value_(value)
     {
     }
-    const std::string &value() const
+    std::string_view value() const
     {
         return value_;
     }
 
 private:
-    std::string value_;
+    std::string_view value_;
 };
 
 class ASTNotOp : public ASTNode
 {
 public:
-    ASTNotOp(std::unique_ptr<ASTNode> node, int linenumber)
-        : ASTNode(ASTNodeType::ntNOT, linenumber), expression_(std::move(node))
+    ASTNotOp(const ASTNode *node, int linenumber)
+        : ASTNode(ASTNodeType::ntNOT, linenumber), expression_(node)
     {
     }
     const ASTNode *expression() const
     {
-        return expression_.get();
+        return expression_;
     }
 
 private:
-    std::unique_ptr<ASTNode> expression_;
+    const ASTNode *expression_;
 };
 
 class ASTBoolean : public ASTNode
@@ -416,18 +414,25 @@ private:
 class ASTPrimaryFunction : public ASTNode
 {
 public:
-    ASTPrimaryFunction(std::unique_ptr<ASTNodeList> argList,
-                       std::unique_ptr<ASTNode> primaryPlus,
+    ASTPrimaryFunction(const ASTNodeList *argList,
+                       const ASTNode *primaryPlus,
                        int linenumber)
         : ASTNode(ASTNodeType::ntPrimaryFunction, linenumber),
-          argumentList_(std::move(argList)),
-          primaryPlus_(std::move(primaryPlus))
+          argumentList_(argList), primaryPlus_(primaryPlus)
+    {
+    }
+    const ASTNodeList *argumentList() const
+    {
+        return argumentList_;
+    }
+    const ASTNode *primaryPlus() const
     {
+        return primaryPlus_;
     }
 
 private:
-    std::unique_ptr<ASTNodeList> argumentList_;
-    std::unique_ptr<ASTNode> primaryPlus_;
+    const ASTNodeList *argumentList_;
+    const ASTNode *primaryPlus_;
 };
 
 class ASTNull : public ASTNode
@@ -443,35 +448,35 @@ private:
 class ASTUserFunction : public ASTNode
 {
 public:
-    ASTUserFunction(const std::string &moduleName,
-                    const std::string &functionName,
-                    std::unique_ptr<ASTNodeList> argList,
-                    std::unique_ptr<ASTNodeList> stmtList,
+    ASTUserFunction(std::string_view moduleName,
+                    std::string_view functionName,
+                    const ASTNodeList *argList,
+                    const ASTNodeList *stmtList,
                     int linenumber)
         : ASTNode(ASTNodeType::ntFunction, linenumber), moduleName_(moduleName),
-          functionName_(functionName), argumentList_(std::move(argList)),
-          statementList_(std::move(stmtList))
+          functionName_(functionName), argumentList_(argList),
+          statementList_(stmtList)
     {
     }
 
 private:
-    std::string moduleName_;
-    std::string functionName_;
-    std::unique_ptr<ASTNodeList> argumentList_;
-    std::unique_ptr<ASTNodeList> statementList_;
+    std::string_view moduleName_;
+    std::string_view functionName_;
+    const ASTNodeList *argumentList_;
+    const ASTNodeList *statementList_;
 };
 
 class ASTFunctionCall : public ASTNode
 {
 public:
-    ASTFunctionCall(std::unique_ptr<ASTNodeList> argList, int linenumber)
+    ASTFunctionCall(const ASTNodeList *argList, int linenumber)
         : ASTNode(ASTNodeType::ntFunctionCall, linenumber),
-          argumentList_(std::move(argList))
+          argumentList_(argList)
     {
     }
 
 private:
-    std::unique_ptr<ASTNodeList> argumentList_;
+    const ASTNodeList *argumentList_;
 };
 
 #endif
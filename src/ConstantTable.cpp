@@ -2,9 +2,24 @@
 
 #include "ConstantTable.hpp"
 
-TConstantValueTable constantValueTable;
-
 TConstantValueElement &TConstantValueTable::get(int index)
 {
     return table_[index - 1];
 }
+
+const TConstantValueElement &TConstantValueTable::get(int index) const
+{
+    return table_[index - 1];
+}
+
+void TConstantValueTable::clear()
+{
+    for (auto &elem : table_)
+    {
+        if (elem.type() == TConstantValueType::String)
+        {
+            delete elem.sobject();
+        }
+    }
+    table_.clear();
+}
@@ -38,6 +38,14 @@ public:
     {
         return svalue_->value();
     }
+    TStringObject *sobject() const
+    {
+        return svalue_;
+    }
+    TConstantValueType type() const
+    {
+        return valueType_;
+    }
 
 private:
     TConstantValueType valueType_;
@@ -45,14 +53,21 @@ private:
     double dvalue_;
 };
 
+// Owns the string objects of its String constants.
 class TConstantValueTable
 {
 public:
-    TConstantValueElement &get(int index);
-    void clear()
+    TConstantValueTable() = default;
+    TConstantValueTable(const TConstantValueTable &) = delete;
+    TConstantValueTable &operator=(const TConstantValueTable &) = delete;
+    ~TConstantValueTable()
     {
-        table_.clear();
+        clear();
     }
+
+    TConstantValueElement &get(int index);
+    const TConstantValueElement &get(int index) const;
+    void clear();
     template <typename T>
     void emplace_back(T &&entry)
     {
@@ -68,6 +83,4 @@ private:
     std::vector<TConstantValueElement> table_;
 };
 
-extern TConstantValueTable constantValueTable;
-
 #endif
\ No newline at end of file
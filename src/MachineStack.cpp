@@ -17,6 +17,10 @@ std::string TStackRecordTypeToStr(TStackRecordType type)
         return "STRING";
     case TStackRecordType::stList:
         return "LIST";
+    case TStackRecordType::stMatrix:
+        return "MATRIX";
+    case TStackRecordType::stChannel:
+        return "CHANNEL";
     }
     return "";
 }
@@ -51,12 +55,18 @@ void TMachineStack::push(TMachineStackRecord value)
     }
     else if (value.type() == TStackRecordType::stString)
     {
-        throw std::runtime_error(
-            "TMachineStack::push> Unknown type in push method");
+        stack_[stackTop_].setValue(value.svalue());
     }
     else if (value.type() == TStackRecordType::stList)
     {
-        throw std::runtime_error(
-            "TMachineStack::push> Unknown type in push method");
+        stack_[stackTop_].setValue(value.lvalue());
+    }
+    else if (value.type() == TStackRecordType::stMatrix)
+    {
+        stack_[stackTop_].setValue(value.mvalue());
+    }
+    else if (value.type() == TStackRecordType::stChannel)
+    {
+        stack_[stackTop_].setValue(value.cvalue());
     }
 }
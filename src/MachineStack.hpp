@@ -2,6 +2,7 @@
 #define MACHINESTACK_HPP_INCLUDED
 
 /* DONE */
+#include <algorithm>
 #include <array>
 #include <memory>
 #include <stack>
@@ -11,6 +12,8 @@
 
 class TStringObject;
 class TListObject;
+class TMatrixObject;
+class TChannelObject;
 
 // Define stack types
 enum class TStackRecordType
@@ -21,6 +24,8 @@ enum class TStackRecordType
     stBoolean,
     stString,
     stList,
+    stMatrix,
+    stChannel,
 };
 
 // Define the structure using std::variant for type safety
@@ -51,6 +56,14 @@ public:
     {
         return v.l;
     }
+    TMatrixObject *mvalue() const
+    {
+        return v.m;
+    }
+    TChannelObject *cvalue() const
+    {
+        return v.c;
+    }
     TStackRecordType type() const
     {
         return type_;
@@ -82,6 +95,16 @@ public:
         v.s = val;
         type_ = TStackRecordType::stString;
     }
+    void setValue(TMatrixObject *val)
+    {
+        v.m = val;
+        type_ = TStackRecordType::stMatrix;
+    }
+    void setValue(TChannelObject *val)
+    {
+        v.c = val;
+        type_ = TStackRecordType::stChannel;
+    }
     void setType(TStackRecordType type)
     {
         type_ = type;
@@ -94,6 +117,8 @@ private:
     {
         TListObject *l;
         TStringObject *s;
+        TMatrixObject *m;
+        TChannelObject *c;
         double d;
         int i;
         bool b;
@@ -110,7 +135,21 @@ public:
     }
     bool empty() const
     {
-        return stack_.empty();
+        return stackTop_ < 0;
+    }
+    void clear()
+    {
+        stackTop_ = -1;
+    }
+    // Copy the live part of the stack out and back in, see TSuspendedRun.
+    void save(std::vector<TMachineStackRecord> &records) const
+    {
+        records.assign(stack_.begin(), stack_.begin() + stackTop_ + 1);
+    }
+    void restore(const std::vector<TMachineStackRecord> &records)
+    {
+        std::copy(records.begin(), records.end(), stack_.begin());
+        stackTop_ = static_cast<int>(records.size()) - 1;
     }
     TMachineStackRecord &top()
     {
@@ -163,6 +202,18 @@ public:
     {
         stack_[++stackTop_].setValue(value);
     }
+    void push(TListObject *value)
+    {
+        stack_[++stackTop_].setValue(value);
+    }
+    void push(TMatrixObject *value)
+    {
+        stack_[++stackTop_].setValue(value);
+    }
+    void push(TChannelObject *value)
+    {
+        stack_[++stackTop_].setValue(value);
+    }
     void push(TMachineStackRecord value);
 
 private:
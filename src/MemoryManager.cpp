@@ -19,12 +19,6 @@ TMemoryNode *TMemoryList::addNode(TRhodusObject *node)
     return tail;
 }
 
-TMemoryList &TMemoryList::getInstance()
-{
-    static TMemoryList instance;
-    return instance;
-}
-
 TMemoryNode *TMemoryList::newNode(TRhodusObject *obj) const
 {
     auto node = new TMemoryNode();
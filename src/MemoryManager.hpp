@@ -67,7 +67,12 @@ struct TMemorySummary
 class TMemoryList
 {
 public:
-    static TMemoryList &getInstance();
+    TMemoryList() = default;
+    TMemoryList(const TMemoryList &) = delete;
+    TMemoryList &operator=(const TMemoryList &) = delete;
+
+    // Heap of the runtime entered on the calling thread, see TRuntime.
+    static TMemoryList &current();
 
     TMemoryNode *newNode(TRhodusObject *obj) const;
     TMemoryNode *addNode(TRhodusObject *robj);
@@ -18,6 +18,8 @@ std::string OpCodeToString(OpCode code)
         return "mult";
     case OpCode::Divide:
         return "divide";
+    case OpCode::DotProduct:
+        return "dotProduct";
     case OpCode::Mod:
         return "mod";
     case OpCode::Umi:
@@ -78,8 +80,22 @@ std::string OpCodeToString(OpCode code)
         return "jmpIfTrue";
     case OpCode::JmpIfFalse:
         return "jmpIfFalse";
+    case OpCode::CreateList:
+        return "createList";
+    case OpCode::LvecIdx:
+        return "lvecIdx";
+    case OpCode::SvecIdx:
+        return "svecIdx";
     case OpCode::Call:
         return "call";
+    case OpCode::BuiltIn:
+        return "builtIn";
+    case OpCode::ParallelMap:
+        return "parallelMap";
+    case OpCode::ParallelReduce:
+        return "parallelReduce";
+    case OpCode::Spawn:
+        return "spawn";
     case OpCode::Return:
         return "ret";
     }
@@ -15,6 +15,7 @@ enum class OpCode
     // Divi, // Integer division
     Mod, // Modulus of two integer values
     Divide,
+    DotProduct, // Pop two numeric lists and push their dot product
     Umi,
     Power,
     Inc, // Increment stack entry by arg
@@ -57,15 +58,19 @@ enum class OpCode
     JmpIfTrue,  // Relative jump if stack entry is True
     JmpIfFalse, // Relative jump if stack entry is False
 
-    // CreateList,    //
-    // LvecIdx,       // Load element from vector
-    // SvecIdx,       // Save element to vector
+    CreateList, // Pop operand number of items and push a list holding them
+    LvecIdx,    // Load element from vector
+    SvecIdx,    // Save element to vector
     // LocalLvecIdx,  // Load element from local vector
     // LocalSvecIdx,  // Save element to local vector
 
     // Calling routines
     Call, // Call a user defined function
-    // BuiltIn,  // Call a builin function
+    BuiltIn, // Call a built-in function, operand is its index
+    ParallelMap,    // Pop a list and a function index, push the mapped list
+    ParallelReduce, // Pop init, a list and a function index, push the fold
+    Spawn, // Pop operand arguments and a function index, run the function in
+           // an isolate and push the channel of its result
     Return, // Return from a function
 
     // Print,       // Pop the stack and write the item to stdout
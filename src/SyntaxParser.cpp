@@ -3,11 +3,16 @@
 
 SyntaxParser::SyntaxParser(Scanner &sc) : sc_(sc)
 {
+    tokenVector_.retain(sc.source());
 }
 
 std::optional<SyntaxError> SyntaxParser::syntaxCheck()
 {
     tokenVector_.clearCode();
+    // Growing the table copies every token so far. Scripts average 2.5 to 4
+    // characters a token, the rule module of the benchmarks 4, so a third
+    // of the source is enough for most and denser code grows once.
+    tokenVector_.reserve(sc_.sourceSize() / 3 + 1);
     nextToken();
 
     if (tokenVector_.token().code() != TokenCode::tEndofStream)
@@ -75,7 +80,8 @@ std::optional<SyntaxError> SyntaxParser::statement()
     }
     else if (tokenCode == TokenCode::tError)
     {
-        err = SyntaxError("Syntax error: " + tokenVector_.token().tString());
+        err = SyntaxError("Syntax error: " +
+                          std::string(tokenVector_.token().tString()));
     }
     else
     {
@@ -227,7 +233,8 @@ std::optional<SyntaxError> SyntaxParser::term()
         return err;
 
     while (tokenVector_.token().code() == TokenCode::tMult ||
-           tokenVector_.token().code() == TokenCode::tDivide)
+           tokenVector_.token().code() == TokenCode::tDivide ||
+           tokenVector_.token().code() == TokenCode::tDotproduct)
     {
         nextToken();
         err = power();
@@ -307,6 +314,20 @@ std::optional<SyntaxError> SyntaxParser::factor()
             return err;
         break;
     }
+    case (TokenCode::tLeftCurleyBracket):
+    {
+        nextToken();
+        if (tokenVector_.token().code() != TokenCode::tRightCurleyBracket)
+        {
+            err = expressionList();
+            if (err)
+                return err;
+        }
+        err = expect(TokenCode::tRightCurleyBracket);
+        if (err)
+            return err;
+        break;
+    }
     case (TokenCode::tNot):
     {
         nextToken();
@@ -341,6 +362,29 @@ std::optional<SyntaxError> SyntaxParser::primaryPlus()
         if (err)
             return err;
     }
+    else if (tokenVector_.token().code() == TokenCode::tLeftBracket)
+    {
+        nextToken();
+        auto err = expression();
+        if (err)
+            return err;
+
+        if (tokenVector_.token().code() == TokenCode::tComma)
+        {
+            nextToken();
+            err = expression();
+            if (err)
+                return err;
+        }
+
+        err = expect(TokenCode::tRightBracket);
+        if (err)
+            return err;
+
+        err = primaryPlus();
+        if (err)
+            return err;
+    }
     else if (tokenVector_.token().code() == TokenCode::tLeftParenthesis)
     {
         nextToken();
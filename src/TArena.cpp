@@ -0,0 +1,27 @@
+#include "TArena.hpp"
+
+#include <algorithm>
+
+void *TArena::allocateBlock(size_t size, size_t alignment)
+{
+    // Blocks double up to a limit, larger requests get a block of their own
+    // and the current block stays in use.
+    size_t needed = size + alignment - 1;
+    if (needed > kMaxBlockSize)
+    {
+        blocks_.emplace_back(new char[needed]);
+        auto p = (reinterpret_cast<uintptr_t>(blocks_.back().get()) +
+                  alignment - 1) &
+                 ~(alignment - 1);
+        return reinterpret_cast<void *>(p);
+    }
+    while (blockSize_ < needed)
+    {
+        blockSize_ *= 2;
+    }
+    blocks_.emplace_back(new char[blockSize_]);
+    pos_ = blocks_.back().get();
+    end_ = pos_ + blockSize_;
+    blockSize_ = std::min(blockSize_ * 2, kMaxBlockSize);
+    return allocate(size, alignment);
+}
@@ -0,0 +1,78 @@
+#ifndef TARENA_HPP_INCLUDED
+#define TARENA_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator for objects that die together. Memory comes from blocks of
+// growing size and is only given back with the arena, a block at a time;
+// destructors are never run, so objects must not own anything outside it.
+class TArena
+{
+public:
+    TArena() = default;
+    TArena(const TArena &) = delete;
+    TArena &operator=(const TArena &) = delete;
+
+    void *allocate(size_t size, size_t alignment)
+    {
+        auto p = (reinterpret_cast<uintptr_t>(pos_) + alignment - 1) &
+                 ~(alignment - 1);
+        if (pos_ == nullptr || p + size > reinterpret_cast<uintptr_t>(end_))
+        {
+            return allocateBlock(size, alignment);
+        }
+        pos_ = reinterpret_cast<char *>(p + size);
+        return reinterpret_cast<void *>(p);
+    }
+    template <typename T, typename... Args>
+    T *make(Args &&...args)
+    {
+        static_assert(alignof(T) <= alignof(std::max_align_t));
+        return new (allocate(sizeof(T), alignof(T)))
+            T(std::forward<Args>(args)...);
+    }
+    template <typename T>
+    std::span<const T> copy(std::span<const T> items)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (items.empty())
+        {
+            return {};
+        }
+        auto *p = static_cast<T *>(allocate(items.size_bytes(), alignof(T)));
+        std::memcpy(p, items.data(), items.size_bytes());
+        return {p, items.size()};
+    }
+    std::string_view copy(std::string_view text)
+    {
+        auto chars = copy(std::span<const char>(text.data(), text.size()));
+        return {chars.data(), chars.size()};
+    }
+
+    size_t blockCount() const
+    {
+        return blocks_.size();
+    }
+
+private:
+    void *allocateBlock(size_t size, size_t alignment);
+
+    static constexpr size_t kFirstBlockSize = 4096;
+    static constexpr size_t kMaxBlockSize = 1 << 20;
+
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    size_t blockSize_ = kFirstBlockSize;
+    char *pos_ = nullptr;
+    char *end_ = nullptr;
+};
+
+#endif
@@ -0,0 +1,16 @@
+#include "TAtomTable.hpp"
+
+int TAtomTable::intern(std::string_view name)
+{
+    uint32_t h = TNameIndex::hash(name);
+    int atom = index_.find(name, h, [this](int id) -> std::string_view {
+        return names_[id];
+    });
+    if (atom < 0)
+    {
+        atom = static_cast<int>(names_.size());
+        names_.emplace_back(name);
+        index_.add(h);
+    }
+    return atom;
+}
@@ -0,0 +1,37 @@
+#ifndef TATOMTABLE_HPP_INCLUDED
+#define TATOMTABLE_HPP_INCLUDED
+
+#include "TNameIndex.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Interned identifiers. Every distinct name is stored once and known by a
+// dense id from then on, so that tokens carry an int instead of a string.
+class TAtomTable
+{
+public:
+    // Returns the id of the name, adding it the first time it is seen.
+    int intern(std::string_view name);
+    const std::string &name(int atom) const
+    {
+        return names_[atom];
+    }
+    // The TNameIndex hash of the name, symbol tables look it up by it.
+    uint32_t hash(int atom) const
+    {
+        return index_.hashOf(atom);
+    }
+    size_t size() const
+    {
+        return names_.size();
+    }
+
+private:
+    std::vector<std::string> names_;
+    TNameIndex index_;
+};
+
+#endif
@@ -0,0 +1,392 @@
+#include "TBuiltIns.hpp"
+
+#include <climits>
+#include <stdexcept>
+#include <vector>
+
+#include "MachineStack.hpp"
+#include "TChannel.hpp"
+#include "TListObject.hpp"
+#include "TMatrixObject.hpp"
+#include "TThreadPool.hpp"
+#include "VectorKernels.hpp"
+
+namespace
+{
+
+/*
+ * Packed numeric contents of a list or matrix. Integer and double lists
+ * and matrices are read in place, mixed lists are copied into a packed
+ * array once.
+ */
+class TNumericView
+{
+public:
+    TNumericView(const TMachineStackRecord &record, const std::string &fn)
+    {
+        if (record.type() == TStackRecordType::stMatrix)
+        {
+            size_ = record.mvalue()->rows() * record.mvalue()->cols();
+            doubles_ = record.mvalue()->data();
+            return;
+        }
+        if (record.type() != TStackRecordType::stList)
+        {
+            throw std::runtime_error(fn + " expects a list of numbers");
+        }
+        const TListObject *list = record.lvalue();
+        size_ = list->size();
+        if (list->storage() == TListStorage::lsInteger)
+        {
+            isInteger_ = true;
+            ints_ = list->intData();
+        }
+        else if (list->storage() == TListStorage::lsDouble)
+        {
+            doubles_ = list->doubleData();
+        }
+        else
+        {
+            unpack(list, fn);
+        }
+    }
+
+    bool isInteger() const
+    {
+        return isInteger_;
+    }
+    size_t size() const
+    {
+        return size_;
+    }
+    const int64_t *ints() const
+    {
+        return ints_;
+    }
+    const double *doubles()
+    {
+        if (doubles_ == nullptr)
+        {
+            ownedDoubles_.assign(ints_, ints_ + size_);
+            doubles_ = ownedDoubles_.data();
+        }
+        return doubles_;
+    }
+
+private:
+    void unpack(const TListObject *list, const std::string &fn)
+    {
+        bool allIntegers = true;
+        for (size_t i = 0; i < size_; ++i)
+        {
+            auto item = list->get(static_cast<int>(i));
+            if (item.type() == TListItemType::liInteger)
+            {
+                ownedDoubles_.push_back(item.ivalue());
+            }
+            else if (item.type() == TListItemType::liDouble)
+            {
+                ownedDoubles_.push_back(item.dvalue());
+                allIntegers = false;
+            }
+            else
+            {
+                throw std::runtime_error(fn + " expects a list of numbers");
+            }
+        }
+
+        isInteger_ = allIntegers;
+        if (allIntegers)
+        {
+            ownedInts_.assign(ownedDoubles_.begin(), ownedDoubles_.end());
+            ints_ = ownedInts_.data();
+        }
+        else
+        {
+            doubles_ = ownedDoubles_.data();
+        }
+    }
+
+    bool isInteger_ = false;
+    size_t size_ = 0;
+    const int64_t *ints_ = nullptr;
+    const double *doubles_ = nullptr;
+    std::vector<int64_t> ownedInts_;
+    std::vector<double> ownedDoubles_;
+};
+
+// Integer results stay integers unless they overflow the VM's int.
+void pushInteger(TMachineStack &stack, int64_t value)
+{
+    if (value >= INT_MIN && value <= INT_MAX)
+    {
+        stack.push(static_cast<int>(value));
+    }
+    else
+    {
+        stack.push(static_cast<double>(value));
+    }
+}
+
+void checkNotEmpty(const TNumericView &view, const std::string &fn)
+{
+    if (view.size() == 0)
+    {
+        throw std::runtime_error(fn + " of an empty list");
+    }
+}
+
+void sumFunction(TMachineStack &stack)
+{
+    TNumericView view(stack.pop(), "sum");
+    const auto &kernels = TVectorKernels::best();
+    if (view.isInteger())
+    {
+        pushInteger(stack, kernels.sumi(view.ints(), view.size()));
+    }
+    else
+    {
+        stack.push(kernels.sumd(view.doubles(), view.size()));
+    }
+}
+
+void meanFunction(TMachineStack &stack)
+{
+    TNumericView view(stack.pop(), "mean");
+    checkNotEmpty(view, "mean");
+    const auto &kernels = TVectorKernels::best();
+    double sum = 0.;
+    if (view.isInteger())
+    {
+        sum = static_cast<double>(kernels.sumi(view.ints(), view.size()));
+    }
+    else
+    {
+        sum = kernels.sumd(view.doubles(), view.size());
+    }
+    stack.push(sum / static_cast<double>(view.size()));
+}
+
+void minFunction(TMachineStack &stack)
+{
+    TNumericView view(stack.pop(), "min");
+    checkNotEmpty(view, "min");
+    const auto &kernels = TVectorKernels::best();
+    if (view.isInteger())
+    {
+        pushInteger(stack, kernels.mini(view.ints(), view.size()));
+    }
+    else
+    {
+        stack.push(kernels.mind(view.doubles(), view.size()));
+    }
+}
+
+void maxFunction(TMachineStack &stack)
+{
+    TNumericView view(stack.pop(), "max");
+    checkNotEmpty(view, "max");
+    const auto &kernels = TVectorKernels::best();
+    if (view.isInteger())
+    {
+        pushInteger(stack, kernels.maxi(view.ints(), view.size()));
+    }
+    else
+    {
+        stack.push(kernels.maxd(view.doubles(), view.size()));
+    }
+}
+
+int sizeArgument(const TMachineStackRecord &record, const std::string &fn)
+{
+    if (record.type() != TStackRecordType::stInteger || record.ivalue() < 0)
+    {
+        throw std::runtime_error(fn + " expects non-negative integer sizes");
+    }
+    return record.ivalue();
+}
+
+TMatrixObject *matrixArgument(const TMachineStackRecord &record,
+                              const std::string &fn)
+{
+    if (record.type() != TStackRecordType::stMatrix)
+    {
+        throw std::runtime_error(fn + " expects a matrix");
+    }
+    return record.mvalue();
+}
+
+void matrixFunction(TMachineStack &stack)
+{
+    const auto &record = stack.pop();
+    if (record.type() != TStackRecordType::stList)
+    {
+        throw std::runtime_error("matrix expects a list of rows");
+    }
+    stack.push(TMatrixObject::fromList(record.lvalue()));
+}
+
+void zerosFunction(TMachineStack &stack)
+{
+    int cols = sizeArgument(stack.pop(), "zeros");
+    int rows = sizeArgument(stack.pop(), "zeros");
+    stack.push(TMatrixObject::createObject(rows, cols));
+}
+
+void identityFunction(TMachineStack &stack)
+{
+    stack.push(TMatrixObject::identity(sizeArgument(stack.pop(), "identity")));
+}
+
+void transposeFunction(TMachineStack &stack)
+{
+    stack.push(
+        TMatrixObject::transpose(matrixArgument(stack.pop(), "transpose")));
+}
+
+void rowsFunction(TMachineStack &stack)
+{
+    stack.push(static_cast<int>(matrixArgument(stack.pop(), "rows")->rows()));
+}
+
+void colsFunction(TMachineStack &stack)
+{
+    stack.push(static_cast<int>(matrixArgument(stack.pop(), "cols")->cols()));
+}
+
+// Below this many multiply-adds a product is not worth handing to the pool.
+constexpr size_t kParallelMatrixWork = size_t(1) << 18;
+
+void matrixProduct(TMachineStack &stack)
+{
+    auto *b = matrixArgument(stack.pop(), "Matrix product");
+    auto *a = matrixArgument(stack.pop(), "Matrix product");
+    size_t work = a->rows() * a->cols() * b->cols();
+    TThreadPool *pool =
+        work >= kParallelMatrixWork ? &TThreadPool::shared() : nullptr;
+    stack.push(TMatrixObject::multiply(a, b, pool));
+}
+
+TChannel &channelArgument(const TMachineStackRecord &record,
+                          const std::string &fn)
+{
+    if (record.type() != TStackRecordType::stChannel)
+    {
+        throw std::runtime_error(fn + " expects a channel");
+    }
+    return record.cvalue()->channel();
+}
+
+void channelFunction(TMachineStack &stack)
+{
+    const auto &record = stack.pop();
+    if (record.type() != TStackRecordType::stInteger || record.ivalue() < 1)
+    {
+        throw std::runtime_error("channel expects a positive capacity");
+    }
+    stack.push(TChannelObject::createObject(
+        std::make_shared<TChannel>(record.ivalue())));
+}
+
+// send(c, value) pushes true once the value is queued.
+void sendFunction(TMachineStack &stack)
+{
+    auto message = TMessage::pack(stack.pop());
+    channelArgument(stack.pop(), "send").send(std::move(message));
+    stack.push(true);
+}
+
+void recvFunction(TMachineStack &stack)
+{
+    auto &channel = channelArgument(stack.pop(), "recv");
+    TMessage message;
+    if (!channel.recv(message))
+    {
+        throw std::runtime_error(channel.error().empty()
+                                     ? "recv on a closed channel"
+                                     : channel.error());
+    }
+    stack.push(message.unpack());
+}
+
+void closeFunction(TMachineStack &stack)
+{
+    channelArgument(stack.pop(), "close").close();
+    stack.push(true);
+}
+
+const std::vector<TBuiltIn> builtIns = {
+    {"sum", 1, sumFunction},
+    {"mean", 1, meanFunction},
+    {"min", 1, minFunction},
+    {"max", 1, maxFunction},
+    {"matrix", 1, matrixFunction},
+    {"zeros", 2, zerosFunction},
+    {"identity", 1, identityFunction},
+    {"transpose", 1, transposeFunction},
+    {"rows", 1, rowsFunction},
+    {"cols", 1, colsFunction},
+    {"channel", 1, channelFunction},
+    {"send", 2, sendFunction},
+    {"recv", 1, recvFunction},
+    {"close", 1, closeFunction},
+};
+
+} // namespace
+
+bool TBuiltIns::find(const std::string &name, int &index)
+{
+    for (size_t i = 0; i < builtIns.size(); ++i)
+    {
+        if (builtIns[i].name == name)
+        {
+            index = static_cast<int>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+const TBuiltIn &TBuiltIns::get(int index)
+{
+    return builtIns.at(index);
+}
+
+size_t TBuiltIns::size()
+{
+    return builtIns.size();
+}
+
+void TBuiltIns::dotProduct(TMachineStack &stack)
+{
+    bool xMatrix = stack[stack.topIndex() - 1].type() ==
+                   TStackRecordType::stMatrix;
+    bool yMatrix = stack.ctop().type() == TStackRecordType::stMatrix;
+    if (xMatrix && yMatrix)
+    {
+        matrixProduct(stack);
+        return;
+    }
+    if (xMatrix || yMatrix)
+    {
+        throw std::runtime_error("Dot product of a matrix and a list");
+    }
+
+    TNumericView y(stack.pop(), "Dot product");
+    TNumericView x(stack.pop(), "Dot product");
+    if (x.size() != y.size())
+    {
+        throw std::runtime_error(
+            "Lists must have the same length in a dot product");
+    }
+
+    const auto &kernels = TVectorKernels::best();
+    if (x.isInteger() && y.isInteger())
+    {
+        pushInteger(stack, kernels.doti(x.ints(), y.ints(), x.size()));
+    }
+    else
+    {
+        stack.push(kernels.dotd(x.doubles(), y.doubles(), x.size()));
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef TBUILTINS_HPP_INCLUDED
+#define TBUILTINS_HPP_INCLUDED
+
+#include <cstddef>
+#include <string>
+
+class TMachineStack;
+
+// A built-in pops its arguments off the stack and pushes its result.
+using TBuiltInFunction = void (*)(TMachineStack &stack);
+
+struct TBuiltIn
+{
+    std::string name;
+    int nArgs;
+    TBuiltInFunction function;
+};
+
+class TBuiltIns
+{
+public:
+    static bool find(const std::string &name, int &index);
+    static const TBuiltIn &get(int index);
+    static size_t size();
+
+    // Backs the '@' operator, TOS1 @ TOS: the dot product of two numeric
+    // lists or the product of two matrices.
+    static void dotProduct(TMachineStack &stack);
+};
+
+#endif
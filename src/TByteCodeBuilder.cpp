@@ -1,7 +1,11 @@
 #include "TByteCodeBuilder.hpp"
+#include "TBuiltIns.hpp"
 #include "TModule.hpp"
+#include "TThreadPool.hpp"
 #include "lexer.hpp"
+#include <algorithm>
 #include <assert.h>
+#include <exception>
 #include <sstream>
 
 void TByteCodeBuilder::expect(TokenCode tcode)
@@ -22,15 +26,107 @@ void TByteCodeBuilder::expect(TokenCode tcode)
 // program = statementList
 void TByteCodeBuilder::build(TModule *module)
 {
-    sc_.reset();
-    sc_.setMode(TokensTable::Mode::Reading);
-    nextToken();
-
+    seek(0);
     module_ = module;
     statementList(module_->code());
     module_->code().addByteCode(OpCode::Halt);
 }
 
+void TByteCodeBuilder::build(TModule *module, TThreadPool &pool)
+{
+    if (pool.size() == 0)
+    {
+        return build(module);
+    }
+
+    std::vector<TDeferredBody> bodies;
+    std::exception_ptr topLevelError;
+    deferred_ = &bodies;
+    try
+    {
+        build(module);
+    }
+    catch (...)
+    {
+        topLevelError = std::current_exception();
+    }
+    deferred_ = nullptr;
+
+    // Report the error a sequential build would: the first in the source.
+    // Every deferred body comes before the point the top level failed at.
+    // Bodies are handed out in runs, most of them are only a few lines.
+    std::vector<std::exception_ptr> errors(bodies.size());
+    size_t nChunks = std::min(bodies.size(), (pool.size() + 1) * 8);
+    pool.parallelFor(nChunks, [&](size_t chunk) {
+        TByteCodeBuilder builder(sc_);
+        size_t end = (chunk + 1) * bodies.size() / nChunks;
+        for (size_t i = chunk * bodies.size() / nChunks; i < end; ++i)
+        {
+            try
+            {
+                builder.buildBody(module, bodies[i]);
+            }
+            catch (...)
+            {
+                errors[i] = std::current_exception();
+            }
+        }
+    });
+    for (const auto &error : errors)
+    {
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+    if (topLevelError)
+    {
+        std::rethrow_exception(topLevelError);
+    }
+}
+
+void TByteCodeBuilder::buildLazy(TModule *module,
+                                 std::shared_ptr<TokensTable> tokens)
+{
+    std::vector<TDeferredBody> bodies;
+    TByteCodeBuilder builder(*tokens);
+    builder.deferred_ = &bodies;
+    builder.build(module);
+
+    TokensTable *table = tokens.get();
+    for (const auto &body : bodies)
+    {
+        body.function->setLazyBody([module, table, body](TUserFunction &) {
+            TByteCodeBuilder bodyBuilder(*table);
+            bodyBuilder.buildBody(module, body);
+        });
+    }
+    module->keepAlive(std::move(tokens));
+}
+
+void TByteCodeBuilder::buildBody(TModule *module, const TDeferredBody &body)
+{
+    module_ = module;
+    currentUserFunction = body.function;
+    nVisibleSymbols_ = body.nVisibleSymbols;
+    // The builder may come from a body that failed half way.
+    inVariableDefinition_ = false;
+    lastIndexDepth_ = 0;
+    enterUserFunctionScope();
+    seek(body.position);
+    functionBody();
+}
+
+// A body compiled on its own only sees the module symbols a sequential
+// build had defined when it got to the body.
+bool TByteCodeBuilder::findSymbol(const std::string &name,
+                                  uint32_t hash,
+                                  int &index)
+{
+    return symboltable().find(name, hash, index) &&
+           (nVisibleSymbols_ < 0 || index < nVisibleSymbols_);
+}
+
 // statementList = statement { statement }
 void TByteCodeBuilder::statementList(TProgram &program)
 {
@@ -114,6 +210,17 @@ void TByteCodeBuilder::exprStatement(TProgram &program)
         {
             bytecode.opCode = OpCode::StoreLocal;
         }
+        else if (bytecode.opCode == OpCode::LvecIdx)
+        {
+            // Only the outermost list can be assigned into, an inner list
+            // loaded by LvecIdx may still share its buffer with a copy.
+            if (lastIndexDepth_ > 1)
+            {
+                throw std::runtime_error(
+                    "Nested list element cannot be assigned to");
+            }
+            bytecode.opCode = OpCode::SvecIdx;
+        }
         else
         {
             throw std::runtime_error("Left-hand side cannot be assigned to");
@@ -267,11 +374,12 @@ void TByteCodeBuilder::simpleExpression(TProgram &program)
     }
 }
 
-// term = power { ('*', '/', MOD, DIV) power }
+// term = power { ('*', '/', '@', MOD, DIV) power }
 void TByteCodeBuilder::term(TProgram &program)
 {
     power(program);
-    while (code() == TokenCode::tMult || code() == TokenCode::tDivide)
+    while (code() == TokenCode::tMult || code() == TokenCode::tDivide ||
+           code() == TokenCode::tDotproduct)
     {
         auto op = code();
         nextToken();
@@ -284,6 +392,10 @@ void TByteCodeBuilder::term(TProgram &program)
         {
             program.addByteCode(OpCode::Divide);
         }
+        else if (op == TokenCode::tDotproduct)
+        {
+            program.addByteCode(OpCode::DotProduct);
+        }
     }
 }
 
@@ -323,7 +435,7 @@ void TByteCodeBuilder::factor(TProgram &program)
     }
     else if (code() == TokenCode::tFloat)
     {
-        program.addByteCode(OpCode::Pushd, token().tFloat());
+        program.addByteCode(OpCode::Pushd, token().tFloat(), constants());
         nextToken();
     }
     else if (code() == TokenCode::tLeftParenthesis)
@@ -338,9 +450,22 @@ void TByteCodeBuilder::factor(TProgram &program)
     }
     else if (code() == TokenCode::tString)
     {
-        program.addByteCode(OpCode::Pushs, token().tString());
+        program.addByteCode(OpCode::Pushs,
+                            std::string(token().tString()),
+                            constants());
         nextToken();
     }
+    else if (code() == TokenCode::tLeftCurleyBracket)
+    {
+        nextToken();
+        int nItems = 0;
+        if (code() != TokenCode::tRightCurleyBracket)
+        {
+            nItems = expressionList(program);
+        }
+        expect(TokenCode::tRightCurleyBracket);
+        program.addByteCode(OpCode::CreateList, nItems);
+    }
     else if (code() == TokenCode::tNot)
     {
         nextToken();
@@ -381,10 +506,10 @@ int TByteCodeBuilder::expressionList(TProgram &program)
 }
 
 void TByteCodeBuilder::parseFunctionCall(TProgram &program,
+                                         const std::string &identifier,
                                          int expectedArguments)
 {
     int nArguments = 0;
-    auto identifier = token().tString();
     nextToken();
     if (code() != TokenCode::tRightParenthesis)
     {
@@ -393,9 +518,65 @@ void TByteCodeBuilder::parseFunctionCall(TProgram &program,
     if (nArguments != expectedArguments)
     {
         throw std::runtime_error("incorrect number of arguments in function "
-                                 "call: [' + identifier + ']");
+                                 "call: [" +
+                                 identifier + "]");
+    }
+    expect(TokenCode::tRightParenthesis);
+}
+
+// pmap(f, list), preduce(f, list, init) and spawn(f, args...). Functions
+// are no values, so f must name a user function; its symbol index is
+// pushed in its place. The call takes as many more arguments as f does.
+void TByteCodeBuilder::functionArgumentCall(TProgram &program,
+                                            const std::string &identifier)
+{
+    expect(TokenCode::tLeftParenthesis);
+    int index = 0;
+    if (code() != TokenCode::tIdentifier ||
+        !findSymbol(name(), nameHash(), index) ||
+        symboltable().get(index).type() != TSymbolElementType::symUserFunc)
+    {
+        throw std::runtime_error(identifier +
+                                 " expects the name of a user function");
+    }
+
+    int nArguments = symboltable().get(index).fvalue()->numberOfArguments();
+    int expectedArguments = nArguments;
+    if (identifier == "pmap")
+    {
+        expectedArguments = 1;
+    }
+    else if (identifier == "preduce")
+    {
+        expectedArguments = 2;
+    }
+    if (nArguments != expectedArguments)
+    {
+        throw std::runtime_error(identifier + " expects a function of " +
+                                 std::to_string(expectedArguments) +
+                                 " arguments");
+    }
+    nextToken();
+    program.addByteCode(OpCode::Pushi, index);
+
+    for (int i = 0; i < nArguments; ++i)
+    {
+        expect(TokenCode::tComma);
+        expression(program);
     }
     expect(TokenCode::tRightParenthesis);
+    if (identifier == "pmap")
+    {
+        program.addByteCode(OpCode::ParallelMap);
+    }
+    else if (identifier == "preduce")
+    {
+        program.addByteCode(OpCode::ParallelReduce);
+    }
+    else
+    {
+        program.addByteCode(OpCode::Spawn, nArguments);
+    }
 }
 
 // There are a number of places where we will find identifiers:
@@ -405,7 +586,8 @@ void TByteCodeBuilder::parseFunctionCall(TProgram &program,
 void TByteCodeBuilder::parseIdentifier(TProgram &program)
 {
     // bool globalVariable = false;
-    auto identifier = token().tString();
+    const std::string &identifier = name();
+    uint32_t hash = nameHash();
     nextToken();
     int index = 0;
 
@@ -414,13 +596,13 @@ void TByteCodeBuilder::parseIdentifier(TProgram &program)
         // It's the start of a function call, eg func (1,2)
         // Check that the function already exists in the main symbol table
         // We do a reverse search, look for most recent declared functions
-        if (symboltable().find(identifier, index))
+        if (findSymbol(identifier, hash, index))
         {
             if (symboltable().get(index).type() ==
                 TSymbolElementType::symUserFunc)
             {
                 parseFunctionCall(
-                    program,
+                    program, identifier,
                     symboltable().get(index).fvalue()->numberOfArguments());
                 program.addByteCode(OpCode::Pushi, index);
                 program.addByteCode(OpCode::Call);
@@ -435,10 +617,23 @@ void TByteCodeBuilder::parseIdentifier(TProgram &program)
                     identifier + "]");
             }
         }
+        else if (identifier == "pmap" || identifier == "preduce" ||
+                 identifier == "spawn")
+        {
+            functionArgumentCall(program, identifier);
+            return;
+        }
+        else if (TBuiltIns::find(identifier, index))
+        {
+            parseFunctionCall(program, identifier,
+                              TBuiltIns::get(index).nArgs);
+            program.addByteCode(OpCode::BuiltIn, index);
+            return;
+        }
         else
         {
-            throw std::runtime_error("TByteCodeBuilder>Builtin function "
-                                     "reading not yet implemented");
+            throw std::runtime_error("Undefined function: [" + identifier +
+                                     "]");
         }
     }
 
@@ -455,7 +650,9 @@ void TByteCodeBuilder::parseIdentifier(TProgram &program)
     if (inUserFunctionScope())
     {
         bool localfound =
-            currentUserFunction->symboltable().find(identifier, localindex);
+            currentUserFunction->symboltable().find(identifier,
+                                                    hash,
+                                                    localindex);
         bool globalfound =
             currentUserFunction->globalVariableList().find(identifier,
                                                            globalindex);
@@ -473,36 +670,31 @@ void TByteCodeBuilder::parseIdentifier(TProgram &program)
                 globalVariable = true;
             }
 
-            if (code() == TokenCode::tLeftBracket)
+            if (localVariable)
             {
-                throw std::runtime_error("Implementation missing");
+                program.addByteCode(OpCode::LoadLocal, localindex);
+            }
+            else if (globalVariable)
+            {
+                program.addByteCode(
+                    OpCode::Load,
+                    currentUserFunction->globalVariableList()[globalindex],
+                    constants());
             }
             else
             {
-                if (localVariable)
-                {
-                    program.addByteCode(OpCode::LoadLocal, localindex);
-                }
-                else if (globalVariable)
-                {
-                    program.addByteCode(
-                        OpCode::Load,
-                        currentUserFunction->globalVariableList()[globalindex]);
-                }
-                else
-                {
-                    throw std::runtime_error("Undefined variable");
-                }
+                throw std::runtime_error("Undefined variable");
             }
         }
         else
         {
             program.addByteCode(OpCode::LoadLocal, localindex);
         }
+        listIndex(program);
     }
     else
     {
-        bool found = module_->symboltable().find(identifier, index);
+        bool found = module_->symboltable().find(identifier, hash, index);
         if (!found)
         {
             if (inVariableDefinition())
@@ -517,15 +709,32 @@ void TByteCodeBuilder::parseIdentifier(TProgram &program)
             }
         }
 
-        if (code() == TokenCode::tLeftBracket)
-        {
-            throw std::runtime_error("TByteCodeBuilder> Not yet implemented");
-        }
-        else
+        program.addByteCode(OpCode::Load, index);
+        listIndex(program);
+    }
+}
+
+// listIndex = { '[' expression [ ',' expression ] ']' }
+// The operand of LvecIdx is the number of indices, two index a matrix.
+void TByteCodeBuilder::listIndex(TProgram &program)
+{
+    int depth = 0;
+    while (code() == TokenCode::tLeftBracket)
+    {
+        nextToken();
+        expression(program);
+        int nIndices = 1;
+        if (code() == TokenCode::tComma)
         {
-            program.addByteCode(OpCode::Load, index);
+            nextToken();
+            expression(program);
+            nIndices = 2;
         }
+        expect(TokenCode::tRightBracket);
+        program.addByteCode(OpCode::LvecIdx, nIndices);
+        ++depth;
     }
+    lastIndexDepth_ = depth;
 }
 
 // argument = identifier
@@ -539,9 +748,9 @@ void TByteCodeBuilder::argument(TProgram &program)
 
     // Add the argument symbol to the user function local symbol table
     int index = 0;
-    if (!currentUserFunction->symboltable().find(token().tString(), index))
+    if (!currentUserFunction->symboltable().find(name(), nameHash(), index))
     {
-        currentUserFunction->symboltable().addSymbol(token().tString());
+        currentUserFunction->symboltable().addSymbol(name());
     }
     nextToken();
 }
@@ -577,8 +786,11 @@ void TByteCodeBuilder::functionDef(TProgram &program)
     }
     else
     {
-        functionName = sc_.token().tString();
+        functionName = name();
     }
+    // Functions defined in a body are compiled with it, as they add to the
+    // module symbols.
+    bool deferBody = deferred_ != nullptr && !inUserFunctionScope();
     currentUserFunction = new TUserFunction(functionName);
     module_->symboltable().addSymbol(currentUserFunction);
 
@@ -589,6 +801,20 @@ void TByteCodeBuilder::functionDef(TProgram &program)
         argumentList(currentUserFunction->funcCode()));
     expect(TokenCode::tRightParenthesis);
 
+    size_t end = 0;
+    if (deferBody && findBodyEnd(end))
+    {
+        deferred_->push_back({currentUserFunction, position_ - 1,
+                              static_cast<int>(symboltable().size())});
+        exitUserFunctionScope();
+        seek(end + 1);
+        return;
+    }
+    functionBody();
+}
+
+void TByteCodeBuilder::functionBody()
+{
     statementList(currentUserFunction->funcCode());
     exitUserFunctionScope();
     expect(TokenCode::tEnd);
@@ -597,6 +823,39 @@ void TByteCodeBuilder::functionDef(TProgram &program)
     currentUserFunction->funcCode().addByteCode(OpCode::Return);
 }
 
+// Finds the end closing the body that starts at the current token. Fails
+// for bodies that define functions of their own.
+bool TByteCodeBuilder::findBodyEnd(size_t &end) const
+{
+    if (token_ == &endOfStream_)
+    {
+        return false;
+    }
+    int depth = 0;
+    for (size_t i = position_ - 1; i < sc_.count(); ++i)
+    {
+        switch (sc_.at(i).code())
+        {
+        case TokenCode::tIf:
+            ++depth;
+            break;
+        case TokenCode::tFunction:
+            return false;
+        case TokenCode::tEnd:
+            if (depth == 0)
+            {
+                end = i;
+                return true;
+            }
+            --depth;
+            break;
+        default:
+            break;
+        }
+    }
+    return false;
+}
+
 // returnStatement = RETURN expression
 void TByteCodeBuilder::returnStmt(TProgram &program)
 {
@@ -4,38 +4,83 @@
 #include "TModule.hpp"
 #include "TokenTable.hpp"
 #include "lexer.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
 
 class Scanner;
 class TProgram;
+class TThreadPool;
 class TUserFunction;
 class TSymbolTable;
 
 /*
  * The TByteCodeBuilder assumes that the code is valid.
  * SyntaxAnalysis is responsible for this.
+ *
+ * Every function gets a constant table of its own, so function bodies can
+ * be compiled independently of each other and of the top level.
  */
 class TByteCodeBuilder
 {
 public:
     explicit TByteCodeBuilder(TokensTable &sc) : sc_(sc)
     {
+        endOfStream_.setCode(TokenCode::tEndofStream);
     }
 
     void build(TModule *module);
+    // Builds the top level first and then compiles the function bodies on
+    // the pool. The bytecode is the same as build() produces, whatever the
+    // number of threads, and so is the error reported for a bad module.
+    void build(TModule *module, TThreadPool &pool);
+    // Builds the top level and leaves every function body to be compiled on
+    // its first call, see TUserFunction::ensureCompiled, so that a run only
+    // pays for the functions it calls. The module keeps the tokens alive.
+    // Errors in a body are reported by the calls of its function.
+    static void buildLazy(TModule *module,
+                          std::shared_ptr<TokensTable> tokens);
 
 private:
+    // A function body left for build(module, pool) or for the first call
+    // to compile.
+    struct TDeferredBody
+    {
+        TUserFunction *function;
+        size_t position;     // token index of the first body token
+        int nVisibleSymbols; // module symbols defined before the body
+    };
+
     TokenCode code() const
     {
-        return sc_.token().code();
+        return token_->code();
     }
     void expect(TokenCode tcode);
+    // The builder reads the tokens through a cursor of its own, several
+    // builders can compile from one table at the same time.
     void nextToken()
     {
-        sc_.nextToken();
+        token_ = position_ < sc_.count() ? &sc_.at(position_++)
+                                         : &endOfStream_;
+    }
+    void seek(size_t position)
+    {
+        position_ = position;
+        nextToken();
     }
     const TokenRecord &token() const
     {
-        return sc_.token();
+        return *token_;
+    }
+    // The interned name of the identifier token.
+    const std::string &name() const
+    {
+        return sc_.atoms().name(token_->atom());
+    }
+    uint32_t nameHash() const
+    {
+        return sc_.atoms().hash(token_->atom());
     }
 
     void enterUserFunctionScope()
@@ -73,24 +118,44 @@ private:
     void power(TProgram &program);
     void factor(TProgram &program);
     void parseIdentifier(TProgram &program);
+    void listIndex(TProgram &program);
     void letStatement(TProgram &program);
     void ifStatement(TProgram &program);
     void functionDef(TProgram &program);
+    void functionBody();
+    bool findBodyEnd(size_t &end) const;
+    void buildBody(TModule *module, const TDeferredBody &body);
+    bool findSymbol(const std::string &name, uint32_t hash, int &index);
     int argumentList(TProgram &program);
     void argument(TProgram &program);
     void returnStmt(TProgram &program);
-    void parseFunctionCall(TProgram &program, int expectedArguments);
+    void parseFunctionCall(TProgram &program,
+                           const std::string &identifier,
+                           int expectedArguments);
+    void functionArgumentCall(TProgram &program,
+                              const std::string &identifier);
     int expressionList(TProgram &program);
 
     TSymbolTable &symboltable()
     {
         return module_->symboltable();
     }
+    TConstantValueTable &constants()
+    {
+        return inUserFunctionScope() ? currentUserFunction->constantTable()
+                                     : module_->constants();
+    }
 
     TokensTable &sc_;
+    const TokenRecord *token_ = nullptr;
+    size_t position_ = 0;
+    TokenRecord endOfStream_;
+    std::vector<TDeferredBody> *deferred_ = nullptr;
+    int nVisibleSymbols_ = -1; // all of them
     TModule *module_ = nullptr;
     bool inUserFunctionParsing_ = false;
     bool inVariableDefinition_ = false;
+    int lastIndexDepth_ = 0;
     TUserFunction *currentUserFunction = nullptr;
 };
 
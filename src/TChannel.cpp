@@ -0,0 +1,394 @@
+#include "TChannel.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+#include <thread>
+
+#include "TListObject.hpp"
+#include "TMatrixObject.hpp"
+#include "TStringObject.hpp"
+
+namespace
+{
+
+// Retries with a yield in between before a blocked send or recv sleeps.
+constexpr int kSpins = 100;
+constexpr size_t kMaxCapacity = size_t(1) << 24;
+// Set in sendPos_ by close(), so a send either claims its cell before the
+// close or sees the bit.
+constexpr size_t kClosedBit = size_t(1) << 63;
+
+void appendUnpacked(TListObject *list, const TMachineStackRecord &record)
+{
+    switch (record.type())
+    {
+    case TStackRecordType::stInteger:
+        list->append(record.ivalue());
+        break;
+    case TStackRecordType::stBoolean:
+        list->append(record.bvalue());
+        break;
+    case TStackRecordType::stDouble:
+        list->append(record.dvalue());
+        break;
+    case TStackRecordType::stString:
+        list->append(record.svalue());
+        break;
+    case TStackRecordType::stList:
+        list->append(record.lvalue());
+        break;
+    default:
+        // pack() only puts list elements into a list.
+        throw std::runtime_error("Internal Error: bad list element message");
+    }
+}
+
+} // namespace
+
+TMessage TMessage::pack(const TMachineStackRecord &record)
+{
+    TMessage message;
+    switch (record.type())
+    {
+    case TStackRecordType::stNone:
+        break;
+    case TStackRecordType::stInteger:
+        message.value_ = record.ivalue();
+        break;
+    case TStackRecordType::stDouble:
+        message.value_ = record.dvalue();
+        break;
+    case TStackRecordType::stBoolean:
+        message.value_ = record.bvalue();
+        break;
+    case TStackRecordType::stString:
+        message.value_ = std::string(record.svalue()->value());
+        break;
+    case TStackRecordType::stList:
+        return pack(record.lvalue());
+    case TStackRecordType::stMatrix:
+    {
+        const auto *matrix = record.mvalue();
+        const double *data = matrix->data();
+        size_t n = matrix->rows() * matrix->cols();
+        message.value_ = TMatrixMessage{matrix->rows(), matrix->cols(),
+                                        std::vector<double>(data, data + n)};
+        break;
+    }
+    case TStackRecordType::stChannel:
+        message.value_ = record.cvalue()->shared();
+        break;
+    }
+    return message;
+}
+
+TMessage TMessage::pack(const TListItem &item)
+{
+    TMessage message;
+    switch (item.type())
+    {
+    case TListItemType::liInteger:
+        message.value_ = item.ivalue();
+        break;
+    case TListItemType::liBoolean:
+        message.value_ = item.bvalue();
+        break;
+    case TListItemType::liDouble:
+        message.value_ = item.dvalue();
+        break;
+    case TListItemType::liString:
+        message.value_ = std::string(item.svalue()->value());
+        break;
+    case TListItemType::liList:
+        return pack(item.lvalue());
+    }
+    return message;
+}
+
+TMessage TMessage::pack(const TListObject *list)
+{
+    TMessage message;
+    size_t n = list->size();
+    switch (list->storage())
+    {
+    case TListStorage::lsInteger:
+        message.value_ =
+            std::vector<int64_t>(list->intData(), list->intData() + n);
+        break;
+    case TListStorage::lsDouble:
+        message.value_ =
+            std::vector<double>(list->doubleData(), list->doubleData() + n);
+        break;
+    case TListStorage::lsMixed:
+    {
+        std::vector<TMessage> items;
+        items.reserve(n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            items.push_back(pack(list->get(static_cast<int>(i))));
+        }
+        message.value_ = std::move(items);
+        break;
+    }
+    }
+    return message;
+}
+
+TMachineStackRecord TMessage::unpack() const
+{
+    TMachineStackRecord record;
+    if (const auto *value = std::get_if<int>(&value_))
+    {
+        record.setValue(*value);
+    }
+    else if (const auto *value = std::get_if<double>(&value_))
+    {
+        record.setValue(*value);
+    }
+    else if (const auto *value = std::get_if<bool>(&value_))
+    {
+        record.setValue(*value);
+    }
+    else if (const auto *value = std::get_if<std::string>(&value_))
+    {
+        record.setValue(TStringObject::createStringObject(*value));
+    }
+    else if (const auto *ints = std::get_if<std::vector<int64_t>>(&value_))
+    {
+        auto *list = TListObject::createObject();
+        for (auto item : *ints)
+        {
+            list->append(static_cast<int>(item));
+        }
+        record.setValue(list);
+    }
+    else if (const auto *doubles = std::get_if<std::vector<double>>(&value_))
+    {
+        auto *list = TListObject::createObject();
+        for (auto item : *doubles)
+        {
+            list->append(item);
+        }
+        record.setValue(list);
+    }
+    else if (const auto *items = std::get_if<std::vector<TMessage>>(&value_))
+    {
+        auto *list = TListObject::createObject();
+        for (const auto &item : *items)
+        {
+            appendUnpacked(list, item.unpack());
+        }
+        record.setValue(list);
+    }
+    else if (const auto *matrix = std::get_if<TMatrixMessage>(&value_))
+    {
+        record.setValue(TMatrixObject::createObject(matrix->rows, matrix->cols,
+                                                    matrix->data));
+    }
+    else if (const auto *channel =
+                 std::get_if<std::shared_ptr<TChannel>>(&value_))
+    {
+        record.setValue(TChannelObject::createObject(*channel));
+    }
+    return record;
+}
+
+TChannel::TChannel(size_t capacity)
+{
+    if (capacity > kMaxCapacity)
+    {
+        throw std::runtime_error("Channel capacity exceeds " +
+                                 std::to_string(kMaxCapacity));
+    }
+    mask_ = std::bit_ceil(std::max<size_t>(capacity, 2)) - 1;
+    cells_ = std::make_unique<TCell[]>(mask_ + 1);
+    for (size_t i = 0; i <= mask_; ++i)
+    {
+        cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+// A cell is free for the sender at pos when its sequence is pos, and holds
+// a message for the receiver at pos when its sequence is pos + 1.
+bool TChannel::push(TMessage &message)
+{
+    size_t pos = sendPos_.load(std::memory_order_relaxed);
+    while (true)
+    {
+        if (pos & kClosedBit)
+        {
+            throw std::runtime_error("send on a closed channel");
+        }
+        TCell &cell = cells_[pos & mask_];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        auto diff =
+            static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+        if (diff == 0)
+        {
+            if (sendPos_.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed))
+            {
+                cell.message = std::move(message);
+                cell.sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (diff < 0)
+        {
+            return false; // full
+        }
+        else
+        {
+            pos = sendPos_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool TChannel::pop(TMessage &message)
+{
+    size_t pos = recvPos_.load(std::memory_order_relaxed);
+    while (true)
+    {
+        TCell &cell = cells_[pos & mask_];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        auto diff =
+            static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+        if (diff == 0)
+        {
+            if (recvPos_.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed))
+            {
+                message = std::move(cell.message);
+                cell.sequence.store(pos + mask_ + 1,
+                                    std::memory_order_release);
+                return true;
+            }
+        }
+        else if (diff < 0)
+        {
+            return false; // empty
+        }
+        else
+        {
+            pos = recvPos_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool TChannel::trySend(TMessage &message)
+{
+    if (!push(message))
+    {
+        return false;
+    }
+    notify();
+    return true;
+}
+
+bool TChannel::tryRecv(TMessage &message)
+{
+    if (!pop(message))
+    {
+        return false;
+    }
+    notify();
+    return true;
+}
+
+void TChannel::send(TMessage message)
+{
+    for (int spins = 0;; ++spins)
+    {
+        uint32_t seen = changes_.load();
+        if (trySend(message))
+        {
+            return;
+        }
+        if (spins < kSpins)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            waitForChange(seen);
+        }
+    }
+}
+
+bool TChannel::recv(TMessage &message)
+{
+    for (int spins = 0;; ++spins)
+    {
+        uint32_t seen = changes_.load();
+        if (tryRecv(message))
+        {
+            return true;
+        }
+        if (closed())
+        {
+            return drain(message);
+        }
+        if (spins < kSpins)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            waitForChange(seen);
+        }
+    }
+}
+
+void TChannel::close(const std::string &error)
+{
+    if (closing_.exchange(true))
+    {
+        return;
+    }
+    error_ = error;
+    sendPos_.fetch_or(kClosedBit);
+    closed_.store(true, std::memory_order_release);
+    notify();
+}
+
+// Messages sent before the close are still delivered. A sender may have
+// claimed its cell and not yet filled it, so wait for every claimed cell.
+bool TChannel::drain(TMessage &message)
+{
+    size_t sent = sendPos_.load() & ~kClosedBit;
+    while (recvPos_.load() < sent)
+    {
+        if (tryRecv(message))
+        {
+            return true;
+        }
+        std::this_thread::yield();
+    }
+    return false;
+}
+
+// Every change bumps the counter, a waiter that read it before finding
+// the channel full or empty either sees the bump or gets notified.
+void TChannel::notify()
+{
+    changes_.fetch_add(1);
+    if (waiters_.load() > 0)
+    {
+        changes_.notify_all();
+    }
+}
+
+void TChannel::waitForChange(uint32_t seen)
+{
+    waiters_.fetch_add(1);
+    changes_.wait(seen);
+    waiters_.fetch_sub(1);
+}
+
+TChannelObject *TChannelObject::createObject(std::shared_ptr<TChannel> channel)
+{
+    auto *obj = new TChannelObject(std::move(channel));
+    TMemoryList::current().addNode(obj);
+    return obj;
+}
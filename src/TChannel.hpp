@@ -0,0 +1,149 @@
+#ifndef TCHANNEL_HPP_INCLUDED
+#define TCHANNEL_HPP_INCLUDED
+
+#include "MachineStack.hpp"
+#include "MemoryManager.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <variant>
+#include <vector>
+
+class TChannel;
+class TListItem;
+class TListObject;
+
+struct TMatrixMessage
+{
+    size_t rows = 0;
+    size_t cols = 0;
+    std::vector<double> data;
+};
+
+/*
+ * A value on its way between two runtimes. pack() deep copies a record out
+ * of the sender's heap and unpack() builds it again in the heap of the
+ * runtime entered on the receiving thread, so no object is ever shared.
+ * Channels are the exception, both ends refer to the same channel.
+ */
+class TMessage
+{
+public:
+    static TMessage pack(const TMachineStackRecord &record);
+    static TMessage pack(const TListItem &item);
+    TMachineStackRecord unpack() const;
+
+private:
+    static TMessage pack(const TListObject *list);
+
+    // Packed lists keep their storage, mixed lists hold one message per
+    // element.
+    std::variant<std::monostate,
+                 int,
+                 double,
+                 bool,
+                 std::string,
+                 std::vector<int64_t>,
+                 std::vector<double>,
+                 std::vector<TMessage>,
+                 TMatrixMessage,
+                 std::shared_ptr<TChannel>>
+        value_;
+};
+
+/*
+ * Bounded lock-free multi-producer multi-consumer queue of messages, the
+ * array based queue of D. Vyukov: every cell carries a sequence number
+ * that tells producers and consumers whose turn it is, so the only
+ * contended writes are the two position counters.
+ *
+ * send and recv spin briefly and then sleep on a change counter when the
+ * channel is full or empty. Closing sets a bit in the send position, so
+ * every send either lands before the close and is delivered or fails;
+ * receives drain what is left.
+ */
+class TChannel
+{
+public:
+    // The capacity is rounded up to a power of two, at least 2. Capacities
+    // above 2^24 are rejected.
+    explicit TChannel(size_t capacity);
+    TChannel(const TChannel &) = delete;
+    TChannel &operator=(const TChannel &) = delete;
+
+    size_t capacity() const
+    {
+        return mask_ + 1;
+    }
+    // Return false instead of blocking, the message is only moved from on
+    // success.
+    bool trySend(TMessage &message);
+    bool tryRecv(TMessage &message);
+    // Blocks while the channel is full, throws if it is closed.
+    void send(TMessage message);
+    // Blocks while the channel is empty and open. Returns false once it is
+    // closed and drained.
+    bool recv(TMessage &message);
+    // error is reported to receivers that find the channel drained.
+    void close(const std::string &error = "");
+    bool closed() const
+    {
+        return closed_.load(std::memory_order_acquire);
+    }
+    // Only meaningful once closed() returned true.
+    const std::string &error() const
+    {
+        return error_;
+    }
+
+private:
+    struct alignas(64) TCell
+    {
+        std::atomic<size_t> sequence;
+        TMessage message;
+    };
+
+    bool push(TMessage &message);
+    bool pop(TMessage &message);
+    bool drain(TMessage &message);
+    void notify();
+    void waitForChange(uint32_t seen);
+
+    std::unique_ptr<TCell[]> cells_;
+    size_t mask_ = 0;
+    alignas(64) std::atomic<size_t> sendPos_{0};
+    alignas(64) std::atomic<size_t> recvPos_{0};
+    alignas(64) std::atomic<uint32_t> changes_{0};
+    std::atomic<int> waiters_{0};
+    std::atomic<bool> closing_{false};
+    std::atomic<bool> closed_{false};
+    std::string error_;
+};
+
+// A channel as a script value. Copies refer to the same channel.
+class TChannelObject : public TRhodusObject
+{
+public:
+    TChannel &channel() const
+    {
+        return *channel_;
+    }
+    const std::shared_ptr<TChannel> &shared() const
+    {
+        return channel_;
+    }
+
+    static TChannelObject *createObject(std::shared_ptr<TChannel> channel);
+
+private:
+    explicit TChannelObject(std::shared_ptr<TChannel> channel)
+        : channel_(std::move(channel))
+    {
+    }
+
+    std::shared_ptr<TChannel> channel_;
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef TEXECUTIONCONTEXT_HPP_INCLUDED
+#define TEXECUTIONCONTEXT_HPP_INCLUDED
+
+#include <memory>
+
+#include "TModule.hpp"
+#include "TSymbolTable.hpp"
+
+/*
+ * The per-run state of a module: the values of its global variables. Their
+ * names stay in the module's symboltable; a context only copies the
+ * fixed-size values, so creating one per run is cheap.
+ */
+class TExecutionContext
+{
+public:
+    explicit TExecutionContext(std::shared_ptr<const TModule> module)
+        : module_(std::move(module)), globals_(module_->symboltable())
+    {
+    }
+
+    const TModule &module() const
+    {
+        return *module_;
+    }
+    const std::shared_ptr<const TModule> &sharedModule() const
+    {
+        return module_;
+    }
+    TGlobalValues &globals()
+    {
+        return globals_;
+    }
+
+private:
+    std::shared_ptr<const TModule> module_;
+    TGlobalValues globals_;
+};
+
+#endif
@@ -0,0 +1,85 @@
+#include "TGreenThreads.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+#include "TRuntime.hpp"
+
+TGreenThreads::TGreenThreads(TRuntime &runtime, size_t quantum)
+    : vm_(std::make_unique<VM>(runtime)),
+      quantum_(std::max<size_t>(quantum, 1))
+{
+}
+
+TGreenThreads::~TGreenThreads() = default;
+
+size_t TGreenThreads::spawn(std::shared_ptr<const TModule> module,
+                            int priority)
+{
+    auto thread = std::make_unique<TGreenThread>(std::move(module));
+    thread->priority = std::max(priority, 1);
+    vm_->start(thread->context);
+    vm_->save(thread->run);
+
+    size_t id = threads_.size();
+    threads_.push_back(std::move(thread));
+    ready_.push_back(id);
+    return id;
+}
+
+void TGreenThreads::runAll()
+{
+    while (!ready_.empty())
+    {
+        size_t id = ready_.front();
+        ready_.pop_front();
+
+        auto &thread = *threads_[id];
+        ++thread.turns;
+        vm_->restore(thread.run);
+        try
+        {
+            if (vm_->resume(quantum_ * thread.priority) ==
+                TRunState::Suspended)
+            {
+                vm_->save(thread.run);
+                ready_.push_back(id);
+                continue;
+            }
+            if (!vm_->empty())
+            {
+                thread.result = vm_->top();
+            }
+        }
+        catch (const std::exception &e)
+        {
+            thread.error = e.what();
+        }
+
+        thread.finished = true;
+        thread.run = TSuspendedRun();
+        finishOrder_.push_back(id);
+    }
+}
+
+const TMachineStackRecord &TGreenThreads::result(size_t id) const
+{
+    const auto &thread = *threads_.at(id);
+    if (!thread.finished || !thread.error.empty())
+    {
+        throw std::runtime_error("Green thread " + std::to_string(id) +
+                                 " has no result");
+    }
+    return thread.result;
+}
+
+const std::string &TGreenThreads::error(size_t id) const
+{
+    return threads_.at(id)->error;
+}
+
+size_t TGreenThreads::turns(size_t id) const
+{
+    return threads_.at(id)->turns;
+}
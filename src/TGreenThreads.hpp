@@ -0,0 +1,75 @@
+#ifndef TGREENTHREADS_HPP_INCLUDED
+#define TGREENTHREADS_HPP_INCLUDED
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MachineStack.hpp"
+#include "TExecutionContext.hpp"
+#include "TModule.hpp"
+#include "VM.hpp"
+
+class TRuntime;
+
+/*
+ * Multiplexes script runs on the calling thread. All green threads share
+ * one VM: a thread is resumed for a quantum of instructions at a time, then
+ * suspended at its next safepoint and its TSuspendedRun moved out of the
+ * VM, so a long script cannot starve short ones. Threads take turns round
+ * robin, a thread of priority p runs p quanta per turn.
+ */
+class TGreenThreads
+{
+public:
+    explicit TGreenThreads(TRuntime &runtime, size_t quantum = 1000);
+    ~TGreenThreads();
+
+    // Returns the id of the new thread, ids count up from 0.
+    size_t spawn(std::shared_ptr<const TModule> module, int priority = 1);
+    // Runs every spawned thread to its end.
+    void runAll();
+
+    size_t size() const
+    {
+        return threads_.size();
+    }
+    // The value a finished thread left on its stack.
+    const TMachineStackRecord &result(size_t id) const;
+    // Empty unless the thread stopped on an error.
+    const std::string &error(size_t id) const;
+    // Number of turns the thread was given.
+    size_t turns(size_t id) const;
+    // Ids in the order the threads finished.
+    const std::vector<size_t> &finishOrder() const
+    {
+        return finishOrder_;
+    }
+
+private:
+    struct TGreenThread
+    {
+        explicit TGreenThread(std::shared_ptr<const TModule> module)
+            : context(std::move(module))
+        {
+        }
+
+        TExecutionContext context;
+        TSuspendedRun run;
+        int priority = 1;
+        size_t turns = 0;
+        bool finished = false;
+        TMachineStackRecord result;
+        std::string error;
+    };
+
+    std::unique_ptr<VM> vm_;
+    size_t quantum_;
+    std::vector<std::unique_ptr<TGreenThread>> threads_;
+    std::deque<size_t> ready_;
+    std::vector<size_t> finishOrder_;
+};
+
+#endif
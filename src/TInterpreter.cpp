@@ -0,0 +1,141 @@
+#include "TInterpreter.hpp"
+
+#include <stdexcept>
+
+#include "SyntaxParser.hpp"
+#include "TByteCodeBuilder.hpp"
+#include "TListObject.hpp"
+#include "TStringObject.hpp"
+#include "TThreadPool.hpp"
+
+namespace
+{
+
+// Scripts this large are scanned on the shared pool before the syntax check.
+constexpr size_t kParallelScanSize = 8 << 20;
+
+TMachineStackRecord toRecord(const THostValue &value)
+{
+    TMachineStackRecord record;
+    std::visit(
+        [&record](const auto &v) {
+            using T = std::decay_t<decltype(v)>;
+            if constexpr (std::is_same_v<T, std::string>)
+            {
+                record.setValue(
+                    TStringObject::createStringObject(std::string(v)));
+            }
+            else if constexpr (std::is_same_v<T, std::span<const int64_t>> ||
+                               std::is_same_v<T, std::span<const double>>)
+            {
+                record.setValue(TListObject::createView(v.data(), v.size()));
+            }
+            else
+            {
+                record.setValue(v);
+            }
+        },
+        value);
+    return record;
+}
+
+} // namespace
+
+std::shared_ptr<const TModule> TInterpreter::compile(const std::string &source,
+                                                     TCompileMode mode)
+{
+    // Lazily built modules keep the tokens and so the source they view.
+    Scanner sc(std::make_shared<const std::string>(source));
+    if (source.size() >= kParallelScanSize && TThreadPool::shared().size() > 0)
+    {
+        sc.scanAll(TThreadPool::shared());
+    }
+    SyntaxParser sp(sc);
+    if (auto error = sp.syntaxCheck())
+    {
+        throw std::runtime_error(error->msg());
+    }
+
+    auto module = std::make_shared<TModule>();
+    if (mode == TCompileMode::Lazy)
+    {
+        auto tokens = std::make_shared<TokensTable>(std::move(sp.tokens()));
+        TByteCodeBuilder::buildLazy(module.get(), std::move(tokens));
+        return module;
+    }
+    TByteCodeBuilder builder(sp.tokens());
+    builder.build(module.get());
+    return module;
+}
+
+void TInterpreter::load(const std::string &source, TCompileMode mode)
+{
+    load(compile(source, mode));
+}
+
+void TInterpreter::load(std::shared_ptr<const TModule> module)
+{
+    context_ = std::make_unique<TExecutionContext>(std::move(module));
+    vm_.runModule(*context_);
+}
+
+TFunctionHandle TInterpreter::function(const std::string &name)
+{
+    int index = -1;
+    if (!context_ || !context_->globals().find(name, index) ||
+        context_->globals().get(index).type() !=
+            TSymbolElementType::symUserFunc)
+    {
+        throw std::runtime_error("Script has no function named " + name);
+    }
+    const auto *fn = context_->globals().get(index).fvalue();
+    return {index, fn->numberOfArguments()};
+}
+
+TExecutionContext &TInterpreter::loaded()
+{
+    if (!context_)
+    {
+        throw std::runtime_error("No script is loaded");
+    }
+    return *context_;
+}
+
+TMachineStackRecord TInterpreter::call(TFunctionHandle function,
+                                       const std::vector<THostValue> &args)
+{
+    auto &context = loaded();
+    std::vector<TMachineStackRecord> records;
+    records.reserve(args.size());
+    {
+        TRuntime::TScope scope(runtime_);
+        for (const auto &arg : args)
+        {
+            records.push_back(toRecord(arg));
+        }
+    }
+    return vm_.callFunction(context, function.index, records.data(),
+                            records.size());
+}
+
+void TInterpreter::callBatch(TFunctionHandle function,
+                             std::span<const TBatchColumn> columns,
+                             std::span<double> results,
+                             TBatchMode mode)
+{
+    vm_.callBatch(loaded(), function.index, columns, results, mode);
+}
+
+std::vector<double> TInterpreter::callBatch(
+    TFunctionHandle function,
+    std::span<const TBatchColumn> columns,
+    TBatchMode mode)
+{
+    size_t nRows = columns.empty()
+                       ? 0
+                       : std::visit([](auto c) { return c.size(); },
+                                    columns.front());
+    std::vector<double> results(nRows);
+    callBatch(function, columns, results, mode);
+    return results;
+}
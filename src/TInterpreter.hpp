@@ -0,0 +1,123 @@
+#ifndef TINTERPRETER_HPP_INCLUDED
+#define TINTERPRETER_HPP_INCLUDED
+
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <span>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "MachineStack.hpp"
+#include "TExecutionContext.hpp"
+#include "TModule.hpp"
+#include "TRuntime.hpp"
+#include "VM.hpp"
+
+// A value a host passes to a script function. Spans reach the script as
+// read-only lists over the host's memory, see TListObject::createView.
+using THostValue = std::variant<int,
+                                double,
+                                bool,
+                                std::string,
+                                std::span<const int64_t>,
+                                std::span<const double>>;
+
+enum class TCompileMode
+{
+    Eager, // every function body is compiled up front
+    Lazy   // bodies are compiled on their first call
+};
+
+// A function of the loaded module, looked up once and called many times.
+struct TFunctionHandle
+{
+    int index = -1;
+    int nArgs = 0;
+};
+
+/*
+ * Embeds Daewoo in a C++ host: a runtime with a loaded module whose
+ * functions the host calls with typed arguments.
+ *
+ *     TInterpreter interpreter;
+ *     interpreter.load("fn total(xs)\n return sum(xs)\n end\n");
+ *     auto result = interpreter.call("total", {std::span(data, n)});
+ *
+ * To evaluate one function over many rows, look it up once and pass its
+ * arguments as columns to callBatch().
+ *
+ * Arrays passed as spans are read in place; a script that modifies such a
+ * list modifies a copy. The array must stay alive and unchanged while a
+ * call runs and while a result that refers to it is in use.
+ *
+ * An interpreter is used by one thread at a time.
+ */
+class TInterpreter
+{
+public:
+    TInterpreter() : vm_(runtime_)
+    {
+    }
+    TInterpreter(const TInterpreter &) = delete;
+    TInterpreter &operator=(const TInterpreter &) = delete;
+
+    // Throws std::runtime_error with the message of the first syntax error.
+    // In lazy mode errors in a function body are only thrown by its calls.
+    static std::shared_ptr<const TModule> compile(
+        const std::string &source,
+        TCompileMode mode = TCompileMode::Eager);
+
+    // Loads a module in place of the current one and runs its top level
+    // statements.
+    void load(const std::string &source,
+              TCompileMode mode = TCompileMode::Eager);
+    void load(std::shared_ptr<const TModule> module);
+
+    // Throws if the loaded module has no function of that name.
+    TFunctionHandle function(const std::string &name);
+
+    // Calls a function of the loaded module. The result lives in this
+    // interpreter's heap and stays valid until the interpreter goes away.
+    // Throws if the handle is not a function of the loaded module or the
+    // number of arguments differs.
+    TMachineStackRecord call(TFunctionHandle function,
+                             const std::vector<THostValue> &args);
+    TMachineStackRecord call(const std::string &name,
+                             const std::vector<THostValue> &args)
+    {
+        return call(function(name), args);
+    }
+    TMachineStackRecord call(const std::string &name,
+                             std::initializer_list<THostValue> args)
+    {
+        return call(function(name), std::vector<THostValue>(args));
+    }
+
+    // results[row] = f(columns[0][row], columns[1][row], ...) for every
+    // row; every column holds results.size() values. f must return a
+    // number, booleans are stored as 0 or 1.
+    void callBatch(TFunctionHandle function,
+                   std::span<const TBatchColumn> columns,
+                   std::span<double> results,
+                   TBatchMode mode = TBatchMode::Vectorized);
+    std::vector<double> callBatch(TFunctionHandle function,
+                                  std::span<const TBatchColumn> columns,
+                                  TBatchMode mode = TBatchMode::Vectorized);
+
+    TRuntime &runtime()
+    {
+        return runtime_;
+    }
+
+private:
+    // Throws unless a module is loaded.
+    TExecutionContext &loaded();
+
+    TRuntime runtime_;
+    VM vm_;
+    std::unique_ptr<TExecutionContext> context_;
+};
+
+#endif
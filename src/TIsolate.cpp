@@ -0,0 +1,70 @@
+#include "TIsolate.hpp"
+
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <thread>
+
+#include "TChannel.hpp"
+#include "TExecutionContext.hpp"
+#include "TRuntime.hpp"
+#include "VM.hpp"
+
+namespace
+{
+
+// Declared first in an isolate's thread, so that the flag is only set
+// once the isolate's runtime has gone and joined its own isolates.
+struct TFinishedFlag
+{
+    std::shared_ptr<std::atomic<bool>> flag;
+    ~TFinishedFlag()
+    {
+        flag->store(true, std::memory_order_release);
+    }
+};
+
+} // namespace
+
+TChannelObject *TIsolate::spawn(const TExecutionContext &context,
+                                int funcIndex,
+                                const std::vector<TMachineStackRecord> &args)
+{
+    std::vector<TMessage> messages;
+    messages.reserve(args.size());
+    for (const auto &arg : args)
+    {
+        messages.push_back(TMessage::pack(arg));
+    }
+    auto result = std::make_shared<TChannel>(1);
+    auto finished = std::make_shared<std::atomic<bool>>(false);
+
+    std::thread isolate([module = context.sharedModule(), funcIndex,
+                         messages = std::move(messages), result, finished] {
+        TFinishedFlag done{finished};
+        TRuntime runtime;
+        TExecutionContext context(module);
+        VM vm(runtime);
+        try
+        {
+            std::vector<TMachineStackRecord> args;
+            {
+                TRuntime::TScope scope(runtime);
+                for (const auto &message : messages)
+                {
+                    args.push_back(message.unpack());
+                }
+            }
+            auto value =
+                vm.callFunction(context, funcIndex, args.data(), args.size());
+            result->send(TMessage::pack(value));
+            result->close();
+        }
+        catch (const std::exception &e)
+        {
+            result->close(e.what());
+        }
+    });
+    TRuntime::current().addIsolate(std::move(isolate), std::move(finished));
+    return TChannelObject::createObject(std::move(result));
+}
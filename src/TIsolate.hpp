@@ -0,0 +1,28 @@
+#ifndef TISOLATE_HPP_INCLUDED
+#define TISOLATE_HPP_INCLUDED
+
+#include "MachineStack.hpp"
+#include <vector>
+
+class TChannelObject;
+class TExecutionContext;
+
+/*
+ * Backs spawn(f, args...): runs a user function on a thread of its own,
+ * with its own runtime, VM and execution context of the spawner's module.
+ * The arguments are deep copied into the isolate; channels among them are
+ * the only state it shares with the spawner.
+ *
+ * The returned channel receives the function's result, or is closed with
+ * its error. The spawner's runtime joins finished threads when it spawns
+ * another one, and the rest when it is destroyed.
+ */
+class TIsolate
+{
+public:
+    static TChannelObject *spawn(const TExecutionContext &context,
+                                 int funcIndex,
+                                 const std::vector<TMachineStackRecord> &args);
+};
+
+#endif
@@ -1,36 +1,25 @@
 #include "TListObject.hpp"
 #include "MemoryManager.hpp"
 #include "TStringObject.hpp"
+#include "VectorKernels.hpp"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
 /* DONE */
 TListObject *TListObject::clone() const
 {
-    auto *ret = new TListObject;
-    for (const auto &entry : *this)
+    auto *ret = createObject();
+    ret->list_ = list_;
+    return ret;
+}
+
+void TListObject::detach()
+{
+    if (list_.use_count() > 1)
     {
-        switch (entry.type())
-        {
-        case TListItemType::liBoolean:
-        case TListItemType::liInteger:
-        case TListItemType::liDouble:
-            ret->list_.emplace_back(entry);
-            break;
-        case TListItemType::liString:
-        {
-            auto *obj = entry.svalue()->clone();
-            obj->setType(TBlockType::btOwned);
-            ret->list_.emplace_back(obj);
-            break;
-        }
-        case TListItemType::liList:
-        {
-            auto *obj = entry.lvalue()->clone();
-            obj->setType(TBlockType::btOwned);
-            ret->list_.emplace_back(obj);
-            break;
-        }
-        }
+        list_ = std::make_shared<TListBuffer>(*list_);
     }
-    return ret;
 }
 
 TListObject *TListObject::addLists(TListObject *l1, TListObject *l2)
@@ -45,46 +34,68 @@ TListObject *TListObject::addLists(TListObject *l1, TListObject *l2)
         ret = l1->clone();
     }
 
-    ret->list_.insert(ret->list_.end(), l2->list_.begin(), l2->list_.end());
+    // Keep the right operand alive and unchanged while appending it to a
+    // buffer it may share with the left operand.
+    auto source = l2->list_;
+    ret->detach();
+    ret->list_->append(*source);
     return ret;
 }
 
 TListObject *TListObject::multiply(int multiplier, const TListObject *aList)
 {
-    const auto *workingCopy = aList->isBound() ? aList->clone() : aList;
-
-    size_t nContents = aList->list_.size();
-    TListObject *result = new TListObject();
+    if (multiplier < 0)
+    {
+        throw std::runtime_error("list repeated a negative number of times: " +
+                                 std::to_string(multiplier));
+    }
+    const auto &source = *aList->list_;
+    size_t nContents = source.size();
+    TListObject *result = createObject();
+    result->list_->reserve(nContents == 0 ? multiplier
+                                          : multiplier * nContents);
 
     for (int i = 0; i < multiplier; ++i)
     {
         if (nContents == 0)
         {
-            result->list_.push_back(TListItem(0));
+            result->list_->append(TListItem(0));
         }
         else
         {
-            for (size_t j = 0; j < nContents; ++j)
-            {
-                result->list_.push_back(TListItem(workingCopy->list_[j]));
-            }
+            result->list_->append(source);
         }
     }
 
-    if (aList->isBound())
-        delete workingCopy; // Clean up cloned copy if needed
-
     return result;
 }
 
 bool TListObject::listEquals(const TListObject *l1, const TListObject *l2)
 {
-    if (l1->list_.size() != l2->list_.size())
+    const auto &b1 = *l1->list_;
+    const auto &b2 = *l2->list_;
+    if (&b1 == &b2)
+        return true;
+
+    if (b1.size() != b2.size())
         return false;
 
-    for (size_t i = 0; i < l1->list_.size(); ++i)
+    if (b1.storage() == TListStorage::lsInteger &&
+        b2.storage() == TListStorage::lsInteger)
+    {
+        return std::equal(b1.ints(), b1.ints() + b1.size(), b2.ints());
+    }
+
+    if (b1.storage() == TListStorage::lsDouble &&
+        b2.storage() == TListStorage::lsDouble)
+    {
+        return std::equal(b1.doubles(), b1.doubles() + b1.size(),
+                          b2.doubles());
+    }
+
+    for (size_t i = 0; i < b1.size(); ++i)
     {
-        if (!TListItem::listEquals(l1->list_[i], l2->list_[i]))
+        if (!TListItem::listEquals(b1.get(i), b2.get(i)))
             return false;
     }
     return true;
@@ -92,28 +103,91 @@ bool TListObject::listEquals(const TListObject *l1, const TListObject *l2)
 
 void TListObject::append(int value)
 {
-    list_.emplace_back(value);
+    detach();
+    list_->append(TListItem(value));
 }
 
 void TListObject::append(bool value)
 {
-    list_.emplace_back(value);
+    detach();
+    list_->append(TListItem(value));
 }
 
 void TListObject::append(double value)
 {
-    list_.emplace_back(value);
+    detach();
+    list_->append(TListItem(value));
 }
 
 void TListObject::append(TStringObject *value)
 {
-    list_.emplace_back(value);
+    detach();
+    list_->append(TListItem(value));
+}
+
+void TListObject::append(TListObject *value)
+{
+    // A nested list is a value, share its buffer instead of aliasing it.
+    auto *entry = value->isGarbage() ? value : value->clone();
+    entry->setType(TBlockType::btOwned);
+    detach();
+    list_->append(TListItem(entry));
+}
+
+void TListObject::insert(const TListObject &other)
+{
+    auto source = other.list_;
+    detach();
+    list_->append(*source);
+}
+
+void TListObject::set(int index, const TListItem &item)
+{
+    checkIndex(index);
+    detach();
+    list_->set(index, item);
+}
+
+TListItem TListObject::get(int index) const
+{
+    checkIndex(index);
+    return list_->get(index);
+}
+
+void TListObject::checkIndex(int index) const
+{
+    if (index < 0 || index >= static_cast<int>(list_->size()))
+    {
+        throw std::runtime_error("list index out of range: " +
+                                 std::to_string(index));
+    }
 }
 
 TListObject *TListObject::createObject()
 {
     auto *obj = new TListObject();
-    TMemoryList::getInstance().addNode(obj);
+    TMemoryList::current().addNode(obj);
+    return obj;
+}
+
+TListObject *TListObject::createView(const int64_t *data, size_t n)
+{
+    // List integers are ints, the integer kernels and get() rely on it.
+    const auto &kernels = TVectorKernels::best();
+    if (n > 0 && (kernels.mini(data, n) < std::numeric_limits<int>::min() ||
+                  kernels.maxi(data, n) > std::numeric_limits<int>::max()))
+    {
+        throw std::runtime_error("list view element out of integer range");
+    }
+    auto *obj = createObject();
+    obj->list_ = std::make_shared<TListBuffer>(data, n);
+    return obj;
+}
+
+TListObject *TListObject::createView(const double *data, size_t n)
+{
+    auto *obj = createObject();
+    obj->list_ = std::make_shared<TListBuffer>(data, n);
     return obj;
 }
 
@@ -140,14 +214,193 @@ bool TListItem::listEquals(const TListItem &item1, const TListItem &item2)
     if (item1.type() == TListItemType::liString &&
         item2.type() == TListItemType::liString)
     {
-        return item1.svalue() == item2.svalue();
+        return item1.svalue()->isEqualTo(*item2.svalue());
     }
 
     if (item1.type() == TListItemType::liList &&
         item2.type() == TListItemType::liList)
     {
-        return item1.lvalue() == item2.lvalue();
+        return TListObject::listEquals(item1.lvalue(), item2.lvalue());
     }
 
     return false;
 }
+
+TListItem TListBuffer::get(size_t index) const
+{
+    switch (storage_)
+    {
+    case TListStorage::lsInteger:
+        return TListItem(static_cast<int>(ints()[index]));
+    case TListStorage::lsDouble:
+        return TListItem(doubles()[index]);
+    default:
+        return items_[index];
+    }
+}
+
+void TListBuffer::set(size_t index, const TListItem &item)
+{
+    own();
+    if (!accepts(item))
+    {
+        promoteFor(item);
+    }
+
+    switch (storage_)
+    {
+    case TListStorage::lsInteger:
+        ints_[index] = item.ivalue();
+        break;
+    case TListStorage::lsDouble:
+        doubles_[index] = item.dvalue();
+        break;
+    case TListStorage::lsMixed:
+        items_[index] = item;
+        break;
+    }
+}
+
+void TListBuffer::append(const TListItem &item)
+{
+    own();
+    if (!accepts(item))
+    {
+        promoteFor(item);
+    }
+
+    switch (storage_)
+    {
+    case TListStorage::lsInteger:
+        ints_.push_back(item.ivalue());
+        break;
+    case TListStorage::lsDouble:
+        doubles_.push_back(item.dvalue());
+        break;
+    case TListStorage::lsMixed:
+        items_.push_back(item);
+        break;
+    }
+}
+
+void TListBuffer::append(const TListBuffer &other)
+{
+    if (other.size() == 0)
+    {
+        return;
+    }
+    own();
+
+    if (size() == 0 && storage_ != other.storage_)
+    {
+        storage_ = other.storage_;
+    }
+
+    if (storage_ == other.storage_)
+    {
+        switch (storage_)
+        {
+        case TListStorage::lsInteger:
+            ints_.insert(ints_.end(), other.ints(),
+                         other.ints() + other.size());
+            break;
+        case TListStorage::lsDouble:
+            doubles_.insert(doubles_.end(), other.doubles(),
+                            other.doubles() + other.size());
+            break;
+        case TListStorage::lsMixed:
+            items_.insert(items_.end(), other.items_.begin(),
+                          other.items_.end());
+            break;
+        }
+        return;
+    }
+
+    reserve(size() + other.size());
+    for (size_t i = 0; i < other.size(); ++i)
+    {
+        append(other.get(i));
+    }
+}
+
+void TListBuffer::reserve(size_t n)
+{
+    own();
+    switch (storage_)
+    {
+    case TListStorage::lsInteger:
+        ints_.reserve(n);
+        break;
+    case TListStorage::lsDouble:
+        doubles_.reserve(n);
+        break;
+    case TListStorage::lsMixed:
+        items_.reserve(n);
+        break;
+    }
+}
+
+bool TListBuffer::accepts(const TListItem &item) const
+{
+    switch (storage_)
+    {
+    case TListStorage::lsInteger:
+        return item.type() == TListItemType::liInteger;
+    case TListStorage::lsDouble:
+        return item.type() == TListItemType::liDouble;
+    default:
+        return true;
+    }
+}
+
+void TListBuffer::promoteFor(const TListItem &item)
+{
+    // An empty buffer simply takes on the storage of its first element.
+    if (size() == 0)
+    {
+        ints_.clear();
+        doubles_.clear();
+        if (item.type() == TListItemType::liInteger)
+        {
+            storage_ = TListStorage::lsInteger;
+        }
+        else if (item.type() == TListItemType::liDouble)
+        {
+            storage_ = TListStorage::lsDouble;
+        }
+        else
+        {
+            storage_ = TListStorage::lsMixed;
+        }
+        return;
+    }
+
+    std::vector<TListItem> items;
+    items.reserve(size() + 1);
+    for (size_t i = 0; i < size(); ++i)
+    {
+        items.push_back(get(i));
+    }
+    std::vector<int64_t>().swap(ints_);
+    std::vector<double>().swap(doubles_);
+    items_ = std::move(items);
+    storage_ = TListStorage::lsMixed;
+}
+
+void TListBuffer::own()
+{
+    if (view_ == nullptr)
+    {
+        return;
+    }
+    if (storage_ == TListStorage::lsInteger)
+    {
+        ints_.assign(ints(), ints() + viewSize_);
+    }
+    else
+    {
+        doubles_.assign(doubles(), doubles() + viewSize_);
+    }
+    view_ = nullptr;
+    viewSize_ = 0;
+}
@@ -2,7 +2,9 @@
 #define TLISTOBJECT_HPP_INCLUDED
 /* DONE */
 #include "MemoryManager.hpp"
-#include "TListObject.hpp"
+#include <cstdint>
+#include <cstring>
+#include <memory>
 #include <vector>
 
 class TStringObject;
@@ -17,93 +19,250 @@ enum class TListItemType
     liList
 };
 
+/*
+ * A list element packed in 8 bytes. Doubles are stored as they are, every
+ * other type lives in the payload of a negative quiet NaN with a 3 bit tag
+ * above it. NaN doubles are canonicalised to a positive NaN so they are
+ * never mistaken for a tagged value.
+ */
 class TListItem
 {
 public:
-    explicit TListItem(int v) : type_(TListItemType::liInteger), ivalue_(v)
+    explicit TListItem(int v)
+        : bits_(box(kIntegerTag, static_cast<uint32_t>(v)))
     {
     }
-    explicit TListItem(bool v) : type_(TListItemType::liBoolean), bvalue_(v)
+    explicit TListItem(bool v) : bits_(box(kBooleanTag, v ? 1 : 0))
     {
     }
-    explicit TListItem(double v) : type_(TListItemType::liDouble), dvalue_(v)
+    explicit TListItem(double v)
     {
+        if (v != v)
+        {
+            bits_ = kCanonicalNaN;
+        }
+        else
+        {
+            std::memcpy(&bits_, &v, sizeof(v));
+        }
     }
     explicit TListItem(TStringObject *v)
-        : type_(TListItemType::liString), svalue_(v)
+        : bits_(box(kStringTag, reinterpret_cast<uintptr_t>(v)))
     {
     }
     explicit TListItem(TListObject *v)
-        : type_(TListItemType::liList), lvalue_(v)
+        : bits_(box(kListTag, reinterpret_cast<uintptr_t>(v)))
     {
     }
 
     TListItemType type() const
     {
-        return type_;
+        if ((bits_ & kBoxMask) != kBoxMask)
+        {
+            return TListItemType::liDouble;
+        }
+        switch ((bits_ >> kTagShift) & kTagBits)
+        {
+        case kIntegerTag:
+            return TListItemType::liInteger;
+        case kBooleanTag:
+            return TListItemType::liBoolean;
+        case kStringTag:
+            return TListItemType::liString;
+        default:
+            return TListItemType::liList;
+        }
     }
     const TStringObject *svalue() const
     {
-        return svalue_;
+        return reinterpret_cast<const TStringObject *>(payload());
     }
     const TListObject *lvalue() const
     {
-        return lvalue_;
+        return reinterpret_cast<const TListObject *>(payload());
     }
     int ivalue() const
     {
-        return ivalue_;
+        return static_cast<int>(static_cast<uint32_t>(payload()));
     }
     bool bvalue() const
     {
-        return bvalue_;
+        return payload() != 0;
     }
     double dvalue() const
     {
-        return dvalue_;
+        double v;
+        std::memcpy(&v, &bits_, sizeof(v));
+        return v;
     }
 
     static bool listEquals(const TListItem &item1, const TListItem &item2);
 
 private:
-    TListItemType type_;
-    int ivalue_ = 0;
-    bool bvalue_ = false;
-    double dvalue_ = 0.;
-    TStringObject *svalue_ = nullptr;
-    TListObject *lvalue_ = nullptr; // TODO is this used ?
+    static constexpr uint64_t kBoxMask = 0xFFF8000000000000ull;
+    static constexpr uint64_t kPayloadMask = 0x0000FFFFFFFFFFFFull;
+    static constexpr uint64_t kCanonicalNaN = 0x7FF8000000000000ull;
+    static constexpr int kTagShift = 48;
+    static constexpr uint64_t kTagBits = 0x7;
+    static constexpr uint64_t kIntegerTag = 1;
+    static constexpr uint64_t kBooleanTag = 2;
+    static constexpr uint64_t kStringTag = 3;
+    static constexpr uint64_t kListTag = 4;
+
+    static uint64_t box(uint64_t tag, uint64_t payload)
+    {
+        return kBoxMask | (tag << kTagShift) | (payload & kPayloadMask);
+    }
+    uint64_t payload() const
+    {
+        return bits_ & kPayloadMask;
+    }
+
+    uint64_t bits_;
+};
+
+static_assert(sizeof(TListItem) == 8, "TListItem must stay 8 bytes");
+
+enum class TListStorage
+{
+    lsInteger, // packed int64_t, also used by empty lists
+    lsDouble,  // packed double
+    lsMixed    // TListItem per element
+};
+
+/*
+ * Backing store of a list. Only the array matching storage() is in use.
+ * Appending an element the packed array cannot hold promotes the whole
+ * buffer to the next wider storage, a buffer is never demoted.
+ *
+ * A buffer can also be a view of an int64_t or double array it does not
+ * own. It reads the array in place and copies it on the first mutation.
+ */
+class TListBuffer
+{
+public:
+    TListBuffer() = default;
+    TListBuffer(const int64_t *data, size_t n)
+        : storage_(TListStorage::lsInteger), view_(data), viewSize_(n)
+    {
+    }
+    TListBuffer(const double *data, size_t n)
+        : storage_(TListStorage::lsDouble), view_(data), viewSize_(n)
+    {
+    }
+
+    TListStorage storage() const
+    {
+        return storage_;
+    }
+    bool isView() const
+    {
+        return view_ != nullptr;
+    }
+    size_t size() const
+    {
+        if (view_ != nullptr)
+        {
+            return viewSize_;
+        }
+        switch (storage_)
+        {
+        case TListStorage::lsInteger:
+            return ints_.size();
+        case TListStorage::lsDouble:
+            return doubles_.size();
+        default:
+            return items_.size();
+        }
+    }
+    const int64_t *ints() const
+    {
+        return view_ != nullptr ? static_cast<const int64_t *>(view_)
+                                : ints_.data();
+    }
+    const double *doubles() const
+    {
+        return view_ != nullptr ? static_cast<const double *>(view_)
+                                : doubles_.data();
+    }
+    TListItem get(size_t index) const;
+    void set(size_t index, const TListItem &item);
+    void append(const TListItem &item);
+    void append(const TListBuffer &other);
+    void reserve(size_t n);
+
+private:
+    bool accepts(const TListItem &item) const;
+    void promoteFor(const TListItem &item);
+    // Copies the viewed array into the buffer, called before mutations.
+    void own();
+
+    TListStorage storage_ = TListStorage::lsInteger;
+    std::vector<int64_t> ints_;
+    std::vector<double> doubles_;
+    std::vector<TListItem> items_;
+    const void *view_ = nullptr;
+    size_t viewSize_ = 0;
 };
 
+/*
+ * Lists have value semantics but are copy-on-write: clone() shares the
+ * item buffer with the original and only the first mutation through
+ * append, insert or set copies it.
+ */
 class TListObject : public TRhodusObject
 {
 public:
-    using const_iterator = std::vector<TListItem>::const_iterator;
     void append(int value);
     void append(double value);
     void append(bool value);
     void append(TStringObject *value);
-    void insert(const_iterator begin, const_iterator end)
+    void append(TListObject *value);
+    void insert(const TListObject &other);
+    void set(int index, const TListItem &item);
+    TListItem get(int index) const;
+    TListObject *clone() const;
+    size_t size() const
     {
-        list_.insert(list_.end(), begin, end);
+        return list_->size();
     }
-    TListObject *clone() const;
-    const_iterator begin() const
+    TListStorage storage() const
+    {
+        return list_->storage();
+    }
+    // Packed element arrays, only valid for the matching storage().
+    const int64_t *intData() const
+    {
+        return list_->ints();
+    }
+    const double *doubleData() const
+    {
+        return list_->doubles();
+    }
+    bool sharesBufferWith(const TListObject &other) const
     {
-        return list_.begin();
+        return list_ == other.list_;
     }
-    const_iterator end() const
+    bool isView() const
     {
-        return list_.end();
+        return list_->isView();
     }
 
     static TListObject *createObject();
+    // A read-only list over a host array, nothing is copied until the list
+    // is modified. The array must outlive the list and every clone of it.
+    // Throws if an integer does not fit in an int.
+    static TListObject *createView(const int64_t *data, size_t n);
+    static TListObject *createView(const double *data, size_t n);
     static TListObject *addLists(TListObject *l1, TListObject *l2);
     static TListObject *multiply(int multiplier, const TListObject *list);
     static bool listEquals(const TListObject *l1, const TListObject *l2);
 
 private:
     TListObject() = default;
-    std::vector<TListItem> list_;
+    void checkIndex(int index) const;
+    void detach();
+    std::shared_ptr<TListBuffer> list_ = std::make_shared<TListBuffer>();
 };
 
-#endif
\ No newline at end of file
+#endif
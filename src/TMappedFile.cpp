@@ -0,0 +1,42 @@
+#include "TMappedFile.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::shared_ptr<TMappedFile> TMappedFile::open(const std::string &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return nullptr;
+    }
+    auto size = static_cast<size_t>(st.st_size);
+    void *data = nullptr;
+    if (size > 0)
+    {
+        data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        return nullptr;
+    }
+    return std::shared_ptr<TMappedFile>(
+        new TMappedFile(static_cast<char *>(data), size));
+}
+
+TMappedFile::~TMappedFile()
+{
+    if (data_)
+    {
+        munmap(data_, size_);
+    }
+}
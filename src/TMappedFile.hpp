@@ -0,0 +1,38 @@
+#ifndef TMAPPEDFILE_HPP_INCLUDED
+#define TMAPPEDFILE_HPP_INCLUDED
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+// A private mapping of a whole file. The pages are shared with the page
+// cache until written to, writes are never carried back to the file.
+class TMappedFile
+{
+public:
+    // Returns nullptr if the file cannot be opened or mapped. An empty file
+    // maps to no data.
+    static std::shared_ptr<TMappedFile> open(const std::string &path);
+    TMappedFile(const TMappedFile &) = delete;
+    TMappedFile &operator=(const TMappedFile &) = delete;
+    ~TMappedFile();
+
+    char *data() const
+    {
+        return data_;
+    }
+    size_t size() const
+    {
+        return size_;
+    }
+
+private:
+    TMappedFile(char *data, size_t size) : data_(data), size_(size)
+    {
+    }
+
+    char *data_;
+    size_t size_;
+};
+
+#endif
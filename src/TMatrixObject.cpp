@@ -0,0 +1,299 @@
+#include "TMatrixObject.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <string>
+
+#include "TListObject.hpp"
+#include "TThreadPool.hpp"
+#include "VectorKernels.hpp"
+
+namespace
+{
+
+// Tile sizes of the multiply, picked so that a kBlockK x kBlockJ tile of
+// the right operand (128 KiB) stays in L2 while a row block streams past.
+constexpr size_t kBlockI = 64;
+constexpr size_t kBlockK = 64;
+constexpr size_t kBlockJ = 256;
+
+void checkSameShape(const TMatrixObject *a,
+                    const TMatrixObject *b,
+                    const std::string &operation)
+{
+    if (a->rows() != b->rows() || a->cols() != b->cols())
+    {
+        throw std::runtime_error("Matrices must have the same shape when " +
+                                 operation);
+    }
+}
+
+// c[rowBegin..rowEnd) += a[rowBegin..rowEnd) * b
+void multiplyRows(const double *a,
+                  const double *b,
+                  double *c,
+                  size_t rowBegin,
+                  size_t rowEnd,
+                  size_t inner,
+                  size_t cols)
+{
+    const auto &kernels = TVectorKernels::best();
+    for (size_t kb = 0; kb < inner; kb += kBlockK)
+    {
+        size_t kEnd = std::min(kb + kBlockK, inner);
+        for (size_t jb = 0; jb < cols; jb += kBlockJ)
+        {
+            size_t nj = std::min(kBlockJ, cols - jb);
+            for (size_t i = rowBegin; i < rowEnd; ++i)
+            {
+                double *cRow = c + i * cols + jb;
+                for (size_t k = kb; k < kEnd; ++k)
+                {
+                    kernels.axpyd(a[i * inner + k], b + k * cols + jb, cRow,
+                                  nj);
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+TMatrixObject::TMatrixObject(size_t rows, size_t cols)
+    : rows_(rows), cols_(cols),
+      data_(std::make_shared<std::vector<double>>(rows * cols, 0.))
+{
+}
+
+TMatrixObject *TMatrixObject::createObject(size_t rows, size_t cols)
+{
+    auto *obj = new TMatrixObject(rows, cols);
+    TMemoryList::current().addNode(obj);
+    return obj;
+}
+
+TMatrixObject *TMatrixObject::createObject(size_t rows,
+                                           size_t cols,
+                                           std::vector<double> data)
+{
+    if (data.size() != rows * cols)
+    {
+        throw std::runtime_error("Matrix data does not match its shape");
+    }
+    auto *matrix = createObject(0, 0);
+    matrix->rows_ = rows;
+    matrix->cols_ = cols;
+    *matrix->data_ = std::move(data);
+    return matrix;
+}
+
+TMatrixObject *TMatrixObject::clone() const
+{
+    auto *ret = createObject(0, 0);
+    ret->rows_ = rows_;
+    ret->cols_ = cols_;
+    ret->data_ = data_;
+    return ret;
+}
+
+void TMatrixObject::detach()
+{
+    if (data_.use_count() > 1)
+    {
+        data_ = std::make_shared<std::vector<double>>(*data_);
+    }
+}
+
+double TMatrixObject::get(int row, int col) const
+{
+    checkIndex(row, col);
+    return (*data_)[row * cols_ + col];
+}
+
+void TMatrixObject::set(int row, int col, double value)
+{
+    checkIndex(row, col);
+    detach();
+    (*data_)[row * cols_ + col] = value;
+}
+
+void TMatrixObject::checkIndex(int row, int col) const
+{
+    if (row < 0 || row >= static_cast<int>(rows_) || col < 0 ||
+        col >= static_cast<int>(cols_))
+    {
+        throw std::runtime_error("matrix index out of range: [" +
+                                 std::to_string(row) + ", " +
+                                 std::to_string(col) + "]");
+    }
+}
+
+TMatrixObject *TMatrixObject::fromList(const TListObject *list)
+{
+    size_t rows = list->size();
+    size_t cols = 0;
+    for (size_t i = 0; i < rows; ++i)
+    {
+        auto row = list->get(static_cast<int>(i));
+        if (row.type() != TListItemType::liList ||
+            (i > 0 && row.lvalue()->size() != cols))
+        {
+            throw std::runtime_error(
+                "A matrix is built from a list of equally long rows");
+        }
+        cols = row.lvalue()->size();
+    }
+
+    auto *matrix = createObject(rows, cols);
+    double *out = matrix->mutableData();
+    for (size_t i = 0; i < rows; ++i)
+    {
+        const TListObject *row = list->get(static_cast<int>(i)).lvalue();
+        for (size_t j = 0; j < cols; ++j)
+        {
+            auto item = row->get(static_cast<int>(j));
+            if (item.type() == TListItemType::liInteger)
+            {
+                out[i * cols + j] = item.ivalue();
+            }
+            else if (item.type() == TListItemType::liDouble)
+            {
+                out[i * cols + j] = item.dvalue();
+            }
+            else
+            {
+                throw std::runtime_error("Matrix elements must be numbers");
+            }
+        }
+    }
+    return matrix;
+}
+
+TMatrixObject *TMatrixObject::identity(size_t n)
+{
+    auto *matrix = createObject(n, n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        matrix->mutableData()[i * n + i] = 1.;
+    }
+    return matrix;
+}
+
+TMatrixObject *TMatrixObject::add(const TMatrixObject *a,
+                                  const TMatrixObject *b)
+{
+    checkSameShape(a, b, "adding");
+    auto *result = createObject(a->rows_, a->cols_);
+    std::transform(a->data_->begin(), a->data_->end(), b->data_->begin(),
+                   result->data_->begin(), std::plus<double>());
+    return result;
+}
+
+TMatrixObject *TMatrixObject::sub(const TMatrixObject *a,
+                                  const TMatrixObject *b)
+{
+    checkSameShape(a, b, "subtracting");
+    auto *result = createObject(a->rows_, a->cols_);
+    std::transform(a->data_->begin(), a->data_->end(), b->data_->begin(),
+                   result->data_->begin(), std::minus<double>());
+    return result;
+}
+
+TMatrixObject *TMatrixObject::multiplyElements(const TMatrixObject *a,
+                                               const TMatrixObject *b)
+{
+    checkSameShape(a, b, "multiplying");
+    auto *result = createObject(a->rows_, a->cols_);
+    std::transform(a->data_->begin(), a->data_->end(), b->data_->begin(),
+                   result->data_->begin(), std::multiplies<double>());
+    return result;
+}
+
+TMatrixObject *TMatrixObject::scale(const TMatrixObject *a, double factor)
+{
+    auto *result = createObject(a->rows_, a->cols_);
+    std::transform(a->data_->begin(), a->data_->end(),
+                   result->data_->begin(),
+                   [factor](double x) { return x * factor; });
+    return result;
+}
+
+TMatrixObject *TMatrixObject::divide(const TMatrixObject *a, double divisor)
+{
+    auto *result = createObject(a->rows_, a->cols_);
+    std::transform(a->data_->begin(), a->data_->end(),
+                   result->data_->begin(),
+                   [divisor](double x) { return x / divisor; });
+    return result;
+}
+
+TMatrixObject *TMatrixObject::transpose(const TMatrixObject *a)
+{
+    auto *result = createObject(a->cols_, a->rows_);
+    const double *in = a->data();
+    double *out = result->mutableData();
+    constexpr size_t block = 32;
+    for (size_t ib = 0; ib < a->rows_; ib += block)
+    {
+        size_t iEnd = std::min(ib + block, a->rows_);
+        for (size_t jb = 0; jb < a->cols_; jb += block)
+        {
+            size_t jEnd = std::min(jb + block, a->cols_);
+            for (size_t i = ib; i < iEnd; ++i)
+            {
+                for (size_t j = jb; j < jEnd; ++j)
+                {
+                    out[j * a->rows_ + i] = in[i * a->cols_ + j];
+                }
+            }
+        }
+    }
+    return result;
+}
+
+TMatrixObject *TMatrixObject::multiply(const TMatrixObject *a,
+                                       const TMatrixObject *b,
+                                       TThreadPool *pool)
+{
+    if (a->cols_ != b->rows_)
+    {
+        throw std::runtime_error(
+            "Matrix product needs as many columns on the left as rows on "
+            "the right");
+    }
+
+    size_t rows = a->rows_;
+    size_t inner = a->cols_;
+    size_t cols = b->cols_;
+    auto *result = createObject(rows, cols);
+    const double *pa = a->data();
+    const double *pb = b->data();
+    double *pc = result->mutableData();
+
+    size_t nBlocks = (rows + kBlockI - 1) / kBlockI;
+    auto rowBlock = [=](size_t block) {
+        size_t begin = block * kBlockI;
+        multiplyRows(pa, pb, pc, begin, std::min(begin + kBlockI, rows),
+                     inner, cols);
+    };
+
+    if (pool != nullptr && nBlocks > 1)
+    {
+        pool->parallelFor(nBlocks, rowBlock);
+    }
+    else
+    {
+        for (size_t block = 0; block < nBlocks; ++block)
+        {
+            rowBlock(block);
+        }
+    }
+    return result;
+}
+
+bool TMatrixObject::equals(const TMatrixObject *a, const TMatrixObject *b)
+{
+    return a->rows_ == b->rows_ && a->cols_ == b->cols_ &&
+           *a->data_ == *b->data_;
+}
@@ -0,0 +1,69 @@
+#ifndef TMATRIXOBJECT_HPP_INCLUDED
+#define TMATRIXOBJECT_HPP_INCLUDED
+
+#include "MemoryManager.hpp"
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+class TListObject;
+class TThreadPool;
+
+/*
+ * Dense row-major matrix of doubles. Like lists, matrices are values that
+ * share their element buffer copy-on-write between clones.
+ */
+class TMatrixObject : public TRhodusObject
+{
+public:
+    size_t rows() const
+    {
+        return rows_;
+    }
+    size_t cols() const
+    {
+        return cols_;
+    }
+    const double *data() const
+    {
+        return data_->data();
+    }
+    double get(int row, int col) const;
+    void set(int row, int col, double value);
+    TMatrixObject *clone() const;
+
+    static TMatrixObject *createObject(size_t rows, size_t cols);
+    static TMatrixObject *createObject(size_t rows,
+                                       size_t cols,
+                                       std::vector<double> data);
+    static TMatrixObject *fromList(const TListObject *list);
+    static TMatrixObject *identity(size_t n);
+    static TMatrixObject *add(const TMatrixObject *a, const TMatrixObject *b);
+    static TMatrixObject *sub(const TMatrixObject *a, const TMatrixObject *b);
+    static TMatrixObject *multiplyElements(const TMatrixObject *a,
+                                           const TMatrixObject *b);
+    static TMatrixObject *scale(const TMatrixObject *a, double factor);
+    static TMatrixObject *divide(const TMatrixObject *a, double divisor);
+    static TMatrixObject *transpose(const TMatrixObject *a);
+    // Blocked product a * b. Row blocks are spread over the pool when one
+    // is given, otherwise everything runs on the calling thread.
+    static TMatrixObject *multiply(const TMatrixObject *a,
+                                   const TMatrixObject *b,
+                                   TThreadPool *pool = nullptr);
+    static bool equals(const TMatrixObject *a, const TMatrixObject *b);
+
+private:
+    TMatrixObject(size_t rows, size_t cols);
+    void checkIndex(int row, int col) const;
+    void detach();
+    double *mutableData()
+    {
+        return data_->data();
+    }
+
+    size_t rows_;
+    size_t cols_;
+    std::shared_ptr<std::vector<double>> data_;
+};
+
+#endif
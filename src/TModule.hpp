@@ -1,10 +1,17 @@
 #ifndef TMODULE_HPP_INCLUDED
 #define TMODULE_HPP_INCLUDED
+#include <memory>
 #include <string>
 
+#include "ConstantTable.hpp"
 #include "TSymbolTable.hpp"
 
-/* A module is a pair of bytecode associated with a symboltable */
+/*
+ * A module is the bytecode of a script with its constants and symboltable.
+ * Once built it is read-only: the symboltable only describes the globals and
+ * functions, the values a run stores live in its TExecutionContext. A built
+ * module can therefore be shared by VMs running on several threads.
+ */
 class TModule
 {
 public:
@@ -12,6 +19,8 @@ public:
     explicit TModule(const std::string &name) : name_(name)
     {
     }
+    TModule(const TModule &) = delete;
+    TModule &operator=(const TModule &) = delete;
 
     const TProgram &code() const
     {
@@ -25,10 +34,30 @@ public:
     {
         return symboltable_;
     }
+    const TSymbolTable &symboltable() const
+    {
+        return symboltable_;
+    }
+    TConstantValueTable &constants()
+    {
+        return constants_;
+    }
+    const TConstantValueTable &constants() const
+    {
+        return constants_;
+    }
+    // Memory the code of the module refers to, such as a mapped module
+    // file, is kept alive as long as the module.
+    void keepAlive(std::shared_ptr<const void> storage)
+    {
+        storage_ = std::move(storage);
+    }
 
 private:
+    std::shared_ptr<const void> storage_; // released last
     std::string name_ = "";
     TProgram code_;
+    TConstantValueTable constants_;
     TSymbolTable symboltable_;
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,665 @@
+#include "TModuleFile.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "OpCodes.hpp"
+#include "TBuiltIns.hpp"
+#include "TInterpreter.hpp"
+#include "TMappedFile.hpp"
+#include "TModule.hpp"
+#include "TSymbolTable.hpp"
+
+namespace
+{
+
+constexpr char kMagic[8] = {'D', 'A', 'E', 'W', 'O', 'O', 'B', 'C'};
+constexpr uint32_t kByteOrder = 0x01020304;
+// The last enumerator of OpCode.
+constexpr auto kLastOpCode = static_cast<int>(OpCode::Return);
+
+static_assert(std::is_trivially_copyable_v<TByteCode>);
+
+// A slice of the string section.
+struct TStringRef
+{
+    uint32_t offset = 0;
+    uint32_t length = 0;
+};
+
+// Records first to first + count - 1 of a section.
+struct TRange
+{
+    uint32_t first = 0;
+    uint32_t count = 0;
+};
+
+struct TSection
+{
+    uint64_t offset = 0; // from the start of the file
+    uint64_t count = 0;  // of records
+};
+
+struct TConstantRecord
+{
+    double dvalue = 0;
+    TStringRef svalue;
+    uint32_t type = 0; // TConstantValueType
+    uint32_t padding = 0;
+};
+
+struct TSymbolRecord
+{
+    TStringRef name;
+    int32_t function = -1; // index of the function, -1 for a variable
+    uint32_t padding = 0;
+};
+
+struct TFunctionRecord
+{
+    TStringRef name;
+    int32_t nArgs = 0;
+    uint32_t padding = 0;
+    TRange code;
+    TRange constants;
+    TRange symbols; // the local symbol table
+};
+
+struct THeader
+{
+    char magic[8] = {};
+    uint32_t formatVersion = 0;
+    uint32_t byteOrder = 0;
+    uint64_t compilerVersion = 0;
+    uint64_t sourceHash = 0;
+    uint64_t fileSize = 0;
+    TRange moduleCode;
+    TRange moduleConstants;
+    TRange moduleSymbols;
+    TSection code;      // TByteCode
+    TSection constants; // TConstantRecord
+    TSection symbols;   // TSymbolRecord
+    TSection functions; // TFunctionRecord
+    TSection strings;   // char
+};
+
+// FNV-1a
+uint64_t hashBytes(const void *data, size_t n, uint64_t hash)
+{
+    const auto *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < n; ++i)
+    {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+constexpr uint64_t kHashSeed = 0xcbf29ce484222325ULL;
+
+uint64_t hashString(const std::string &s, uint64_t hash)
+{
+    // The terminating zero keeps {"ab", "c"} apart from {"a", "bc"}.
+    return hashBytes(s.c_str(), s.size() + 1, hash);
+}
+
+uint32_t checked32(size_t n)
+{
+    if (n > UINT32_MAX)
+    {
+        throw std::runtime_error("Module too large to save");
+    }
+    return static_cast<uint32_t>(n);
+}
+
+uint64_t align8(uint64_t n)
+{
+    return (n + 7) & ~uint64_t(7);
+}
+
+// The sections of a file being written.
+struct TImage
+{
+    std::vector<TByteCode> code;
+    std::vector<TConstantRecord> constants;
+    std::vector<TSymbolRecord> symbols;
+    std::vector<TFunctionRecord> functions;
+    std::string strings;
+
+    TStringRef addString(const std::string &s)
+    {
+        TStringRef ref{checked32(strings.size()), checked32(s.size())};
+        strings += s;
+        return ref;
+    }
+
+    TRange addCode(const TProgram &program)
+    {
+        TRange range{checked32(code.size()), checked32(program.size())};
+        for (size_t i = 0; i < program.size(); ++i)
+        {
+            code.push_back(program[i]);
+        }
+        return range;
+    }
+
+    TRange addConstants(const TConstantValueTable &table)
+    {
+        TRange range{checked32(constants.size()), checked32(table.size())};
+        for (int i = 1; i <= static_cast<int>(table.size()); ++i)
+        {
+            const auto &constant = table.get(i);
+            TConstantRecord record;
+            record.type = static_cast<uint32_t>(constant.type());
+            if (constant.type() == TConstantValueType::Double)
+            {
+                record.dvalue = constant.dvalue();
+            }
+            else if (constant.type() == TConstantValueType::String)
+            {
+                record.svalue = addString(constant.svalue());
+            }
+            constants.push_back(record);
+        }
+        return range;
+    }
+
+    TRange addLocals(TSymbolTable &table)
+    {
+        TRange range{checked32(symbols.size()), checked32(table.size())};
+        for (size_t i = 0; i < table.size(); ++i)
+        {
+            TSymbolRecord record;
+            record.name = addString(table.get(i).name());
+            symbols.push_back(record);
+        }
+        return range;
+    }
+
+    int32_t addFunction(TUserFunction &function)
+    {
+        function.ensureCompiled();
+        TFunctionRecord record;
+        record.name = addString(function.name());
+        record.nArgs = function.numberOfArguments();
+        record.code = addCode(function.funcCode());
+        record.constants = addConstants(function.constantTable());
+        record.symbols = addLocals(function.symboltable());
+        functions.push_back(record);
+        return static_cast<int32_t>(functions.size() - 1);
+    }
+
+    // The module's symbols take the first records, the locals of its
+    // functions follow.
+    TRange addGlobals(const TSymbolTable &table)
+    {
+        TRange range{checked32(symbols.size()), checked32(table.size())};
+        symbols.resize(symbols.size() + table.size());
+        for (size_t i = 0; i < table.size(); ++i)
+        {
+            const auto &symbol = table.get(i);
+            TSymbolRecord record;
+            record.name = addString(symbol.name());
+            if (symbol.type() == TSymbolElementType::symUserFunc)
+            {
+                record.function = addFunction(*symbol.fvalue());
+            }
+            else if (symbol.type() != TSymbolElementType::symUndefined)
+            {
+                throw std::runtime_error("Cannot save a module holding the "
+                                         "value of " +
+                                         symbol.name());
+            }
+            symbols[range.first + i] = record;
+        }
+        return range;
+    }
+};
+
+template <typename T>
+void writeSection(std::ofstream &out, const T *data, TSection &section,
+                  uint64_t &position, uint64_t count)
+{
+    static const char zeros[8] = {};
+    uint64_t start = align8(position);
+    out.write(zeros, static_cast<std::streamsize>(start - position));
+    section.offset = start;
+    section.count = count;
+    out.write(reinterpret_cast<const char *>(data),
+              static_cast<std::streamsize>(count * sizeof(T)));
+    position = start + count * sizeof(T);
+}
+
+// Checks every offset and index of a mapped file before it is used.
+class TReader
+{
+public:
+    explicit TReader(const TMappedFile &mapping)
+        : data_(mapping.data()), size_(mapping.size())
+    {
+    }
+
+    template <typename T>
+    T *section(const TSection &section) const
+    {
+        if (section.offset % 8 != 0 || section.offset > size_ ||
+            section.count > (size_ - section.offset) / sizeof(T))
+        {
+            return nullptr;
+        }
+        return reinterpret_cast<T *>(data_ + section.offset);
+    }
+
+    static bool valid(const TRange &range, const TSection &section)
+    {
+        return uint64_t(range.first) + range.count <= section.count;
+    }
+
+private:
+    char *data_;
+    size_t size_;
+};
+
+class TLoader
+{
+public:
+    TLoader(const THeader &header, TByteCode *code,
+            const TConstantRecord *constants, const TSymbolRecord *symbols,
+            const TFunctionRecord *functions, const char *strings)
+        : header_(header), code_(code), constants_(constants),
+          symbols_(symbols), functions_(functions), strings_(strings)
+    {
+    }
+
+    bool valid() const
+    {
+        const auto &h = header_;
+        for (uint64_t i = 0; i < h.code.count; ++i)
+        {
+            auto op = static_cast<int>(code_[i].opCode);
+            if (op < 0 || op > kLastOpCode)
+            {
+                return false;
+            }
+        }
+        for (uint64_t i = 0; i < h.constants.count; ++i)
+        {
+            const auto &c = constants_[i];
+            if (c.type > static_cast<uint32_t>(TConstantValueType::String) ||
+                !validString(c.svalue))
+            {
+                return false;
+            }
+        }
+        for (uint64_t i = 0; i < h.symbols.count; ++i)
+        {
+            const auto &s = symbols_[i];
+            if (!validString(s.name) || s.function < -1 ||
+                uint64_t(s.function + 1) > h.functions.count)
+            {
+                return false;
+            }
+        }
+        for (uint64_t i = 0; i < h.functions.count; ++i)
+        {
+            const auto &f = functions_[i];
+            if (!validString(f.name) || f.nArgs < 0 ||
+                uint32_t(f.nArgs) > f.symbols.count ||
+                !TReader::valid(f.code, h.code) ||
+                !TReader::valid(f.constants, h.constants) ||
+                !TReader::valid(f.symbols, h.symbols))
+            {
+                return false;
+            }
+        }
+        if (!TReader::valid(h.moduleCode, h.code) ||
+            !TReader::valid(h.moduleConstants, h.constants) ||
+            !TReader::valid(h.moduleSymbols, h.symbols) ||
+            !validCode(h.moduleCode, h.moduleConstants, 0))
+        {
+            return false;
+        }
+        for (uint64_t i = 0; i < h.functions.count; ++i)
+        {
+            const auto &f = functions_[i];
+            if (!validCode(f.code, f.constants, f.symbols.count))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::shared_ptr<TModule> module() const
+    {
+        const auto &h = header_;
+        auto module = std::make_shared<TModule>();
+        std::vector<TUserFunction *> functions;
+        functions.reserve(h.functions.count);
+        for (uint64_t i = 0; i < h.functions.count; ++i)
+        {
+            const auto &record = functions_[i];
+            auto *function = new TUserFunction(string(record.name));
+            function->setNumberOfArguments(record.nArgs);
+            function->funcCode() = code(record.code);
+            addConstants(function->constantTable(), record.constants);
+            for (uint32_t j = 0; j < record.symbols.count; ++j)
+            {
+                function->symboltable().addSymbol(
+                    string(symbols_[record.symbols.first + j].name));
+            }
+            functions.push_back(function);
+        }
+        module->code() = code(h.moduleCode);
+        addConstants(module->constants(), h.moduleConstants);
+        for (uint32_t i = 0; i < h.moduleSymbols.count; ++i)
+        {
+            const auto &record = symbols_[h.moduleSymbols.first + i];
+            if (record.function >= 0)
+            {
+                module->symboltable().addSymbol(functions[record.function]);
+            }
+            else
+            {
+                module->symboltable().addSymbol(string(record.name));
+            }
+        }
+        return module;
+    }
+
+private:
+    bool validString(const TStringRef &ref) const
+    {
+        return uint64_t(ref.offset) + ref.length <= header_.strings.count;
+    }
+
+    // Constant operands count from 1.
+    bool validConstant(int64_t index, const TRange &constants,
+                       TConstantValueType type) const
+    {
+        return index >= 1 && index <= constants.count &&
+               constants_[constants.first + index - 1].type ==
+                   static_cast<uint32_t>(type);
+    }
+
+    // The VM trusts the operands the builder emits, so a file's code must
+    // only refer to its own constants, symbols and instructions.
+    bool validCode(const TRange &range, const TRange &constants,
+                   uint32_t nLocals) const
+    {
+        const TByteCode *code = code_ + range.first;
+        const int64_t size = range.count;
+        const int64_t nGlobals = header_.moduleSymbols.count;
+        // Execution never runs off the end of the code.
+        if (size == 0 || (code[size - 1].opCode != OpCode::Halt &&
+                          code[size - 1].opCode != OpCode::Return &&
+                          code[size - 1].opCode != OpCode::Jmp))
+        {
+            return false;
+        }
+        for (int64_t i = 0; i < size; ++i)
+        {
+            const int64_t operand = code[i].index;
+            switch (code[i].opCode)
+            {
+            case OpCode::Pushd:
+                if (!validConstant(operand, constants,
+                                   TConstantValueType::Double))
+                {
+                    return false;
+                }
+                break;
+            case OpCode::Pushs:
+                if (!validConstant(operand, constants,
+                                   TConstantValueType::String))
+                {
+                    return false;
+                }
+                break;
+            case OpCode::Load:
+            case OpCode::Store:
+                if (operand < 0 || operand >= nGlobals)
+                {
+                    return false;
+                }
+                break;
+            case OpCode::LoadLocal:
+            case OpCode::StoreLocal:
+                if (operand < 0 || operand >= nLocals)
+                {
+                    return false;
+                }
+                break;
+            case OpCode::Jmp:
+            case OpCode::JmpIfTrue:
+            case OpCode::JmpIfFalse:
+                // A call takes its target from the Pushi before it, so a
+                // jump must not land between the two.
+                if (i + operand < 0 || i + operand >= size ||
+                    code[i + operand].opCode == OpCode::Call)
+                {
+                    return false;
+                }
+                break;
+            case OpCode::Call:
+            {
+                const int64_t target = i > 0 ? code[i - 1].index : -1;
+                if (i == 0 || code[i - 1].opCode != OpCode::Pushi ||
+                    target < 0 || target >= nGlobals ||
+                    symbols_[header_.moduleSymbols.first + target].function <
+                        0)
+                {
+                    return false;
+                }
+                break;
+            }
+            case OpCode::BuiltIn:
+                if (operand < 0 ||
+                    operand >= static_cast<int64_t>(TBuiltIns::size()))
+                {
+                    return false;
+                }
+                break;
+            case OpCode::LvecIdx:
+            case OpCode::SvecIdx:
+                if (operand != 1 && operand != 2)
+                {
+                    return false;
+                }
+                break;
+            case OpCode::CreateList:
+            case OpCode::Spawn:
+                if (operand < 0)
+                {
+                    return false;
+                }
+                break;
+            default:
+                break;
+            }
+        }
+        return true;
+    }
+
+    std::string string(const TStringRef &ref) const
+    {
+        return std::string(strings_ + ref.offset, ref.length);
+    }
+
+    TProgram code(const TRange &range) const
+    {
+        return TProgram::view(code_ + range.first, range.count);
+    }
+
+    void addConstants(TConstantValueTable &table, const TRange &range) const
+    {
+        for (uint32_t i = 0; i < range.count; ++i)
+        {
+            const auto &record = constants_[range.first + i];
+            switch (static_cast<TConstantValueType>(record.type))
+            {
+            case TConstantValueType::None:
+                table.emplace_back(TConstantValueElement());
+                break;
+            case TConstantValueType::Double:
+                table.emplace_back(record.dvalue);
+                break;
+            case TConstantValueType::String:
+                table.emplace_back(string(record.svalue));
+                break;
+            }
+        }
+    }
+
+    const THeader &header_;
+    TByteCode *code_;
+    const TConstantRecord *constants_;
+    const TSymbolRecord *symbols_;
+    const TFunctionRecord *functions_;
+    const char *strings_;
+};
+
+} // namespace
+
+uint64_t TModuleFile::sourceHash(const std::string &source)
+{
+    return hashBytes(source.data(), source.size(), kHashSeed);
+}
+
+uint64_t TModuleFile::compilerVersion()
+{
+    static const uint64_t version = [] {
+        uint64_t hash = kHashSeed;
+        uint32_t layout[] = {kFormatVersion, uint32_t(sizeof(TByteCode)),
+                             uint32_t(sizeof(THeader))};
+        hash = hashBytes(layout, sizeof(layout), hash);
+        for (int op = 0; op <= kLastOpCode; ++op)
+        {
+            hash = hashString(OpCodeToString(static_cast<OpCode>(op)), hash);
+        }
+        for (size_t i = 0; i < TBuiltIns::size(); ++i)
+        {
+            const auto &builtIn = TBuiltIns::get(static_cast<int>(i));
+            hash = hashString(builtIn.name, hash);
+            hash = hashBytes(&builtIn.nArgs, sizeof(builtIn.nArgs), hash);
+        }
+        return hash;
+    }();
+    return version;
+}
+
+void TModuleFile::save(const TModule &module,
+                       const std::string &source,
+                       const std::string &path)
+{
+    TImage image;
+    THeader header;
+    header.moduleSymbols = image.addGlobals(module.symboltable());
+    header.moduleCode = image.addCode(module.code());
+    header.moduleConstants = image.addConstants(module.constants());
+
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.formatVersion = kFormatVersion;
+    header.byteOrder = kByteOrder;
+    header.compilerVersion = compilerVersion();
+    header.sourceHash = sourceHash(source);
+
+    // Written next to the target and renamed over it, so that a reader
+    // never maps a half written file.
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            throw std::runtime_error("Cannot write " + tmp);
+        }
+        // The header goes last, once the section offsets are known.
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        uint64_t position = sizeof(header);
+        writeSection(out, image.code.data(), header.code, position,
+                     image.code.size());
+        writeSection(out, image.constants.data(), header.constants, position,
+                     image.constants.size());
+        writeSection(out, image.symbols.data(), header.symbols, position,
+                     image.symbols.size());
+        writeSection(out, image.functions.data(), header.functions, position,
+                     image.functions.size());
+        writeSection(out, image.strings.data(), header.strings, position,
+                     image.strings.size());
+        header.fileSize = position;
+        out.seekp(0);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        if (!out.flush())
+        {
+            std::remove(tmp.c_str());
+            throw std::runtime_error("Cannot write " + tmp);
+        }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0)
+    {
+        std::remove(tmp.c_str());
+        throw std::runtime_error("Cannot write " + path);
+    }
+}
+
+std::shared_ptr<const TModule> TModuleFile::load(const std::string &path,
+                                                 const std::string &source)
+{
+    auto mapping = TMappedFile::open(path);
+    if (!mapping || mapping->size() < sizeof(THeader))
+    {
+        return nullptr;
+    }
+    const auto &header = *reinterpret_cast<const THeader *>(mapping->data());
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+        header.formatVersion != kFormatVersion ||
+        header.byteOrder != kByteOrder ||
+        header.compilerVersion != compilerVersion() ||
+        header.fileSize != mapping->size() ||
+        header.sourceHash != sourceHash(source))
+    {
+        return nullptr;
+    }
+
+    TReader reader(*mapping);
+    auto *code = reader.section<TByteCode>(header.code);
+    const auto *constants = reader.section<TConstantRecord>(header.constants);
+    const auto *symbols = reader.section<TSymbolRecord>(header.symbols);
+    const auto *functions = reader.section<TFunctionRecord>(header.functions);
+    const auto *strings = reader.section<char>(header.strings);
+    if (!code || !constants || !symbols || !functions || !strings)
+    {
+        return nullptr;
+    }
+    TLoader loader(header, code, constants, symbols, functions, strings);
+    if (!loader.valid())
+    {
+        return nullptr;
+    }
+    auto module = loader.module();
+    module->keepAlive(std::move(mapping));
+    return module;
+}
+
+std::shared_ptr<const TModule> TModuleFile::loadOrCompile(
+    const std::string &path,
+    const std::string &source)
+{
+    if (auto module = load(path, source))
+    {
+        return module;
+    }
+    auto module = TInterpreter::compile(source);
+    try
+    {
+        save(*module, source, path);
+    }
+    catch (const std::runtime_error &)
+    {
+        // A cache that cannot be written only costs the next start.
+    }
+    return module;
+}
@@ -0,0 +1,51 @@
+#ifndef TMODULEFILE_HPP_INCLUDED
+#define TMODULEFILE_HPP_INCLUDED
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+class TModule;
+
+/*
+ * Compiled modules on disk, so that a script is only parsed and built once.
+ *
+ * A file holds everything the builder produces: the code of the module and
+ * of every function, the symbol tables, the constants and the strings they
+ * name. Its header records the hash of the source and the version of the
+ * compiler it was built by. Every section is an 8 byte aligned array of
+ * fixed size records, so a loaded module executes its code straight out of
+ * the mapped file; only symbols, functions and string constants are
+ * rebuilt.
+ *
+ * Files are written in the byte order and layout of the host and are not
+ * meant to be moved between machines; a file from another one is rejected
+ * like any other mismatch.
+ */
+class TModuleFile
+{
+public:
+    static constexpr uint32_t kFormatVersion = 1;
+
+    // Throws if the file cannot be written or the module holds values a
+    // build never stores in it. The file is replaced atomically.
+    static void save(const TModule &module,
+                     const std::string &source,
+                     const std::string &path);
+    // Returns nullptr if the file is missing or damaged, or if it was
+    // written for another source or by another compiler.
+    static std::shared_ptr<const TModule> load(const std::string &path,
+                                               const std::string &source);
+    // Loads the file, or compiles the source and rewrites the file if it
+    // cannot be loaded. Throws on syntax errors.
+    static std::shared_ptr<const TModule> loadOrCompile(
+        const std::string &path,
+        const std::string &source);
+
+    static uint64_t sourceHash(const std::string &source);
+    // Changes whenever the format, the opcodes or the built-ins change,
+    // since the code refers to both by number.
+    static uint64_t compilerVersion();
+};
+
+#endif
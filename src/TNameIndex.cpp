@@ -0,0 +1,52 @@
+#include "TNameIndex.hpp"
+
+// FNV-1a
+uint32_t TNameIndex::hash(std::string_view name)
+{
+    uint32_t h = 2166136261u;
+    for (char ch : name)
+    {
+        h = (h ^ static_cast<unsigned char>(ch)) * 16777619u;
+    }
+    return h;
+}
+
+void TNameIndex::add(uint32_t h, bool indexed)
+{
+    hashes_.push_back(h);
+    if (!indexed)
+    {
+        return;
+    }
+    // Kept at most half full, so that probe sequences stay short.
+    if (2 * (nIndexed_ + 1) > slots_.size())
+    {
+        grow();
+    }
+    insert(static_cast<int>(hashes_.size() - 1));
+    ++nIndexed_;
+}
+
+void TNameIndex::insert(int id)
+{
+    size_t mask = slots_.size() - 1;
+    size_t i = hashes_[id] & mask;
+    while (slots_[i] >= 0)
+    {
+        i = (i + 1) & mask;
+    }
+    slots_[i] = id;
+}
+
+void TNameIndex::grow()
+{
+    std::vector<int> old(slots_.empty() ? 64 : 2 * slots_.size(), -1);
+    old.swap(slots_);
+    for (int id : old)
+    {
+        if (id >= 0)
+        {
+            insert(id);
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef TNAMEINDEX_HPP_INCLUDED
+#define TNAMEINDEX_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// An open addressing hash index over names numbered 0, 1, 2, ... in the
+// order they are added. The owner keeps the names, lookups compare them
+// through the nameOf callback only when the hashes agree.
+class TNameIndex
+{
+public:
+    static uint32_t hash(std::string_view name);
+
+    // Returns the id of the name, or -1.
+    template <typename NameOf>
+    int find(std::string_view name, uint32_t h, const NameOf &nameOf) const
+    {
+        if (slots_.empty())
+        {
+            return -1;
+        }
+        size_t mask = slots_.size() - 1;
+        for (size_t i = h & mask;; i = (i + 1) & mask)
+        {
+            int id = slots_[i];
+            if (id < 0)
+            {
+                return -1;
+            }
+            if (hashes_[id] == h && nameOf(id) == name)
+            {
+                return id;
+            }
+        }
+    }
+    // Numbers the next name, whose hash is h. Ids added without being
+    // indexed are never found, so that a name keeps its first id.
+    void add(uint32_t h, bool indexed = true);
+    uint32_t hashOf(int id) const
+    {
+        return hashes_[id];
+    }
+    size_t size() const
+    {
+        return hashes_.size();
+    }
+
+private:
+    void insert(int id);
+    void grow();
+
+    std::vector<uint32_t> hashes_; // by id
+    std::vector<int> slots_;       // ids, -1 for empty slots
+    size_t nIndexed_ = 0;
+};
+
+#endif
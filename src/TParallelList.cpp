@@ -0,0 +1,429 @@
+#include "TParallelList.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "TChannel.hpp"
+#include "TExecutionContext.hpp"
+#include "TListObject.hpp"
+#include "TMatrixObject.hpp"
+#include "TRuntime.hpp"
+#include "TStringObject.hpp"
+#include "TThreadPool.hpp"
+#include "VM.hpp"
+
+namespace
+{
+
+// Below this many elements a chunk costs more to hand out than to run.
+constexpr size_t kMinChunkSize = 32;
+// More chunks than threads, so that elements of uneven cost even out.
+constexpr size_t kChunksPerThread = 4;
+
+// The caller's values of the globals the function declares, by index and
+// copied out of the caller's heap.
+using TCapturedGlobals = std::vector<std::pair<int, TMessage>>;
+
+TCapturedGlobals capture(TExecutionContext &context, int funcIndex)
+{
+    TCapturedGlobals captured;
+    auto &globals = context.globals();
+    const auto &names = globals.get(funcIndex).fvalue()->globalVariableList();
+    for (size_t k = 0; k < names.size(); ++k)
+    {
+        int i = -1;
+        if (!globals.find(names[static_cast<int>(k)], i))
+        {
+            continue;
+        }
+        const auto &value = globals.get(i);
+        TMachineStackRecord record;
+        switch (value.type())
+        {
+        case TSymbolElementType::symInteger:
+            record.setValue(value.ivalue());
+            break;
+        case TSymbolElementType::symBoolean:
+            record.setValue(value.bvalue());
+            break;
+        case TSymbolElementType::symDouble:
+            record.setValue(value.dvalue());
+            break;
+        case TSymbolElementType::symString:
+            record.setValue(value.svalue());
+            break;
+        case TSymbolElementType::symList:
+            record.setValue(value.lvalue());
+            break;
+        case TSymbolElementType::symMatrix:
+            record.setValue(value.mvalue());
+            break;
+        case TSymbolElementType::symChannel:
+            record.setValue(value.cvalue());
+            break;
+        default:
+            // Functions are part of the module, the rest is unset.
+            continue;
+        }
+        captured.emplace_back(i, TMessage::pack(record));
+    }
+    return captured;
+}
+
+void bind(TGlobalValues &globals, int index, const TMachineStackRecord &value)
+{
+    switch (value.type())
+    {
+    case TStackRecordType::stInteger:
+        globals.storeSymbolToTable(index, value.ivalue());
+        break;
+    case TStackRecordType::stBoolean:
+        globals.storeSymbolToTable(index, value.bvalue());
+        break;
+    case TStackRecordType::stDouble:
+        globals.storeSymbolToTable(index, value.dvalue());
+        break;
+    case TStackRecordType::stString:
+        globals.storeSymbolToTable(index, value.svalue());
+        break;
+    case TStackRecordType::stList:
+        globals.storeSymbolToTable(index, value.lvalue());
+        break;
+    case TStackRecordType::stMatrix:
+        globals.storeSymbolToTable(index, value.mvalue());
+        break;
+    case TStackRecordType::stChannel:
+        globals.storeSymbolToTable(index, value.cvalue());
+        break;
+    case TStackRecordType::stNone:
+        break;
+    }
+}
+
+// A VM with a runtime of its own and a fresh context of the caller's
+// module. The captured globals are unpacked into the worker's heap, so
+// workers never touch an object of the caller or of each other.
+struct TWorker
+{
+    TWorker(std::shared_ptr<const TModule> module,
+            const TCapturedGlobals &globals)
+        : context(std::move(module)), vm(runtime)
+    {
+        TRuntime::TScope scope(runtime);
+        for (const auto &[index, message] : globals)
+        {
+            bind(context.globals(), index, message.unpack());
+        }
+    }
+
+    TRuntime runtime;
+    TExecutionContext context;
+    VM vm;
+};
+
+// Workers are created on demand and passed from chunk to chunk, so there
+// are never more of them than threads working on the list. They live
+// until the call returns, results are read out of their heaps.
+class TWorkers
+{
+public:
+    TWorkers(TExecutionContext &caller, int funcIndex)
+        : module_(caller.sharedModule()), globals_(capture(caller, funcIndex))
+    {
+    }
+
+    TWorker *acquire()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (idle_.empty())
+        {
+            all_.push_back(std::make_unique<TWorker>(module_, globals_));
+            return all_.back().get();
+        }
+        auto *worker = idle_.back();
+        idle_.pop_back();
+        return worker;
+    }
+    void release(TWorker *worker)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        idle_.push_back(worker);
+    }
+
+private:
+    std::shared_ptr<const TModule> module_;
+    TCapturedGlobals globals_;
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<TWorker>> all_;
+    std::vector<TWorker *> idle_;
+};
+
+class TLease
+{
+public:
+    explicit TLease(TWorkers &workers)
+        : workers_(workers), worker_(workers.acquire())
+    {
+    }
+    TLease(const TLease &) = delete;
+    TLease &operator=(const TLease &) = delete;
+    ~TLease()
+    {
+        workers_.release(worker_);
+    }
+
+    TWorker *operator->() const
+    {
+        return worker_;
+    }
+
+private:
+    TWorkers &workers_;
+    TWorker *worker_;
+};
+
+size_t chunkCount(size_t n, const TThreadPool &pool)
+{
+    size_t threads = pool.size() + 1;
+    return std::max<size_t>(
+        1, std::min(n / kMinChunkSize, threads * kChunksPerThread));
+}
+
+size_t chunkBegin(size_t chunk, size_t nChunks, size_t n)
+{
+    return chunk * n / nChunks;
+}
+
+// The functions below copy values into the heap of the runtime entered on
+// the calling thread, so that they outlive the heap they came from.
+TStringObject *importString(const TStringObject *value)
+{
+    return TStringObject::createStringObject(std::string(value->value()));
+}
+
+TListObject *importList(const TListObject *list)
+{
+    if (list->storage() != TListStorage::lsMixed)
+    {
+        // Packed buffers hold no pointers, sharing them is enough.
+        return list->clone();
+    }
+
+    auto *copy = TListObject::createObject();
+    for (size_t i = 0; i < list->size(); ++i)
+    {
+        auto item = list->get(static_cast<int>(i));
+        switch (item.type())
+        {
+        case TListItemType::liInteger:
+            copy->append(item.ivalue());
+            break;
+        case TListItemType::liBoolean:
+            copy->append(item.bvalue());
+            break;
+        case TListItemType::liDouble:
+            copy->append(item.dvalue());
+            break;
+        case TListItemType::liString:
+            copy->append(importString(item.svalue()));
+            break;
+        case TListItemType::liList:
+            copy->append(importList(item.lvalue()));
+            break;
+        }
+    }
+    return copy;
+}
+
+TMachineStackRecord importRecord(const TMachineStackRecord &record)
+{
+    TMachineStackRecord copy = record;
+    switch (record.type())
+    {
+    case TStackRecordType::stString:
+        copy.setValue(importString(record.svalue()));
+        break;
+    case TStackRecordType::stList:
+        copy.setValue(importList(record.lvalue()));
+        break;
+    case TStackRecordType::stMatrix:
+        copy.setValue(record.mvalue()->clone());
+        break;
+    case TStackRecordType::stChannel:
+        copy.setValue(
+            TChannelObject::createObject(record.cvalue()->shared()));
+        break;
+    default:
+        break;
+    }
+    return copy;
+}
+
+// The elements of a list as messages, packed on the calling thread so that
+// workers never read the caller's strings and lists. Packed numeric storage
+// holds no objects and is read by the workers directly.
+std::vector<TMessage> packElements(const TListObject *list)
+{
+    std::vector<TMessage> messages;
+    if (list->storage() != TListStorage::lsMixed)
+    {
+        return messages;
+    }
+    messages.reserve(list->size());
+    for (size_t i = 0; i < list->size(); ++i)
+    {
+        messages.push_back(TMessage::pack(list->get(static_cast<int>(i))));
+    }
+    return messages;
+}
+
+// The i-th element as a function argument in the worker's heap.
+TMachineStackRecord argument(const TListObject *list,
+                             const std::vector<TMessage> &packed,
+                             size_t i)
+{
+    if (!packed.empty())
+    {
+        return packed[i].unpack();
+    }
+    TMachineStackRecord record;
+    auto item = list->get(static_cast<int>(i));
+    switch (item.type())
+    {
+    case TListItemType::liInteger:
+        record.setValue(item.ivalue());
+        break;
+    case TListItemType::liBoolean:
+        record.setValue(item.bvalue());
+        break;
+    case TListItemType::liDouble:
+        record.setValue(item.dvalue());
+        break;
+    default:
+        throw std::logic_error("Packed list storage holds an object");
+    }
+    return record;
+}
+
+void append(TListObject *list, const TMachineStackRecord &record)
+{
+    switch (record.type())
+    {
+    case TStackRecordType::stInteger:
+        list->append(record.ivalue());
+        break;
+    case TStackRecordType::stBoolean:
+        list->append(record.bvalue());
+        break;
+    case TStackRecordType::stDouble:
+        list->append(record.dvalue());
+        break;
+    case TStackRecordType::stString:
+        list->append(importString(record.svalue()));
+        break;
+    case TStackRecordType::stList:
+        list->append(importList(record.lvalue()));
+        break;
+    case TStackRecordType::stMatrix:
+        throw std::runtime_error("Matrices cannot be stored in lists");
+    case TStackRecordType::stChannel:
+        throw std::runtime_error("Channels cannot be stored in lists");
+    case TStackRecordType::stNone:
+        throw std::runtime_error("pmap expects a function returning a value");
+    }
+}
+
+} // namespace
+
+TListObject *TParallelList::map(TExecutionContext &context,
+                                int funcIndex,
+                                const TListObject *list,
+                                TThreadPool &pool)
+{
+    size_t n = list->size();
+    size_t nChunks = chunkCount(n, pool);
+    std::vector<TMachineStackRecord> results(n);
+    auto packed = packElements(list);
+    TWorkers workers(context, funcIndex);
+
+    pool.parallelFor(nChunks, [&](size_t chunk) {
+        TLease worker(workers);
+        TRuntime::TScope scope(worker->runtime);
+        size_t end = chunkBegin(chunk + 1, nChunks, n);
+        for (size_t i = chunkBegin(chunk, nChunks, n); i < end; ++i)
+        {
+            results[i] = worker->vm.callFunction(
+                worker->context, funcIndex,
+                {argument(list, packed, i)});
+        }
+    });
+
+    auto *mapped = TListObject::createObject();
+    for (const auto &result : results)
+    {
+        append(mapped, result);
+    }
+    return mapped;
+}
+
+TMachineStackRecord TParallelList::reduce(TExecutionContext &context,
+                                          int funcIndex,
+                                          const TListObject *list,
+                                          const TMachineStackRecord &init,
+                                          TThreadPool &pool)
+{
+    size_t n = list->size();
+    if (n == 0)
+    {
+        return init;
+    }
+
+    // The first chunk starts from init, the others from their first
+    // element; the partial results are then folded left to right.
+    size_t nChunks = chunkCount(n, pool);
+    std::vector<TMachineStackRecord> partials(nChunks);
+    auto packed = packElements(list);
+    auto packedInit = TMessage::pack(init);
+    TWorkers workers(context, funcIndex);
+
+    pool.parallelFor(nChunks, [&](size_t chunk) {
+        TLease worker(workers);
+        TRuntime::TScope scope(worker->runtime);
+        size_t begin = chunkBegin(chunk, nChunks, n);
+        size_t end = chunkBegin(chunk + 1, nChunks, n);
+        TMachineStackRecord acc;
+        if (chunk == 0)
+        {
+            acc = packedInit.unpack();
+        }
+        else
+        {
+            acc = argument(list, packed, begin++);
+        }
+        for (size_t i = begin; i < end; ++i)
+        {
+            acc = worker->vm.callFunction(
+                worker->context, funcIndex,
+                {acc, argument(list, packed, i)});
+        }
+        partials[chunk] = acc;
+    });
+
+    TMachineStackRecord acc = partials[0];
+    if (nChunks > 1)
+    {
+        TLease worker(workers);
+        TRuntime::TScope scope(worker->runtime);
+        for (size_t chunk = 1; chunk < nChunks; ++chunk)
+        {
+            acc = worker->vm.callFunction(
+                worker->context, funcIndex,
+                {importRecord(acc), importRecord(partials[chunk])});
+        }
+    }
+    return importRecord(acc);
+}
@@ -0,0 +1,38 @@
+#ifndef TPARALLELLIST_HPP_INCLUDED
+#define TPARALLELLIST_HPP_INCLUDED
+
+#include "MachineStack.hpp"
+
+class TExecutionContext;
+class TListObject;
+class TThreadPool;
+
+/*
+ * Backs pmap(f, list) and preduce(f, list, init). The list is cut into
+ * chunks that worker VMs evaluate on the pool, each worker with its own
+ * runtime and a fresh execution context of the caller's module. The
+ * globals f declares, the elements and init reach the workers as TMessages,
+ * like the arguments of spawn. Results are copied into the caller's heap
+ * in list order.
+ *
+ * Lists too short to be worth splitting are evaluated on the calling
+ * thread.
+ */
+class TParallelList
+{
+public:
+    // The list of f(x) for every x in list.
+    static TListObject *map(TExecutionContext &context,
+                            int funcIndex,
+                            const TListObject *list,
+                            TThreadPool &pool);
+    // f(...f(f(init, x0), x1)..., xn). Chunks are folded independently and
+    // combined left to right, so f must be associative.
+    static TMachineStackRecord reduce(TExecutionContext &context,
+                                      int funcIndex,
+                                      const TListObject *list,
+                                      const TMachineStackRecord &init,
+                                      TThreadPool &pool);
+};
+
+#endif
@@ -0,0 +1,56 @@
+#include "TRuntime.hpp"
+
+namespace
+{
+
+thread_local TRuntime *entered = nullptr;
+
+} // namespace
+
+TRuntime::~TRuntime()
+{
+    for (auto &isolate : isolates_)
+    {
+        isolate.thread.join();
+    }
+    heap_.freeList();
+}
+
+void TRuntime::addIsolate(std::thread thread,
+                          std::shared_ptr<const std::atomic<bool>> finished)
+{
+    std::erase_if(isolates_, [](TIsolateThread &isolate) {
+        if (!isolate.finished->load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        isolate.thread.join();
+        return true;
+    });
+    isolates_.push_back({std::move(thread), std::move(finished)});
+}
+
+TRuntime &TRuntime::current()
+{
+    if (entered != nullptr)
+    {
+        return *entered;
+    }
+    thread_local TRuntime fallback;
+    return fallback;
+}
+
+TRuntime::TScope::TScope(TRuntime &runtime) : previous_(entered)
+{
+    entered = &runtime;
+}
+
+TRuntime::TScope::~TScope()
+{
+    entered = previous_;
+}
+
+TMemoryList &TMemoryList::current()
+{
+    return TRuntime::current().heap();
+}
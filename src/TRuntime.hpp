@@ -0,0 +1,68 @@
+#ifndef TRUNTIME_HPP_INCLUDED
+#define TRUNTIME_HPP_INCLUDED
+
+#include "MemoryManager.hpp"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/*
+ * The state a running script allocates into: the heap registry. Runtimes do
+ * not share state, so two of them can run scripts on different threads, even
+ * the same TModule.
+ *
+ * The VM is given its runtime. Object factories deep in the call graph
+ * allocate from the runtime entered on the calling thread, see TScope; a
+ * thread that never entered one gets a private default.
+ */
+class TRuntime
+{
+public:
+    TRuntime() = default;
+    TRuntime(const TRuntime &) = delete;
+    TRuntime &operator=(const TRuntime &) = delete;
+    ~TRuntime();
+
+    TMemoryList &heap()
+    {
+        return heap_;
+    }
+    // Threads of isolates spawned by scripts of this runtime, the runtime
+    // waits for them before it goes away. A thread sets finished as its last
+    // step; finished threads are joined whenever another one is added, so a
+    // long lived runtime does not keep them all.
+    void addIsolate(std::thread thread,
+                    std::shared_ptr<const std::atomic<bool>> finished);
+    size_t isolates() const
+    {
+        return isolates_.size();
+    }
+
+    static TRuntime &current();
+
+    // Makes a runtime current on this thread for the lifetime of the scope.
+    class TScope
+    {
+    public:
+        explicit TScope(TRuntime &runtime);
+        TScope(const TScope &) = delete;
+        TScope &operator=(const TScope &) = delete;
+        ~TScope();
+
+    private:
+        TRuntime *previous_;
+    };
+
+private:
+    struct TIsolateThread
+    {
+        std::thread thread;
+        std::shared_ptr<const std::atomic<bool>> finished;
+    };
+
+    TMemoryList heap_;
+    std::vector<TIsolateThread> isolates_;
+};
+
+#endif
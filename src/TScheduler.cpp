@@ -0,0 +1,232 @@
+#include "TScheduler.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+
+#include "TExecutionContext.hpp"
+#include "TRuntime.hpp"
+#include "TStringObject.hpp"
+#include "VM.hpp"
+
+struct TScheduler::TWorker
+{
+    TWorker() : vm(runtime)
+    {
+    }
+
+    std::mutex mutex;
+    std::deque<TTask> jobs;
+    TRuntime runtime;
+    VM vm;
+    std::thread thread;
+};
+
+namespace
+{
+
+void bindInput(TExecutionContext &context,
+               const std::string &name,
+               const TScriptValue &value)
+{
+    int index = -1;
+    if (!context.globals().find(name, index))
+    {
+        throw std::runtime_error("Script has no global named " + name);
+    }
+
+    auto &globals = context.globals();
+    std::visit(
+        [&globals, index](const auto &v) {
+            using T = std::decay_t<decltype(v)>;
+            if constexpr (std::is_same_v<T, std::string>)
+            {
+                globals.storeSymbolToTable(
+                    index, TStringObject::createStringObject(std::string(v)));
+            }
+            else if constexpr (!std::is_same_v<T, std::monostate>)
+            {
+                globals.storeSymbolToTable(index, v);
+            }
+        },
+        value);
+}
+
+TScriptValue resultValue(const VM &vm)
+{
+    if (vm.empty())
+    {
+        return {};
+    }
+
+    const auto &top = vm.top();
+    switch (top.type())
+    {
+    case TStackRecordType::stInteger:
+        return top.ivalue();
+    case TStackRecordType::stDouble:
+        return top.dvalue();
+    case TStackRecordType::stBoolean:
+        return top.bvalue();
+    case TStackRecordType::stString:
+        return top.svalue()->value();
+    case TStackRecordType::stNone:
+        return {};
+    default:
+        throw std::runtime_error("Script result of type " +
+                                 TStackRecordTypeToStr(top.type()) +
+                                 " cannot leave its runtime");
+    }
+}
+
+} // namespace
+
+TScheduler::TScheduler(size_t nWorkers)
+{
+    nWorkers = std::max<size_t>(nWorkers, 1);
+    workers_.reserve(nWorkers);
+    for (size_t i = 0; i < nWorkers; ++i)
+    {
+        workers_.push_back(std::make_unique<TWorker>());
+    }
+    // Start the threads only once every deque exists, they steal from all.
+    for (size_t i = 0; i < nWorkers; ++i)
+    {
+        workers_[i]->thread = std::thread([this, i] { workerLoop(i); });
+    }
+}
+
+TScheduler::~TScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wakeUp_.notify_all();
+    for (auto &worker : workers_)
+    {
+        worker->thread.join();
+    }
+}
+
+size_t TScheduler::defaultWorkers()
+{
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+std::future<TScriptResult> TScheduler::submit(TScriptJob job)
+{
+    auto promise = std::make_shared<std::promise<TScriptResult>>();
+    auto future = promise->get_future();
+    submit(std::move(job), [promise](TScriptResult result) {
+        promise->set_value(std::move(result));
+    });
+    return future;
+}
+
+void TScheduler::submit(TScriptJob job, TJobCallback done)
+{
+    TTask task;
+    task.job = std::move(job);
+    task.done = std::move(done);
+    task.queued = std::chrono::steady_clock::now();
+    task.queue = nextQueue_.fetch_add(1) % workers_.size();
+
+    auto &worker = *workers_[task.queue];
+    {
+        // Counted under the lock so that a worker about to sleep sees it,
+        // and before the job is published, so that a thief taking it never
+        // decrements the count below zero.
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++pending_;
+    }
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.jobs.push_back(std::move(task));
+    }
+    wakeUp_.notify_one();
+}
+
+bool TScheduler::take(size_t self, TTask &task)
+{
+    {
+        auto &own = *workers_[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.jobs.empty())
+        {
+            task = std::move(own.jobs.back());
+            own.jobs.pop_back();
+            --pending_;
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < workers_.size(); ++i)
+    {
+        auto &victim = *workers_[(self + i) % workers_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty())
+        {
+            task = std::move(victim.jobs.front());
+            victim.jobs.pop_front();
+            --pending_;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TScheduler::workerLoop(size_t self)
+{
+    auto &worker = *workers_[self];
+    while (true)
+    {
+        TTask task;
+        if (take(self, task))
+        {
+            auto start = std::chrono::steady_clock::now();
+            auto result = execute(worker, task.job);
+            auto stop = std::chrono::steady_clock::now();
+
+            result.stats.queueWait = start - task.queued;
+            result.stats.runTime = stop - start;
+            result.stats.worker = self;
+            result.stats.stolen = task.queue != self;
+            task.done(std::move(result));
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        wakeUp_.wait(lock, [this] { return stopping_ || pending_ > 0; });
+        if (stopping_ && pending_ == 0)
+        {
+            return;
+        }
+    }
+}
+
+TScriptResult TScheduler::execute(TWorker &worker, const TScriptJob &job)
+{
+    TScriptResult result;
+    try
+    {
+        TRuntime::TScope scope(worker.runtime);
+        TExecutionContext context(job.module);
+        for (const auto &[name, value] : job.inputs)
+        {
+            bindInput(context, name, value);
+        }
+        worker.vm.runModule(context);
+        result.value = resultValue(worker.vm);
+    }
+    catch (const std::exception &e)
+    {
+        result.value = {};
+        result.error = e.what();
+    }
+    // Nothing of the run outlives it, the result was copied out above.
+    worker.runtime.heap().freeList();
+    return result;
+}
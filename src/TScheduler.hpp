@@ -0,0 +1,96 @@
+#ifndef TSCHEDULER_HPP_INCLUDED
+#define TSCHEDULER_HPP_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "TModule.hpp"
+
+// A value handed to a scheduled script or returned from it. Results that
+// are lists or matrices are reported as an error.
+using TScriptValue =
+    std::variant<std::monostate, int, double, bool, std::string>;
+
+struct TScriptJob
+{
+    std::shared_ptr<const TModule> module;
+    // Globals bound before the run. The host declares their names with
+    // module->symboltable().addSymbol() before building the module.
+    std::vector<std::pair<std::string, TScriptValue>> inputs;
+};
+
+struct TJobStats
+{
+    std::chrono::nanoseconds queueWait{0};
+    std::chrono::nanoseconds runTime{0};
+    size_t worker = 0;
+    bool stolen = false; // run by a worker other than the one it was queued on
+};
+
+struct TScriptResult
+{
+    TScriptValue value;
+    std::string error; // set when the run threw, value is then empty
+    TJobStats stats;
+};
+
+// Called on the worker thread that ran the job, it must not throw.
+using TJobCallback = std::function<void(TScriptResult result)>;
+
+/*
+ * Runs script jobs on a fixed set of workers, one per core by default.
+ * Every worker owns a runtime and a VM it reuses for all of its jobs, and a
+ * deque of queued jobs. Submitted jobs are dealt round robin over the
+ * deques. A worker takes the newest job from the back of its own deque and,
+ * once that is empty, steals the oldest job from the front of another one.
+ */
+class TScheduler
+{
+public:
+    explicit TScheduler(size_t nWorkers = defaultWorkers());
+    TScheduler(const TScheduler &) = delete;
+    TScheduler &operator=(const TScheduler &) = delete;
+    // Runs the jobs still queued, then joins the workers.
+    ~TScheduler();
+
+    std::future<TScriptResult> submit(TScriptJob job);
+    void submit(TScriptJob job, TJobCallback done);
+
+    size_t size() const
+    {
+        return workers_.size();
+    }
+    static size_t defaultWorkers();
+
+private:
+    struct TTask
+    {
+        TScriptJob job;
+        TJobCallback done;
+        std::chrono::steady_clock::time_point queued;
+        size_t queue = 0;
+    };
+    struct TWorker;
+
+    bool take(size_t self, TTask &task);
+    void workerLoop(size_t self);
+    TScriptResult execute(TWorker &worker, const TScriptJob &job);
+
+    std::vector<std::unique_ptr<TWorker>> workers_;
+    std::atomic<size_t> nextQueue_{0};
+    std::atomic<size_t> pending_{0};
+    std::mutex mutex_;
+    std::condition_variable wakeUp_;
+    bool stopping_ = false;
+};
+
+#endif
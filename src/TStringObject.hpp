@@ -3,13 +3,23 @@
 /* DONE */
 
 #include "MemoryManager.hpp"
+#include <memory>
 #include <string>
 
+/*
+ * A string object is a view of the first length_ bytes of a shared buffer.
+ * Concatenation appends in place when the left operand is the last view of
+ * its buffer, so building a string with repeated '+' is linear in the bytes
+ * produced. Older views of the same buffer keep their own length and are
+ * flattened into a private buffer the first time they are read.
+ */
 class TStringObject : public TRhodusObject
 {
 public:
     template <typename T>
-    explicit TStringObject(T &&value) : value_(std::forward<T>(value))
+    explicit TStringObject(T &&value)
+        : buffer_(std::make_shared<std::string>(std::forward<T>(value))),
+          length_(buffer_->size())
     {
     }
 
@@ -18,6 +28,7 @@ public:
     {
         auto *ret = new TStringObject(std::forward<T>(value));
         ret->setType(TBlockType::btConstant);
+        ret->readOnly_ = true;
         return ret;
     }
 
@@ -25,34 +36,96 @@ public:
     static TStringObject *createStringObject(T &&value)
     {
         auto *ret = new TStringObject(std::forward<T>(value));
-        TMemoryList::getInstance().addNode(ret);
+        TMemoryList::current().addNode(ret);
         return ret;
     }
 
     bool isEqualTo(const TStringObject &other) const
     {
-        return !value_.compare(other.value_);
+        return length_ == other.length_ && !value().compare(other.value());
     }
 
     // FIXME whoever calls this function, must free the returned object.
     static TStringObject *add(const TStringObject &first,
                               const TStringObject &second)
     {
-        return createStringObject(first.value_ + second.value_);
+        // Constants are shared by every run of a module, never grow them.
+        if (!first.isReadOnly() && first.isBufferTail())
+        {
+            if (first.buffer_ == second.buffer_)
+            {
+                first.buffer_->append(std::string(second.value()));
+            }
+            else
+            {
+                first.buffer_->append(*second.buffer_, 0, second.length_);
+            }
+            return createStringObject(first.buffer_, first.buffer_->size());
+        }
+
+        auto buffer = std::make_shared<std::string>();
+        buffer->reserve(first.length_ + second.length_);
+        buffer->append(*first.buffer_, 0, first.length_);
+        buffer->append(*second.buffer_, 0, second.length_);
+        size_t length = buffer->size();
+        return createStringObject(std::move(buffer), length);
     }
 
+    // Strings are immutable, a clone is just another view of the buffer.
+    // Constants may be read by several threads at once, so their clones
+    // get a buffer of their own that appends can grow in place.
     TStringObject *clone() const
     {
-        return createStringObject(value_);
+        if (isReadOnly())
+        {
+            return createStringObject(std::string(value()));
+        }
+        return createStringObject(buffer_, length_);
+    }
+
+    size_t length() const
+    {
+        return length_;
+    }
+    // Set once for the constants of a module, unlike the block type, which
+    // the VM retags as values are stored and dropped.
+    bool isReadOnly() const
+    {
+        return readOnly_;
     }
 
     const std::string &value() const
     {
-        return value_;
+        if (!isBufferTail())
+        {
+            buffer_ = std::make_shared<std::string>(*buffer_, 0, length_);
+        }
+        return *buffer_;
     }
 
 private:
-    std::string value_;
+    TStringObject(std::shared_ptr<std::string> buffer, size_t length)
+        : buffer_(std::move(buffer)), length_(length)
+    {
+    }
+
+    static TStringObject *createStringObject(
+        std::shared_ptr<std::string> buffer,
+        size_t length)
+    {
+        auto *ret = new TStringObject(std::move(buffer), length);
+        TMemoryList::current().addNode(ret);
+        return ret;
+    }
+
+    bool isBufferTail() const
+    {
+        return length_ == buffer_->size();
+    }
+
+    mutable std::shared_ptr<std::string> buffer_;
+    size_t length_ = 0;
+    bool readOnly_ = false;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,6 +1,8 @@
 #include "TSymbolTable.hpp"
 #include "ConstantTable.hpp"
+#include "TChannel.hpp"
 #include "TListObject.hpp"
+#include "TMatrixObject.hpp"
 #include <assert.h>
 #include <stdexcept>
 /* DONE */
@@ -12,13 +14,15 @@ static TByteCode createByteCode(OpCode opcode, int ivalue)
     return bcode;
 }
 
-static TByteCode createByteCode(OpCode opcode, double dvalue)
+static TByteCode createByteCode(OpCode opcode,
+                                double dvalue,
+                                TConstantValueTable &constants)
 {
     TByteCode bcode;
     bcode.opCode = opcode;
     TConstantValueElement elem(dvalue);
-    constantValueTable.emplace_back(std::move(elem));
-    bcode.index = static_cast<int>(constantValueTable.size());
+    constants.emplace_back(std::move(elem));
+    bcode.index = static_cast<int>(constants.size());
     return bcode;
 }
 
@@ -37,31 +41,41 @@ static TByteCode createByteCode(OpCode opcode)
     return bcode;
 }
 
-static TByteCode createByteCode(OpCode opcode, const std::string &svalue)
+static TByteCode createByteCode(OpCode opcode,
+                                const std::string &svalue,
+                                TConstantValueTable &constants)
 {
     TByteCode bcode;
     bcode.opCode = opcode;
-    constantValueTable.emplace_back(svalue);
-    bcode.index = static_cast<int>(constantValueTable.size());
+    constants.emplace_back(svalue);
+    bcode.index = static_cast<int>(constants.size());
     return bcode;
 }
 
-bool TSymbolTable::find(const std::string &name, int &index)
+bool TSymbolTable::find(const std::string &name, int &index) const
 {
-    for (size_t i = 0; i < symbols_.size(); ++i)
+    return find(name, TNameIndex::hash(name), index);
+}
+
+bool TSymbolTable::find(std::string_view name,
+                        uint32_t hash,
+                        int &index) const
+{
+    int found = index_.find(name, hash, [this](int id) -> std::string_view {
+        return symbols_[id].name();
+    });
+    if (found < 0)
     {
-        if (symbols_[i].name() == name)
-        {
-            index = static_cast<int>(i);
-            return true;
-        }
+        return false;
     }
-    return false;
+    index = found;
+    return true;
 }
 
 int TSymbolTable::addSymbol(const std::string &name)
 {
     symbols_.emplace_back(name);
+    indexLastSymbol();
     return static_cast<int>(symbols_.size() - 1);
 }
 
@@ -70,63 +84,59 @@ int TSymbolTable::addSymbol(TUserFunction *fvalue)
     symbols_.emplace_back(fvalue);
     symbols_.back().setName(fvalue->name());
     symbols_.back().setType(TSymbolElementType::symUserFunc);
+    indexLastSymbol();
     return static_cast<int>(symbols_.size() - 1);
 }
 
+// A name added again keeps finding its first symbol.
+void TSymbolTable::indexLastSymbol()
+{
+    const std::string &name = symbols_.back().name();
+    uint32_t hash = TNameIndex::hash(name);
+    int existing = 0;
+    index_.add(hash, !find(name, hash, existing));
+}
+
 void TSymbolTable::storeSymbolToTable(int index, int ivalue)
 {
     checkForExistingData(index);
-    symbols_[index].type_ = TSymbolElementType::symInteger;
-    symbols_[index].setValue(ivalue);
+    symbols_[index].store(ivalue);
 }
 
 void TSymbolTable::storeSymbolToTable(int index, bool bvalue)
 {
     checkForExistingData(index);
-    symbols_[index].type_ = TSymbolElementType::symBoolean;
-    symbols_[index].setValue(bvalue);
+    symbols_[index].store(bvalue);
 }
 
 void TSymbolTable::storeSymbolToTable(int index, double dvalue)
 {
     checkForExistingData(index);
-    symbols_[index].type_ = TSymbolElementType::symDouble;
-    symbols_[index].setValue(dvalue);
+    symbols_[index].store(dvalue);
 }
 
 void TSymbolTable::storeSymbolToTable(int index, TStringObject *svalue)
 {
     checkForExistingData(index);
-
-    TStringObject *entry = nullptr;
-    if (svalue->isConstant() || svalue->isBound())
-    {
-        entry = svalue->clone();
-    }
-    else
-    {
-        entry = svalue;
-    }
-    entry->setType(TBlockType::btBound);
-    symbols_[index].setValue(entry);
-    symbols_[index].setType(TSymbolElementType::symString);
+    symbols_[index].store(svalue);
 }
 
 void TSymbolTable::storeSymbolToTable(int index, TListObject *lvalue)
 {
     checkForExistingData(index);
-    TListObject *entry = nullptr;
-    if (lvalue->isConstant() || lvalue->isBound() || lvalue->isOwned())
-    {
-        entry = lvalue->clone();
-    }
-    else
-    {
-        entry = lvalue;
-    }
-    entry->setType(TBlockType::btBound);
-    symbols_[index].setValue(entry);
-    symbols_[index].setType(TSymbolElementType::symList);
+    symbols_[index].store(lvalue);
+}
+
+void TSymbolTable::storeSymbolToTable(int index, TMatrixObject *mvalue)
+{
+    checkForExistingData(index);
+    symbols_[index].store(mvalue);
+}
+
+void TSymbolTable::storeSymbolToTable(int index, TChannelObject *cvalue)
+{
+    checkForExistingData(index);
+    symbols_[index].store(cvalue);
 }
 
 void TSymbolTable::checkForExistingData(int index)
@@ -139,6 +149,7 @@ void TSymbolTable::checkForExistingData(int index)
 
 void TProgram::clear()
 {
+    view_ = nullptr;
     actualLength_ = 0;
     code_.clear();
 }
@@ -163,10 +174,12 @@ void TProgram::addByteCode(OpCode opcode, int val)
     code_[actualLength_++] = createByteCode(opcode, val);
 }
 
-void TProgram::addByteCode(OpCode opcode, double val)
+void TProgram::addByteCode(OpCode opcode,
+                           double val,
+                           TConstantValueTable &constants)
 {
     checkSpace();
-    code_[actualLength_++] = createByteCode(opcode, val);
+    code_[actualLength_++] = createByteCode(opcode, val, constants);
 }
 
 void TProgram::addByteCode(OpCode opcode, bool val)
@@ -175,10 +188,12 @@ void TProgram::addByteCode(OpCode opcode, bool val)
     code_[actualLength_++] = createByteCode(opcode, val);
 }
 
-void TProgram::addByteCode(OpCode opcode, std::string val)
+void TProgram::addByteCode(OpCode opcode,
+                           std::string val,
+                           TConstantValueTable &constants)
 {
     checkSpace();
-    code_[actualLength_++] = createByteCode(opcode, val);
+    code_[actualLength_++] = createByteCode(opcode, val, constants);
 }
 
 void TProgram::appendProgram(TProgram program)
@@ -195,8 +210,18 @@ size_t TProgram::createInstructionSpace()
     return ++actualLength_;
 }
 
+void TProgram::own()
+{
+    if (view_)
+    {
+        code_.assign(view_, view_ + actualLength_);
+        view_ = nullptr;
+    }
+}
+
 void TProgram::checkSpace()
 {
+    own();
     if (actualLength_ == code_.size())
     {
         code_.resize(code_.size() + ALLOC_BY);
@@ -207,8 +232,11 @@ bool TProgram::operator==(const TProgram &other) const
 {
     if (actualLength_ != other.actualLength_)
         return false;
-    if (code_ != other.code_)
-        return false;
+    for (size_t i = 0; i < actualLength_; ++i)
+    {
+        if ((*this)[i] != other[i])
+            return false;
+    }
     return true;
 }
 
@@ -218,10 +246,10 @@ std::string TProgram::string() const
     int i = static_cast<int>(actualLength_);
     while (--i >= 0)
     {
-        msg += OpCodeToString(code_[i].opCode);
-        if (code_[i].index != -1)
+        msg += OpCodeToString((*this)[i].opCode);
+        if ((*this)[i].index != -1)
         {
-            msg += " " + std::to_string(code_[i].index);
+            msg += " " + std::to_string((*this)[i].index);
         }
         msg += "\n";
     }
@@ -229,14 +257,96 @@ std::string TProgram::string() const
 }
 
 TSymbol::TSymbol(const std::string &name)
-    : type_(TSymbolElementType::symUndefined), name_(name)
+    : TSymbolValue(TSymbolElementType::symUndefined), name_(name)
 {
 }
 
 TSymbol::TSymbol(TUserFunction *fvalue)
-    : type_(TSymbolElementType::symUserFunc), name_(fvalue->name())
+    : TSymbolValue(TSymbolElementType::symUserFunc), name_(fvalue->name())
+{
+    setValue(fvalue);
+}
+
+void TSymbolValue::store(int ivalue)
+{
+    type_ = TSymbolElementType::symInteger;
+    setValue(ivalue);
+}
+
+void TSymbolValue::store(bool bvalue)
+{
+    type_ = TSymbolElementType::symBoolean;
+    setValue(bvalue);
+}
+
+void TSymbolValue::store(double dvalue)
+{
+    type_ = TSymbolElementType::symDouble;
+    setValue(dvalue);
+}
+
+void TSymbolValue::store(TStringObject *svalue)
+{
+    TStringObject *entry = nullptr;
+    if (svalue->isReadOnly() || svalue->isBound())
+    {
+        entry = svalue->clone();
+    }
+    else
+    {
+        entry = svalue;
+    }
+    entry->setType(TBlockType::btBound);
+    setValue(entry);
+    setType(TSymbolElementType::symString);
+}
+
+void TSymbolValue::store(TListObject *lvalue)
+{
+    TListObject *entry = nullptr;
+    if (lvalue->isConstant() || lvalue->isBound() || lvalue->isOwned())
+    {
+        entry = lvalue->clone();
+    }
+    else
+    {
+        entry = lvalue;
+    }
+    entry->setType(TBlockType::btBound);
+    setValue(entry);
+    setType(TSymbolElementType::symList);
+}
+
+void TSymbolValue::store(TMatrixObject *mvalue)
 {
-    v.f = fvalue;
+    TMatrixObject *entry = nullptr;
+    if (mvalue->isGarbage())
+    {
+        entry = mvalue;
+    }
+    else
+    {
+        entry = mvalue->clone();
+    }
+    entry->setType(TBlockType::btBound);
+    setValue(entry);
+    setType(TSymbolElementType::symMatrix);
+}
+
+void TSymbolValue::store(TChannelObject *cvalue)
+{
+    cvalue->setType(TBlockType::btBound);
+    setValue(cvalue);
+    setType(TSymbolElementType::symChannel);
+}
+
+TGlobalValues::TGlobalValues(const TSymbolTable &symbols) : symbols_(&symbols)
+{
+    values_.reserve(symbols.size());
+    for (size_t i = 0; i < symbols.size(); ++i)
+    {
+        values_.push_back(symbols.get(i));
+    }
 }
 
 bool operator==(const TByteCode &lhs, const TByteCode &rhs)
@@ -262,3 +372,71 @@ bool TGlobalVariableList::find(const std::string &identifier, int &index) const
         return true;
     }
 }
+
+void TUserFunction::compile()
+{
+    std::lock_guard<std::mutex> lock(compileMutex_);
+    if (compiled_.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    if (!compileError_)
+    {
+        try
+        {
+            compileBody_(*this);
+            compileBody_ = nullptr;
+            compiled_.store(true, std::memory_order_release);
+            return;
+        }
+        catch (...)
+        {
+            compileError_ = std::current_exception();
+        }
+    }
+    std::rethrow_exception(compileError_);
+}
+
+void TGlobalValues::storeSymbolToTable(int index, int ivalue)
+{
+    at(index).store(ivalue);
+}
+
+void TGlobalValues::storeSymbolToTable(int index, bool bvalue)
+{
+    at(index).store(bvalue);
+}
+
+void TGlobalValues::storeSymbolToTable(int index, double dvalue)
+{
+    at(index).store(dvalue);
+}
+
+void TGlobalValues::storeSymbolToTable(int index, TStringObject *svalue)
+{
+    at(index).store(svalue);
+}
+
+void TGlobalValues::storeSymbolToTable(int index, TListObject *lvalue)
+{
+    at(index).store(lvalue);
+}
+
+void TGlobalValues::storeSymbolToTable(int index, TMatrixObject *mvalue)
+{
+    at(index).store(mvalue);
+}
+
+void TGlobalValues::storeSymbolToTable(int index, TChannelObject *cvalue)
+{
+    at(index).store(cvalue);
+}
+
+TSymbolValue &TGlobalValues::at(int index)
+{
+    if (index < 0 || static_cast<size_t>(index) >= values_.size())
+    {
+        throw std::runtime_error("TGlobalValues> Symbols buffer overflow");
+    }
+    return values_[index];
+}
@@ -1,18 +1,26 @@
 #ifndef TSYMBOLTABLE_HPP_INCLUDED
 #define TSYMBOLTABLE_HPP_INCLUDED
 
+#include <atomic>
 #include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string_view>
 #include <unordered_map>
 #include <variant>
 #include <vector>
 
 #include "ConstantTable.hpp"
 #include "OpCodes.hpp"
+#include "TNameIndex.hpp"
 #include "TStringObject.hpp"
 #include "TSymbolTable.hpp"
 
 /* DONE */
 class TListObject;
+class TMatrixObject;
+class TChannelObject;
 class TStringObject;
 class TSymbol;
 class TUserFunction;
@@ -29,6 +37,8 @@ enum class TSymbolElementType
     symBoolean,
     symString,
     symList,
+    symMatrix,
+    symChannel,
     symUserFunc
 };
 
@@ -48,17 +58,31 @@ class TProgram
 {
 public:
     TProgram() = default;
+    // A program over n bytecodes it does not own, e.g. in a mapped module
+    // file. The code must outlive the program; growing or clearing the
+    // program copies it first.
+    static TProgram view(TByteCode *code, size_t n)
+    {
+        TProgram program;
+        program.view_ = code;
+        program.actualLength_ = n;
+        return program;
+    }
+    bool isView() const
+    {
+        return view_ != nullptr;
+    }
     TByteCode &operator[](size_t index)
     {
-        return code_[index];
+        return view_ ? view_[index] : code_[index];
     }
     const TByteCode &operator[](size_t index) const
     {
-        return code_[index];
+        return view_ ? view_[index] : code_[index];
     }
     TByteCode &last()
     {
-        return code_[actualLength_ - 1];
+        return (*this)[actualLength_ - 1];
     }
 
     size_t size() const
@@ -69,14 +93,19 @@ public:
     void append(TByteCode bytecode);
     void compactCode()
     {
+        own();
         code_.resize(actualLength_);
     }
     size_t addByteCode(OpCode opCode);
     void addByteCode(OpCode opCode, int ivalue);
-    void addByteCode(OpCode opCode, double dvalue);
     void addByteCode(OpCode opCode, bool bvalue);
+    // Pushd and Pushs operands are 1-based indices into the constants.
+    void addByteCode(OpCode opCode,
+                     double dvalue,
+                     TConstantValueTable &constants);
     void addByteCode(OpCode opCode,
-                     std::string svalue); // FIXME passed by value
+                     std::string svalue,
+                     TConstantValueTable &constants); // FIXME passed by value
 
     void appendProgram(TProgram program); // FIXME passed by value
     size_t getCurrentInstructionPointer() const
@@ -86,35 +115,29 @@ public:
     size_t createInstructionSpace();
     void setGotoLabel(int location, int value)
     {
-        code_[location].index = value;
+        (*this)[location].index = value;
     }
     std::string string() const;
     bool operator==(const TProgram &other) const;
 
 private:
     void checkSpace();
+    void own();
     TCode code_;
+    TByteCode *view_ = nullptr;
     size_t actualLength_ = 0;
 
     static constexpr int ALLOC_BY = 512;
 };
 
-class TSymbol
+// The type and value of a symbol, without its name.
+class TSymbolValue
 {
 public:
-    friend class TSymbolTable;
-
-    explicit TSymbol(const std::string &name);
-    explicit TSymbol(TUserFunction *fvalue);
-
     TSymbolElementType type() const
     {
         return type_;
     }
-    const std::string &name() const
-    {
-        return name_;
-    }
     TStringObject *svalue() const
     {
         return v.s;
@@ -123,6 +146,14 @@ public:
     {
         return v.l;
     }
+    TMatrixObject *mvalue() const
+    {
+        return v.m;
+    }
+    TChannelObject *cvalue() const
+    {
+        return v.c;
+    }
     TUserFunction *fvalue() const
     {
         return v.f;
@@ -164,22 +195,42 @@ public:
     {
         v.l = val;
     }
-    void setName(const std::string &name)
+    void setValue(TMatrixObject *val)
     {
-        name_ = name;
+        v.m = val;
+    }
+    void setValue(TChannelObject *val)
+    {
+        v.c = val;
     }
     void setValue(TUserFunction *val)
     {
         v.f = val;
     }
 
+    // Binds a value the way a store instruction does: strings, lists and
+    // matrices still referenced elsewhere are cloned.
+    void store(int ivalue);
+    void store(bool bvalue);
+    void store(double dvalue);
+    void store(TStringObject *svalue);
+    void store(TListObject *lvalue);
+    void store(TMatrixObject *mvalue);
+    void store(TChannelObject *cvalue);
+
+protected:
+    explicit TSymbolValue(TSymbolElementType type) : type_(type)
+    {
+    }
+
 private:
-    std::string name_ = ""; // FIXME Do i need this ?
     union
     {
         double d;
         TStringObject *s;
         TListObject *l;
+        TMatrixObject *m;
+        TChannelObject *c;
         TUserFunction *f;
         int i;
         bool b;
@@ -188,12 +239,37 @@ private:
     TSymbolElementType type_ = TSymbolElementType::symUndefined;
 };
 
+class TSymbol : public TSymbolValue
+{
+public:
+    explicit TSymbol(const std::string &name);
+    explicit TSymbol(TUserFunction *fvalue);
+
+    const std::string &name() const
+    {
+        return name_;
+    }
+    void setName(const std::string &name)
+    {
+        name_ = name;
+    }
+
+private:
+    std::string name_ = ""; // FIXME Do i need this ?
+};
+
+// Symbols keep the index they were added at, the bytecode refers to them
+// by it. Names are looked up through a hash index; if a name was added
+// more than once, its first symbol is found.
 class TSymbolTable
 {
 public:
     int addSymbol(const std::string &name);
     int addSymbol(TUserFunction *fvalue);
-    bool find(const std::string &name, int &index); // TODO refactor
+    bool find(const std::string &name, int &index) const; // TODO refactor
+    // For callers that have the TNameIndex hash of the name at hand, e.g.
+    // from a TAtomTable.
+    bool find(std::string_view name, uint32_t hash, int &index) const;
     size_t size() const
     {
         return symbols_.size();
@@ -203,6 +279,8 @@ public:
     void storeSymbolToTable(int index, bool bvalue);
     void storeSymbolToTable(int index, double dvalue);
     void storeSymbolToTable(int index, TListObject *lvalue);
+    void storeSymbolToTable(int index, TMatrixObject *mvalue);
+    void storeSymbolToTable(int index, TChannelObject *cvalue);
     void storeSymbolToTable(
         int index,
         TStringObject *svalue); // FIXME possible mem leak...
@@ -214,7 +292,49 @@ public:
 
 private:
     void checkForExistingData(int index);
+    void indexLastSymbol();
     std::vector<TSymbol> symbols_;
+    TNameIndex index_;
+};
+
+// The values of a module's globals for one run, indexed like the module's
+// symbol table. Names and their index stay in that shared table, so setting
+// up a run copies one fixed-size record per global.
+class TGlobalValues
+{
+public:
+    explicit TGlobalValues(const TSymbolTable &symbols);
+
+    bool find(const std::string &name, int &index) const
+    {
+        return symbols_->find(name, index);
+    }
+    const std::string &name(size_t index) const
+    {
+        return symbols_->get(index).name();
+    }
+    size_t size() const
+    {
+        return values_.size();
+    }
+    const TSymbolValue &get(size_t index) const
+    {
+        return values_[index];
+    }
+
+    void storeSymbolToTable(int index, int ivalue);
+    void storeSymbolToTable(int index, bool bvalue);
+    void storeSymbolToTable(int index, double dvalue);
+    void storeSymbolToTable(int index, TListObject *lvalue);
+    void storeSymbolToTable(int index, TMatrixObject *mvalue);
+    void storeSymbolToTable(int index, TChannelObject *cvalue);
+    void storeSymbolToTable(int index, TStringObject *svalue);
+
+private:
+    TSymbolValue &at(int index);
+
+    const TSymbolTable *symbols_;
+    std::vector<TSymbolValue> values_;
 };
 
 class TGlobalVariableList
@@ -225,6 +345,10 @@ public:
     {
         return variables_[index];
     }
+    size_t size() const
+    {
+        return variables_.size();
+    }
 
 private:
     std::unordered_map<std::string, int> table_;
@@ -237,10 +361,31 @@ public:
     explicit TUserFunction(const std::string &name) : name_(name)
     {
     }
+    TUserFunction(const TUserFunction &) = delete;
+    TUserFunction &operator=(const TUserFunction &) = delete;
+
     const std::string &name() const
     {
         return name_;
     }
+    // A function built lazily only has its name and arguments until
+    // compileBody runs on the first call.
+    void setLazyBody(std::function<void(TUserFunction &)> compileBody)
+    {
+        compileBody_ = std::move(compileBody);
+        compiled_.store(false, std::memory_order_release);
+    }
+    // Makes sure the code, constants and locals are there before they are
+    // read. Threads sharing a module may race to the first call: the body
+    // is compiled once and published with the release below. A body that
+    // fails to compile throws the same error on every call.
+    void ensureCompiled()
+    {
+        if (!compiled_.load(std::memory_order_acquire))
+        {
+            compile();
+        }
+    }
     TProgram &funcCode()
     {
         return funcCode_;
@@ -267,12 +412,18 @@ public:
     }
 
 private:
+    void compile();
+
     TGlobalVariableList globalVariableList_;
     TProgram funcCode_;
     std::string name_;
     TConstantValueTable constantTable_; // FIXME is this a global reference ?
     TSymbolTable symboltable_;
     int nArgs_;
+    std::atomic<bool> compiled_{true};
+    std::mutex compileMutex_;
+    std::function<void(TUserFunction &)> compileBody_;
+    std::exception_ptr compileError_;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,129 @@
+#include "TThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+TThreadPool::TThreadPool(size_t nThreads)
+{
+    workers_.reserve(nThreads);
+    for (size_t i = 0; i < nThreads; ++i)
+    {
+        workers_.emplace_back([this] { workerLoop(); });
+    }
+}
+
+TThreadPool::~TThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wakeUp_.notify_all();
+    for (auto &worker : workers_)
+    {
+        worker.join();
+    }
+}
+
+TThreadPool &TThreadPool::shared()
+{
+    static TThreadPool pool(
+        std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return pool;
+}
+
+void TThreadPool::post(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back(std::move(job));
+    }
+    wakeUp_.notify_one();
+}
+
+void TThreadPool::workerLoop()
+{
+    while (true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wakeUp_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+            if (jobs_.empty())
+            {
+                return;
+            }
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+        job();
+    }
+}
+
+void TThreadPool::parallelFor(size_t nTasks,
+                              const std::function<void(size_t)> &task)
+{
+    if (nTasks == 0)
+    {
+        return;
+    }
+
+    // Every participant pulls task indices from a shared counter, so a
+    // slow task does not hold up the others. The caller waits for the
+    // tasks rather than for the helpers: a helper that only gets to run
+    // once every index is taken returns without touching the batch's task,
+    // which keeps nested calls from a worker thread free of deadlocks.
+    struct TBatch
+    {
+        std::atomic<size_t> next{0};
+        size_t finished = 0;
+        std::mutex mutex;
+        std::condition_variable done;
+        std::exception_ptr error;
+    };
+    auto batch = std::make_shared<TBatch>();
+
+    auto run = [batch, nTasks, &task] {
+        size_t index = 0;
+        while ((index = batch->next.fetch_add(1)) < nTasks)
+        {
+            std::exception_ptr error;
+            try
+            {
+                task(index);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+
+            std::lock_guard<std::mutex> lock(batch->mutex);
+            if (error && !batch->error)
+            {
+                batch->error = error;
+            }
+            if (++batch->finished == nTasks)
+            {
+                batch->done.notify_all();
+            }
+        }
+    };
+
+    size_t nHelpers = std::min(size(), nTasks - 1);
+    for (size_t i = 0; i < nHelpers; ++i)
+    {
+        post(run);
+    }
+    run();
+
+    std::unique_lock<std::mutex> lock(batch->mutex);
+    batch->done.wait(lock, [&batch, nTasks] {
+        return batch->finished == nTasks;
+    });
+    if (batch->error)
+    {
+        std::rethrow_exception(batch->error);
+    }
+}
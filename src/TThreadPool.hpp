@@ -0,0 +1,45 @@
+#ifndef TTHREADPOOL_HPP_INCLUDED
+#define TTHREADPOOL_HPP_INCLUDED
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Fixed set of worker threads. parallelFor runs task(0) .. task(n - 1)
+ * on the workers and on the calling thread and returns once all of them
+ * are done; the first exception thrown by a task is rethrown to the caller.
+ */
+class TThreadPool
+{
+public:
+    explicit TThreadPool(size_t nThreads);
+    ~TThreadPool();
+    TThreadPool(const TThreadPool &) = delete;
+    TThreadPool &operator=(const TThreadPool &) = delete;
+
+    size_t size() const
+    {
+        return workers_.size();
+    }
+    void parallelFor(size_t nTasks, const std::function<void(size_t)> &task);
+
+    // Pool with one worker per hardware thread, created on first use.
+    static TThreadPool &shared();
+
+private:
+    void post(std::function<void()> job);
+    void workerLoop();
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> jobs_;
+    std::mutex mutex_;
+    std::condition_variable wakeUp_;
+    bool stopping_ = false;
+};
+
+#endif
@@ -0,0 +1,544 @@
+#include "TVectorProgram.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <variant>
+
+#include "ConstantTable.hpp"
+#include "OpCodes.hpp"
+#include "TSymbolTable.hpp"
+
+namespace
+{
+
+// Static type of a stack slot or local, every row holds the same type.
+enum class TValueType
+{
+    Unset,
+    Integer,
+    Double,
+    Boolean
+};
+
+bool isNumber(TValueType type)
+{
+    return type == TValueType::Integer || type == TValueType::Double;
+}
+
+template <typename F>
+void apply(double *out, const double *a, const double *b, size_t n, F f)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        out[i] = f(a[i], b[i]);
+    }
+}
+
+template <typename F>
+void apply(double *out, const double *a, size_t n, F f)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        out[i] = f(a[i]);
+    }
+}
+
+// The VM computes integers in int, which wraps around in practice.
+double wrap(int64_t value)
+{
+    return static_cast<int32_t>(value);
+}
+
+bool anySet(const uint8_t *mask, size_t n)
+{
+    return std::any_of(mask, mask + n, [](uint8_t bit) { return bit != 0; });
+}
+
+} // namespace
+
+std::unique_ptr<TVectorProgram> TVectorProgram::compile(
+    TUserFunction &function,
+    std::span<const TBatchColumn> columns)
+{
+    const auto &code = function.funcCode();
+    std::unique_ptr<TVectorProgram> program(new TVectorProgram());
+    program->nArgs_ = columns.size();
+    program->nLocals_ = function.symboltable().size();
+
+    std::vector<TValueType> locals(program->nLocals_, TValueType::Unset);
+    for (size_t i = 0; i < columns.size(); ++i)
+    {
+        locals[i] = std::holds_alternative<std::span<const int64_t>>(columns[i])
+                        ? TValueType::Integer
+                        : TValueType::Double;
+    }
+
+    // Branches are only followed with an empty stack, so jump targets need
+    // no merging of stack types. Locals keep one type for the whole body.
+    std::vector<TValueType> stack;
+    std::vector<size_t> firstInstruction(code.size() + 1);
+    std::vector<bool> isTarget(code.size() + 1, false);
+    std::vector<std::pair<size_t, size_t>> jumps; // instruction, target pc
+
+    auto emit = [&program](TOp op, int operand, size_t slot) {
+        program->code_.push_back({op, operand, static_cast<int>(slot)});
+    };
+    auto constant = [&program, &stack](double value, TValueType type) {
+        program->constants_.emplace_back(kBlockSize, value);
+        stack.push_back(type);
+        return static_cast<int>(program->constants_.size()) - 1;
+    };
+
+    for (size_t pc = 0; pc < code.size(); ++pc)
+    {
+        firstInstruction[pc] = program->code_.size();
+        if (isTarget[pc] && !stack.empty())
+        {
+            return nullptr;
+        }
+
+        const auto &byteCode = code[pc];
+        size_t slot = stack.size();
+        switch (byteCode.opCode)
+        {
+        case OpCode::Nop:
+            break;
+        case OpCode::LoadLocal:
+            if (locals[byteCode.index] == TValueType::Unset)
+            {
+                return nullptr;
+            }
+            emit(TOp::LoadLocal, byteCode.index, slot);
+            stack.push_back(locals[byteCode.index]);
+            break;
+        case OpCode::StoreLocal:
+        {
+            if (stack.size() != 1)
+            {
+                return nullptr;
+            }
+            auto &local = locals[byteCode.index];
+            if (local != TValueType::Unset && local != stack.back())
+            {
+                return nullptr;
+            }
+            local = stack.back();
+            stack.pop_back();
+            emit(TOp::StoreLocal, byteCode.index, 0);
+            break;
+        }
+        case OpCode::Pushi:
+            emit(TOp::LoadConstant,
+                 constant(byteCode.index, TValueType::Integer), slot);
+            break;
+        case OpCode::Pushd:
+            emit(TOp::LoadConstant,
+                 constant(function.constantTable().get(byteCode.index).dvalue(),
+                          TValueType::Double),
+                 slot);
+            break;
+        case OpCode::Pushb:
+            emit(TOp::LoadConstant,
+                 constant(byteCode.index != 0 ? 1.0 : 0.0,
+                          TValueType::Boolean),
+                 slot);
+            break;
+        case OpCode::Pop:
+            if (stack.empty())
+            {
+                return nullptr;
+            }
+            stack.pop_back();
+            break;
+        case OpCode::Add:
+        case OpCode::Sub:
+        case OpCode::Mult:
+        case OpCode::Divide:
+        {
+            if (slot < 2 || !isNumber(stack[slot - 1]) ||
+                !isNumber(stack[slot - 2]))
+            {
+                return nullptr;
+            }
+            bool integer = stack[slot - 1] == TValueType::Integer &&
+                           stack[slot - 2] == TValueType::Integer;
+            TOp op = TOp::Divide;
+            switch (byteCode.opCode)
+            {
+            case OpCode::Add:
+                op = integer ? TOp::AddInteger : TOp::Add;
+                break;
+            case OpCode::Sub:
+                op = integer ? TOp::SubInteger : TOp::Sub;
+                break;
+            case OpCode::Mult:
+                op = integer ? TOp::MultInteger : TOp::Mult;
+                break;
+            default:
+                if (integer)
+                {
+                    return nullptr; // truncates, and traps on zero
+                }
+                break;
+            }
+            emit(op, 0, slot - 2);
+            stack.pop_back();
+            stack.back() = integer ? TValueType::Integer : TValueType::Double;
+            break;
+        }
+        case OpCode::Umi:
+            if (slot < 1 || !isNumber(stack.back()))
+            {
+                return nullptr;
+            }
+            emit(TOp::Negate, 0, slot - 1);
+            break;
+        case OpCode::IsEq:
+        case OpCode::IsNotEq:
+        case OpCode::IsLt:
+        case OpCode::IsLte:
+        case OpCode::IsGt:
+        case OpCode::IsGte:
+        case OpCode::And:
+        case OpCode::Or:
+        {
+            if (slot < 2)
+            {
+                return nullptr;
+            }
+            bool numbers =
+                isNumber(stack[slot - 1]) && isNumber(stack[slot - 2]);
+            bool booleans = stack[slot - 1] == TValueType::Boolean &&
+                            stack[slot - 2] == TValueType::Boolean;
+            TOp op;
+            switch (byteCode.opCode)
+            {
+            case OpCode::IsEq:
+                op = booleans ? TOp::IsEqBoolean : TOp::IsEq;
+                break;
+            case OpCode::IsNotEq:
+                op = booleans ? TOp::IsNotEqBoolean : TOp::IsNotEq;
+                break;
+            case OpCode::IsLt:
+                op = TOp::IsLt;
+                break;
+            case OpCode::IsLte:
+                op = TOp::IsLte;
+                break;
+            case OpCode::IsGt:
+                op = TOp::IsGt;
+                break;
+            case OpCode::IsGte:
+                op = TOp::IsGte;
+                break;
+            case OpCode::And:
+                op = TOp::And;
+                break;
+            default:
+                op = TOp::Or;
+                break;
+            }
+            bool logic = op == TOp::And || op == TOp::Or ||
+                         op == TOp::IsEqBoolean || op == TOp::IsNotEqBoolean;
+            if (logic ? !booleans : !numbers)
+            {
+                return nullptr;
+            }
+            emit(op, 0, slot - 2);
+            stack.pop_back();
+            stack.back() = TValueType::Boolean;
+            break;
+        }
+        case OpCode::Not:
+            if (slot < 1 || stack.back() != TValueType::Boolean)
+            {
+                return nullptr;
+            }
+            emit(TOp::Not, 0, slot - 1);
+            break;
+        case OpCode::JmpIfFalse:
+        case OpCode::Jmp:
+        {
+            bool conditional = byteCode.opCode == OpCode::JmpIfFalse;
+            if (conditional &&
+                (slot != 1 || stack.back() != TValueType::Boolean))
+            {
+                return nullptr;
+            }
+            if (!conditional && slot != 0)
+            {
+                return nullptr;
+            }
+            // Forward jumps only, the body is walked once in code order.
+            size_t target = pc + byteCode.index;
+            if (byteCode.index <= 0 || target >= code.size())
+            {
+                return nullptr;
+            }
+            isTarget[target] = true;
+            jumps.emplace_back(program->code_.size(), target);
+            emit(conditional ? TOp::JmpIfFalse : TOp::Jmp, 0, 0);
+            stack.clear();
+            break;
+        }
+        case OpCode::Return:
+            if (slot != 1)
+            {
+                return nullptr;
+            }
+            emit(TOp::Return, 0, 0);
+            stack.clear();
+            break;
+        case OpCode::PushNone:
+            // Only as the implicit return of a body without one.
+            if (slot != 0 || pc + 1 == code.size() ||
+                code[pc + 1].opCode != OpCode::Return)
+            {
+                return nullptr;
+            }
+            emit(TOp::ReturnNone, 0, 0);
+            firstInstruction[++pc] = program->code_.size() - 1;
+            break;
+        default:
+            return nullptr;
+        }
+        program->nSlots_ = std::max(program->nSlots_, stack.size());
+    }
+
+    for (auto [instruction, target] : jumps)
+    {
+        auto &arrival = program->code_[firstInstruction[target]].arrival;
+        if (arrival < 0)
+        {
+            arrival = static_cast<int>(program->nArrivals_++);
+        }
+        program->code_[instruction].operand = arrival;
+    }
+    return program;
+}
+
+void TVectorProgram::run(std::span<const TBatchColumn> columns,
+                         std::span<double> results) const
+{
+    // Integer columns are read as the ints the scalar VM would see.
+    checkBatchColumns(columns);
+    std::vector<double> scratch(nSlots_ * kBlockSize);
+    std::vector<double> localData(nLocals_ * kBlockSize);
+    std::vector<const double *> locals(nLocals_);
+    std::vector<const double *> slots(nSlots_);
+    std::vector<uint8_t> active(kBlockSize);
+    std::vector<uint8_t> arrivals(nArrivals_ * kBlockSize);
+    std::vector<uint8_t> defined(nLocals_ * kBlockSize);
+
+    for (size_t begin = 0; begin < results.size(); begin += kBlockSize)
+    {
+        size_t n = std::min(kBlockSize, results.size() - begin);
+        for (size_t i = 0; i < nLocals_; ++i)
+        {
+            locals[i] = &localData[i * kBlockSize];
+        }
+        for (size_t i = 0; i < nArgs_; ++i)
+        {
+            if (const auto *doubles =
+                    std::get_if<std::span<const double>>(&columns[i]))
+            {
+                locals[i] = doubles->data() + begin;
+                continue;
+            }
+            const auto &ints = std::get<std::span<const int64_t>>(columns[i]);
+            double *local = &localData[i * kBlockSize];
+            for (size_t j = 0; j < n; ++j)
+            {
+                local[j] = static_cast<int>(ints[begin + j]);
+            }
+        }
+        std::fill(active.begin(), active.begin() + n, 1);
+        std::fill(arrivals.begin(), arrivals.end(), 0);
+        std::fill(defined.begin(), defined.end(), 0);
+        bool any = true;
+        double *out = results.data() + begin;
+
+        for (const auto &ins : code_)
+        {
+            if (ins.arrival >= 0)
+            {
+                const uint8_t *arrived = &arrivals[ins.arrival * kBlockSize];
+                for (size_t j = 0; j < n; ++j)
+                {
+                    active[j] |= arrived[j];
+                }
+                any = anySet(active.data(), n);
+            }
+            if (!any)
+            {
+                continue;
+            }
+
+            double *result = &scratch[ins.slot * kBlockSize];
+            const double *a = slots[ins.slot];
+            const double *b = nullptr;
+            if (static_cast<size_t>(ins.slot) + 1 < nSlots_)
+            {
+                b = slots[ins.slot + 1];
+            }
+            switch (ins.op)
+            {
+            case TOp::LoadLocal:
+                if (static_cast<size_t>(ins.operand) >= nArgs_)
+                {
+                    const uint8_t *set = &defined[ins.operand * kBlockSize];
+                    for (size_t j = 0; j < n; ++j)
+                    {
+                        if (active[j] && !set[j])
+                        {
+                            throw std::runtime_error(
+                                "RunTimeError: Variable undefined");
+                        }
+                    }
+                }
+                slots[ins.slot] = locals[ins.operand];
+                continue;
+            case TOp::LoadConstant:
+                slots[ins.slot] = constants_[ins.operand].data();
+                continue;
+            case TOp::StoreLocal:
+            {
+                double *local = &localData[ins.operand * kBlockSize];
+                if (locals[ins.operand] != local)
+                {
+                    // An argument read from its column, take a copy.
+                    std::copy(locals[ins.operand], locals[ins.operand] + n,
+                              local);
+                    locals[ins.operand] = local;
+                }
+                uint8_t *set = &defined[ins.operand * kBlockSize];
+                for (size_t j = 0; j < n; ++j)
+                {
+                    local[j] = active[j] ? a[j] : local[j];
+                    set[j] |= active[j];
+                }
+                continue;
+            }
+            case TOp::AddInteger:
+                apply(result, a, b, n, [](double x, double y) {
+                    return wrap(static_cast<int64_t>(x) +
+                                static_cast<int64_t>(y));
+                });
+                break;
+            case TOp::SubInteger:
+                apply(result, a, b, n, [](double x, double y) {
+                    return wrap(static_cast<int64_t>(x) -
+                                static_cast<int64_t>(y));
+                });
+                break;
+            case TOp::MultInteger:
+                apply(result, a, b, n, [](double x, double y) {
+                    return wrap(static_cast<int64_t>(x) *
+                                static_cast<int64_t>(y));
+                });
+                break;
+            case TOp::Add:
+                apply(result, a, b, n,
+                      [](double x, double y) { return x + y; });
+                break;
+            case TOp::Sub:
+                apply(result, a, b, n,
+                      [](double x, double y) { return x - y; });
+                break;
+            case TOp::Mult:
+                apply(result, a, b, n,
+                      [](double x, double y) { return x * y; });
+                break;
+            case TOp::Divide:
+                apply(result, a, b, n,
+                      [](double x, double y) { return x / y; });
+                break;
+            case TOp::Negate:
+                apply(result, a, n, [](double x) { return -x; });
+                break;
+            case TOp::IsEq:
+                apply(result, a, b, n, [](double x, double y) {
+                    return std::fabs(x - y) < 1e-9 ? 1.0 : 0.0;
+                });
+                break;
+            case TOp::IsNotEq:
+                apply(result, a, b, n, [](double x, double y) {
+                    return std::fabs(x - y) < 1e-9 ? 0.0 : 1.0;
+                });
+                break;
+            case TOp::IsEqBoolean:
+                apply(result, a, b, n,
+                      [](double x, double y) { return x == y ? 1.0 : 0.0; });
+                break;
+            case TOp::IsNotEqBoolean:
+                apply(result, a, b, n,
+                      [](double x, double y) { return x != y ? 1.0 : 0.0; });
+                break;
+            case TOp::IsLt:
+                apply(result, a, b, n,
+                      [](double x, double y) { return x < y ? 1.0 : 0.0; });
+                break;
+            case TOp::IsLte:
+                apply(result, a, b, n,
+                      [](double x, double y) { return x <= y ? 1.0 : 0.0; });
+                break;
+            case TOp::IsGt:
+                apply(result, a, b, n,
+                      [](double x, double y) { return x > y ? 1.0 : 0.0; });
+                break;
+            case TOp::IsGte:
+                apply(result, a, b, n,
+                      [](double x, double y) { return x >= y ? 1.0 : 0.0; });
+                break;
+            case TOp::And:
+                apply(result, a, b, n,
+                      [](double x, double y) { return x * y; });
+                break;
+            case TOp::Or:
+                apply(result, a, b, n,
+                      [](double x, double y) { return std::max(x, y); });
+                break;
+            case TOp::Not:
+                apply(result, a, n, [](double x) { return 1.0 - x; });
+                break;
+            case TOp::JmpIfFalse:
+            {
+                uint8_t *arrived = &arrivals[ins.operand * kBlockSize];
+                for (size_t j = 0; j < n; ++j)
+                {
+                    uint8_t taken = active[j] & (a[j] == 0.0);
+                    arrived[j] |= taken;
+                    active[j] &= !taken;
+                }
+                any = anySet(active.data(), n);
+                continue;
+            }
+            case TOp::Jmp:
+            {
+                uint8_t *arrived = &arrivals[ins.operand * kBlockSize];
+                for (size_t j = 0; j < n; ++j)
+                {
+                    arrived[j] |= active[j];
+                    active[j] = 0;
+                }
+                any = false;
+                continue;
+            }
+            case TOp::Return:
+                for (size_t j = 0; j < n; ++j)
+                {
+                    out[j] = active[j] ? a[j] : out[j];
+                    active[j] = 0;
+                }
+                any = false;
+                continue;
+            case TOp::ReturnNone:
+                throw std::runtime_error(
+                    "Batched calls expect a number, got " +
+                    TStackRecordTypeToStr(TStackRecordType::stNone));
+            }
+            slots[ins.slot] = result;
+        }
+    }
+}
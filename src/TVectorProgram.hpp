@@ -0,0 +1,91 @@
+#ifndef TVECTORPROGRAM_HPP_INCLUDED
+#define TVECTORPROGRAM_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "VM.hpp"
+
+class TUserFunction;
+
+/*
+ * A user function translated for vector-at-a-time evaluation of batched
+ * calls. Every instruction runs over a block of up to kBlockSize rows:
+ * stack slots and locals hold one value per row and the rows taking a
+ * branch are tracked with selection masks instead of jumps. Arithmetic
+ * always runs over the whole block, so its loops vectorize; the masks only
+ * decide which rows a store or a return applies to.
+ *
+ * Only functions whose results this reproduces exactly are translated:
+ * numbers and booleans, arithmetic, comparisons, logic, locals and forward
+ * branches. Anything else, calls, globals, lists, strings or integer
+ * division, is left to the scalar VM.
+ */
+class TVectorProgram
+{
+public:
+    static constexpr size_t kBlockSize = 1024;
+
+    // Returns nullptr if the function cannot be translated for arguments of
+    // the column types.
+    static std::unique_ptr<TVectorProgram> compile(
+        TUserFunction &function,
+        std::span<const TBatchColumn> columns);
+
+    // Same contract as VM::callBatch.
+    void run(std::span<const TBatchColumn> columns,
+             std::span<double> results) const;
+
+private:
+    enum class TOp : uint8_t
+    {
+        LoadLocal,
+        LoadConstant,
+        StoreLocal,
+        AddInteger, // 32 bit integer arithmetic, wraps like the VM
+        SubInteger,
+        MultInteger,
+        Add,
+        Sub,
+        Mult,
+        Divide,
+        Negate,
+        IsEq,
+        IsEqBoolean,
+        IsNotEq,
+        IsNotEqBoolean,
+        IsLt,
+        IsLte,
+        IsGt,
+        IsGte,
+        And,
+        Or,
+        Not,
+        JmpIfFalse,
+        Jmp,
+        Return,
+        ReturnNone
+    };
+
+    struct TInstruction
+    {
+        TOp op;
+        int operand = 0; // local, constant or target instruction
+        int slot = 0;    // stack slot of the first operand or the result
+        int arrival = -1; // mask of the rows jumping here, if any
+    };
+
+    TVectorProgram() = default;
+
+    std::vector<TInstruction> code_;
+    std::vector<std::vector<double>> constants_; // one block per constant
+    size_t nArgs_ = 0;
+    size_t nLocals_ = 0;
+    size_t nSlots_ = 0;
+    size_t nArrivals_ = 0;
+};
+
+#endif
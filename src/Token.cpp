@@ -186,13 +186,13 @@ std::string TokenRecord::literal() const
     switch (code_)
     {
     case TokenCode::tIdentifier:
-        return tString_;
+        return std::string(tString());
     case TokenCode::tInteger:
-        return std::to_string(tInt_);
+        return std::to_string(tInt());
     case TokenCode::tFloat:
-        return std::to_string(tFloat_);
+        return std::to_string(tFloat());
     case TokenCode::tString:
-        return tString_;
+        return std::string(tString());
     case TokenCode::tMinus:
         return "-";
     case TokenCode::tPlus:
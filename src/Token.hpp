@@ -2,7 +2,9 @@
 #define TOKEN_HPP_INCLUDED
 
 #include "defs.hpp"
+#include <cstdint>
 #include <string>
+#include <string_view>
 
 enum class TokenCode
 {
@@ -67,6 +69,9 @@ enum class TokenCode
     tLet
 };
 
+// A plain record, cheap to copy. The text of identifiers, keywords and
+// strings is a view into the source, which the scanner and the token table
+// keep alive; identifiers in a token table also carry their atom.
 class TokenRecord
 {
 public:
@@ -81,36 +86,45 @@ public:
 
     std::string literal() const;
 
-    template <typename T>
-    void setString(T &&v)
+    void setString(std::string_view v)
     {
-        tString_ = std::forward<std::string>(v);
+        text_ = v.data();
+        length_ = static_cast<uint32_t>(v.size());
     }
-    const std::string &tString() const
+    std::string_view tString() const
     {
-        return tString_;
+        return {text_, length_};
+    }
+    void setAtom(int v)
+    {
+        atom_ = v;
+    }
+    int atom() const
+    {
+        return atom_;
     }
 
+    // Numbers hold either value, as their code says.
     void setFloat(double v)
     {
-        tFloat_ = v;
+        value_.f = v;
     }
     double tFloat() const
     {
-        return tFloat_;
+        return value_.f;
     }
 
     void setInt(int v)
     {
-        tInt_ = v;
+        value_.i = v;
     }
     int tInt() const
     {
-        return tInt_;
+        return value_.i;
     }
     double tIntAsDouble() const
     {
-        return tInt_;
+        return value_.i;
     }
     void setChar(char v)
     {
@@ -140,14 +154,18 @@ public:
     }
 
 private:
-    TokenCode code_;
-    int lineNumber_;
-    int columnNumber_;
-
-    double tFloat_;
-    int tInt_;
-    char tChar_;
-    std::string tString_;
+    const char *text_ = nullptr;
+    union
+    {
+        double f;
+        int i;
+    } value_{0.};
+    TokenCode code_ = TokenCode::tError;
+    int lineNumber_ = 0;
+    int columnNumber_ = 0;
+    uint32_t length_ = 0;
+    int atom_ = -1;
+    char tChar_ = 0;
 };
 
 std::string tokenToString(TokenCode code);
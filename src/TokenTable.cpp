@@ -1,7 +1,7 @@
 #include "TokenTable.hpp"
 #include "Token.hpp"
 
-TokenRecord TokensTable::nextToken()
+const TokenRecord &TokensTable::nextToken()
 {
     if (mode_ == Mode::Saving)
     {
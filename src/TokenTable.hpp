@@ -1,7 +1,9 @@
 #ifndef TOKENTABLE_HPP_INCLUDED
 #define TOKENTABLE_HPP_INCLUDED
 
+#include "TAtomTable.hpp"
 #include "Token.hpp"
+#include <memory>
 #include <vector>
 
 class TokensTable
@@ -14,19 +16,40 @@ public:
     };
 
 public:
-    template <typename T>
-    void add(T &&entry)
+    // Identifiers are interned as they are added.
+    void add(const TokenRecord &entry)
     {
-        tokens_.emplace_back(std::forward<T>(entry));
-        tokenRecord_ = tokens_.back();
+        tokens_.push_back(entry);
+        TokenRecord &token = tokens_.back();
+        token.setAtom(token.code() == TokenCode::tIdentifier
+                          ? atoms_.intern(token.tString())
+                          : -1);
+        tokenRecord_ = token;
     }
 
+    void reserve(size_t n)
+    {
+        tokens_.reserve(n);
+    }
     size_t count() const
     {
         return tokens_.size();
     }
+    const TokenRecord &at(size_t index) const
+    {
+        return tokens_[index];
+    }
+    const TAtomTable &atoms() const
+    {
+        return atoms_;
+    }
+    // The token texts point into the source, the table keeps its owner.
+    void retain(std::shared_ptr<const void> source)
+    {
+        source_ = std::move(source);
+    }
 
-    TokenRecord nextToken();
+    const TokenRecord &nextToken();
     const TokenRecord &token() const
     {
         return tokenRecord_;
@@ -45,7 +68,9 @@ public:
     }
 
 private:
+    std::shared_ptr<const void> source_;
     std::vector<TokenRecord> tokens_;
+    TAtomTable atoms_;
     TokenRecord tokenRecord_; // FIXME do i need this ?
     size_t ptr_ = 0;
     Mode mode_ = Mode::Saving;
@@ -2,13 +2,24 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <limits>
 #include <memory>
 #include <stdexcept>
 
 #include "ConstantTable.hpp"
 #include "OpCodes.hpp"
+#include "TBuiltIns.hpp"
+#include "TChannel.hpp"
+#include "TIsolate.hpp"
 #include "TListObject.hpp"
+#include "TMatrixObject.hpp"
 #include "TModule.hpp"
+#include "TParallelList.hpp"
+#include "TRuntime.hpp"
+#include "TThreadPool.hpp"
+#include "TVectorProgram.hpp"
+#include "VectorKernels.hpp"
 #include "macros.hpp"
 
 void VM::error(const std::string &arg,
@@ -20,27 +31,255 @@ void VM::error(const std::string &arg,
                              " cannot be used with the " + arg + " operation");
 }
 
-void VM::runModule(std::shared_ptr<TModule> module)
+// Scalar operand of a matrix operation.
+static bool isNumber(const TMachineStackRecord &record)
 {
-    module_ = module;
-    run(module_->code());
+    return record.type() == TStackRecordType::stInteger ||
+           record.type() == TStackRecordType::stDouble;
 }
 
-void VM::run(const TProgram &code)
+static double numberValue(const TMachineStackRecord &record)
 {
-    size_t ip = 0; // instruction counter.
+    return record.type() == TStackRecordType::stInteger ? record.ivalue()
+                                                        : record.dvalue();
+}
+
+void VM::runModule(std::shared_ptr<const TModule> module)
+{
+    ownContext_ = std::make_unique<TExecutionContext>(std::move(module));
+    runModule(*ownContext_);
+}
+
+void VM::runModule(TExecutionContext &context)
+{
+    start(context);
+    resume(std::numeric_limits<size_t>::max());
+}
+
+void VM::start(TExecutionContext &context)
+{
+    stack_.clear();
+    frameStack_.clear();
+    context_ = &context;
+    ip_ = &context.module().code()[0];
+}
+
+void VM::save(TSuspendedRun &run) const
+{
+    run.context = context_;
+    run.ip = ip_;
+    stack_.save(run.stack);
+    frameStack_.save(run.frames);
+}
+
+void VM::restore(const TSuspendedRun &run)
+{
+    context_ = run.context;
+    ip_ = run.ip;
+    stack_.restore(run.stack);
+    frameStack_.restore(run.frames);
+}
+
+// Code of a callFunction() run: call the function whose index and
+// arguments are on the stack, then halt on return.
+static const TByteCode callAndHalt[] = {{0, OpCode::Call}, {0, OpCode::Halt}};
+
+// The user function a host call names, checked against the arguments the
+// host passes.
+static TUserFunction *calledFunction(TExecutionContext &context,
+                                     int funcIndex,
+                                     size_t nArgs)
+{
+    const auto &globals = context.globals();
+    if (funcIndex < 0 || static_cast<size_t>(funcIndex) >= globals.size() ||
+        globals.get(funcIndex).type() != TSymbolElementType::symUserFunc)
+    {
+        throw std::runtime_error("No user function at index " +
+                                 std::to_string(funcIndex));
+    }
+    auto *function = globals.get(funcIndex).fvalue();
+    if (function->numberOfArguments() != static_cast<int>(nArgs))
+    {
+        throw std::runtime_error(
+            "Function " + globals.name(funcIndex) + " expects " +
+            std::to_string(function->numberOfArguments()) + " arguments");
+    }
+    return function;
+}
+
+void checkBatchColumns(std::span<const TBatchColumn> columns)
+{
+    const auto &kernels = TVectorKernels::best();
+    for (const auto &column : columns)
+    {
+        const auto *ints = std::get_if<std::span<const int64_t>>(&column);
+        if (ints != nullptr && !ints->empty() &&
+            (kernels.mini(ints->data(), ints->size()) <
+                 std::numeric_limits<int>::min() ||
+             kernels.maxi(ints->data(), ints->size()) >
+                 std::numeric_limits<int>::max()))
+        {
+            throw std::runtime_error("Batch column value out of integer "
+                                     "range");
+        }
+    }
+}
+
+TMachineStackRecord VM::callFunction(TExecutionContext &context,
+                                     int funcIndex,
+                                     const TMachineStackRecord *args,
+                                     size_t nArgs)
+{
+    calledFunction(context, funcIndex, nArgs);
+
+    stack_.clear();
+    frameStack_.clear();
+    context_ = &context;
+    for (size_t i = 0; i < nArgs; ++i)
+    {
+        push(args[i]);
+    }
+    push(funcIndex);
+    ip_ = &callAndHalt[0];
+    resume(std::numeric_limits<size_t>::max());
+    return pop();
+}
+
+static double batchResult(const TMachineStackRecord &record)
+{
+    switch (record.type())
+    {
+    case TStackRecordType::stInteger:
+        return record.ivalue();
+    case TStackRecordType::stDouble:
+        return record.dvalue();
+    case TStackRecordType::stBoolean:
+        return record.bvalue() ? 1.0 : 0.0;
+    default:
+        throw std::runtime_error("Batched calls expect a number, got " +
+                                 TStackRecordTypeToStr(record.type()));
+    }
+}
+
+void VM::callBatch(TExecutionContext &context,
+                   int funcIndex,
+                   std::span<const TBatchColumn> columns,
+                   std::span<double> results,
+                   TBatchMode mode)
+{
+    auto *function = calledFunction(context, funcIndex, columns.size());
+    for (const auto &column : columns)
+    {
+        auto rows = std::visit([](auto c) { return c.size(); }, column);
+        if (rows != results.size())
+        {
+            throw std::runtime_error("Batch columns must have one value per "
+                                     "result");
+        }
+    }
+
+    function->ensureCompiled();
+    if (mode == TBatchMode::Vectorized)
+    {
+        if (auto program = TVectorProgram::compile(*function, columns))
+        {
+            program->run(columns, results);
+            return;
+        }
+    }
+
+    checkBatchColumns(columns);
+    TFrame frame;
+    frame.funcIndex = funcIndex;
+    frame.nArgs = function->numberOfArguments();
+    frame.nlocals = static_cast<int>(function->symboltable().size());
+    frame.constantTable = &function->constantTable();
+    frame.symbolTable = &function->symboltable();
+    frame.bsp = 0;
+    frame.returnIp = &callAndHalt[0];
+    const TByteCode *body = &function->funcCode()[0];
+
+    context_ = &context;
+    frameStack_.clear();
+    TRuntime::TScope scope(runtime_);
+    try
+    {
+        for (size_t row = 0; row < results.size(); ++row)
+        {
+            stack_.clear();
+            for (size_t i = 0; i < columns.size(); ++i)
+            {
+                if (const auto *ints =
+                        std::get_if<std::span<const int64_t>>(&columns[i]))
+                {
+                    push(static_cast<int>((*ints)[row]));
+                }
+                else
+                {
+                    push(std::get<std::span<const double>>(columns[i])[row]);
+                }
+            }
+            stack_.increaseBy(frame.nlocals - frame.nArgs);
+            frameStack_.increase();
+            frameStack_.top() = frame;
+
+            ip_ = body;
+            run(std::numeric_limits<size_t>::max());
+            results[row] = batchResult(stack_.top());
+        }
+    }
+    catch (...)
+    {
+        ip_ = nullptr;
+        throw;
+    }
+}
+
+TRunState VM::resume(size_t quantum)
+{
+    if (finished())
+    {
+        return TRunState::Finished;
+    }
+
+    TRuntime::TScope scope(runtime_);
+    try
+    {
+        return run(quantum);
+    }
+    catch (...)
+    {
+        ip_ = nullptr;
+        throw;
+    }
+}
+
+// Calls do not recurse into run(), the frame keeps the caller's
+// instruction pointer instead. That way the whole state of a run can be
+// parked in ip_ at any safepoint.
+TRunState VM::run(size_t quantum)
+{
+    const TByteCode *ip = ip_; // programs do not change during a run
+    // Constants of the running function, or of the module at the top level.
+    const auto *constants = currentConstants();
+    auto budget = static_cast<int64_t>(
+        std::min<size_t>(quantum, std::numeric_limits<int64_t>::max()));
 
     while (true)
     {
-        const auto &byteCode = code[ip];
+        const auto &byteCode = *ip;
         switch (byteCode.opCode)
         {
         case OpCode::Nop:
             break;
         case OpCode::Halt:
-            return;
+            ip_ = nullptr;
+            return TRunState::Finished;
         case OpCode::Pushd:
-            push(constantValueTable.get(byteCode.index).dvalue());
+            push(constants->get(byteCode.index).dvalue());
+            break;
+        case OpCode::Pushs:
+            push(constants->get(byteCode.index).sobject());
             break;
         case OpCode::Umi:
             unaryMinusOp();
@@ -63,6 +302,9 @@ void VM::run(const TProgram &code)
         case OpCode::Power:
             powerOp();
             break;
+        case OpCode::DotProduct:
+            TBuiltIns::dotProduct(stack_);
+            break;
         case OpCode::Store:
             store(byteCode.index);
             // TODO garbage collection if size reached.
@@ -104,20 +346,62 @@ void VM::run(const TProgram &code)
             if (!stack_.pop().bvalue())
             {
                 ip += byteCode.index - 1;
+                if (byteCode.index <= 0 && budget <= 0)
+                {
+                    ip_ = ip + 1;
+                    return TRunState::Suspended;
+                }
             }
             break;
         case OpCode::Jmp:
             ip += byteCode.index - 1;
+            if (byteCode.index <= 0 && budget <= 0)
+            {
+                ip_ = ip + 1;
+                return TRunState::Suspended;
+            }
             break;
         case OpCode::Call:
-            callUserFunction();
+            if (budget <= 0)
+            {
+                // Resuming executes the call itself.
+                ip_ = ip;
+                return TRunState::Suspended;
+            }
+            if (const auto *callee = callUserFunction(ip))
+            {
+                ip = callee;
+                constants = frameStack_.top().constantTable;
+                --budget;
+                continue;
+            }
+            break;
+        case OpCode::BuiltIn:
+            TBuiltIns::get(byteCode.index).function(stack_);
+            break;
+        case OpCode::ParallelMap:
+            parallelMapOp();
+            break;
+        case OpCode::ParallelReduce:
+            parallelReduceOp();
+            break;
+        case OpCode::Spawn:
+            spawnOp(byteCode.index);
             break;
         case OpCode::Return:
+        {
+            const auto &frame = frameStack_.top();
+            ip = frame.returnIp;
             returnOp();
-            return;
+            constants = currentConstants();
+            break;
+        }
         case OpCode::PushNone:
             push();
             break;
+        case OpCode::Pop:
+            stack_.pop();
+            break;
         case OpCode::StoreLocal:
             storeLocalSymbol(byteCode.index);
             // TODO collectGarbage
@@ -125,23 +409,40 @@ void VM::run(const TProgram &code)
         case OpCode::LoadLocal:
             loadLocalSymbol(byteCode.index);
             break;
+        case OpCode::CreateList:
+            createList(byteCode.index);
+            break;
+        case OpCode::LvecIdx:
+            loadListItem(byteCode.index);
+            break;
+        case OpCode::SvecIdx:
+            storeListItem(byteCode.index);
+            break;
         case OpCode::Mod:
         case OpCode::Inc:
         case OpCode::Dec:
         case OpCode::Xor:
-        case OpCode::Pushs:
         case OpCode::JmpIfTrue:
         case OpCode::LocalInc:
         case OpCode::LocalDec:
-        case OpCode::Pop:
             throw std::runtime_error("VM::Unsupported opcode: " +
                                      OpCodeToString(byteCode.opCode));
         }
         ++ip;
+        --budget;
+    }
+}
+
+const TConstantValueTable *VM::currentConstants()
+{
+    if (frameStack_.topIndex() < 0)
+    {
+        return &context_->module().constants();
     }
+    return frameStack_.top().constantTable;
 }
 
-void VM::callUserFunction()
+const TByteCode *VM::callUserFunction(const TByteCode *returnIp)
 {
     int index = stack_.popInteger();
     auto &symbols = symboltable();
@@ -149,6 +450,7 @@ void VM::callUserFunction()
     if (symbols.get(index).type() == TSymbolElementType::symUserFunc)
     {
         auto *funcRecord = symbols.get(index).fvalue();
+        funcRecord->ensureCompiled();
         frameStack_.increase();
 
         // Set up the new frame
@@ -159,14 +461,36 @@ void VM::callUserFunction()
         frame.constantTable = &funcRecord->constantTable();
         frame.symbolTable = &funcRecord->symboltable();
         frame.bsp = stack_.topIndex() - funcRecord->numberOfArguments() + 1;
+        frame.returnIp = returnIp;
 
-        // // Allocate space for local variables
+        // Lists and matrices are passed by value, the callee gets its own
+        // copy-on-write clone so that rebinding or mutating the argument
+        // leaves the caller's value untouched.
         size_t nArgs = funcRecord->numberOfArguments();
+        for (size_t i = 0; i < nArgs; ++i)
+        {
+            auto &arg = stack_[frame.bsp + i];
+            if (arg.type() == TStackRecordType::stList)
+            {
+                auto *copy = arg.lvalue()->clone();
+                copy->setType(TBlockType::btBound);
+                arg.setValue(copy);
+            }
+            else if (arg.type() == TStackRecordType::stMatrix)
+            {
+                auto *copy = arg.mvalue()->clone();
+                copy->setType(TBlockType::btBound);
+                arg.setValue(copy);
+            }
+        }
+
+        // // Allocate space for local variables
         int nPureLocals = funcRecord->symboltable().size() - nArgs;
         stack_.increaseBy(nPureLocals);
 
-        run(funcRecord->funcCode());
+        return &funcRecord->funcCode()[0];
     }
+    return nullptr;
 }
 
 void VM::store(int symTableIndex)
@@ -175,20 +499,25 @@ void VM::store(int symTableIndex)
     switch (record.type())
     {
     case TStackRecordType::stInteger:
-        module_->symboltable().storeSymbolToTable(symTableIndex,
-                                                  record.ivalue());
+        symboltable().storeSymbolToTable(symTableIndex, record.ivalue());
         break;
     case TStackRecordType::stBoolean:
-        module_->symboltable().storeSymbolToTable(symTableIndex,
-                                                  record.bvalue());
+        symboltable().storeSymbolToTable(symTableIndex, record.bvalue());
         break;
     case TStackRecordType::stDouble:
-        module_->symboltable().storeSymbolToTable(symTableIndex,
-                                                  record.dvalue());
+        symboltable().storeSymbolToTable(symTableIndex, record.dvalue());
         break;
     case TStackRecordType::stString:
+        symboltable().storeSymbolToTable(symTableIndex, record.svalue());
+        break;
     case TStackRecordType::stList:
-        throw std::runtime_error("TODO VM::store not supported"); // FIXME
+        symboltable().storeSymbolToTable(symTableIndex, record.lvalue());
+        break;
+    case TStackRecordType::stMatrix:
+        symboltable().storeSymbolToTable(symTableIndex, record.mvalue());
+        break;
+    case TStackRecordType::stChannel:
+        symboltable().storeSymbolToTable(symTableIndex, record.cvalue());
         break;
     case TStackRecordType::stNone:
         break;
@@ -267,7 +596,6 @@ void VM::addOp()
         if (st1_typ == TStackRecordType::stString)
         {
             stack_.push(TStringObject::add(*st2.svalue(), *st1.svalue()));
-            throw std::runtime_error(IMPLEMENTATION_MISSING);
         }
         else
         {
@@ -276,41 +604,44 @@ void VM::addOp()
     }
     else if (st2_typ == TStackRecordType::stList)
     {
+        // Temporaries are extended in place, anything bound to a name is
+        // cloned first so the variable keeps its value.
+        auto *list = st2.lvalue()->isGarbage() ? st2.lvalue()
+                                               : st2.lvalue()->clone();
         if (st1_typ == TStackRecordType::stInteger)
         {
-            auto list = st2.lvalue();
             list->append(st1.ivalue());
-            stack_.push(list);
         }
         else if (st1_typ == TStackRecordType::stBoolean)
         {
-            auto list = st2.lvalue();
             list->append(st1.bvalue());
-            stack_.push(list);
         }
         else if (st1_typ == TStackRecordType::stDouble)
         {
-            auto list = st2.lvalue();
             list->append(st1.dvalue());
-            stack_.push(list);
         }
         else if (st1_typ == TStackRecordType::stString)
         {
-            auto list = st2.lvalue();
             list->append(st1.svalue());
-            stack_.push(list);
         }
         else if (st1_typ == TStackRecordType::stList)
         {
-            auto trg = st2.lvalue();
-            auto src = st1.lvalue();
-            trg->insert(src->begin(), src->end());
-            stack_.push(src);
+            list = TListObject::addLists(list, st1.lvalue());
         }
         else
         {
             error("adding", st2, st1);
         }
+        stack_.push(list);
+    }
+    else if (st2_typ == TStackRecordType::stMatrix &&
+             st1_typ == TStackRecordType::stMatrix)
+    {
+        stack_.push(TMatrixObject::add(st2.mvalue(), st1.mvalue()));
+    }
+    else if (st2_typ == TStackRecordType::stMatrix)
+    {
+        error("adding", st2, st1);
     }
     else
     {
@@ -353,13 +684,11 @@ void VM::multOp()
         }
         else if (st1_typ == TStackRecordType::stList)
         {
-            throw std::runtime_error("VM::multOp> Not implemented yet");
-            // auto buffer = st1.lvalue();
-            // auto newList = buffer;
-            // for (int i = 2; i < st2.ivalue(); ++i) {
-            //     newList.insert(newList.end(), buffer.begin(), buffer.end());
-            // }
-            // stack_.push(newList);
+            stack_.push(TListObject::multiply(st2.ivalue(), st1.lvalue()));
+        }
+        else if (st1_typ == TStackRecordType::stMatrix)
+        {
+            stack_.push(TMatrixObject::scale(st1.mvalue(), st2.ivalue()));
         }
         else
         {
@@ -380,6 +709,10 @@ void VM::multOp()
         {
             stack_.push(st1.dvalue() * st2.dvalue());
         }
+        else if (st1_typ == TStackRecordType::stMatrix)
+        {
+            stack_.push(TMatrixObject::scale(st1.mvalue(), st2.dvalue()));
+        }
         else
         {
             error("multiplying", st2, st1);
@@ -400,18 +733,31 @@ void VM::multOp()
     }
     else if (st2_typ == TStackRecordType::stList)
     {
-        throw std::runtime_error("VM::multOp> Not implemented yet");
-
-        // if (st1_typ == TStackRecordType::stInteger) {
-        //     auto buffer = st2.lvalue();
-        //     auto newList = buffer;
-        //     for (int i = 2; i < st1.ivalue(); ++i) {
-        //         newList.insert(newList.end(), buffer.begin(), buffer.end());
-        //     }
-        //     stack_.push(newList);
-        // } else {
-        //     throw std::runtime_error("Lists can only be multiplied by integers");
-        // }
+        if (st1_typ == TStackRecordType::stInteger)
+        {
+            stack_.push(TListObject::multiply(st1.ivalue(), st2.lvalue()));
+        }
+        else
+        {
+            throw std::runtime_error(
+                "Lists can only be multiplied by integers");
+        }
+    }
+    else if (st2_typ == TStackRecordType::stMatrix)
+    {
+        if (st1_typ == TStackRecordType::stMatrix)
+        {
+            stack_.push(
+                TMatrixObject::multiplyElements(st2.mvalue(), st1.mvalue()));
+        }
+        else if (isNumber(st1))
+        {
+            stack_.push(TMatrixObject::scale(st2.mvalue(), numberValue(st1)));
+        }
+        else
+        {
+            error("multiplying", st2, st1);
+        }
     }
     else
     {
@@ -466,6 +812,11 @@ void VM::divOp()
     }
     else
     {
+        if (st2_typ == TStackRecordType::stMatrix && isNumber(st1))
+        {
+            stack_.push(TMatrixObject::divide(st2.mvalue(), numberValue(st1)));
+            return;
+        }
         throw std::runtime_error(
             "Internal Error: Unsupported datatype in dividing");
     }
@@ -517,6 +868,12 @@ void VM::subOp()
     }
     else
     {
+        if (st2_typ == TStackRecordType::stMatrix &&
+            st1_typ == TStackRecordType::stMatrix)
+        {
+            stack_.push(TMatrixObject::sub(st2.mvalue(), st1.mvalue()));
+            return;
+        }
         throw std::runtime_error(
             "Internal Error: Only integers and floats can be "
             "subtracted from each other");
@@ -663,16 +1020,6 @@ void VM::notOp()
 void VM::returnOp()
 {
     auto value = pop();
-    if (value.type() == TStackRecordType::stString)
-    {
-        // value.setValue(value.svalue().clone());
-        throw std::runtime_error("VM::returnOp> return string");
-    }
-    else if (value.type() == TStackRecordType::stList)
-    {
-        //  value.setValue(value.lvalue().clone());
-        throw std::runtime_error("VM::returnOp> return list");
-    }
     stack_.decreaseBy(frameStack_.top().nlocals);
     frameStack_.decrease();
     push(value);
@@ -945,19 +1292,30 @@ void VM::isEq()
     }
     else if (st1_type == TStackRecordType::stString)
     {
-        // TODO
-        throw std::runtime_error("VM::isEq> TODO");
-        // if (st2_type == TStackRecordType::stString) {
-        //     stack_.push(!st1.svalue().compare(st2.svalue()));
-        // } else {
-        //     throw std::runtime_error("Incompatible types in equality test");
-        // }
+        if (st2_type == TStackRecordType::stString)
+        {
+            stack_.push(st1.svalue()->isEqualTo(*st2.svalue()));
+        }
+        else
+        {
+            throw std::runtime_error("Incompatible types in equality test");
+        }
     }
     else if (st1_type == TStackRecordType::stList)
     {
-        // TODO
-        throw std::runtime_error(
-            "VM::isEq> Incompatible types in equality test");
+        if (st2_type == TStackRecordType::stList)
+        {
+            stack_.push(TListObject::listEquals(st1.lvalue(), st2.lvalue()));
+        }
+        else
+        {
+            throw std::runtime_error("Incompatible types in equality test");
+        }
+    }
+    else if (st1_type == TStackRecordType::stMatrix &&
+             st2_type == TStackRecordType::stMatrix)
+    {
+        stack_.push(TMatrixObject::equals(st1.mvalue(), st2.mvalue()));
     }
     else
     {
@@ -979,7 +1337,8 @@ void VM::loadSymbol(int index)
     switch (symbol.type())
     {
     case TSymbolElementType::symUndefined:
-        throw std::runtime_error("Undefined variable" + symbol.name());
+        throw std::runtime_error("Undefined variable" +
+                                 symboltable().name(index));
     case TSymbolElementType::symInteger:
         stack_.push(symbol.ivalue());
         break;
@@ -995,6 +1354,12 @@ void VM::loadSymbol(int index)
     case TSymbolElementType::symList:
         stack_.push(symbol.lvalue());
         break;
+    case TSymbolElementType::symMatrix:
+        stack_.push(symbol.mvalue());
+        break;
+    case TSymbolElementType::symChannel:
+        stack_.push(symbol.cvalue());
+        break;
     case TSymbolElementType::symUserFunc:
         // TODO
         throw std::runtime_error("VM::loadSymbol:: User function");
@@ -1011,8 +1376,21 @@ void VM::storeLocalSymbol(int index)
     auto bsp = frameStack_.top().bsp;
     auto value = pop(); // This is the value we will store
     auto &record = stack_[bsp + index];
+    if (value.type() == TStackRecordType::stList &&
+        !value.lvalue()->isGarbage())
+    {
+        // Bound lists are shared by value, the clone only copies the
+        // buffer once one side is mutated.
+        value.setValue(value.lvalue()->clone());
+    }
+    if (value.type() == TStackRecordType::stMatrix &&
+        !value.mvalue()->isGarbage())
+    {
+        value.setValue(value.mvalue()->clone());
+    }
+    // Constants pushed by Pushs are shared by every run of the module.
     if (record.type() == TStackRecordType::stString &&
-        record.svalue() != nullptr)
+        record.svalue() != nullptr && !record.svalue()->isReadOnly())
     {
         record.svalue()->setType(TBlockType::btGarbage); // mark as garbage
     }
@@ -1020,6 +1398,11 @@ void VM::storeLocalSymbol(int index)
     {
         record.lvalue()->setType(TBlockType::btGarbage);
     }
+    if (record.type() == TStackRecordType::stMatrix &&
+        record.mvalue() != nullptr)
+    {
+        record.mvalue()->setType(TBlockType::btGarbage);
+    }
 
     // TODO switch case
     if (value.type() == TStackRecordType::stInteger)
@@ -1044,15 +1427,204 @@ void VM::storeLocalSymbol(int index)
     }
     else if (value.type() == TStackRecordType::stList)
     {
+        value.lvalue()->setType(TBlockType::btBound);
         record.setValue(value.lvalue());
         record.setType(TStackRecordType::stList);
     }
+    else if (value.type() == TStackRecordType::stMatrix)
+    {
+        value.mvalue()->setType(TBlockType::btBound);
+        record.setValue(value.mvalue());
+    }
+    else if (value.type() == TStackRecordType::stChannel)
+    {
+        record.setValue(value.cvalue());
+    }
     else
     {
         throw std::runtime_error("unknown symbol type in storeLocalValue");
     }
 }
 
+void VM::createList(int nItems)
+{
+    auto *list = TListObject::createObject();
+    int first = stack_.topIndex() - nItems + 1;
+    for (int i = first; i <= stack_.topIndex(); ++i)
+    {
+        const auto &item = stack_[i];
+        switch (item.type())
+        {
+        case TStackRecordType::stInteger:
+            list->append(item.ivalue());
+            break;
+        case TStackRecordType::stBoolean:
+            list->append(item.bvalue());
+            break;
+        case TStackRecordType::stDouble:
+            list->append(item.dvalue());
+            break;
+        case TStackRecordType::stString:
+            list->append(item.svalue());
+            break;
+        case TStackRecordType::stList:
+            list->append(item.lvalue());
+            break;
+        case TStackRecordType::stMatrix:
+            throw std::runtime_error("Matrices cannot be stored in lists");
+        case TStackRecordType::stChannel:
+            throw std::runtime_error("Channels cannot be stored in lists");
+        case TStackRecordType::stNone:
+            throw std::runtime_error("RunTimeError: Variable undefined");
+        }
+    }
+    stack_.decreaseBy(nItems);
+    push(list);
+}
+
+void VM::loadListItem(int nIndices)
+{
+    if (nIndices == 2)
+    {
+        auto col = pop();
+        auto row = pop();
+        auto matrix = pop();
+        if (matrix.type() != TStackRecordType::stMatrix ||
+            row.type() != TStackRecordType::stInteger ||
+            col.type() != TStackRecordType::stInteger)
+        {
+            error("indexing", matrix, row);
+        }
+        push(matrix.mvalue()->get(row.ivalue(), col.ivalue()));
+        return;
+    }
+
+    auto index = pop();
+    auto list = pop();
+    if (list.type() != TStackRecordType::stList ||
+        index.type() != TStackRecordType::stInteger)
+    {
+        error("indexing", list, index);
+    }
+
+    const auto &item = list.lvalue()->get(index.ivalue());
+    switch (item.type())
+    {
+    case TListItemType::liInteger:
+        push(item.ivalue());
+        break;
+    case TListItemType::liBoolean:
+        push(item.bvalue());
+        break;
+    case TListItemType::liDouble:
+        push(item.dvalue());
+        break;
+    case TListItemType::liString:
+        push(const_cast<TStringObject *>(item.svalue()));
+        break;
+    case TListItemType::liList:
+        push(const_cast<TListObject *>(item.lvalue()));
+        break;
+    }
+}
+
+void VM::storeListItem(int nIndices)
+{
+    if (nIndices == 2)
+    {
+        auto col = pop();
+        auto row = pop();
+        auto matrix = pop();
+        auto value = pop();
+        if (matrix.type() != TStackRecordType::stMatrix ||
+            row.type() != TStackRecordType::stInteger ||
+            col.type() != TStackRecordType::stInteger || !isNumber(value))
+        {
+            error("indexing", matrix, row);
+        }
+        matrix.mvalue()->set(row.ivalue(), col.ivalue(), numberValue(value));
+        return;
+    }
+
+    auto index = pop();
+    auto list = pop();
+    auto value = pop();
+    if (list.type() != TStackRecordType::stList ||
+        index.type() != TStackRecordType::stInteger)
+    {
+        error("indexing", list, index);
+    }
+
+    auto *target = list.lvalue();
+    switch (value.type())
+    {
+    case TStackRecordType::stInteger:
+        target->set(index.ivalue(), TListItem(value.ivalue()));
+        break;
+    case TStackRecordType::stBoolean:
+        target->set(index.ivalue(), TListItem(value.bvalue()));
+        break;
+    case TStackRecordType::stDouble:
+        target->set(index.ivalue(), TListItem(value.dvalue()));
+        break;
+    case TStackRecordType::stString:
+        target->set(index.ivalue(), TListItem(value.svalue()));
+        break;
+    case TStackRecordType::stList:
+    {
+        auto *entry = value.lvalue()->isGarbage() ? value.lvalue()
+                                                  : value.lvalue()->clone();
+        entry->setType(TBlockType::btOwned);
+        target->set(index.ivalue(), TListItem(entry));
+        break;
+    }
+    case TStackRecordType::stMatrix:
+        throw std::runtime_error("Matrices cannot be stored in lists");
+    case TStackRecordType::stChannel:
+        throw std::runtime_error("Channels cannot be stored in lists");
+    case TStackRecordType::stNone:
+        throw std::runtime_error("RunTimeError: Variable undefined");
+    }
+}
+
+static TListObject *listArgument(const TMachineStackRecord &record,
+                                 const std::string &fn)
+{
+    if (record.type() != TStackRecordType::stList)
+    {
+        throw std::runtime_error(fn + " expects a list");
+    }
+    return record.lvalue();
+}
+
+void VM::parallelMapOp()
+{
+    auto *list = listArgument(pop(), "pmap");
+    int funcIndex = stack_.popInteger();
+    push(TParallelList::map(*context_, funcIndex, list,
+                            TThreadPool::shared()));
+}
+
+void VM::parallelReduceOp()
+{
+    auto init = pop();
+    auto *list = listArgument(pop(), "preduce");
+    int funcIndex = stack_.popInteger();
+    push(TParallelList::reduce(*context_, funcIndex, list, init,
+                               TThreadPool::shared()));
+}
+
+void VM::spawnOp(int nArgs)
+{
+    std::vector<TMachineStackRecord> args(nArgs);
+    for (int i = nArgs - 1; i >= 0; --i)
+    {
+        args[i] = pop();
+    }
+    int funcIndex = stack_.popInteger();
+    push(TIsolate::spawn(*context_, funcIndex, args));
+}
+
 void VM::loadLocalSymbol(int index)
 {
     // Obtain the base of the local stack area from the current activation frame
@@ -1064,8 +1636,9 @@ void VM::loadLocalSymbol(int index)
 
 void VM::copyToStack(const TMachineStackRecord &stackelem, TFrame &frame)
 {
-    auto &record = stack_.push();
-    record = stackelem;
+    // stackelem lives in the stack, copy it before the push can move it.
+    TMachineStackRecord value = stackelem;
+    stack_.push() = value;
 }
 
 TFrame &TFrameStack::top()
@@ -3,15 +3,23 @@
 
 #include "ConstantTable.hpp"
 #include "MachineStack.hpp"
+#include "TExecutionContext.hpp"
 #include "TModule.hpp"
 #include "TSymbolTable.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
 #include <memory>
+#include <span>
+#include <variant>
+#include <vector>
 
 class TModule;
+class TRuntime;
 
 struct TFrame
 {
-    // This is a reference to the global constant table
+    // The constants of the called function
     TConstantValueTable *constantTable;
     // This is a reference to the local symbol table
     TSymbolTable *symbolTable;
@@ -19,6 +27,8 @@ struct TFrame
     int bsp = -1;        // stack base of function arguments
     uint8_t nArgs = 0;   // number of arguments
     uint8_t nlocals = 0; // number of local variables
+    // The caller's Call, it continues after it once the function returns.
+    const TByteCode *returnIp = nullptr;
 };
 
 class TFrameStack
@@ -37,17 +47,107 @@ public:
     {
         --topIndex_;
     }
+    void clear()
+    {
+        topIndex_ = -1;
+    }
+    void save(std::vector<TFrame> &frames) const
+    {
+        frames.assign(frameStack_.begin(),
+                      frameStack_.begin() + topIndex_ + 1);
+    }
+    void restore(const std::vector<TFrame> &frames)
+    {
+        std::copy(frames.begin(), frames.end(), frameStack_.begin());
+        topIndex_ = static_cast<int>(frames.size()) - 1;
+    }
 
 private:
     std::array<TFrame, 2048> frameStack_;
     int topIndex_ = -1;
 };
 
+enum class TRunState
+{
+    Finished,
+    Suspended
+};
+
+// A suspended run moved out of its VM: the live part of both stacks and the
+// next instruction. A script a few calls deep fits in a few hundred bytes.
+struct TSuspendedRun
+{
+    TExecutionContext *context = nullptr;
+    const TByteCode *ip = nullptr;
+    std::vector<TMachineStackRecord> stack;
+    std::vector<TFrame> frames;
+};
+
+// One argument for every row of a batched call, see VM::callBatch.
+using TBatchColumn =
+    std::variant<std::span<const int64_t>, std::span<const double>>;
+
+// Throws unless every value of the integer columns fits in an int.
+void checkBatchColumns(std::span<const TBatchColumn> columns);
+
+enum class TBatchMode
+{
+    Vectorized, // a block of rows per instruction where possible
+    Scalar      // a row at a time
+};
+
 class VM
 {
 public:
-    void runModule(std::shared_ptr<TModule> module);
-    void run(const TProgram &code);
+    explicit VM(TRuntime &runtime) : runtime_(runtime)
+    {
+    }
+
+    // Runs a module in a fresh context of its own.
+    void runModule(std::shared_ptr<const TModule> module);
+    // Runs the module of the context, globals are read from and stored into
+    // the context so that other VMs can run the same module concurrently.
+    // Every run starts on empty stacks, so a VM can be reused.
+    void runModule(TExecutionContext &context);
+
+    // Sets up a run of the context's module without executing anything,
+    // resume() then executes it in slices.
+    void start(TExecutionContext &context);
+    // Runs until the script halts or, once quantum instructions have been
+    // executed, until the next safepoint: a call or a backward jump.
+    TRunState resume(size_t quantum);
+    // Move a suspended run out of the VM and back in, so that one VM can
+    // interleave many runs, see TGreenThreads.
+    void save(TSuspendedRun &run) const;
+    void restore(const TSuspendedRun &run);
+    bool finished() const
+    {
+        return ip_ == nullptr;
+    }
+    // Runs one call of the user function at funcIndex of the context and
+    // returns its result, which lives in this VM's runtime. The VM must not
+    // be in the middle of a run.
+    TMachineStackRecord callFunction(TExecutionContext &context,
+                                     int funcIndex,
+                                     const TMachineStackRecord *args,
+                                     size_t nArgs);
+    TMachineStackRecord callFunction(
+        TExecutionContext &context,
+        int funcIndex,
+        std::initializer_list<TMachineStackRecord> args)
+    {
+        return callFunction(context, funcIndex, args.begin(), args.size());
+    }
+    // Calls the user function once per row, the i-th column holding the
+    // i-th argument of every row, and stores the numeric results. Functions
+    // TVectorProgram can translate run a block of rows per instruction.
+    // Otherwise the frame is set up once and a row only writes its
+    // arguments and runs the body.
+    void callBatch(TExecutionContext &context,
+                   int funcIndex,
+                   std::span<const TBatchColumn> columns,
+                   std::span<double> results,
+                   TBatchMode mode = TBatchMode::Vectorized);
     const TMachineStackRecord &top() const
     {
         return stack_.ctop();
@@ -58,6 +158,7 @@ public:
     }
 
 private:
+    TRunState run(size_t quantum);
     void store(int symTableIndex);
     // void load(int symTableIndex);
     void addOp();
@@ -80,6 +181,12 @@ private:
     void isEq();
     void isNotEq();
     void loadSymbol(int index);
+    void createList(int nItems);
+    void loadListItem(int nIndices);
+    void storeListItem(int nIndices);
+    void parallelMapOp();
+    void parallelReduceOp();
+    void spawnOp(int nArgs);
 
     void push()
     {
@@ -97,6 +204,22 @@ private:
     {
         stack_.push(value);
     }
+    void push(TStringObject *value)
+    {
+        stack_.push(value);
+    }
+    void push(TListObject *value)
+    {
+        stack_.push(value);
+    }
+    void push(TMatrixObject *value)
+    {
+        stack_.push(value);
+    }
+    void push(TChannelObject *value)
+    {
+        stack_.push(value);
+    }
     void push(TMachineStackRecord value)
     {
         stack_.push(value);
@@ -105,7 +228,10 @@ private:
     {
         return stack_.pop();
     }
-    void callUserFunction();
+    // Returns the first instruction of the called function, or nullptr if
+    // the symbol is no function.
+    const TByteCode *callUserFunction(const TByteCode *returnIp);
+    const TConstantValueTable *currentConstants();
     void returnOp();
     void storeLocalSymbol(int index);
     void loadLocalSymbol(int index);
@@ -116,14 +242,17 @@ private:
     static void error(const std::string &arg,
                       const TMachineStackRecord &st1,
                       const TMachineStackRecord &st2);
-    TSymbolTable &symboltable()
+    TGlobalValues &symboltable()
     {
-        return module_->symboltable();
+        return context_->globals();
     }
 
+    TRuntime &runtime_;
     TMachineStack stack_;
     TFrameStack frameStack_;
-    std::shared_ptr<TModule> module_;
+    TExecutionContext *context_ = nullptr;
+    const TByteCode *ip_ = nullptr; // nullptr unless a run is in progress
+    std::unique_ptr<TExecutionContext> ownContext_;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,439 @@
+#include "VectorKernels.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#if (defined(__x86_64__) || defined(__i386__)) &&                              \
+    (defined(__GNUC__) || defined(__clang__))
+#define DAEWOO_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+std::string TKernelIsaToStr(TKernelIsa isa)
+{
+    switch (isa)
+    {
+    case TKernelIsa::Scalar:
+        return "scalar";
+    case TKernelIsa::SSE2:
+        return "sse2";
+    case TKernelIsa::AVX2:
+        return "avx2";
+    }
+    return "";
+}
+
+namespace
+{
+
+double dotdScalar(const double *x, const double *y, size_t n)
+{
+    double sum = 0.;
+    for (size_t i = 0; i < n; ++i)
+    {
+        sum += x[i] * y[i];
+    }
+    return sum;
+}
+
+int64_t dotiScalar(const int64_t *x, const int64_t *y, size_t n)
+{
+    int64_t sum = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        sum += x[i] * y[i];
+    }
+    return sum;
+}
+
+double sumdScalar(const double *x, size_t n)
+{
+    double sum = 0.;
+    for (size_t i = 0; i < n; ++i)
+    {
+        sum += x[i];
+    }
+    return sum;
+}
+
+int64_t sumiScalar(const int64_t *x, size_t n)
+{
+    int64_t sum = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        sum += x[i];
+    }
+    return sum;
+}
+
+double mindScalar(const double *x, size_t n)
+{
+    return *std::min_element(x, x + n);
+}
+
+double maxdScalar(const double *x, size_t n)
+{
+    return *std::max_element(x, x + n);
+}
+
+int64_t miniScalar(const int64_t *x, size_t n)
+{
+    return *std::min_element(x, x + n);
+}
+
+int64_t maxiScalar(const int64_t *x, size_t n)
+{
+    return *std::max_element(x, x + n);
+}
+
+void axpydScalar(double a, const double *x, double *y, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        y[i] += a * x[i];
+    }
+}
+
+#ifdef DAEWOO_X86_KERNELS
+
+// SSE2 is part of the x86-64 baseline, these need no target attribute.
+
+double horizontalSum(__m128d v)
+{
+    return _mm_cvtsd_f64(v) + _mm_cvtsd_f64(_mm_unpackhi_pd(v, v));
+}
+
+double dotdSSE2(const double *x, const double *y, size_t n)
+{
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        acc0 = _mm_add_pd(
+            acc0, _mm_mul_pd(_mm_loadu_pd(x + i), _mm_loadu_pd(y + i)));
+        acc1 = _mm_add_pd(
+            acc1,
+            _mm_mul_pd(_mm_loadu_pd(x + i + 2), _mm_loadu_pd(y + i + 2)));
+    }
+    double sum = horizontalSum(_mm_add_pd(acc0, acc1));
+    return sum + dotdScalar(x + i, y + i, n - i);
+}
+
+double sumdSSE2(const double *x, size_t n)
+{
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        acc0 = _mm_add_pd(acc0, _mm_loadu_pd(x + i));
+        acc1 = _mm_add_pd(acc1, _mm_loadu_pd(x + i + 2));
+    }
+    double sum = horizontalSum(_mm_add_pd(acc0, acc1));
+    return sum + sumdScalar(x + i, n - i);
+}
+
+int64_t sumiSSE2(const int64_t *x, size_t n)
+{
+    __m128i acc = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        acc = _mm_add_epi64(
+            acc, _mm_loadu_si128(reinterpret_cast<const __m128i *>(x + i)));
+    }
+    int64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), acc);
+    return lanes[0] + lanes[1] + sumiScalar(x + i, n - i);
+}
+
+double mindSSE2(const double *x, size_t n)
+{
+    if (n < 2)
+    {
+        return mindScalar(x, n);
+    }
+    __m128d acc = _mm_loadu_pd(x);
+    size_t i = 2;
+    for (; i + 2 <= n; i += 2)
+    {
+        acc = _mm_min_pd(acc, _mm_loadu_pd(x + i));
+    }
+    double result = std::min(_mm_cvtsd_f64(acc),
+                             _mm_cvtsd_f64(_mm_unpackhi_pd(acc, acc)));
+    return i < n ? std::min(result, x[i]) : result;
+}
+
+double maxdSSE2(const double *x, size_t n)
+{
+    if (n < 2)
+    {
+        return maxdScalar(x, n);
+    }
+    __m128d acc = _mm_loadu_pd(x);
+    size_t i = 2;
+    for (; i + 2 <= n; i += 2)
+    {
+        acc = _mm_max_pd(acc, _mm_loadu_pd(x + i));
+    }
+    double result = std::max(_mm_cvtsd_f64(acc),
+                             _mm_cvtsd_f64(_mm_unpackhi_pd(acc, acc)));
+    return i < n ? std::max(result, x[i]) : result;
+}
+
+void axpydSSE2(double a, const double *x, double *y, size_t n)
+{
+    __m128d va = _mm_set1_pd(a);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        _mm_storeu_pd(y + i, _mm_add_pd(_mm_loadu_pd(y + i),
+                                        _mm_mul_pd(va, _mm_loadu_pd(x + i))));
+    }
+    axpydScalar(a, x + i, y + i, n - i);
+}
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+AVX2_TARGET __m256i load4(const int64_t *p)
+{
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+}
+
+AVX2_TARGET double horizontalSum(__m256d v)
+{
+    __m128d sum =
+        _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return horizontalSum(sum);
+}
+
+AVX2_TARGET double dotdAVX2(const double *x, const double *y, size_t n)
+{
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = _mm256_add_pd(
+            acc0,
+            _mm256_mul_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+        acc1 = _mm256_add_pd(acc1,
+                             _mm256_mul_pd(_mm256_loadu_pd(x + i + 4),
+                                           _mm256_loadu_pd(y + i + 4)));
+    }
+    double sum = horizontalSum(_mm256_add_pd(acc0, acc1));
+    return sum + dotdScalar(x + i, y + i, n - i);
+}
+
+AVX2_TARGET int64_t dotiAVX2(const int64_t *x, const int64_t *y, size_t n)
+{
+    // _mm256_mul_epi32 multiplies the signed low halves of each lane, which
+    // is exact because list integers fit in 32 bits, see
+    // TListObject::createView.
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        acc = _mm256_add_epi64(acc,
+                               _mm256_mul_epi32(load4(x + i), load4(y + i)));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+           dotiScalar(x + i, y + i, n - i);
+}
+
+AVX2_TARGET double sumdAVX2(const double *x, size_t n)
+{
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(x + i));
+        acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(x + i + 4));
+    }
+    double sum = horizontalSum(_mm256_add_pd(acc0, acc1));
+    return sum + sumdScalar(x + i, n - i);
+}
+
+AVX2_TARGET int64_t sumiAVX2(const int64_t *x, size_t n)
+{
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = _mm256_add_epi64(acc0, load4(x + i));
+        acc1 = _mm256_add_epi64(acc1, load4(x + i + 4));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes),
+                        _mm256_add_epi64(acc0, acc1));
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+           sumiScalar(x + i, n - i);
+}
+
+AVX2_TARGET double mindAVX2(const double *x, size_t n)
+{
+    if (n < 4)
+    {
+        return mindScalar(x, n);
+    }
+    __m256d acc = _mm256_loadu_pd(x);
+    size_t i = 4;
+    for (; i + 4 <= n; i += 4)
+    {
+        acc = _mm256_min_pd(acc, _mm256_loadu_pd(x + i));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, acc);
+    double result = *std::min_element(lanes, lanes + 4);
+    return i < n ? std::min(result, mindScalar(x + i, n - i)) : result;
+}
+
+AVX2_TARGET double maxdAVX2(const double *x, size_t n)
+{
+    if (n < 4)
+    {
+        return maxdScalar(x, n);
+    }
+    __m256d acc = _mm256_loadu_pd(x);
+    size_t i = 4;
+    for (; i + 4 <= n; i += 4)
+    {
+        acc = _mm256_max_pd(acc, _mm256_loadu_pd(x + i));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, acc);
+    double result = *std::max_element(lanes, lanes + 4);
+    return i < n ? std::max(result, maxdScalar(x + i, n - i)) : result;
+}
+
+AVX2_TARGET int64_t miniAVX2(const int64_t *x, size_t n)
+{
+    if (n < 4)
+    {
+        return miniScalar(x, n);
+    }
+    __m256i acc = load4(x);
+    size_t i = 4;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256i v = load4(x + i);
+        acc = _mm256_blendv_epi8(acc, v, _mm256_cmpgt_epi64(acc, v));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), acc);
+    int64_t result = *std::min_element(lanes, lanes + 4);
+    return i < n ? std::min(result, miniScalar(x + i, n - i)) : result;
+}
+
+AVX2_TARGET int64_t maxiAVX2(const int64_t *x, size_t n)
+{
+    if (n < 4)
+    {
+        return maxiScalar(x, n);
+    }
+    __m256i acc = load4(x);
+    size_t i = 4;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256i v = load4(x + i);
+        acc = _mm256_blendv_epi8(acc, v, _mm256_cmpgt_epi64(v, acc));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), acc);
+    int64_t result = *std::max_element(lanes, lanes + 4);
+    return i < n ? std::max(result, maxiScalar(x + i, n - i)) : result;
+}
+
+AVX2_TARGET void axpydAVX2(double a, const double *x, double *y, size_t n)
+{
+    __m256d va = _mm256_set1_pd(a);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d product = _mm256_mul_pd(va, _mm256_loadu_pd(x + i));
+        _mm256_storeu_pd(y + i, _mm256_add_pd(_mm256_loadu_pd(y + i), product));
+    }
+    axpydScalar(a, x + i, y + i, n - i);
+}
+
+#undef AVX2_TARGET
+
+#endif
+
+const TVectorKernels scalarKernels = {dotdScalar, dotiScalar, sumdScalar,
+                                      sumiScalar, mindScalar, maxdScalar,
+                                      miniScalar, maxiScalar, axpydScalar};
+
+#ifdef DAEWOO_X86_KERNELS
+// SSE2 has no signed 32x32->64 multiply or 64 bit compare, those kernels
+// stay scalar.
+const TVectorKernels sse2Kernels = {dotdSSE2,   dotiScalar, sumdSSE2,
+                                    sumiSSE2,   mindSSE2,   maxdSSE2,
+                                    miniScalar, maxiScalar, axpydSSE2};
+
+const TVectorKernels avx2Kernels = {dotdAVX2, dotiAVX2, sumdAVX2,
+                                    sumiAVX2, mindAVX2, maxdAVX2,
+                                    miniAVX2, maxiAVX2, axpydAVX2};
+#endif
+
+} // namespace
+
+bool TVectorKernels::isSupported(TKernelIsa isa)
+{
+    switch (isa)
+    {
+    case TKernelIsa::Scalar:
+        return true;
+#ifdef DAEWOO_X86_KERNELS
+    case TKernelIsa::SSE2:
+        return __builtin_cpu_supports("sse2");
+    case TKernelIsa::AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+const TVectorKernels &TVectorKernels::get(TKernelIsa isa)
+{
+    if (!isSupported(isa))
+    {
+        throw std::runtime_error("Vector kernels not supported by this CPU: " +
+                                 TKernelIsaToStr(isa));
+    }
+    switch (isa)
+    {
+#ifdef DAEWOO_X86_KERNELS
+    case TKernelIsa::SSE2:
+        return sse2Kernels;
+    case TKernelIsa::AVX2:
+        return avx2Kernels;
+#endif
+    default:
+        return scalarKernels;
+    }
+}
+
+TKernelIsa TVectorKernels::bestIsa()
+{
+    static const TKernelIsa isa = [] {
+        if (isSupported(TKernelIsa::AVX2))
+            return TKernelIsa::AVX2;
+        if (isSupported(TKernelIsa::SSE2))
+            return TKernelIsa::SSE2;
+        return TKernelIsa::Scalar;
+    }();
+    return isa;
+}
+
+const TVectorKernels &TVectorKernels::best()
+{
+    static const TVectorKernels &kernels = get(bestIsa());
+    return kernels;
+}
@@ -0,0 +1,50 @@
+#ifndef VECTOR_KERNELS_HPP_INCLUDED
+#define VECTOR_KERNELS_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+enum class TKernelIsa
+{
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+std::string TKernelIsaToStr(TKernelIsa isa);
+
+/*
+ * Reduction kernels over the packed arrays of numeric lists. One table is
+ * compiled per instruction set, best() picks the widest one the CPU
+ * supports at run time.
+ *
+ * Integer kernels are exact; they expect every element to fit in 32 bits,
+ * which holds for list storage since the VM integers are ints and views of
+ * host arrays are range-checked when they are created. The double
+ * sum, mean and dot product reassociate the additions, so they agree with a
+ * left-to-right scalar loop within n * DBL_EPSILON * sum(|x_i|). min and
+ * max are exact, the result is unspecified if the input holds a NaN.
+ * Every kernel requires n > 0, except sum and dot which return 0.
+ * axpyd computes y += a * x elementwise, it is the inner loop of the
+ * matrix multiply.
+ */
+struct TVectorKernels
+{
+    double (*dotd)(const double *x, const double *y, size_t n);
+    int64_t (*doti)(const int64_t *x, const int64_t *y, size_t n);
+    double (*sumd)(const double *x, size_t n);
+    int64_t (*sumi)(const int64_t *x, size_t n);
+    double (*mind)(const double *x, size_t n);
+    double (*maxd)(const double *x, size_t n);
+    int64_t (*mini)(const int64_t *x, size_t n);
+    int64_t (*maxi)(const int64_t *x, size_t n);
+    void (*axpyd)(double a, const double *x, double *y, size_t n);
+
+    static bool isSupported(TKernelIsa isa);
+    static const TVectorKernels &get(TKernelIsa isa);
+    static const TVectorKernels &best();
+    static TKernelIsa bestIsa();
+};
+
+#endif
@@ -8,8 +8,8 @@
 #include <vector>
 
 #include "environment.hpp"
-#include "globals.hpp"
 #include "macros.hpp"
+#include "resolver.hpp"
 
 namespace
 {
@@ -163,44 +163,31 @@ std::string CallExpression::toString() const
     return out.str();
 }
 
-static __Ptr<EvalObject> evalBangOperatorExpression(__Ptr<EvalObject> right)
+static EvalObject evalBangOperatorExpression(const EvalObject &right)
 {
-    auto &g = Globals::getInstance();
-    if (right == g.getTrue())
+    if (right.type == ObjType::Boolean)
     {
-        return g.getFalse();
-    }
-    else if (right == g.getFalse())
-    {
-        return g.getTrue();
+        return EvalObject::makeBoolean(!right.getBool());
     }
     else
     {
-        return g.getFalse();
+        return EvalObject::makeBoolean(false);
     }
 }
 
-static __Ptr<EvalObject> evalMinusPrefixOperatorExpression(
-    __Ptr<EvalObject> right)
+static EvalObject evalMinusPrefixOperatorExpression(const EvalObject &right)
 {
-    if (right->type != ObjType::Integer)
+    if (right.type != ObjType::Integer)
     {
         Error error;
-        error << "unknown operator: -" << typeStr(right->type);
-        auto e = std::make_shared<EvalObject>();
-        e->type = ObjType::Error;
-        e->value = error.msg();
-        return e;
+        error << "unknown operator: -" << typeStr(right.type);
+        return EvalObject::makeError(error.msg());
     }
-
-    auto o = std::make_shared<EvalObject>();
-    o->type = ObjType::Integer;
-    o->value = -right->getInt();
-    return o;
+    return EvalObject::makeInteger(-right.getInt());
 }
 
-static __Ptr<EvalObject> evalPrefixExpression(const std::string op,
-                                              __Ptr<EvalObject> right)
+static EvalObject evalPrefixExpression(const std::string &op,
+                                       const EvalObject &right)
 {
     if (!op.compare("!"))
     {
@@ -213,137 +200,111 @@ static __Ptr<EvalObject> evalPrefixExpression(const std::string op,
     else
     {
         Error err;
-        err << "unknown operator: " << op << typeStr(right->type);
-        auto e = std::make_shared<EvalObject>();
-        e->type = ObjType::Error;
-        e->value = err.msg();
-        return e;
+        err << "unknown operator: " << op << typeStr(right.type);
+        return EvalObject::makeError(err.msg());
     }
 }
 
-__Ptr<EvalObject> nativeBoolToBooleanObject(bool value)
-{
-    auto g = Globals::getInstance();
-    return value ? g.getTrue() : g.getFalse();
-}
-
-static __Ptr<EvalObject> evalIntegerInfixExpression(const std::string &op,
-                                                    __Ptr<EvalObject> l,
-                                                    __Ptr<EvalObject> r)
+static EvalObject evalIntegerInfixExpression(const std::string &op,
+                                             const EvalObject &l,
+                                             const EvalObject &r)
 {
     if (!op.compare("+"))
     {
-        auto o = std::make_shared<EvalObject>();
-        o->type = ObjType::Integer;
-        o->value = l->getInt() + r->getInt();
-        return o;
+        return EvalObject::makeInteger(l.getInt() + r.getInt());
     }
     else if (!op.compare("-"))
     {
-        auto o = std::make_shared<EvalObject>();
-        o->type = ObjType::Integer;
-        o->value = l->getInt() - r->getInt();
-        return o;
+        return EvalObject::makeInteger(l.getInt() - r.getInt());
     }
     else if (!op.compare("*"))
     {
-        auto o = std::make_shared<EvalObject>();
-        o->type = ObjType::Integer;
-        o->value = l->getInt() * r->getInt();
-        return o;
+        return EvalObject::makeInteger(l.getInt() * r.getInt());
     }
     else if (!op.compare("/"))
     {
-        auto o = std::make_shared<EvalObject>();
-        o->type = ObjType::Integer;
-        o->value = l->getInt() / r->getInt();
-        return o;
+        return EvalObject::makeInteger(l.getInt() / r.getInt());
     }
     else if (!op.compare("<"))
     {
-        return nativeBoolToBooleanObject(l->getInt() < r->getInt());
+        return EvalObject::makeBoolean(l.getInt() < r.getInt());
     }
     else if (!op.compare(">"))
     {
-        return nativeBoolToBooleanObject(l->getInt() > r->getInt());
+        return EvalObject::makeBoolean(l.getInt() > r.getInt());
     }
     else if (!op.compare("=="))
     {
-        return nativeBoolToBooleanObject(l->getInt() == r->getInt());
+        return EvalObject::makeBoolean(l.getInt() == r.getInt());
     }
     else if (!op.compare("!="))
     {
-        return nativeBoolToBooleanObject(l->getInt() != r->getInt());
+        return EvalObject::makeBoolean(l.getInt() != r.getInt());
     }
     else
     {
         Error error;
-        error << "unknown operator: " << typeStr(l->type) << " " << op << " "
-              << typeStr(r->type);
-        auto e = std::make_shared<EvalObject>();
-        e->type = ObjType::Error;
-        e->value = error.msg();
-        return e;
+        error << "unknown operator: " << typeStr(l.type) << " " << op << " "
+              << typeStr(r.type);
+        return EvalObject::makeError(error.msg());
     }
 }
 
-static __Ptr<EvalObject> evalInfixExpression(const std::string &op,
-                                             __Ptr<EvalObject> l,
-                                             __Ptr<EvalObject> r)
+// Booleans and null compare by value, functions and errors by identity.
+static bool isSameObject(const EvalObject &l, const EvalObject &r)
+{
+    return l.type == r.type && l.integer == r.integer && l.heap == r.heap;
+}
+
+static EvalObject evalInfixExpression(const std::string &op,
+                                      const EvalObject &l,
+                                      const EvalObject &r)
 {
-    if (l->type == ObjType::Integer && r->type == ObjType::Integer)
+    if (l.type == ObjType::Integer && r.type == ObjType::Integer)
     {
         return evalIntegerInfixExpression(op, l, r);
     }
     else if (!op.compare("=="))
     {
-        return nativeBoolToBooleanObject(l == r);
+        return EvalObject::makeBoolean(isSameObject(l, r));
     }
     else if (!op.compare("!="))
     {
-        return nativeBoolToBooleanObject(l != r);
+        return EvalObject::makeBoolean(!isSameObject(l, r));
     }
-    else if (l->type != r->type)
+    else if (l.type != r.type)
     {
         Error error;
-        error << "type mismatch: " << typeStr(l->type) << " " << op << " "
-              << typeStr(r->type);
-        auto e = std::make_shared<EvalObject>();
-        e->type = ObjType::Error;
-        e->value = error.msg();
-        return e;
+        error << "type mismatch: " << typeStr(l.type) << " " << op << " "
+              << typeStr(r.type);
+        return EvalObject::makeError(error.msg());
     }
     else
     {
         Error error;
-        error << "unknown operator: " << typeStr(l->type) << " " << op << " "
-              << typeStr(r->type);
-        auto e = std::make_shared<EvalObject>();
-        e->type = ObjType::Error;
-        e->value = error.msg();
-        return e;
+        error << "unknown operator: " << typeStr(l.type) << " " << op << " "
+              << typeStr(r.type);
+        return EvalObject::makeError(error.msg());
     }
 }
 
-__Ptr<EvalObject> IntegerLiteral::evaluate(__Ptr<Environment> env)
+EvalObject IntegerLiteral::evaluate(const __Ptr<Environment> &env)
 {
-    auto o = std::make_shared<EvalObject>();
-    o->type = ObjType::Integer;
-    o->value = value_;
-    return o;
+    return EvalObject::makeInteger(value_);
 }
 
-__Ptr<EvalObject> Program::evaluate(__Ptr<Environment> env)
+EvalObject Program::evaluate(const __Ptr<Environment> &env)
 {
-    __Ptr<EvalObject> result = nullptr;
+    EvalObject result;
     for (const auto &stmt : statements_)
     {
         result = stmt->evaluate(env);
-        if (result->type == ObjType::Return)
+        if (result.returned)
         {
-            return result->getObject();
+            result.returned = false;
+            return result;
         }
-        else if (result->type == ObjType::Error)
+        else if (result.type == ObjType::Error)
         {
             return result;
         }
@@ -351,62 +312,53 @@ __Ptr<EvalObject> Program::evaluate(__Ptr<Environment> env)
     return result;
 }
 
-__Ptr<EvalObject> PrefixExpression::evaluate(__Ptr<Environment> env)
+EvalObject PrefixExpression::evaluate(const __Ptr<Environment> &env)
 {
     auto right = right_->evaluate(env);
     return evalPrefixExpression(operator_, right);
 }
 
-__Ptr<EvalObject> InfixExpression::evaluate(__Ptr<Environment> env)
+EvalObject InfixExpression::evaluate(const __Ptr<Environment> &env)
 {
     auto left = lhs_->evaluate(env);
     auto right = rhs_->evaluate(env);
     return evalInfixExpression(operator_, left, right);
 }
 
-__Ptr<EvalObject> BlockStatement::evaluate(__Ptr<Environment> env)
+EvalObject BlockStatement::evaluate(const __Ptr<Environment> &env)
 {
-    __Ptr<EvalObject> result = nullptr;
+    EvalObject result;
     for (const auto &stmt : statements_)
     {
         result = stmt->evaluate(env);
-        if (result)
+        if (result.returned || result.type == ObjType::Error)
         {
-            if (result->type == ObjType::Return ||
-                result->type == ObjType::Error)
-            {
-                return result;
-            }
+            return result;
         }
     }
     return result;
 }
 
-__Ptr<EvalObject> LetStatement::evaluate(__Ptr<Environment> env)
+EvalObject LetStatement::evaluate(const __Ptr<Environment> &env)
 {
     auto val = value_->evaluate(env);
-    if (val->type == ObjType::Error)
+    if (val.type == ObjType::Error)
     {
         return val;
     }
-    env->set(name_->value(), val);
+    env->set(name_->slot(), val);
     return val;
 }
 
-static bool isTruthy(const EvalObject *o)
+static bool isTruthy(const EvalObject &o)
 {
-    const auto &g = Globals::getInstance();
-    if (o == g.getNull().get())
+    if (o.type == ObjType::Null)
     {
         return false;
     }
-    else if (o == g.getTrue().get())
+    else if (o.type == ObjType::Boolean)
     {
-        return true;
-    }
-    else if (o == g.getFalse().get())
-    {
-        return false;
+        return o.getBool();
     }
     else
     {
@@ -414,11 +366,11 @@ static bool isTruthy(const EvalObject *o)
     }
 }
 
-__Ptr<EvalObject> IfExpression::evaluate(__Ptr<Environment> env)
+EvalObject IfExpression::evaluate(const __Ptr<Environment> &env)
 {
     // evalIfExpression
     auto condition = condition_->evaluate(env);
-    if (isTruthy(condition.get()))
+    if (isTruthy(condition))
     {
         return consequence_->evaluate(env);
     }
@@ -428,117 +380,170 @@ __Ptr<EvalObject> IfExpression::evaluate(__Ptr<Environment> env)
     }
     else
     {
-        return Globals::getInstance().getNull();
+        return EvalObject();
     }
 }
 
-__Ptr<EvalObject> ReturnStatement::evaluate(__Ptr<Environment> env)
+EvalObject ReturnStatement::evaluate(const __Ptr<Environment> &env)
 {
     auto val = return_value_->evaluate(env);
-    auto ret = std::make_shared<EvalObject>();
-    ret->type = ObjType::Return;
-    ret->value = val;
-    return ret;
+    val.returned = true;
+    return val;
 }
 
-static __Ptr<EvalObject> evalIdentifier(Identifier &node,
-                                        const __Ptr<Environment> env)
+EvalObject Identifier::evaluate(const __Ptr<Environment> &env)
 {
-    auto val = env->get(node.value());
-    if (!val)
+    for (const SlotAddress &address : addresses_)
     {
-        Error error;
-        error << "identifier not found: " << node.value();
-        auto e = std::make_shared<EvalObject>();
-        e->type = ObjType::Error;
-        e->value = error.msg();
-        return e;
+        if (const auto &val = env->get(address))
+        {
+            return *val;
+        }
     }
-    return val;
+    Error error;
+    error << "identifier not found: " << value_;
+    return EvalObject::makeError(error.msg());
 }
 
-__Ptr<EvalObject> Identifier::evaluate(__Ptr<Environment> env)
+EvalObject FunctionLiteral::evaluate(const __Ptr<Environment> &env)
 {
-    return evalIdentifier(*this, env);
+    return EvalObject::makeFunction(
+        Function(parameters_, body_, env, nSlots_));
+}
+
+// Evaluates the arguments straight into the parameters' slots of the call's
+// environment. Arguments without a parameter are evaluated and dropped.
+static EvalObject extendFunctionEnv(
+    const Function &fn,
+    const std::vector<__Ptr<Expression>> &args,
+    const __Ptr<Environment> &env,
+    __Ptr<Environment> &extended)
+{
+    extended = Environment::make(fn.environment(), fn.slotsCount());
+    const auto &params = fn.parameters();
+    for (size_t argIdx = 0; argIdx < args.size(); ++argIdx)
+    {
+        auto evaluated = args[argIdx]->evaluate(env);
+        if (evaluated.type == ObjType::Error)
+        {
+            return evaluated;
+        }
+        if (argIdx < params.size())
+        {
+            extended->set(params[argIdx]->slot(), std::move(evaluated));
+        }
+    }
+    return EvalObject();
 }
 
-__Ptr<EvalObject> FunctionLiteral::evaluate(__Ptr<Environment> env)
+static EvalObject unwrapReturnValue(EvalObject obj)
 {
-    auto f = std::make_shared<EvalObject>();
-    f->type = ObjType::Function;
-    f->value = Function(parameters_, body_, env);
-    return f;
+    obj.returned = false;
+    return obj;
 }
 
-static std::vector<__Ptr<EvalObject>> evalExpressions(
-    std::vector<__Ptr<Expression>> exps,
-    __Ptr<Environment> env)
+EvalObject CallExpression::evaluate(const __Ptr<Environment> &env)
 {
-    std::vector<__Ptr<EvalObject>> result;
-    for (auto e : exps)
+    auto f = function_->evaluate(env);
+    if (f.type == ObjType::Error)
+    {
+        return f;
+    }
+    if (f.type != ObjType::Function)
     {
-        auto evaluated = e->evaluate(env);
-        if (evaluated->type == ObjType::Error)
+        // Errors of the arguments come first.
+        for (const auto &a : arguments_)
         {
-            return std::vector<__Ptr<EvalObject>>{evaluated};
+            auto evaluated = a->evaluate(env);
+            if (evaluated.type == ObjType::Error)
+            {
+                return evaluated;
+            }
         }
-        result.emplace_back(evaluated);
+        Error error;
+        error << "not a function: " << typeStr(f.type);
+        return EvalObject::makeError(error.msg());
     }
-    return result;
+
+    const auto &function = f.getFunction();
+    __Ptr<Environment> extendedEnv;
+    auto bound = extendFunctionEnv(function, arguments_, env, extendedEnv);
+    if (bound.type == ObjType::Error)
+    {
+        return bound;
+    }
+    return unwrapReturnValue(function.body()->evaluate(extendedEnv));
 }
 
-static __Ptr<Environment> extendFunctionEnv(Function fn,
-                                            std::vector<__Ptr<EvalObject>> args)
+void Program::resolve(Resolver &resolver)
 {
-    auto env = std::make_shared<Environment>(fn.environment());
-    auto params = fn.parameters();
-    for (size_t paramIdx = 0; paramIdx < params.size(); ++paramIdx)
+    for (const auto &stmt : statements_)
     {
-        auto param = params[paramIdx];
-        env->set(param->value(), args[paramIdx]);
+        stmt->resolve(resolver);
     }
-    return env;
 }
 
-static __Ptr<EvalObject> unwrapReturnValue(__Ptr<EvalObject> obj)
+void Identifier::resolve(Resolver &resolver)
+{
+    resolver.use(*this);
+}
+
+void LetStatement::resolve(Resolver &resolver)
+{
+    value_->resolve(resolver);
+    resolver.declare(*name_);
+}
+
+void ReturnStatement::resolve(Resolver &resolver)
+{
+    return_value_->resolve(resolver);
+}
+
+void PrefixExpression::resolve(Resolver &resolver)
+{
+    right_->resolve(resolver);
+}
+
+void InfixExpression::resolve(Resolver &resolver)
+{
+    lhs_->resolve(resolver);
+    rhs_->resolve(resolver);
+}
+
+void BlockStatement::resolve(Resolver &resolver)
 {
-    if (obj->type == ObjType::Return)
+    for (const auto &stmt : statements_)
     {
-        return obj->getObject();
+        stmt->resolve(resolver);
     }
-    return obj;
 }
 
-static __Ptr<EvalObject> applyFunction(__Ptr<EvalObject> fn,
-                                       std::vector<__Ptr<EvalObject>> args)
+void IfExpression::resolve(Resolver &resolver)
 {
-    if (fn->type != ObjType::Function)
+    condition_->resolve(resolver);
+    consequence_->resolve(resolver);
+    if (alternative_)
     {
-        Error error;
-        error << "not a function: " << typeStr(fn->type);
-        auto e = std::make_shared<EvalObject>();
-        e->type = ObjType::Error;
-        e->value = error.msg();
-        return e;
+        alternative_->resolve(resolver);
     }
-
-    auto function = fn->getFunction();
-    auto extendedEnv = extendFunctionEnv(function, args);
-    auto evaluated = function.body()->evaluate(extendedEnv);
-    return unwrapReturnValue(evaluated);
 }
 
-__Ptr<EvalObject> CallExpression::evaluate(__Ptr<Environment> env)
+void FunctionLiteral::resolve(Resolver &resolver)
 {
-    auto f = function_->evaluate(env);
-    if (f->type == ObjType::Error)
+    resolver.enterFunction();
+    for (const auto &p : parameters_)
     {
-        return f;
+        resolver.declare(*p);
     }
-    auto args = evalExpressions(arguments_, env);
-    if (args.size() == 1 && args[0]->type == ObjType::Error)
+    body_->resolve(resolver);
+    nSlots_ = resolver.exitFunction();
+}
+
+void CallExpression::resolve(Resolver &resolver)
+{
+    function_->resolve(resolver);
+    for (const auto &a : arguments_)
     {
-        return args[0];
+        a->resolve(resolver);
     }
-    return applyFunction(f, args);
-}
+}
\ No newline at end of file
@@ -6,19 +6,19 @@
 #include <string>
 #include <vector>
 
+#include "environment.hpp"
 #include "object.hpp"
 
 class Identifier;
-class Environment;
-
-__Ptr<EvalObject> nativeBoolToBooleanObject(bool value);
+class Resolver;
 
 class Node
 {
 public:
     virtual std::string toString() const = 0;
     virtual ~Node() = default;
-    virtual __Ptr<EvalObject> evaluate(__Ptr<Environment> env) = 0;
+    virtual EvalObject evaluate(const __Ptr<Environment> &env) = 0;
+    virtual void resolve(Resolver &resolver) = 0;
 };
 
 class Statement : public Node
@@ -48,10 +48,14 @@ public:
     {
         return expression_->toString();
     }
-    __Ptr<EvalObject> evaluate(__Ptr<Environment> env) override
+    EvalObject evaluate(const __Ptr<Environment> &env) override
     {
         return expression_->evaluate(env);
     }
+    void resolve(Resolver &resolver) override
+    {
+        expression_->resolve(resolver);
+    }
 
 private:
     __Ptr<Expression> expression_ = nullptr;
@@ -82,7 +86,8 @@ public:
         statements_.emplace_back(std::move(s));
     }
     std::string toString() const override;
-    __Ptr<EvalObject> evaluate(__Ptr<Environment> env) override;
+    EvalObject evaluate(const __Ptr<Environment> &env) override;
+    void resolve(Resolver &resolver) override;
 
 private:
     Statements statements_;
@@ -103,10 +108,27 @@ public:
     {
         return value_;
     }
-    __Ptr<EvalObject> evaluate(__Ptr<Environment> env) override;
+    EvalObject evaluate(const __Ptr<Environment> &env) override;
+    void resolve(Resolver &resolver) override;
+
+    // The slots the value may live in, innermost first, see Resolver. A
+    // name being bound has a single one, in the current environment.
+    const std::vector<SlotAddress> &addresses() const
+    {
+        return addresses_;
+    }
+    void setAddresses(std::vector<SlotAddress> addresses)
+    {
+        addresses_ = std::move(addresses);
+    }
+    int slot() const
+    {
+        return addresses_.front().slot;
+    }
 
 private:
     std::string value_;
+    std::vector<SlotAddress> addresses_;
     // static constexpr size_t max_length = 15; // TODO consider allowing smaller length values.
     // char value_[max_length + 1] = {};
 };
@@ -125,7 +147,10 @@ public:
     {
         return std::to_string(value_);
     }
-    __Ptr<EvalObject> evaluate(__Ptr<Environment> env) override;
+    EvalObject evaluate(const __Ptr<Environment> &env) override;
+    void resolve(Resolver &) override
+    {
+    }
 
 private:
     int value_ = 0;
@@ -147,7 +172,8 @@ public:
     {
         return value_.get();
     }
-    __Ptr<EvalObject> evaluate(__Ptr<Environment> env) override;
+    EvalObject evaluate(const __Ptr<Environment> &env) override;
+    void resolve(Resolver &resolver) override;
 
 private:
     __Ptr<Identifier> name_ = nullptr;
@@ -162,7 +188,8 @@ public:
     {
     }
     std::string toString() const override;
-    __Ptr<EvalObject> evaluate(__Ptr<Environment> env) override;
+    EvalObject evaluate(const __Ptr<Environment> &env) override;
+    void resolve(Resolver &resolver) override;
 
 private:
     __Ptr<Expression> return_value_ = nullptr;
@@ -184,7 +211,8 @@ public:
         return right_.get();
     }
     std::string toString() const override;
-    __Ptr<EvalObject> evaluate(__Ptr<Environment> env) override;
+    EvalObject evaluate(const __Ptr<Environment> &env) override;
+    void resolve(Resolver &resolver) override;
 
 private:
     std::string operator_;
@@ -213,7 +241,8 @@ public:
         return operator_;
     }
     std::string toString() const override;
-    __Ptr<EvalObject> evaluate(__Ptr<Environment> env) override;
+    EvalObject evaluate(const __Ptr<Environment> &env) override;
+    void resolve(Resolver &resolver) override;
 
 private:
     __Ptr<Expression> lhs_;
@@ -235,9 +264,12 @@ public:
     {
         return value_ ? "true" : "false";
     }
-    __Ptr<EvalObject> evaluate(__Ptr<Environment> env) override
+    EvalObject evaluate(const __Ptr<Environment> &env) override
+    {
+        return EvalObject::makeBoolean(value_);
+    }
+    void resolve(Resolver &) override
     {
-        return nativeBoolToBooleanObject(value_);
     }
 
 private:
@@ -260,7 +292,8 @@ public:
     {
         return statements_.at(i).get();
     }
-    __Ptr<EvalObject> evaluate(__Ptr<Environment> env) override;
+    EvalObject evaluate(const __Ptr<Environment> &env) override;
+    void resolve(Resolver &resolver) override;
 
 private:
     std::vector<__Ptr<Statement>> statements_;
@@ -290,7 +323,8 @@ public:
     {
         return alternative_.get();
     }
-    __Ptr<EvalObject> evaluate(__Ptr<Environment> env) override;
+    EvalObject evaluate(const __Ptr<Environment> &env) override;
+    void resolve(Resolver &resolver) override;
 
 private:
     __Ptr<Expression> condition_;
@@ -323,11 +357,13 @@ public:
     {
         return body_.get();
     }
-    __Ptr<EvalObject> evaluate(__Ptr<Environment> env) override;
+    EvalObject evaluate(const __Ptr<Environment> &env) override;
+    void resolve(Resolver &resolver) override;
 
 private:
     __Ptr<BlockStatement> body_;
     std::vector<__Ptr<Identifier>> parameters_;
+    size_t nSlots_ = 0;
 };
 
 class CallExpression : public Expression
@@ -351,7 +387,8 @@ public:
     {
         return arguments_.at(i).get();
     }
-    __Ptr<EvalObject> evaluate(__Ptr<Environment> env) override;
+    EvalObject evaluate(const __Ptr<Environment> &env) override;
+    void resolve(Resolver &resolver) override;
 
 private:
     __Ptr<Expression> function_;
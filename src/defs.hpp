@@ -1,7 +1,10 @@
 #ifndef DEFS_HPP_INCLUDED
 #define DEFS_HPP_INCLUDED
 
-using BufferSize = unsigned short int;
-using Length = unsigned char;
+#include <cstddef>
+
+// Offsets into and lengths within a source, of any size.
+using BufferSize = std::size_t;
+using Length = std::size_t;
 
 #endif
\ No newline at end of file
@@ -1,21 +1,110 @@
 #include "environment.hpp"
-#include "object.hpp"
 
-__Ptr<EvalObject> Environment::get(const std::string &name) const
+namespace
 {
-    auto it = repo_.find(name);
-    if (it == repo_.end() && outer_)
+// Hands out blocks of one type from a free list of the thread, so that the
+// control blocks of call environments are not allocated per call.
+template <typename T>
+class PoolAllocator
+{
+public:
+    using value_type = T;
+
+    PoolAllocator() = default;
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> &)
+    {
+    }
+
+    T *allocate(size_t n)
+    {
+        auto &blocks = freeList().blocks;
+        if (n != 1 || blocks.empty())
+        {
+            return std::allocator<T>().allocate(n);
+        }
+        T *block = blocks.back();
+        blocks.pop_back();
+        return block;
+    }
+    void deallocate(T *block, size_t n)
+    {
+        if (n != 1)
+        {
+            std::allocator<T>().deallocate(block, n);
+            return;
+        }
+        freeList().blocks.push_back(block);
+    }
+
+    friend bool operator==(const PoolAllocator &, const PoolAllocator &)
+    {
+        return true;
+    }
+
+private:
+    struct FreeList
+    {
+        ~FreeList()
+        {
+            for (T *block : blocks)
+            {
+                std::allocator<T>().deallocate(block, 1);
+            }
+        }
+        std::vector<T *> blocks;
+    };
+
+    static FreeList &freeList()
+    {
+        thread_local FreeList list;
+        return list;
+    }
+};
+
+std::vector<std::unique_ptr<Environment>> &freeEnvironments()
+{
+    thread_local std::vector<std::unique_ptr<Environment>> environments;
+    return environments;
+}
+} // namespace
+
+__Ptr<Environment> Environment::make(__Ptr<Environment> outer, size_t nSlots)
+{
+    auto &pool = freeEnvironments();
+    std::unique_ptr<Environment> env;
+    if (pool.empty())
     {
-        return outer_->get(name);
+        env = std::make_unique<Environment>();
     }
-    else if (it != repo_.end())
+    else
     {
-        return it->second;
+        env = std::move(pool.back());
+        pool.pop_back();
     }
-    return nullptr;
+    env->outer_ = std::move(outer);
+    env->slots_.resize(nSlots);
+    return __Ptr<Environment>(env.release(),
+                              &Environment::recycle,
+                              PoolAllocator<Environment>());
+}
+
+void Environment::recycle(Environment *env)
+{
+    // The slot array keeps its capacity for the next call. Releasing the
+    // values may recycle further environments.
+    env->slots_.clear();
+    env->outer_ = nullptr;
+    freeEnvironments().emplace_back(env);
 }
 
-void Environment::set(const std::string &name, __Ptr<EvalObject> val)
+int Environment::declare(const std::string &name)
 {
-    repo_[name] = val;
-}
\ No newline at end of file
+    auto [it, added] =
+        names_.try_emplace(name, static_cast<int>(slots_.size()));
+    if (added)
+    {
+        slots_.emplace_back();
+    }
+    return it->second;
+}
@@ -2,26 +2,55 @@
 #define ENVIRONMENT_HPP_INCLUDED
 
 #include "macros.hpp"
-#include <map>
+#include "object.hpp"
 #include <memory>
+#include <optional>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
-struct EvalObject;
+// Where a variable lives: a slot of the environment depth levels out from
+// the current one, as assigned by the Resolver.
+struct SlotAddress
+{
+    int depth = 0;
+    int slot = 0;
+};
 
+// The values of one scope, held in the slots the Resolver assigned. The
+// top-level environment also maps its names to slots, since every program
+// evaluated in it is resolved against them. A call's environment is only
+// its slots and is recycled once released, see make().
 class Environment
 {
 public:
     Environment() = default;
-    Environment(__Ptr<Environment> env) : outer_(env)
+
+    // A call environment of nSlots unset slots, enclosed by outer.
+    static __Ptr<Environment> make(__Ptr<Environment> outer, size_t nSlots);
+
+    const std::optional<EvalObject> &get(SlotAddress address) const
     {
+        const Environment *env = this;
+        for (int i = 0; i < address.depth; ++i)
+        {
+            env = env->outer_.get();
+        }
+        return env->slots_[address.slot];
     }
-
-    __Ptr<EvalObject> get(const std::string &name) const;
-    void set(const std::string &name, __Ptr<EvalObject> val);
+    void set(int slot, EvalObject val)
+    {
+        slots_[slot] = std::move(val);
+    }
+    // The slot of a top-level name, added unset if the name is new.
+    int declare(const std::string &name);
 
 private:
-    std::map<std::string, __Ptr<EvalObject>> repo_;
+    static void recycle(Environment *env);
+
+    std::vector<std::optional<EvalObject>> slots_;
     __Ptr<Environment> outer_ = nullptr;
+    std::unordered_map<std::string, int> names_;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -3,9 +3,11 @@
 #include "ast.hpp"
 #include "environment.hpp"
 #include "object.hpp"
+#include "resolver.hpp"
 #include <iostream>
 
-__Ptr<EvalObject> Eval(Node *n, __Ptr<Environment> env)
+EvalObject Eval(Node *n, __Ptr<Environment> env)
 {
+    Resolver(*env).resolve(*n);
     return n->evaluate(env);
 }
\ No newline at end of file
@@ -7,6 +7,8 @@
 class Node;
 class Environment;
 
-__Ptr<EvalObject> Eval(Node *n, __Ptr<Environment> env);
+// Resolves the variables of n against env, its top-level environment,
+// before evaluating it.
+EvalObject Eval(Node *n, __Ptr<Environment> env);
 
 #endif
\ No newline at end of file
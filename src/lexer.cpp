@@ -1,35 +1,278 @@
 #include "lexer.hpp"
+#include "TMappedFile.hpp"
+#include "TThreadPool.hpp"
 #include "Token.hpp"
 #include "macros.hpp"
 
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
 #include <limits>
 #include <stdexcept>
 
-Scanner::Scanner(std::istream &in) : reader_(in)
+#if defined(__SSE2__)
+#define DAEWOO_SSE2_SCANNER 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+
+enum TCharClass : uint8_t
+{
+    ccLetter = 1, // including '_'
+    ccDigit = 2,
+    ccBlank = 4 // ' ' and '\t'
+};
+
+constexpr std::array<uint8_t, 256> kCharClasses = [] {
+    std::array<uint8_t, 256> classes{};
+    for (int ch = 'a'; ch <= 'z'; ++ch)
+    {
+        classes[ch] = ccLetter;
+        classes[ch - 'a' + 'A'] = ccLetter;
+    }
+    classes['_'] = ccLetter;
+    for (int ch = '0'; ch <= '9'; ++ch)
+    {
+        classes[ch] = ccDigit;
+    }
+    classes[' '] = ccBlank;
+    classes['\t'] = ccBlank;
+    return classes;
+}();
+
+bool hasClass(char ch, uint8_t classes)
+{
+    return (kCharClasses[static_cast<unsigned char>(ch)] & classes) != 0;
+}
+
+#ifdef DAEWOO_SSE2_SCANNER
+// Lanes whose unsigned value is below n.
+__m128i below(__m128i chars, uint8_t n)
+{
+    const __m128i sign = _mm_set1_epi8(static_cast<char>(0x80));
+    return _mm_cmplt_epi8(_mm_xor_si128(chars, sign),
+                          _mm_set1_epi8(static_cast<char>(n ^ 0x80)));
+}
+
+// Lanes in any of the classes, the vector version of hasClass.
+__m128i classify(__m128i chars, uint8_t classes)
+{
+    __m128i in = _mm_setzero_si128();
+    if (classes & ccLetter)
+    {
+        __m128i lower = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+        in = _mm_or_si128(in, below(_mm_sub_epi8(lower, _mm_set1_epi8('a')),
+                                    26));
+        in = _mm_or_si128(in, _mm_cmpeq_epi8(chars, _mm_set1_epi8('_')));
+    }
+    if (classes & ccDigit)
+    {
+        in = _mm_or_si128(in,
+                          below(_mm_sub_epi8(chars, _mm_set1_epi8('0')), 10));
+    }
+    if (classes & ccBlank)
+    {
+        in = _mm_or_si128(in, _mm_cmpeq_epi8(chars, _mm_set1_epi8(' ')));
+        in = _mm_or_si128(in, _mm_cmpeq_epi8(chars, _mm_set1_epi8('\t')));
+    }
+    return in;
+}
+#endif
+
+// The first character from p on that is in none of the classes.
+const char *skipClasses(const char *p, const char *end, uint8_t classes)
+{
+#ifdef DAEWOO_SSE2_SCANNER
+    for (; end - p >= 16; p += 16)
+    {
+        __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        auto out = static_cast<unsigned>(
+            ~_mm_movemask_epi8(classify(chars, classes)) & 0xffff);
+        if (out != 0)
+        {
+            return p + std::countr_zero(out);
+        }
+    }
+#endif
+    while (p < end && hasClass(*p, classes))
+    {
+        ++p;
+    }
+    return p;
+}
+
+// The first of the characters a, b and c from p on, or end.
+const char *findAny(const char *p, const char *end, char a, char b, char c)
+{
+#ifdef DAEWOO_SSE2_SCANNER
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    const __m128i vc = _mm_set1_epi8(c);
+    for (; end - p >= 16; p += 16)
+    {
+        __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        __m128i hit = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chars, va), _mm_cmpeq_epi8(chars, vb)),
+            _mm_cmpeq_epi8(chars, vc));
+        auto mask = static_cast<unsigned>(_mm_movemask_epi8(hit));
+        if (mask != 0)
+        {
+            return p + std::countr_zero(mask);
+        }
+    }
+#endif
+    while (p < end && *p != a && *p != b && *p != c)
+    {
+        ++p;
+    }
+    return p;
+}
+
+struct TKeyword
+{
+    std::string_view word;
+    TokenCode code;
+};
+
+constexpr TKeyword kKeywords[] = {
+    {"let", TokenCode::tLet},
+    {"if", TokenCode::tIf},
+    {"do", TokenCode::tDo},
+    {"to", TokenCode::tTo},
+    {"or", TokenCode::tOr},
+    // {"in", TokenCode::tIn},
+
+    {"end", TokenCode::tEnd},
+    {"for", TokenCode::tFor},
+    {"and", TokenCode::tAnd},
+    // {"xor", TokenCode::tXor},
+    {"not", TokenCode::tNot},
+    // {"div", TokenCode::tDivI},
+    // {"mod", TokenCode::tMod},
+    // {"inc", TokenCode::tInc},
+    // {"dec", TokenCode::tDec},
+
+    {"then", TokenCode::tThen},
+    {"else", TokenCode::tElse},
+    {"true", TokenCode::tTrue},
+    {"false", TokenCode::tFalse},
+    {"print", TokenCode::tPrint},
+    {"step", TokenCode::tStep},
+
+    {"while", TokenCode::tWhile},
+    {"until", TokenCode::tUntil},
+    {"break", TokenCode::tBreak},
+    {"println", TokenCode::tPrintln},
+    // {"setColor", TokenCode::tSetColor},
+
+    {"repeat", TokenCode::tRepeat},
+    {"downto", TokenCode::tDownTo},
+
+    // {"assertTrue", TokenCode::tAssertTrue},
+    // {"assertFalse", TokenCode::tAssertFalse},
+
+    {"fn", TokenCode::tFunction},
+    {"return", TokenCode::tReturn},
+    {"global", TokenCode::tGlobal},
+    {"import", TokenCode::tImport},
+    // {"ref", TokenCode::tRef},
+    {"switch", TokenCode::tSwitch},
+    {"case", TokenCode::tCase},
+};
+constexpr size_t kMaxKeyword = 7;
+constexpr size_t kKeywordSlots = 64;
+
+constexpr size_t keywordSlot(std::string_view word)
+{
+    return (static_cast<unsigned char>(word.front()) * 7u +
+            static_cast<unsigned char>(word.back()) * 3u + word.size()) %
+           kKeywordSlots;
+}
+
+// An open addressing hash table of indices into kKeywords, -1 marks an
+// empty slot.
+constexpr std::array<int8_t, kKeywordSlots> kKeywordTable = [] {
+    std::array<int8_t, kKeywordSlots> table{};
+    table.fill(-1);
+    for (size_t i = 0; i < std::size(kKeywords); ++i)
+    {
+        size_t slot = keywordSlot(kKeywords[i].word);
+        while (table[slot] >= 0)
+        {
+            slot = (slot + 1) % kKeywordSlots;
+        }
+        table[slot] = static_cast<int8_t>(i);
+    }
+    return table;
+}();
+
+} // namespace
+
+Scanner::Scanner(std::istream &in)
+{
+    auto buffer = std::make_shared<std::string>();
+    char chunk[1 << 16];
+    while (in.read(chunk, sizeof(chunk)) || in.gcount() > 0)
+    {
+        buffer->append(chunk, static_cast<size_t>(in.gcount()));
+    }
+    begin_ = pos_ = buffer->data();
+    end_ = pos_ + buffer->size();
+    source_ = std::move(buffer);
+    startScanner(1, 1);
+}
+
+Scanner::Scanner(std::string_view source) : Scanner(source, 1, 1)
+{
+}
+
+Scanner::Scanner(std::string_view source, int firstLine, int firstColumn)
+    : begin_(source.data()), pos_(source.data()),
+      end_(source.data() + source.size())
+{
+    startScanner(firstLine, firstColumn);
+}
+
+Scanner::Scanner(std::shared_ptr<const std::string> source)
+    : Scanner(std::string_view(*source))
 {
-    startScanner();
-    addKeywords();
+    source_ = std::move(source);
 }
 
-void Scanner::startScanner()
+Scanner::Scanner(std::shared_ptr<const TMappedFile> file)
+    : Scanner(std::string_view(file->data(), file->size()))
 {
-    lineNumber_ = 1;
-    columnNumber_ = 0;
+    source_ = std::move(file);
+}
+
+void Scanner::startScanner(int firstLine, int firstColumn)
+{
+    lineNumber_ = firstLine;
+    columnNumber_ = firstColumn - 1;
     ch_ = nextChar();
 }
 
+// Reading the end yields EOF and counts as a column once, as reading it
+// from a stream did.
 char Scanner::readRawChar()
 {
-    if (reader_.eof())
+    if (pos_ < end_)
     {
-        return EOF;
+        ++columnNumber_;
+        return *pos_++;
     }
-    else
+    if (!eofRead_)
     {
+        eofRead_ = true;
         ++columnNumber_;
-        return reader_.get();
     }
+    return EOF;
 }
 
 char Scanner::getOS_IndependentChar()
@@ -63,7 +306,7 @@ char Scanner::getOS_IndependentChar()
     }
 }
 
-char Scanner::nextChar()
+char Scanner::nextCharSlow()
 {
     // tokenWasLF_ = false;
     char ch = getOS_IndependentChar();
@@ -83,7 +326,10 @@ void Scanner::skipMultiLineComment()
     while (true)
     {
         while (ch_ != '*' && ch_ != EOF)
+        {
+            skipTo(findAny(pos_, end_, '*', LF, CR));
             ch_ = nextChar();
+        }
 
         if (ch_ == EOF)
             return;
@@ -102,7 +348,10 @@ void Scanner::skipMultiLineComment()
 void Scanner::skipSingleLineComment()
 {
     while (ch_ != LF && ch_ != EOF)
+    {
+        skipTo(findAny(pos_, end_, LF, CR, LF));
         ch_ = getOS_IndependentChar();
+    }
     if (ch_ != EOF)
         ch_ = nextChar();
     columnNumber_ = 1;
@@ -114,10 +363,13 @@ void Scanner::skipBlanksAndComments()
     while (ch_ == ' ' || ch_ == '\t' || ch_ == '/')
     {
         if (ch_ == ' ' || ch_ == '\t')
+        {
+            skipTo(skipClasses(pos_, end_, ccBlank));
             ch_ = nextChar();
+        }
         else
         {
-            if (reader_.peek() == '/' || reader_.peek() == '*')
+            if (peekChar() == '/' || peekChar() == '*')
             {
                 ch_ = getOS_IndependentChar();
                 if (ch_ == '/')
@@ -165,7 +417,7 @@ void Scanner::getNumber()
                 return;
             }
 
-            if (!isdigit(ch_))
+            if (!isDigit(ch_))
                 break;
         }
     }
@@ -175,7 +427,7 @@ void Scanner::getNumber()
         tokenRecord_.setCode(TokenCode::tFloat);
         tokenRecord_.setFloat(tokenRecord_.tInt());
         ch_ = nextChar();
-        while (isdigit(ch_))
+        while (isDigit(ch_))
         {
             scale *= 0.1;
             singleDigit = ch_ - '0';
@@ -199,7 +451,7 @@ void Scanner::getNumber()
                 exponentSign = -1;
             ch_ = nextChar();
         }
-        if (!isdigit(ch_))
+        if (!isDigit(ch_))
         {
             error_.setError("syntax error: number expected in exponent",
                             lineNumber_,
@@ -225,7 +477,7 @@ void Scanner::getNumber()
                     columnNumber_);
                 return;
             }
-            if (!isdigit(ch_))
+            if (!isDigit(ch_))
                 break;
         }
 
@@ -258,43 +510,56 @@ void Scanner::getHexNumber()
 
 bool Scanner::isHexDigit(char ch)
 {
-    return (std::isdigit(ch) || (ch >= 'A' && ch <= 'F'));
+    return (isDigit(ch) || (ch >= 'A' && ch <= 'F'));
 }
 
+// A word starts at the letter in ch_, the character before pos_.
 void Scanner::getWord()
 {
-    tokenRecord_.setString("");
-    while (isLetter(ch_) || isdigit(ch_))
-    {
-        tokenRecord_.setString(tokenRecord_.tString() + ch_);
-        ch_ = nextChar();
-    }
+    const char *start = pos_ - 1;
+    skipTo(skipClasses(pos_, end_, ccLetter | ccDigit));
+    tokenRecord_.setString(std::string_view(start, pos_ - start));
+    ch_ = nextChar();
 
     tokenRecord_.setCode(getKeywordCode(tokenRecord_.tString()));
 }
 
-bool Scanner::isLetter(char ch) const
+bool Scanner::isLetter(char ch)
 {
-    return isalpha(ch) || ch == '_';
+    return hasClass(ch, ccLetter);
+}
+
+bool Scanner::isDigit(char ch)
+{
+    return hasClass(ch, ccDigit);
 }
 
+// The text of a string is a view of the source between the quotes, line
+// breaks included. Only the first character goes through nextChar.
 void Scanner::getString()
 {
-    tokenRecord_.setString("");
+    tokenRecord_.setString({});
     tokenRecord_.setCode(TokenCode::tString);
+    const char *start = pos_;
     ch_ = nextChar();
-    while (ch_ != EOF)
+    if (ch_ == '"')
+    {
+        ch_ = nextChar();
+        return;
+    }
+    if (ch_ != EOF)
     {
+        const auto *quote =
+            static_cast<const char *>(std::memchr(pos_, '"', end_ - pos_));
+        const char *stop = quote ? quote : end_;
+        skipTo(stop);
+        tokenRecord_.setString(std::string_view(start, stop - start));
+        ch_ = readRawChar();
         if (ch_ == '"')
         {
             ch_ = nextChar();
             return;
         }
-        else
-        {
-            tokenRecord_.setString(tokenRecord_.tString() + ch_);
-            ch_ = readRawChar();
-        }
     }
     error_.setError("String without terminating quotation mark at line " +
                         std::to_string(lineNumber_) + ", column ",
@@ -333,7 +598,7 @@ void Scanner::getSpecial()
         break;
     case '!':
     {
-        if (reader_.peek() == '=')
+        if (peekChar() == '=')
         {
             ch_ = nextChar();
             tokenRecord_.setCode(TokenCode::tNotEqual);
@@ -350,7 +615,7 @@ void Scanner::getSpecial()
     }
     case '>':
     {
-        if (reader_.peek() == '=')
+        if (peekChar() == '=')
         {
             ch_ = nextChar();
             tokenRecord_.setCode(TokenCode::tMoreThanOrEqual);
@@ -363,7 +628,7 @@ void Scanner::getSpecial()
     }
     case '<':
     {
-        if (reader_.peek() == '=')
+        if (peekChar() == '=')
         {
             ch_ = nextChar();
             tokenRecord_.setCode(TokenCode::tLessThanOrEqual);
@@ -376,7 +641,7 @@ void Scanner::getSpecial()
     }
     case '=':
     {
-        if (reader_.peek() == '=')
+        if (peekChar() == '=')
         {
             ch_ = nextChar();
             tokenRecord_.setCode(TokenCode::tEquivalence);
@@ -419,9 +684,159 @@ void Scanner::getSpecial()
     ch_ = nextChar();
 }
 
+// Chunks start after a line feed that a line break does not follow, where
+// a fresh scanner counts columns like a sequential one. Every chunk is
+// scanned on its own, on to the first token past its end. A chunk that
+// starts inside a comment or a string goes wrong until it reaches a token
+// the previous chunk also stops at, from there on it is that of a
+// sequential scan; a chunk that never gets there is scanned again.
+void Scanner::scanAll(TThreadPool &pool, size_t chunkSize)
+{
+    size_t nChunks = std::min(std::max<size_t>(1, sourceSize() / chunkSize),
+                              (pool.size() + 1) * 4);
+    std::vector<const char *> bounds{begin_};
+    for (size_t i = 1; i < nChunks; ++i)
+    {
+        const char *p = begin_ + i * sourceSize() / nChunks;
+        while (p < end_ &&
+               (p = static_cast<const char *>(
+                    std::memchr(p, LF, end_ - p))) != nullptr &&
+               ++p < end_ && (*p == LF || *p == CR))
+        {
+        }
+        if (p != nullptr && p > bounds.back() && p < end_)
+        {
+            bounds.push_back(p);
+        }
+    }
+    bounds.push_back(end_);
+
+    // A wrong scan might run through the rest of the source in a comment,
+    // it is clipped at the end of the next chunk.
+    size_t n = bounds.size() - 1;
+    scanned_.resize(n);
+    pool.parallelFor(n, [&](size_t i) {
+        scanned_[i] = scanRange(bounds[i],
+                                bounds[i + 1],
+                                i == 0 ? end_ : bounds[std::min(i + 2, n)],
+                                1,
+                                1);
+    });
+
+    // The first chunk starts where a sequential scan does.
+    for (size_t i = 1; i < n; ++i)
+    {
+        const TScannedChunk &previous = scanned_[i - 1];
+        if (previous.stop == nullptr)
+        {
+            // The source ends or fails in the previous chunk
+            scanned_.resize(i);
+            break;
+        }
+        int line = previous.stopLine + previous.lineDelta;
+        TScannedChunk &chunk = scanned_[i];
+        auto start = std::lower_bound(chunk.starts.begin(),
+                                      chunk.starts.end(),
+                                      previous.stop);
+        size_t first = start - chunk.starts.begin();
+        if (!chunk.error && !chunk.clipped && start != chunk.starts.end() &&
+            *start == previous.stop &&
+            chunk.tokens[first].columnNumber() == previous.stopColumn)
+        {
+            chunk.first = first;
+            chunk.lineDelta = line - chunk.tokens[first].lineNumber();
+        }
+        else
+        {
+            chunk = scanRange(previous.stop,
+                              bounds[i + 1],
+                              end_,
+                              line,
+                              previous.stopColumn);
+        }
+    }
+    scannedChunk_ = 0;
+    scannedToken_ = 0;
+}
+
+// Scans from begin, which a token or the start of the source follows, up to
+// the first token that starts at or past limit.
+Scanner::TScannedChunk Scanner::scanRange(const char *begin,
+                                          const char *limit,
+                                          const char *end,
+                                          int firstLine,
+                                          int firstColumn) const
+{
+    TScannedChunk chunk;
+    chunk.tokens.reserve((limit - begin) / 3 + 1);
+    chunk.starts.reserve((limit - begin) / 3 + 1);
+    try
+    {
+        Scanner sc(std::string_view(begin, end - begin),
+                   firstLine,
+                   firstColumn);
+        while (true)
+        {
+            sc.skipBlanksAndComments();
+            const char *start = sc.ch_ == EOF ? end : sc.pos_ - 1;
+            if (sc.ch_ != EOF && start >= limit)
+            {
+                chunk.stop = start;
+                chunk.stopLine = sc.lineNumber_;
+                chunk.stopColumn = sc.columnNumber_;
+                break;
+            }
+            sc.getToken();
+            chunk.tokens.push_back(sc.token());
+            chunk.starts.push_back(start);
+            if (sc.token().code() == TokenCode::tEndofStream)
+            {
+                chunk.clipped = end != end_;
+                break;
+            }
+        }
+    }
+    catch (...)
+    {
+        chunk.error = std::current_exception();
+    }
+    return chunk;
+}
+
+void Scanner::nextScannedToken()
+{
+    while (scannedToken_ == scanned_[scannedChunk_].tokens.size())
+    {
+        const TScannedChunk &chunk = scanned_[scannedChunk_];
+        if (chunk.error)
+        {
+            std::rethrow_exception(chunk.error);
+        }
+        ++scannedChunk_;
+        scannedToken_ = scanned_[scannedChunk_].first;
+    }
+    const TScannedChunk &chunk = scanned_[scannedChunk_];
+    const TokenRecord &token = chunk.tokens[scannedToken_];
+    tokenRecord_ = token;
+    tokenRecord_.setLineNumber(token.lineNumber() + chunk.lineDelta);
+    if (token.code() != TokenCode::tEndofStream)
+    {
+        ++scannedToken_;
+    }
+}
+
 void Scanner::nextToken()
 {
+    if (!scanned_.empty())
+    {
+        return nextScannedToken();
+    }
     skipBlanksAndComments();
+    getToken();
+}
+
+void Scanner::getToken()
+{
     tokenRecord_.setLineNumber(lineNumber_);
     tokenRecord_.setColumnNumber(columnNumber_);
 
@@ -429,7 +844,7 @@ void Scanner::nextToken()
     {
         getWord();
     }
-    else if (isdigit(ch_) || ch_ == '.')
+    else if (isDigit(ch_) || ch_ == '.')
     {
         getNumber();
     }
@@ -469,7 +884,7 @@ std::string Scanner::tokenToString(TokenCode code)
     case TokenCode::tFloat:
         return "float';// + floattostr (tokenElement.FTokenFloat) + '>";
     case TokenCode::tString:
-        return "string " + tokenRecord_.tString();
+        return "string " + std::string(tokenRecord_.tString());
     case TokenCode::tMinus:
         return "character: '-'";
     case TokenCode::tPlus:
@@ -586,15 +1001,6 @@ std::string Scanner::tokenToString(TokenCode code)
 
 /* ------------------------------------------------ */
 
-std::unordered_map<std::string, Token::Type> Lexer::keywords_ = {
-    {"fn", Token::Type::Function},
-    {"let", Token::Type::Let},
-    {"true", Token::Type::True},
-    {"false", Token::Type::False},
-    {"if", Token::Type::If},
-    {"else", Token::Type::Else},
-    {"return", Token::Type::Return}};
-
 static bool isLetter(char ch)
 {
     return isalpha(ch) || ch == '_';
@@ -605,14 +1011,14 @@ static bool isDigit(char ch)
     return '0' <= ch && ch <= '9';
 }
 
-Lexer::Lexer(const std::string &input) : input_(input)
+Lexer::Lexer(std::string_view input) : input_(input)
 {
-    if (input_.size() > std::numeric_limits<BufferSize>::max())
-    {
-        throw std::out_of_range(
-            "Input size exceeds maximum allowed BufferSize");
-    }
+    readChar();
+}
 
+Lexer::Lexer(std::shared_ptr<const TMappedFile> file)
+    : file_(std::move(file)), input_(file_->data(), file_->size())
+{
     readChar();
 }
 
@@ -624,15 +1030,8 @@ void Lexer::readChar()
     }
     else
     {
-        ch_ = input_.at(read_position_);
-    }
-
-    if (input_.size() > std::numeric_limits<decltype(read_position_)>::max())
-    {
-        throw std::out_of_range(
-            "Input size exceeds maximum allowed BufferSize");
+        ch_ = input_[read_position_];
     }
-
     position_ = read_position_++;
 }
 
@@ -730,11 +1129,6 @@ Token Lexer::nextToken()
     return token;
 }
 
-std::string Lexer::getLiteral(const Token &token) const
-{
-    return input_.substr(token.position_, token.length_);
-}
-
 Length Lexer::readIdentifier()
 {
     BufferSize position = position_;
@@ -742,21 +1136,27 @@ Length Lexer::readIdentifier()
     {
         readChar();
     }
-
-    BufferSize length = position_ - position;
-    if (length > std::numeric_limits<Length>::max())
-    {
-        throw std::out_of_range(
-            "Input size exceeds maximum allowed BufferSize");
-    }
-
-    return static_cast<Length>(length);
+    return position_ - position;
 }
 
-Token::Type Lexer::lookupIdent(const std::string &ident)
+Token::Type Lexer::lookupIdent(std::string_view ident)
 {
-    auto it = keywords_.find(ident);
-    return it == keywords_.end() ? Token::Type::Ident : it->second;
+    static constexpr std::pair<std::string_view, Token::Type> keywords[] = {
+        {"fn", Token::Type::Function},
+        {"let", Token::Type::Let},
+        {"true", Token::Type::True},
+        {"false", Token::Type::False},
+        {"if", Token::Type::If},
+        {"else", Token::Type::Else},
+        {"return", Token::Type::Return}};
+    for (const auto &[keyword, type] : keywords)
+    {
+        if (ident == keyword)
+        {
+            return type;
+        }
+    }
+    return Token::Type::Ident;
 }
 
 void Lexer::skipWhitespace()
@@ -774,15 +1174,7 @@ Length Lexer::readNumber()
     {
         readChar();
     }
-
-    BufferSize length = position_ - position;
-    if (length > std::numeric_limits<Length>::max())
-    {
-        throw std::out_of_range(
-            "Input size exceeds maximum allowed BufferSize");
-    }
-
-    return static_cast<Length>(length);
+    return position_ - position;
 }
 
 char Lexer::peekChar()
@@ -797,59 +1189,20 @@ char Lexer::peekChar()
     }
 }
 
-void Scanner::addKeywords()
-{
-    tKeywords_.emplace("let", TokenCode::tLet);
-    tKeywords_.emplace("if", TokenCode::tIf);
-    tKeywords_.emplace("do", TokenCode::tDo);
-    tKeywords_.emplace("to", TokenCode::tTo);
-    tKeywords_.emplace("or", TokenCode::tOr);
-    // tKeywords_.emplace("in", TokenCode::tIn);
-
-    tKeywords_.emplace("end", TokenCode::tEnd);
-    tKeywords_.emplace("for", TokenCode::tFor);
-    tKeywords_.emplace("and", TokenCode::tAnd);
-    // tKeywords_.emplace("xor", TokenCode::tXor);
-    tKeywords_.emplace("not", TokenCode::tNot);
-    // tKeywords_.emplace("div", TokenCode::tDivI);
-    //  tKeywords_.emplace("mod", TokenCode::tMod);
-    //  tKeywords_.emplace("inc", TokenCode::tInc);
-    //  tKeywords_.emplace("dec", TokenCode::tDec);
-
-    tKeywords_.emplace("then", TokenCode::tThen);
-    tKeywords_.emplace("else", TokenCode::tElse);
-    tKeywords_.emplace("true", TokenCode::tTrue);
-    tKeywords_.emplace("false", TokenCode::tFalse);
-    tKeywords_.emplace("print", TokenCode::tPrint);
-    tKeywords_.emplace("step", TokenCode::tStep);
-
-    tKeywords_.emplace("while", TokenCode::tWhile);
-    tKeywords_.emplace("until", TokenCode::tUntil);
-    tKeywords_.emplace("break", TokenCode::tBreak);
-    tKeywords_.emplace("println", TokenCode::tPrintln);
-    // tKeywords_.emplace("setColor", TokenCode::tSetColor);
-
-    tKeywords_.emplace("repeat", TokenCode::tRepeat);
-    tKeywords_.emplace("downto", TokenCode::tDownTo);
-
-    // tKeywords_.emplace("assertTrue", TokenCode::tAssertTrue);
-    // tKeywords_.emplace("assertFalse", TokenCode::tAssertFalse);
-
-    tKeywords_.emplace("fn", TokenCode::tFunction);
-    tKeywords_.emplace("return", TokenCode::tReturn);
-    tKeywords_.emplace("global", TokenCode::tGlobal);
-    tKeywords_.emplace("import", TokenCode::tImport);
-    // tKeywords_.emplace("ref", TokenCode::tRef);
-    tKeywords_.emplace("switch", TokenCode::tSwitch);
-    tKeywords_.emplace("case", TokenCode::tCase);
-}
-
-TokenCode Scanner::getKeywordCode(const std::string &value)
+TokenCode Scanner::getKeywordCode(std::string_view value)
 {
-    auto it = tKeywords_.find(value);
-    if (it != tKeywords_.end())
+    if (value.empty() || value.size() > kMaxKeyword)
+    {
+        return TokenCode::tIdentifier;
+    }
+    for (size_t slot = keywordSlot(value); kKeywordTable[slot] >= 0;
+         slot = (slot + 1) % kKeywordSlots)
     {
-        return it->second;
+        const auto &keyword = kKeywords[kKeywordTable[slot]];
+        if (keyword.word == value)
+        {
+            return keyword.code;
+        }
     }
     return TokenCode::tIdentifier;
 }
\ No newline at end of file
@@ -4,10 +4,16 @@
 #include "Token.hpp"
 #include "defs.hpp"
 #include <deque>
+#include <exception>
 #include <istream>
+#include <memory>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <utility>
+#include <vector>
+
+class TMappedFile;
+class TThreadPool;
 
 class ScannerError
 {
@@ -39,51 +45,134 @@ private:
     int columnNumber_ = 0;
 };
 
+/*
+ * The scanner works over one contiguous buffer: a string or a mapped file
+ * scanned in place, or a stream read in once. Blanks, comments, strings
+ * and identifiers are skipped a vector of characters at a time, the rest
+ * is classified through a table.
+ */
 class Scanner
 {
 public:
-    Scanner(std::istream &input);
+    explicit Scanner(std::istream &input);
+    // The source must outlive the scanner and the tokens it returns.
+    explicit Scanner(std::string_view source);
+    explicit Scanner(std::shared_ptr<const std::string> source);
+    explicit Scanner(std::shared_ptr<const TMappedFile> file);
+    Scanner(const Scanner &) = delete;
+    Scanner &operator=(const Scanner &) = delete;
+    // Scans the whole source up front on the pool, a chunk of at least
+    // chunkSize characters per task, and hands out the tokens from then on.
+    // Tokens, positions and errors are those of a sequential scan, an error
+    // is thrown when the token it stops at is reached. Must be called before
+    // the first token is read.
+    void scanAll(TThreadPool &pool, size_t chunkSize = 1 << 20);
     void nextToken();
     const TokenRecord &token() const
     {
         return tokenRecord_;
     }
+    // The owner of the buffer token texts point into, nullptr if the
+    // caller owns it.
+    const std::shared_ptr<const void> &source() const
+    {
+        return source_;
+    }
+    size_t sourceSize() const
+    {
+        return static_cast<size_t>(end_ - begin_);
+    }
 
     std::string tokenToString(TokenCode code);
 
 private:
-    bool isEof() const
+    // The tokens of a chunk of the source, from first on, and where they
+    // start. The chunk ends with the token stop, the end of stream or an
+    // error. Chunks scanned on their own count lines from 1, lineDelta
+    // makes them count from the start of the source.
+    struct TScannedChunk
+    {
+        std::vector<TokenRecord> tokens;
+        std::vector<const char *> starts;
+        std::exception_ptr error;
+        const char *stop = nullptr;
+        int stopLine = 0;
+        int stopColumn = 0;
+        bool clipped = false; // the end of stream is not that of the source
+        size_t first = 0;
+        int lineDelta = 0;
+    };
+
+    Scanner(std::string_view source, int firstLine, int firstColumn);
+    TScannedChunk scanRange(const char *begin,
+                            const char *limit,
+                            const char *end,
+                            int firstLine,
+                            int firstColumn) const;
+    void nextScannedToken();
+
+    // Like istream::peek, looking at the end counts as reading it.
+    char peekChar()
+    {
+        if (pos_ < end_)
+        {
+            return *pos_;
+        }
+        eofRead_ = true;
+        return EOF;
+    }
+    // Skips the raw characters up to stop, none of which is a line break.
+    void skipTo(const char *stop)
     {
-        return reader_.eof();
+        columnNumber_ += static_cast<int>(stop - pos_);
+        pos_ = stop;
     }
-    void startScanner();
+    void startScanner(int firstLine, int firstColumn);
     void skipBlanksAndComments();
     void skipSingleLineComment();
     void skipMultiLineComment();
 
     char readRawChar();
     char getOS_IndependentChar();
-    char nextChar();
+    // A line break reads as a blank. Characters within a line take the
+    // inline path.
+    char nextChar()
+    {
+        if (pos_ < end_ && *pos_ != CR && *pos_ != LF)
+        {
+            ++columnNumber_;
+            return *pos_++;
+        }
+        return nextCharSlow();
+    }
+    char nextCharSlow();
 
-    bool isLetter(char ch) const;
-    bool isHexDigit(char ch);
+    static bool isLetter(char ch);
+    static bool isDigit(char ch);
+    static bool isHexDigit(char ch);
 
+    void getToken();
     void getWord();
     void getString();
     void getNumber();
     void getHexNumber();
     void getSpecial();
-    void addKeywords();
-    TokenCode getKeywordCode(const std::string &value);
-
-    std::istream &reader_;
+    static TokenCode getKeywordCode(std::string_view value);
+
+    std::shared_ptr<const void> source_;
+    const char *begin_ = nullptr;
+    const char *pos_ = nullptr; // next character to read
+    const char *end_ = nullptr;
+    bool eofRead_ = false;
+    std::vector<TScannedChunk> scanned_; // once scanAll has run
+    size_t scannedChunk_ = 0;
+    size_t scannedToken_ = 0;
     TokenRecord tokenRecord_;
     bool inMultiLineComment_ = false;
     int lineNumber_ = 0;
     int columnNumber_ = 0;
     char ch_ = 0;
     ScannerError error_;
-    std::unordered_map<std::string, TokenCode> tKeywords_;
 
     static constexpr int MAX_DIGIT_COUNT = 3;
     static constexpr int MAX_EXPONENT = 308;
@@ -92,29 +181,35 @@ private:
     static constexpr char CR = '\r';
 };
 
+// Lexes in place: tokens are offsets into the input and literals are views
+// of it, nothing is copied.
 class Lexer
 {
 public:
-    explicit Lexer(const std::string &input);
+    // The input must outlive the lexer and the literals it returns.
+    explicit Lexer(std::string_view input);
+    explicit Lexer(std::shared_ptr<const TMappedFile> file);
 
     void readChar();
     Length readIdentifier();
     Length readNumber();
 
     Token nextToken();
-    Token::Type lookupIdent(const std::string &ident);
+    static Token::Type lookupIdent(std::string_view ident);
     void skipWhitespace();
     char peekChar();
 
-    std::string getLiteral(const Token &token) const;
+    std::string_view getLiteral(const Token &token) const
+    {
+        return input_.substr(token.position_, token.length_);
+    }
 
 private:
-    std::string input_;
+    std::shared_ptr<const TMappedFile> file_;
+    std::string_view input_;
     BufferSize position_ = 0;
     BufferSize read_position_ = 0;
     char ch_ = 0;
-
-    static std::unordered_map<std::string, Token::Type> keywords_;
 };
 
 #endif
\ No newline at end of file
@@ -16,11 +16,6 @@ static std::string inspectNull()
     return "null";
 }
 
-static std::string inspectReturn(const EvalObject &o)
-{
-    return inspect(*o.getObject());
-}
-
 static std::string inspectError(const EvalObject &o)
 {
     std::string buffer("ERROR: ");
@@ -51,8 +46,6 @@ std::string inspect(const EvalObject &o)
         return inspectBoolean(o);
     case ObjType::Null:
         return inspectNull();
-    case ObjType::Return:
-        return inspectReturn(o);
     case ObjType::Error:
         return inspectError(o);
     case ObjType::Function:
@@ -71,8 +64,6 @@ std::string typeStr(ObjType type)
         return "BOOLEAN";
     case ObjType::Null:
         return "NULL";
-    case ObjType::Return:
-        return "RETURN";
     case ObjType::Error:
         return "ERROR";
     case ObjType::Function:
@@ -4,7 +4,6 @@
 #include "macros.hpp"
 #include <memory>
 #include <string>
-#include <variant>
 #include <vector>
 
 class Environment;
@@ -16,7 +15,6 @@ enum class ObjType
     Integer,
     Boolean,
     Null,
-    Return,
     Error,
     Function,
 };
@@ -26,8 +24,9 @@ class Function
 public:
     Function(const std::vector<__Ptr<Identifier>> &params,
              __Ptr<BlockStatement> &body,
-             __Ptr<Environment> env)
-        : parameters_(params), body_(body), env_(env)
+             __Ptr<Environment> env,
+             size_t nSlots)
+        : parameters_(params), body_(body), env_(env), nSlots_(nSlots)
     {
     }
     size_t parametersCount() const
@@ -46,41 +45,76 @@ public:
     {
         return env_;
     }
+    // The size of the environment of a call.
+    size_t slotsCount() const
+    {
+        return nSlots_;
+    }
 
 private:
     std::vector<__Ptr<Identifier>> parameters_;
     __Ptr<BlockStatement> body_;
     __Ptr<Environment> env_;
+    size_t nSlots_ = 0;
 };
 
+// A value of the tree-walking evaluator. Integers, booleans and null are
+// held inline, so arithmetic allocates nothing and copies touch no reference
+// count. Functions and error messages are immutable and shared on the heap.
 struct EvalObject
 {
-    using Enclosed = __Ptr<EvalObject>;
-
-    int getInt() const
+    static EvalObject makeInteger(int value)
     {
-        return std::get<int>(value);
+        EvalObject o;
+        o.type = ObjType::Integer;
+        o.integer = value;
+        return o;
     }
-    bool getBool() const
+    static EvalObject makeBoolean(bool value)
     {
-        return std::get<bool>(value);
+        EvalObject o;
+        o.type = ObjType::Boolean;
+        o.integer = value;
+        return o;
     }
-    Enclosed getObject() const
+    static EvalObject makeError(std::string message)
     {
-        return std::get<Enclosed>(value);
+        EvalObject o;
+        o.type = ObjType::Error;
+        o.heap = std::make_shared<const std::string>(std::move(message));
+        return o;
     }
-    std::string getString() const
+    static EvalObject makeFunction(Function function)
     {
-        return std::get<std::string>(value);
+        EvalObject o;
+        o.type = ObjType::Function;
+        o.heap = std::make_shared<const Function>(std::move(function));
+        return o;
     }
 
-    Function getFunction() const
+    int getInt() const
+    {
+        return integer;
+    }
+    bool getBool() const
+    {
+        return integer != 0;
+    }
+    // The message of an error.
+    const std::string &getString() const
+    {
+        return *static_cast<const std::string *>(heap.get());
+    }
+    const Function &getFunction() const
     {
-        return std::get<Function>(value);
+        return *static_cast<const Function *>(heap.get());
     }
 
     ObjType type = ObjType::Null;
-    std::variant<int, bool, Enclosed, std::string, Function> value;
+    // Set while a return statement unwinds to the function it returns from.
+    bool returned = false;
+    int integer = 0; // also a boolean
+    __Ptr<const void> heap;
 };
 
 std::string inspect(const EvalObject &o);
@@ -102,7 +102,8 @@ __Ptr<Statement> Parser::parseStatement()
 
 __Ptr<Expression> Parser::parseIdentifier()
 {
-    return std::make_shared<Identifier>(lexer_.getLiteral(cur_token_));
+    return std::make_shared<Identifier>(
+        std::string(lexer_.getLiteral(cur_token_)));
 }
 
 __Ptr<LetStatement> Parser::parseLetStatement()
@@ -398,15 +399,15 @@ std::vector<__Ptr<Identifier>> Parser::parseFunctionParameters()
     }
 
     nextToken();
-    identifiers.emplace_back(
-        std::make_shared<Identifier>(lexer_.getLiteral(cur_token_)));
+    identifiers.emplace_back(std::make_shared<Identifier>(
+        std::string(lexer_.getLiteral(cur_token_))));
 
     while (peekTokenIs(Token::Type::Comma))
     {
         nextToken();
         nextToken();
-        identifiers.emplace_back(
-            std::make_shared<Identifier>(lexer_.getLiteral(cur_token_)));
+        identifiers.emplace_back(std::make_shared<Identifier>(
+            std::string(lexer_.getLiteral(cur_token_))));
     }
     if (!expectPeek(Token::Type::RParen))
     {
@@ -11,7 +11,7 @@ static std::string formatToken(const Token &t, const Lexer &l)
 {
     std::string buffer;
     buffer += "{Type:" + tokenType2String(t.type_) +
-              " Literal:" + l.getLiteral(t) + "}";
+              " Literal:" + std::string(l.getLiteral(t)) + "}";
     return buffer;
 }
 
@@ -46,10 +46,7 @@ void Repl::start()
         }
 
         auto evaluated = Eval(program.get(), env);
-        if (evaluated)
-        {
-            std::cout << inspect(*evaluated);
-            std::cout << "\n";
-        }
+        std::cout << inspect(evaluated);
+        std::cout << "\n";
     }
 }
\ No newline at end of file
@@ -0,0 +1,64 @@
+#include "resolver.hpp"
+#include "ast.hpp"
+#include "environment.hpp"
+
+void Resolver::resolve(Node &program)
+{
+    scopes_.assign(1, Scope());
+    uses_.clear();
+    current_ = 0;
+    program.resolve(*this);
+
+    for (const Use &use : uses_)
+    {
+        const std::string &name = use.name->value();
+        std::vector<SlotAddress> addresses;
+        int depth = 0;
+        for (int scope = use.scope; scope > 0;
+             scope = scopes_[scope].outer, ++depth)
+        {
+            auto it = scopes_[scope].slots.find(name);
+            if (it != scopes_[scope].slots.end())
+            {
+                addresses.push_back({depth, it->second});
+            }
+        }
+        // A name no scope binds may still be bound at the top level later.
+        addresses.push_back({depth, globals_.declare(name)});
+        use.name->setAddresses(std::move(addresses));
+    }
+}
+
+void Resolver::declare(Identifier &name)
+{
+    int slot;
+    if (current_ == 0)
+    {
+        slot = globals_.declare(name.value());
+    }
+    else
+    {
+        auto &slots = scopes_[current_].slots;
+        slot = slots.try_emplace(name.value(), static_cast<int>(slots.size()))
+                   .first->second;
+    }
+    name.setAddresses({{0, slot}});
+}
+
+void Resolver::use(Identifier &name)
+{
+    uses_.push_back({&name, current_});
+}
+
+void Resolver::enterFunction()
+{
+    scopes_.push_back({current_, {}});
+    current_ = static_cast<int>(scopes_.size()) - 1;
+}
+
+size_t Resolver::exitFunction()
+{
+    size_t nSlots = scopes_[current_].slots.size();
+    current_ = scopes_[current_].outer;
+    return nSlots;
+}
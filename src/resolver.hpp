@@ -0,0 +1,58 @@
+#ifndef RESOLVER_HPP_INCLUDED
+#define RESOLVER_HPP_INCLUDED
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Environment;
+class Identifier;
+class Node;
+
+// Assigns every identifier of a program the slots its value may live in, so
+// that the evaluator indexes environments instead of searching them by name.
+// A function literal is a scope of its own. The program's scope is the
+// top-level environment, whose names carry over to the programs resolved
+// against it later, as in the REPL.
+//
+// A let binds its name in the whole enclosing function. As long as the slot
+// is unset, a read falls through to the enclosing scopes binding the same
+// name, just as a lookup by name did.
+class Resolver
+{
+public:
+    explicit Resolver(Environment &globals) : globals_(globals)
+    {
+    }
+
+    void resolve(Node &program);
+
+    // Called by the nodes as they are walked.
+    void declare(Identifier &name);
+    void use(Identifier &name);
+    void enterFunction();
+    // Returns the number of slots of the function.
+    size_t exitFunction();
+
+private:
+    struct Scope
+    {
+        int outer = -1;
+        std::unordered_map<std::string, int> slots;
+    };
+    struct Use
+    {
+        Identifier *name;
+        int scope;
+    };
+
+    Environment &globals_;
+    // scopes_[0] is the program, its slots are those of globals_.
+    std::vector<Scope> scopes_;
+    // Resolved once every scope knows all of its names.
+    std::vector<Use> uses_;
+    int current_ = 0;
+};
+
+#endif
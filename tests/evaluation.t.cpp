@@ -3,10 +3,10 @@
 #include "ast.hpp"
 #include "environment.hpp"
 #include "evaluator.hpp"
-#include "globals.hpp"
 #include "lexer.hpp"
 #include "object.hpp"
 #include "parser.hpp"
+#include "resolver.hpp"
 #include <iostream>
 #include <string>
 
@@ -28,7 +28,7 @@ struct StringExpected
     std::string expected;
 };
 
-static std::shared_ptr<EvalObject> testEval(const std::string input)
+static EvalObject testEval(const std::string input)
 {
     Lexer l(input);
     Parser p(l);
@@ -73,7 +73,7 @@ TEST_CASE("Test_EvalIntegerExpression", "[quick]")
     for (const auto &tt : tests)
     {
         auto evaluated = testEval(tt.input);
-        testIntegerObject(evaluated.get(), tt.expected);
+        testIntegerObject(&evaluated, tt.expected);
     }
 }
 
@@ -104,7 +104,7 @@ TEST_CASE("Test_EvalBooleanExpression", "[quick]")
     for (const auto &tt : tests)
     {
         auto evaluated = testEval(tt.input);
-        testBooleanObject(evaluated.get(), tt.expected);
+        testBooleanObject(&evaluated, tt.expected);
     }
 }
 
@@ -122,7 +122,7 @@ TEST_CASE("Test_BandOperator", "[quick]")
     for (const auto &tt : tests)
     {
         auto evaluated = testEval(tt.input);
-        testBooleanObject(evaluated.get(), tt.expected);
+        testBooleanObject(&evaluated, tt.expected);
     }
 }
 
@@ -138,7 +138,7 @@ TEST_CASE("Test_IfElseExpressionInteger", "[quick]")
     for (const auto &tt : tests)
     {
         auto evaluated = testEval(tt.input);
-        testIntegerObject(evaluated.get(), tt.expected);
+        testIntegerObject(&evaluated, tt.expected);
     }
 }
 
@@ -148,7 +148,7 @@ TEST_CASE("Test_IfElseExpressionNull", "[quick]")
     for (const auto &tt : tests)
     {
         auto evaluated = testEval(tt);
-        REQUIRE(evaluated == Globals::getInstance().getNull());
+        REQUIRE(evaluated.type == ObjType::Null);
     }
 }
 
@@ -171,7 +171,7 @@ TEST_CASE("Test_EvalReturnStatements", "[quick]")
     for (const auto &tt : tests)
     {
         auto evaluated = testEval(tt.input);
-        testIntegerObject(evaluated.get(), tt.expected);
+        testIntegerObject(&evaluated, tt.expected);
     }
 }
 
@@ -213,8 +213,8 @@ TEST_CASE("Test_ErrorHandling", "[quick]")
     for (const auto &tt : tests)
     {
         auto evaluated = testEval(tt.input);
-        REQUIRE(evaluated->type == ObjType::Error);
-        REQUIRE(evaluated->getString() == tt.expected);
+        REQUIRE(evaluated.type == ObjType::Error);
+        REQUIRE(evaluated.getString() == tt.expected);
     }
 }
 
@@ -230,7 +230,7 @@ TEST_CASE("Test_EvalLetStatements", "[quick]")
     for (const auto &[input, expected] : tests)
     {
         auto evaluated = testEval(input);
-        testIntegerObject(evaluated.get(), expected);
+        testIntegerObject(&evaluated, expected);
     }
 }
 
@@ -238,7 +238,7 @@ TEST_CASE("Test_EvalFunctionObject", "[quick]")
 {
     std::string input("fn(x) { x + 2; };");
     auto evaluated = testEval(input);
-    auto obj = evaluated.get();
+    auto obj = &evaluated;
     REQUIRE(obj != nullptr);
     REQUIRE(obj->type == ObjType::Function);
     const auto &fn = obj->getFunction();
@@ -262,6 +262,119 @@ TEST_CASE("Test_EvalFunctionApplication", "[quick]")
     for (const auto &[input, expected] : tests)
     {
         auto evaluated = testEval(input);
-        testIntegerObject(evaluated.get(), expected);
+        testIntegerObject(&evaluated, expected);
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Test_EvalLexicalAddressing", "[quick]")
+{
+    std::vector<IntegerExpected> tests{
+        {"let newAdder = fn(x) { fn(y) { x + y } }; newAdder(2)(3);", 5},
+        {"let fib = fn(n) { if (n < 2) { return n; } "
+         "fib(n - 1) + fib(n - 2); }; fib(10);",
+         55},
+        // Bound in the function, but read before the let.
+        {"let x = 1; let f = fn(z) { let y = x; let x = z; x + y; }; f(10);",
+         11},
+        // Refers to a sibling bound after it.
+        {"let f = fn(z) { let g = fn(a) { h(a) }; let h = fn(a) { a + z }; "
+         "g(3) }; f(4);",
+         7},
+        {"let f = fn(x, x) { x }; f(1, 2);", 2},
+        {"let x = 5; if (x > 1) { let y = x * 2; } y;", 10},
+    };
+
+    for (const auto &[input, expected] : tests)
+    {
+        auto evaluated = testEval(input);
+        testIntegerObject(&evaluated, expected);
+    }
+
+    // Program by program in one environment, as the REPL runs them.
+    auto env = std::make_shared<Environment>();
+    auto run = [&env](const std::string &input) {
+        Lexer l(input);
+        Parser p(l);
+        auto program = p.parseProgram();
+        return Eval(program.get(), env);
+    };
+    auto early = run("let f = fn(a) { later; };");
+    REQUIRE(early.type == ObjType::Function);
+    auto missing = run("f(1);");
+    REQUIRE(missing.type == ObjType::Error);
+    REQUIRE(missing.getString() == "identifier not found: later");
+    run("let later = 42;");
+    auto found = run("f(1);");
+    testIntegerObject(&found, 42);
+
+    std::string input("let a = 1; fn(b) { fn() { a + b; } };");
+    Lexer l(input);
+    Parser p(l);
+    auto program = p.parseProgram();
+    auto globals = std::make_shared<Environment>();
+    Resolver(*globals).resolve(*program);
+    auto outer = dynamic_cast<const FunctionLiteral *>(
+        dynamic_cast<const ExpressionStatement *>(program->at(1))
+            ->expression());
+    REQUIRE(outer != nullptr);
+    REQUIRE(outer->param(0)->slot() == 0);
+    auto inner = dynamic_cast<const FunctionLiteral *>(
+        dynamic_cast<const ExpressionStatement *>(outer->body()->at(0))
+            ->expression());
+    REQUIRE(inner != nullptr);
+    auto sum = dynamic_cast<const InfixExpression *>(
+        dynamic_cast<const ExpressionStatement *>(inner->body()->at(0))
+            ->expression());
+    REQUIRE(sum != nullptr);
+    const auto &a =
+        dynamic_cast<const Identifier *>(sum->left())->addresses();
+    REQUIRE(a.size() == 1);
+    REQUIRE(a[0].depth == 2);
+    REQUIRE(a[0].slot == 0);
+    const auto &b =
+        dynamic_cast<const Identifier *>(sum->right())->addresses();
+    REQUIRE(b.size() == 2);
+    REQUIRE(b[0].depth == 1);
+    REQUIRE(b[0].slot == 0);
+    REQUIRE(b[1].depth == 2);
+}
+
+TEST_CASE("Test_EvalInlineValues", "[quick]")
+{
+    // A return unwinds to its own function only.
+    std::vector<IntegerExpected> integers{
+        {"let f = fn(x) { if (x > 1) { if (x > 2) { return 3; } return 2; } "
+         "1; }; f(5) + f(2) + f(0);",
+         6},
+        {"let g = fn(x) { return x * 10; }; let f = fn(x) { g(x) + 1; }; "
+         "f(4);",
+         41},
+        {"let x = 7; let f = fn(y) { y; }; f(x); x;", 7},
+    };
+    for (const auto &[input, expected] : integers)
+    {
+        auto evaluated = testEval(input);
+        testIntegerObject(&evaluated, expected);
+    }
+
+    // Booleans and null compare by value, functions by identity.
+    std::vector<BooleanExpected> booleans{
+        {"(1 < 2) == true", true},
+        {"if (false) { 1 } == if (false) { 2 }", true},
+        {"let f = fn(x) { x; }; let g = f; g == f", true},
+        {"fn(x) { x; } == fn(x) { x; }", false},
+        {"let f = fn(x) { x; }; f == true", false},
+    };
+    for (const auto &[input, expected] : booleans)
+    {
+        auto evaluated = testEval(input);
+        testBooleanObject(&evaluated, expected);
+    }
+
+    auto unbound = testEval("let f = fn(x, y) { y; }; f(1);");
+    REQUIRE(unbound.type == ObjType::Error);
+    REQUIRE(unbound.getString() == "identifier not found: y");
+    auto notFunction = testEval("5(foobar);");
+    REQUIRE(notFunction.type == ObjType::Error);
+    REQUIRE(notFunction.getString() == "identifier not found: foobar");
+}
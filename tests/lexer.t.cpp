@@ -1,9 +1,15 @@
 #define CATCH_CONFIG_MAIN
 #include <catch2/catch_test_macros.hpp>
 
+#include "SyntaxParser.hpp"
+#include "TMappedFile.hpp"
+#include "TThreadPool.hpp"
 #include "Token.hpp"
 #include "lexer.hpp"
+#include <filesystem>
+#include <fstream>
 #include <sstream>
+#include <stdexcept>
 #include <vector>
 
 struct NextTokenExpected
@@ -218,4 +224,192 @@ TEST_CASE("Test_TokenIntegers", "[quick]")
         REQUIRE(std::abs(got.tFloat() - expected) <
                 std::numeric_limits<double>::epsilon());
     }
+}
+
+TEST_CASE("Test_ScannerSources", "[quick]")
+{
+    // Runs longer than a vector of characters, split at odd places.
+    std::string input(
+        "                    alpha_beta_gamma_delta_epsilon // a comment "
+        "longer than sixteen chars\n" +
+        std::string(18, '\t') +
+        "x /* a block comment\n spanning ** lines */ \"a string longer "
+        "than sixteen\"\nend");
+    std::vector<NextTokenExpected> expected_tokens{
+        {TokenCode::tIdentifier, "alpha_beta_gamma_delta_epsilon", 21, 1},
+        {TokenCode::tIdentifier, "x", 19, 2},
+        {TokenCode::tString, "a string longer than sixteen", 23, 3},
+        {TokenCode::tEnd, "<end>", 1, 4},
+        {TokenCode::tEndofStream, "<eof>", 4, 4}};
+
+    auto path =
+        (std::filesystem::temp_directory_path() / "daewoo_scanner.dw")
+            .string();
+    std::ofstream(path, std::ios::binary) << input;
+    std::istringstream iss(input);
+    Scanner fromStream(iss);
+    Scanner fromString{std::string_view(input)};
+    Scanner fromFile(TMappedFile::open(path));
+    for (auto *scanner : {&fromStream, &fromString, &fromFile})
+    {
+        for (const auto &expected_token : expected_tokens)
+        {
+            scanner->nextToken();
+            auto got = scanner->token();
+            REQUIRE(got.code() == expected_token.type_);
+            REQUIRE(got.literal() == expected_token.literal_);
+            REQUIRE(got.columnNumber() == expected_token.columnNumber_);
+            REQUIRE(got.lineNumber() == expected_token.lineNumber_);
+        }
+    }
+    std::filesystem::remove(path);
+}
+
+
+// The tokens of a scan up to the end or the error it stops at.
+static std::vector<TokenRecord> scanTokens(Scanner &scanner,
+                                           std::string &error)
+{
+    std::vector<TokenRecord> tokens;
+    try
+    {
+        do
+        {
+            scanner.nextToken();
+            tokens.push_back(scanner.token());
+        } while (scanner.token().code() != TokenCode::tEndofStream);
+    }
+    catch (const std::runtime_error &e)
+    {
+        error = e.what();
+    }
+    return tokens;
+}
+
+TEST_CASE("Test_ScannerParallel", "[quick]")
+{
+    // Chunks of a few lines start inside comments and strings, after blank
+    // lines and CRLF line ends, comments span chunks.
+    std::string program;
+    for (int i = 0; i < 40; ++i)
+    {
+        program += "let alpha = " + std::to_string(i) + " + 2.5e3;\n"
+                   "// a comment\n\n"
+                   "/* a block comment\nspanning\n\nlines */ x = 1;\r\n"
+                   "\"a string\nover lines\" ;\n"
+                   "\"not /* a comment\" ;\n"
+                   "/* \" not a string\n" +
+                   std::string(100, '-') + "\n*/\n"
+                   "end\n\n";
+    }
+    // Sources and whether their scan fails.
+    std::vector<std::pair<std::string, bool>> sources{
+        {program, false},
+        {program + "let y = \"never closed;\n", true},
+        {program + "/* never closed\nlet w = 1;\n", true},
+        {program + "let z = 1 ? 2;\n" + program, true},
+        {"", false}};
+
+    TThreadPool pool(3);
+    for (const auto &[source, fails] : sources)
+    {
+        std::string sequentialError;
+        Scanner sequential{std::string_view(source)};
+        auto expected = scanTokens(sequential, sequentialError);
+        REQUIRE(sequentialError.empty() == !fails);
+        for (size_t chunkSize : {16, 64, 1 << 20})
+        {
+            std::string parallelError;
+            Scanner parallel{std::string_view(source)};
+            parallel.scanAll(pool, chunkSize);
+            auto got = scanTokens(parallel, parallelError);
+            REQUIRE(got.size() == expected.size());
+            REQUIRE(parallelError == sequentialError);
+            for (size_t i = 0; i < got.size(); ++i)
+            {
+                REQUIRE(got[i].code() == expected[i].code());
+                REQUIRE(got[i].literal() == expected[i].literal());
+                REQUIRE(got[i].lineNumber() == expected[i].lineNumber());
+                REQUIRE(got[i].columnNumber() ==
+                        expected[i].columnNumber());
+            }
+        }
+    }
+}
+
+TEST_CASE("Test_TokensTable", "[quick]")
+{
+    TokensTable tokens;
+    {
+        auto source = std::make_shared<const std::string>(
+            "let total = 1;\nlet count = total + 2.5;\n"
+            "let label = \"count and total\";");
+        Scanner sc(source);
+        SyntaxParser sp(sc);
+        REQUIRE(!sp.syntaxCheck());
+        tokens = std::move(sp.tokens());
+    }
+
+    // The texts outlive the scanner, identifiers are interned once.
+    std::vector<std::string> names;
+    std::vector<int> atoms;
+    for (size_t i = 0; i < tokens.count(); ++i)
+    {
+        const auto &token = tokens.at(i);
+        if (token.code() == TokenCode::tIdentifier)
+        {
+            names.emplace_back(token.tString());
+            atoms.push_back(token.atom());
+            REQUIRE(tokens.atoms().name(token.atom()) == token.tString());
+        }
+        else
+        {
+            REQUIRE(token.atom() == -1);
+        }
+        if (token.code() == TokenCode::tString)
+        {
+            REQUIRE(token.tString() == "count and total");
+        }
+        if (token.code() == TokenCode::tFloat)
+        {
+            REQUIRE(token.tFloat() == 2.5);
+        }
+    }
+    REQUIRE(names ==
+            std::vector<std::string>{"total", "count", "total", "label"});
+    REQUIRE(atoms[0] == atoms[2]);
+    REQUIRE(atoms[0] != atoms[1]);
+    REQUIRE(tokens.atoms().size() == 3);
+}
+
+TEST_CASE("Test_LexerLargeInput", "[quick]")
+{
+    // Offsets past 64 KB and an identifier longer than 255 characters.
+    std::string identifier(300, 'x');
+    std::string input(70'000, ' ');
+    input += "let " + identifier + " = 12345;";
+
+    auto path =
+        (std::filesystem::temp_directory_path() / "daewoo_lexer.mk").string();
+    std::ofstream(path, std::ios::binary) << input;
+    Lexer fromString{std::string_view(input)};
+    Lexer fromFile(TMappedFile::open(path));
+    for (auto *lexer : {&fromString, &fromFile})
+    {
+        auto let = lexer->nextToken();
+        REQUIRE(let.type_ == Token::Type::Let);
+        REQUIRE(let.position_ == 70'000);
+        auto name = lexer->nextToken();
+        REQUIRE(name.type_ == Token::Type::Ident);
+        REQUIRE(name.position_ == 70'004);
+        REQUIRE(name.length_ == 300);
+        REQUIRE(lexer->getLiteral(name) == identifier);
+        REQUIRE(lexer->nextToken().type_ == Token::Type::Assign);
+        auto number = lexer->nextToken();
+        REQUIRE(number.type_ == Token::Type::Int);
+        REQUIRE(lexer->getLiteral(number) == "12345");
+        REQUIRE(lexer->nextToken().type_ == Token::Type::Semicolon);
+        REQUIRE(lexer->nextToken().type_ == Token::Type::Eof);
+    }
+    std::filesystem::remove(path);
 }
\ No newline at end of file
@@ -171,7 +171,7 @@ TEST_CASE("Test_LetStatements", "[quick]")
     size_t index = 0;
     for (const auto &stmt : *ast)
     {
-        testLetStatement(stmt.get(), expected[index++]);
+        testLetStatement(stmt, expected[index++]);
     }
 }
 
@@ -294,7 +294,7 @@ TEST_CASE("Test_Identifier", "[quick]")
     {
         REQUIRE(stmt->type() == ASTNodeType::ntExpressionStatement);
         const auto *expr_stmt =
-            dynamic_cast<const ASTExpressionStatement *>(stmt.get());
+            dynamic_cast<const ASTExpressionStatement *>(stmt);
         REQUIRE(expr_stmt != nullptr);
         const auto *expr = expr_stmt->expression();
         REQUIRE(expr->type() == ASTNodeType::ntPrimary);
@@ -325,7 +325,7 @@ TEST_CASE("Test_IntegerLiteralExpression", "[quick]")
     {
         REQUIRE(stmt->type() == ASTNodeType::ntExpressionStatement);
         const auto *expr_stmt =
-            dynamic_cast<const ASTExpressionStatement *>(stmt.get());
+            dynamic_cast<const ASTExpressionStatement *>(stmt);
         REQUIRE(expr_stmt != nullptr);
         const auto *expr = expr_stmt->expression();
         REQUIRE(expr->type() == ASTNodeType::ntPrimary);
@@ -558,6 +558,44 @@ TEST_CASE("Test_ParsingInfixExpressionsBoolean", "[quick]")
         REQUIRE(rhs_i->value() == rhs_exp);
     }
 }
+
+TEST_CASE("Test_ASTArena", "[quick]")
+{
+    // The tree outlives the tokens, its names and strings are in the arena.
+    std::unique_ptr<ASTProgram> ast;
+    {
+        std::istringstream iss("let y = 2;\nlet x = f(1, y, \"text\")");
+        Scanner sc(iss);
+        SyntaxParser sp(sc);
+        checkSyntaxParserErrors(sp.syntaxCheck());
+        ASTBuilder ast_builder(sp.tokens());
+        ast = ast_builder.build();
+    }
+    REQUIRE(ast.get() != nullptr);
+    REQUIRE(ast->size() == 2);
+    testLetStatement(ast->at(0), "y");
+    testLetStatement(ast->at(1), "x");
+    REQUIRE(ast->arena().blockCount() == 1);
+
+    const auto *letStmt = dynamic_cast<const ASTLetStatement *>(ast->at(1));
+    const auto *call = dynamic_cast<const ASTPrimary *>(letStmt->rhs());
+    REQUIRE(call != nullptr);
+    testIdentifierLiteral(call, "f");
+    const auto *function =
+        dynamic_cast<const ASTPrimaryFunction *>(call->primaryPlus());
+    REQUIRE(function != nullptr);
+    REQUIRE(function->primaryPlus()->type() == ASTNodeType::ntNull);
+
+    const auto *args = function->argumentList();
+    REQUIRE(args->size() == 3);
+    testIntegerLiteral(args->at(0), 1);
+    testIdentifierLiteral(args->at(1), "y");
+    const auto *text = dynamic_cast<const ASTPrimary *>(args->at(2));
+    REQUIRE(text != nullptr);
+    const auto *string = dynamic_cast<const ASTString *>(text->factor());
+    REQUIRE(string != nullptr);
+    REQUIRE(string->value() == "text");
+}
 /*
 TEST_CASE("Test_OperatorPrecedenceParsing")
 {
@@ -1114,7 +1114,6 @@ static void testByteCodeCore(const std::string &input, const TProgram &expected)
 
     TByteCodeBuilder builder(sp.tokens());
     TModule module;
-    constantValueTable.clear();
     builder.build(&module);
 
     std::stringstream msg;
@@ -1372,4 +1371,63 @@ TEST_CASE("Test_ParsingByteCodeFunctionCall", "[quick]")
     {
         testByteCodeCore(input, expected);
     }
-}
\ No newline at end of file
+}
+TEST_CASE("Test_SymbolTable", "[quick]")
+{
+    TSymbolTable table;
+    for (int i = 0; i < 10'000; ++i)
+    {
+        REQUIRE(table.addSymbol("s" + std::to_string(i)) == i);
+    }
+    // A name added again keeps finding its first symbol.
+    REQUIRE(table.addSymbol("s42") == 10'000);
+
+    TSymbolTable copy = table;
+    for (const auto *t : {&table, &copy})
+    {
+        int index = -1;
+        for (int i = 0; i < 10'000; ++i)
+        {
+            REQUIRE(t->find("s" + std::to_string(i), index));
+            REQUIRE(index == i);
+        }
+        REQUIRE(!t->find("s10000", index));
+        REQUIRE(!t->find("", index));
+    }
+
+    // Every global reads the one defined at half its index.
+    std::string input = "let s0 = 0;\n";
+    for (int i = 1; i < 5'000; ++i)
+    {
+        input += "let s" + std::to_string(i) + " = s" +
+                 std::to_string(i / 2) + " + 1;\n";
+    }
+    Scanner sc{std::string_view(input)};
+    SyntaxParser sp(sc);
+    checkSyntaxParserErrors(sp.syntaxCheck());
+    TModule module;
+    TByteCodeBuilder builder(sp.tokens());
+    builder.build(&module);
+    REQUIRE(module.symboltable().size() == 5'000);
+    std::vector<int> loads;
+    std::vector<int> stores;
+    for (size_t i = 0; i < module.code().size(); ++i)
+    {
+        const auto &bytecode = module.code()[i];
+        if (bytecode.opCode == OpCode::Load)
+        {
+            loads.push_back(bytecode.index);
+        }
+        else if (bytecode.opCode == OpCode::Store)
+        {
+            stores.push_back(bytecode.index);
+        }
+    }
+    REQUIRE(stores.size() == 5'000);
+    REQUIRE(loads.size() == 5'000 - 1);
+    for (int i = 0; i < 5'000; ++i)
+    {
+        REQUIRE(stores[i] == i);
+        REQUIRE((i == 0 || loads[i - 1] == i / 2));
+    }
+}
@@ -3,13 +3,33 @@
 #include "ASTNode.hpp"
 #include "SyntaxParser.hpp"
 #include "TByteCodeBuilder.hpp"
+#include "TChannel.hpp"
+#include "TListObject.hpp"
+#include "TMatrixObject.hpp"
+#include "TThreadPool.hpp"
+#include "TVectorProgram.hpp"
+#include "VectorKernels.hpp"
+#include "TGreenThreads.hpp"
+#include "TInterpreter.hpp"
 #include "TModule.hpp"
+#include "TModuleFile.hpp"
+#include "TParallelList.hpp"
+#include "TRuntime.hpp"
+#include "TScheduler.hpp"
 #include "ast.hpp"
 #include "lexer.hpp"
 #include "parser.hpp"
+#include <atomic>
 #include <catch2/catch_test_macros.hpp>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <limits>
 #include <sstream>
+#include <thread>
 #include <tuple>
 #include <vector>
 
@@ -32,10 +52,10 @@ static void testVM(const std::string &input,
     checkSyntaxParserErrors(err);
     TByteCodeBuilder builder(sp.tokens());
     auto module = std::make_shared<TModule>();
-    constantValueTable.clear();
     builder.build(module.get());
 
-    VM vm;
+    TRuntime runtime;
+    VM vm(runtime);
     vm.runModule(module);
     REQUIRE(vm.empty() == false);
     const auto &result = vm.top();
@@ -65,6 +85,29 @@ static void testVM(const std::string &input,
     }
 }
 
+static void testVMString(const std::string &input,
+                         const std::string &expected_value)
+{
+    std::istringstream iss(input);
+    Scanner sc(iss);
+    SyntaxParser sp(sc);
+    auto err = sp.syntaxCheck();
+    checkSyntaxParserErrors(err);
+    TByteCodeBuilder builder(sp.tokens());
+    auto module = std::make_shared<TModule>();
+    builder.build(module.get());
+
+    TRuntime runtime;
+    VM vm(runtime);
+    vm.runModule(module);
+    REQUIRE(vm.empty() == false);
+    const auto &result = vm.top();
+    INFO("Input> \n'" + input + "'\nExpected: Type>STRING Value> " +
+         expected_value);
+    REQUIRE(result.type() == TStackRecordType::stString);
+    REQUIRE(result.svalue()->value() == expected_value);
+}
+
 static std::string fn_call_fib25()
 {
     return "fn fibonacci(n)\n"
@@ -400,6 +443,50 @@ static std::string fn_call_i5()
            "test_1();\n";
 }
 
+static std::string fn_call_s1()
+{
+    return "fn build(s, n)\n"
+           "    if n == 0 then\n"
+           "        return s\n"
+           "    end\n"
+           "    return build(s + \"ab\", n - 1)\n"
+           "end;\n"
+           "build(\"\", 500);\n";
+}
+
+static std::string fn_call_s2()
+{
+    return "fn greet(name)\n"
+           "    let msg = \"hello \" + name;\n"
+           "    return msg;\n"
+           "end;\n"
+           "greet(\"world\");\n";
+}
+
+static std::string fn_call_l1()
+{
+    return "fn reset(list)\n"
+           "    list[0] = 0;\n"
+           "    return list[0];\n"
+           "end;\n"
+           "let a = {5, 6};\n"
+           "let b = reset(a);\n"
+           "a[0] + b;\n";
+}
+
+static std::string fn_call_l2()
+{
+    return "fn extend(list, n)\n"
+           "    if n == 0 then\n"
+           "        return list\n"
+           "    end\n"
+           "    return extend(list + n, n - 1)\n"
+           "end;\n"
+           "let a = {};\n"
+           "let b = extend(a, 100);\n"
+           "b[0] + b[99];\n";
+}
+
 static std::string fn_call_b1()
 {
     return "fn rbool()\n"
@@ -861,4 +948,1565 @@ TEST_CASE("Test_VM_FunctionCalls", "[quick]")
             testVM(input, TStackRecordType::stDouble, expected_value);
         }
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Test_VM_Strings", "[quick]")
+{
+    SECTION("Concatenation")
+    {
+        std::vector<std::tuple<std::string, std::string>> tests = {
+            {"\"abc\"", "abc"},
+            {"\"abc\" + \"def\"", "abcdef"},
+            {"\"a\" + \"b\" + \"c\" + \"d\"", "abcd"},
+            {"let a = \"ab\"; a = a + a; a = a + a; a", "abababab"},
+            {"let a = \"a\"; let b = a + \"b\"; a", "a"},
+            {"let a = \"a\"; let b = a + \"b\"; b", "ab"},
+            {"let a = \"a\" + \"b\"; let b = a + \"c\"; let c = a + "
+             "\"d\"; b",
+             "abc"},
+            {"let a = \"a\" + \"b\"; let b = a + \"c\"; let c = a + "
+             "\"d\"; c",
+             "abd"},
+            {fn_call_s2(), "hello world"},
+        };
+        for (const auto &[input, expected_value] : tests)
+        {
+            testVMString(input, expected_value);
+        }
+
+        std::string expected;
+        for (int i = 0; i < 500; ++i)
+        {
+            expected += "ab";
+        }
+        testVMString(fn_call_s1(), expected);
+    }
+
+    SECTION("Equality")
+    {
+        std::vector<std::tuple<std::string, bool>> tests = {
+            {"\"abc\" == \"abc\"", true},
+            {"\"abc\" == \"abd\"", false},
+            {"\"ab\" + \"c\" == \"abc\"", true},
+            {"\"abc\" != \"ab\" + \"c\"", false},
+            {"let a = \"x\"; let b = a + \"y\"; let c = a + \"z\"; "
+             "b + c == \"xyxz\"",
+             true},
+        };
+        for (const auto &[input, expected_value] : tests)
+        {
+            testVM(input, TStackRecordType::stBoolean, expected_value);
+        }
+    }
+}
+
+TEST_CASE("Test_VM_Lists", "[quick]")
+{
+    SECTION("Indexing")
+    {
+        std::vector<std::tuple<std::string, int>> tests = {
+            {"let a = {1, 2, 3}; a[1]", 2},
+            {"let a = {1, {2, 3}}; a[1][0]", 2},
+            {"let a = {1, 2} + 3; a[2]", 3},
+            {"let a = {1, 2} + {3, 4}; a[3]", 4},
+            {"let a = 3 * {7}; a[2]", 7},
+            {"let a = {1, 2}; a[1] = 5; a[1]", 5},
+        };
+        for (const auto &[input, expected_value] : tests)
+        {
+            testVM(input, TStackRecordType::stInteger, expected_value);
+        }
+    }
+
+    SECTION("Value semantics")
+    {
+        std::vector<std::tuple<std::string, int>> tests = {
+            {"let a = {1, 2, 3}; let b = a; b[0] = 10; a[0]", 1},
+            {"let a = {1, 2, 3}; let b = a; b[0] = 10; b[0]", 10},
+            {"let a = {1, 2}; let b = a + 3; a[1] + b[2]", 5},
+            {"let a = {1}; let b = {a, a}; a[0] = 4; b[1][0]", 1},
+            {fn_call_l1(), 5},
+        };
+        for (const auto &[input, expected_value] : tests)
+        {
+            testVM(input, TStackRecordType::stInteger, expected_value);
+        }
+        testVM(fn_call_l2(), TStackRecordType::stInteger, 101);
+    }
+
+    SECTION("Equality")
+    {
+        std::vector<std::tuple<std::string, bool>> tests = {
+            {"{1, 2} == {1, 2}", true},
+            {"{1, 2} == {1, 3}", false},
+            {"{\"a\", {1.5}} == {\"a\", {1.5}}", true},
+            {"let a = {1, 2}; let b = a; a == b", true},
+            {"let a = {1, 2}; let b = a; b[0] = 3; a == b", false},
+            {"let a = {}; let b = a + 1; a == {}", true},
+        };
+        for (const auto &[input, expected_value] : tests)
+        {
+            testVM(input, TStackRecordType::stBoolean, expected_value);
+        }
+    }
+
+    SECTION("Repetition")
+    {
+        testVM("let a = {1, 2} * 0; a == {}", TStackRecordType::stBoolean,
+               true);
+        TInterpreter interpreter;
+        REQUIRE_THROWS_WITH(interpreter.load("let a = {1, 2} * -1;"),
+                            "list repeated a negative number of times: -1");
+        REQUIRE_THROWS_AS(interpreter.load("let a = -3 * {1};"),
+                          std::runtime_error);
+    }
+
+    SECTION("Copy on write")
+    {
+        auto *a = TListObject::createObject();
+        a->append(1);
+        a->append(2);
+        auto *b = a->clone();
+        REQUIRE(a->sharesBufferWith(*b));
+        b->set(0, TListItem(5));
+        REQUIRE(!a->sharesBufferWith(*b));
+        REQUIRE(a->get(0).ivalue() == 1);
+        REQUIRE(b->get(0).ivalue() == 5);
+    }
+
+    SECTION("Storage")
+    {
+        REQUIRE(sizeof(TListItem) == 8);
+
+        auto *ints = TListObject::createObject();
+        ints->append(-7);
+        ints->append(1 << 30);
+        REQUIRE(ints->storage() == TListStorage::lsInteger);
+        REQUIRE(ints->intData()[0] == -7);
+
+        auto *doubles = TListObject::createObject();
+        doubles->append(0.5);
+        doubles->append(-2.25);
+        REQUIRE(doubles->storage() == TListStorage::lsDouble);
+        REQUIRE(doubles->doubleData()[1] == -2.25);
+
+        // A heterogeneous element promotes the list but keeps every value.
+        ints->append(1.5);
+        REQUIRE(ints->storage() == TListStorage::lsMixed);
+        REQUIRE(ints->get(0).type() == TListItemType::liInteger);
+        REQUIRE(ints->get(0).ivalue() == -7);
+        REQUIRE(ints->get(1).ivalue() == 1 << 30);
+        REQUIRE(ints->get(2).dvalue() == 1.5);
+
+        auto *mixed = TListObject::createObject();
+        mixed->append(true);
+        mixed->append(doubles);
+        mixed->append(std::nan(""));
+        REQUIRE(mixed->storage() == TListStorage::lsMixed);
+        REQUIRE(mixed->get(0).type() == TListItemType::liBoolean);
+        REQUIRE(mixed->get(0).bvalue());
+        REQUIRE(mixed->get(1).type() == TListItemType::liList);
+        REQUIRE(TListObject::listEquals(mixed->get(1).lvalue(), doubles));
+        REQUIRE(mixed->get(2).type() == TListItemType::liDouble);
+        REQUIRE(std::isnan(mixed->get(2).dvalue()));
+    }
+}
+
+TEST_CASE("Test_VM_Reductions", "[quick]")
+{
+    SECTION("Integer results")
+    {
+        std::vector<std::tuple<std::string, int>> tests = {
+            {"{1, 2, 3} @ {4, 5, 6}", 32},
+            {"let a = {1, -2, 3}; a @ a", 14},
+            {"{1, 2} @ {3, 4} * 2", 22},
+            {"sum({1, 2, 3, 4, 5})", 15},
+            {"sum({})", 0},
+            {"min({4, -3, 9, 0})", -3},
+            {"max({4, -3, 9, 0})", 9},
+            {"let a = {1} + 2 + 3; sum(a) + max(a)", 9},
+        };
+        for (const auto &[input, expected_value] : tests)
+        {
+            testVM(input, TStackRecordType::stInteger, expected_value);
+        }
+    }
+
+    SECTION("Double results")
+    {
+        std::vector<std::tuple<std::string, double>> tests = {
+            {"{0.5, 1.5} @ {2.0, 4.0}", 7.0},
+            {"{1, 2} @ {0.5, 0.25}", 1.0},
+            {"sum({0.5, 0.25, 1})", 1.75},
+            {"mean({1, 2})", 1.5},
+            {"mean({1.0, 2.0, 6.0})", 3.0},
+            {"min({3.5, -1.0, 2.0})", -1.0},
+            {"max({1, 2.5})", 2.5},
+        };
+        for (const auto &[input, expected_value] : tests)
+        {
+            testVM(input, TStackRecordType::stDouble, expected_value);
+        }
+    }
+
+    SECTION("Kernels match the scalar reference")
+    {
+        const auto &reference = TVectorKernels::get(TKernelIsa::Scalar);
+        for (auto isa : {TKernelIsa::SSE2, TKernelIsa::AVX2})
+        {
+            if (!TVectorKernels::isSupported(isa))
+            {
+                continue;
+            }
+            INFO("isa: " + TKernelIsaToStr(isa));
+            const auto &kernels = TVectorKernels::get(isa);
+            for (size_t n : {1, 2, 3, 5, 8, 13, 31, 64, 67, 10001})
+            {
+                std::vector<int64_t> xi(n), yi(n);
+                std::vector<double> xd(n), yd(n);
+                double magnitude = 0.;
+                for (size_t i = 0; i < n; ++i)
+                {
+                    xi[i] = static_cast<int64_t>((i * 7919) % 2001) - 1000;
+                    yi[i] = static_cast<int64_t>((i * 104729) % 65537) - 32768;
+                    xd[i] = xi[i] / 3.0;
+                    yd[i] = yi[i] / 7.0;
+                    magnitude += std::fabs(xd[i] * yd[i]);
+                }
+                double tolerance = n * DBL_EPSILON * magnitude;
+
+                REQUIRE(kernels.sumi(xi.data(), n) ==
+                        reference.sumi(xi.data(), n));
+                REQUIRE(kernels.doti(xi.data(), yi.data(), n) ==
+                        reference.doti(xi.data(), yi.data(), n));
+                REQUIRE(kernels.mini(yi.data(), n) ==
+                        reference.mini(yi.data(), n));
+                REQUIRE(kernels.maxi(yi.data(), n) ==
+                        reference.maxi(yi.data(), n));
+                REQUIRE(kernels.mind(yd.data(), n) ==
+                        reference.mind(yd.data(), n));
+                REQUIRE(kernels.maxd(yd.data(), n) ==
+                        reference.maxd(yd.data(), n));
+                REQUIRE(std::fabs(kernels.dotd(xd.data(), yd.data(), n) -
+                                  reference.dotd(xd.data(), yd.data(), n)) <=
+                        tolerance);
+                REQUIRE(std::fabs(kernels.sumd(yd.data(), n) -
+                                  reference.sumd(yd.data(), n)) <=
+                        n * DBL_EPSILON * 32768 * n);
+            }
+        }
+    }
+}
+
+TEST_CASE("Test_VM_Matrices", "[quick]")
+{
+    SECTION("Scripts")
+    {
+        std::vector<std::tuple<std::string, double>> tests = {
+            {"let m = matrix({{1, 2}, {3, 4}}); m[1, 0]", 3.0},
+            {"let m = identity(3); m[2, 2] = 5; m[2, 2]", 5.0},
+            {"let a = matrix({{1, 2}, {3, 4}}); let c = a @ a; c[1, 1]", 22.0},
+            {"let a = matrix({{1, 2}}); let b = a * 2 + a; b[0, 1]", 6.0},
+            {"let a = matrix({{2, 4}}) / 2 - matrix({{1, 1}}); sum(a)", 1.0},
+            {"let a = transpose(matrix({{1, 2, 3}})); a[2, 0]", 3.0},
+            {"let a = zeros(2, 2); let b = a; b[0, 0] = 1; a[0, 0]", 0.0},
+            {"let a = matrix({{1, 2}, {3, 4}}); let b = a * a; b[1, 1]", 16.0},
+        };
+        for (const auto &[input, expected_value] : tests)
+        {
+            testVM(input, TStackRecordType::stDouble, expected_value);
+        }
+
+        testVM("let a = zeros(3, 5); rows(a) * 10 + cols(a)",
+               TStackRecordType::stInteger, 35);
+        testVM("let a = matrix({{1, 2}, {3, 4}}); a @ identity(2) == a",
+               TStackRecordType::stBoolean, true);
+
+        TInterpreter interpreter;
+        for (const char *input : {"matrix({{1, 2}, {3, 4}}) @ {1, 2, 3, 4};",
+                                  "{1, 2, 3, 4} @ matrix({{1, 2}, {3, 4}});"})
+        {
+            REQUIRE_THROWS_WITH(interpreter.load(input),
+                                "Dot product of a matrix and a list");
+        }
+    }
+
+    SECTION("Blocked multiply")
+    {
+        size_t n = 150, k = 130, m = 170;
+        auto *a = TMatrixObject::createObject(n, k);
+        auto *b = TMatrixObject::createObject(k, m);
+        for (size_t i = 0; i < n; ++i)
+            for (size_t j = 0; j < k; ++j)
+                a->set(i, j, static_cast<double>((i * 31 + j * 17) % 23) - 11);
+        for (size_t i = 0; i < k; ++i)
+            for (size_t j = 0; j < m; ++j)
+                b->set(i, j, static_cast<double>((i * 7 + j * 13) % 19) / 4);
+
+        auto *c = TMatrixObject::multiply(a, b);
+        for (size_t i = 0; i < n; ++i)
+        {
+            for (size_t j = 0; j < m; ++j)
+            {
+                double expected = 0.;
+                for (size_t l = 0; l < k; ++l)
+                {
+                    expected += a->get(i, l) * b->get(l, j);
+                }
+                REQUIRE(std::fabs(c->get(i, j) - expected) < 1e-9);
+            }
+        }
+
+        TThreadPool pool(3);
+        auto *parallel = TMatrixObject::multiply(a, b, &pool);
+        REQUIRE(TMatrixObject::equals(c, parallel));
+    }
+}
+
+static std::shared_ptr<const TModule> compile(const std::string &input)
+{
+    std::istringstream iss(input);
+    Scanner sc(iss);
+    SyntaxParser sp(sc);
+    if (sp.syntaxCheck().has_value())
+    {
+        return nullptr;
+    }
+
+    TByteCodeBuilder builder(sp.tokens());
+    auto module = std::make_shared<TModule>();
+    builder.build(module.get());
+    return module;
+}
+
+static std::string resultToString(const TMachineStackRecord &result)
+{
+    if (result.type() == TStackRecordType::stString)
+    {
+        return result.svalue()->value();
+    }
+    if (result.type() == TStackRecordType::stBoolean)
+    {
+        return result.bvalue() ? "true" : "false";
+    }
+    return std::to_string(result.ivalue());
+}
+
+// Compiles and runs input in its own runtime; safe to call from any thread.
+static std::string runIsolated(const std::string &input)
+{
+    auto module = compile(input);
+    if (module == nullptr)
+    {
+        return "syntax error";
+    }
+
+    TRuntime runtime;
+    VM vm(runtime);
+    vm.runModule(module);
+    return resultToString(vm.top());
+}
+
+TEST_CASE("Test_VM_Runtimes", "[quick]")
+{
+    SECTION("Concurrent scripts")
+    {
+        std::vector<std::tuple<std::string, std::string>> tests = {
+            {fn_call_fib25(), "75025"},
+            {"let s = \"ab\"; let t = s + \"cd\"; t + \"!\"", "abcd!"},
+            {"let a = {1, 2, 3.5}; a[1] = \"x\"; a[1] + \"y\"", "xy"},
+            {"let m = identity(4) * 3; sum(m) == 12.0", "true"},
+        };
+        std::vector<std::string> results(tests.size() * 2);
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const auto &input = std::get<0>(tests[i % tests.size()]);
+            threads.emplace_back(
+                [&results, &input, i] { results[i] = runIsolated(input); });
+        }
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            INFO(std::get<0>(tests[i % tests.size()]));
+            REQUIRE(results[i] == std::get<1>(tests[i % tests.size()]));
+        }
+    }
+
+    SECTION("Heaps are separate")
+    {
+        TRuntime first;
+        TRuntime second;
+        {
+            TRuntime::TScope scope(first);
+            TListObject::createObject();
+            TListObject::createObject();
+        }
+        {
+            TRuntime::TScope scope(second);
+            TStringObject::createStringObject(std::string("x"));
+            REQUIRE(&TMemoryList::current() == &second.heap());
+        }
+        REQUIRE(first.heap().getMemoryListSize() == 2);
+        REQUIRE(second.heap().getMemoryListSize() == 1);
+        REQUIRE(&TMemoryList::current() != &first.heap());
+    }
+
+    SECTION("Shared module")
+    {
+        std::vector<std::tuple<std::string, std::string>> tests = {
+            {"fn fibonacci(n)\n"
+             "    if n < 2 then\n"
+             "        return n\n"
+             "    end\n"
+             "    return fibonacci(n - 1) + fibonacci(n - 2)\n"
+             "end;\n"
+             "let a = fibonacci(15); let b = a + 1; b",
+             "611"},
+            {"let s = \"ab\"; let t = s + \"cd\"; t = t + \"!\"; s + t",
+             "ababcd!"},
+        };
+        for (const auto &[input, expected_value] : tests)
+        {
+            auto module = compile(input);
+            REQUIRE(module != nullptr);
+
+            // Every thread runs the one module many times, each run in a
+            // context of its own.
+            std::vector<std::string> results(4);
+            std::vector<std::thread> threads;
+            for (size_t i = 0; i < results.size(); ++i)
+            {
+                threads.emplace_back([&results, &module, i] {
+                    TRuntime runtime;
+                    for (int run = 0; run < 25; ++run)
+                    {
+                        TExecutionContext context(module);
+                        VM vm(runtime);
+                        vm.runModule(context);
+                        results[i] = resultToString(vm.top());
+                    }
+                });
+            }
+            for (auto &thread : threads)
+            {
+                thread.join();
+            }
+            for (const auto &result : results)
+            {
+                INFO(input);
+                REQUIRE(result == expected_value);
+            }
+            // The values stored by the runs never reach the module.
+            const auto &symbols = module->symboltable();
+            for (size_t i = 0; i < symbols.size(); ++i)
+            {
+                auto type = symbols.get(i).type();
+                REQUIRE((type == TSymbolElementType::symUndefined ||
+                         type == TSymbolElementType::symUserFunc));
+            }
+        }
+    }
+}
+
+TEST_CASE("Test_VM_Scheduler", "[quick]")
+{
+    auto module = std::make_shared<TModule>();
+    module->symboltable().addSymbol("n");
+    {
+        std::istringstream iss("fn fibonacci(n)\n"
+                               "    if n < 2 then\n"
+                               "        return n\n"
+                               "    end\n"
+                               "    return fibonacci(n - 1) + "
+                               "fibonacci(n - 2)\n"
+                               "end;\n"
+                               "fibonacci(n);\n");
+        Scanner sc(iss);
+        SyntaxParser sp(sc);
+        checkSyntaxParserErrors(sp.syntaxCheck());
+        TByteCodeBuilder builder(sp.tokens());
+        builder.build(module.get());
+    }
+
+    SECTION("Futures")
+    {
+        TScheduler scheduler(3);
+        std::vector<std::future<TScriptResult>> results;
+        for (int n = 0; n < 20; ++n)
+        {
+            results.push_back(scheduler.submit({module, {{"n", n}}}));
+        }
+
+        int previous = 0, current = 1;
+        for (int n = 0; n < 20; ++n)
+        {
+            auto result = results[n].get();
+            REQUIRE(result.error.empty());
+            REQUIRE(std::get<int>(result.value) == previous);
+            REQUIRE(result.stats.worker < scheduler.size());
+            std::tie(previous, current) = std::make_tuple(current,
+                                                          previous + current);
+        }
+    }
+
+    SECTION("Callbacks and errors")
+    {
+        std::atomic<int> nDone{0};
+        std::atomic<int> nFailed{0};
+        {
+            TScheduler scheduler(2);
+            for (int i = 0; i < 10; ++i)
+            {
+                TScriptValue n = 10;
+                if (i % 2 == 1)
+                {
+                    n = std::string("ten");
+                }
+                scheduler.submit({module, {{"n", n}}},
+                                 [&nDone, &nFailed](TScriptResult result) {
+                                     if (!result.error.empty())
+                                     {
+                                         ++nFailed;
+                                     }
+                                     ++nDone;
+                                 });
+            }
+            auto missing = scheduler.submit({module, {{"m", 1}}}).get();
+            REQUIRE(missing.error == "Script has no global named m");
+        }
+        // The scheduler finishes its queued jobs before it is destroyed.
+        REQUIRE(nDone == 10);
+        REQUIRE(nFailed == 5);
+    }
+
+    SECTION("String constants stay unchanged")
+    {
+        auto appends = std::make_shared<TModule>();
+        std::istringstream iss("fn f(n)\n"
+                               "    let s = \"ab\";\n"
+                               "    s = s + \"x\";\n"
+                               "    return s\n"
+                               "end;\n"
+                               "f(1) + f(2) + f(3);\n");
+        Scanner sc(iss);
+        SyntaxParser sp(sc);
+        checkSyntaxParserErrors(sp.syntaxCheck());
+        TByteCodeBuilder builder(sp.tokens());
+        builder.build(appends.get());
+        int index = -1;
+        appends->symboltable().find("f", index);
+        const auto &constant =
+            appends->symboltable().get(index).fvalue()->constantTable().get(1);
+        REQUIRE(constant.sobject()->value() == "ab");
+
+        TScheduler scheduler(3);
+        std::vector<std::future<TScriptResult>> results;
+        for (int i = 0; i < 50; ++i)
+        {
+            results.push_back(scheduler.submit({appends, {}}));
+        }
+        for (auto &result : results)
+        {
+            auto value = result.get();
+            REQUIRE(value.error.empty());
+            REQUIRE(std::get<std::string>(value.value) == "abxabxabx");
+        }
+        REQUIRE(constant.sobject()->value() == "ab");
+        REQUIRE(constant.sobject()->isConstant());
+    }
+}
+
+TEST_CASE("Test_VM_GreenThreads", "[quick]")
+{
+    SECTION("Suspend and resume")
+    {
+        auto module = compile(fn_call_fib25());
+        TRuntime runtime;
+        TExecutionContext context(module);
+        VM vm(runtime);
+        vm.start(context);
+        size_t slices = 1;
+        while (vm.resume(1000) == TRunState::Suspended)
+        {
+            // Parking the run only needs its live stack, fib(25) is at
+            // most 25 calls deep.
+            TSuspendedRun run;
+            vm.save(run);
+            REQUIRE(run.frames.size() <= 25);
+            REQUIRE(run.stack.size() <= 3 * 25 + 2);
+            vm.restore(run);
+            ++slices;
+        }
+        REQUIRE(vm.finished());
+        REQUIRE(slices > 100);
+        REQUIRE(vm.top().ivalue() == 75025);
+        REQUIRE(vm.resume(1000) == TRunState::Finished);
+    }
+
+    SECTION("Round robin")
+    {
+        TRuntime runtime;
+        TGreenThreads threads(runtime, 100);
+        auto slow = compile(fn_call_fib25());
+        auto fast = compile("fn f(n)\n"
+                            "    if n < 2 then\n"
+                            "        return n\n"
+                            "    end\n"
+                            "    return f(n - 1) + f(n - 2)\n"
+                            "end;\n"
+                            "f(10) + 0.5");
+        auto failing = compile("fn f(n)\n"
+                               "    return n - \"x\"\n"
+                               "end;\n"
+                               "f(1)");
+        threads.spawn(slow);
+        for (int i = 0; i < 200; ++i)
+        {
+            threads.spawn(fast, 1 + i % 3);
+        }
+        threads.spawn(failing);
+        threads.runAll();
+
+        // The long run started first but is the last to finish.
+        REQUIRE(threads.finishOrder().size() == threads.size());
+        REQUIRE(threads.finishOrder().back() == 0);
+        REQUIRE(threads.result(0).ivalue() == 75025);
+        REQUIRE(threads.turns(0) > threads.turns(1));
+        for (size_t id = 1; id <= 200; ++id)
+        {
+            REQUIRE(threads.error(id).empty());
+            REQUIRE(threads.result(id).dvalue() == 55.5);
+        }
+        REQUIRE(!threads.error(201).empty());
+    }
+}
+
+TEST_CASE("Test_VM_ParallelLists", "[quick]")
+{
+    SECTION("Scripts")
+    {
+        std::vector<std::tuple<std::string, std::string>> tests = {
+            {"fn sq(x)\n"
+             "    return x * x\n"
+             "end;\n"
+             "let a = pmap(sq, {1, 2, 3, 4} * 100); a[398] + sum(a)",
+             "3009"},
+            {"fn sq(x)\n"
+             "    return x * x\n"
+             "end;\n"
+             "pmap(sq, {}) == {}",
+             "true"},
+            {"fn tag(s)\n"
+             "    return s + \"!\"\n"
+             "end;\n"
+             "let b = pmap(tag, {\"a\", \"b\"} * 50); b[0] + b[99]",
+             "a!b!"},
+            {"fn add(a, b)\n"
+             "    return a + b\n"
+             "end;\n"
+             "preduce(add, {1, 2, 3, 4} * 100, 5)",
+             "1005"},
+            {"fn add(a, b)\n"
+             "    return a + b\n"
+             "end;\n"
+             "preduce(add, {}, 5)",
+             "5"},
+            {"fn rest(l)\n"
+             "    return {l[1], l[0]}\n"
+             "end;\n"
+             "let c = pmap(rest, {{1, \"x\"}, {3, \"y\"}} * 40); c[79][0]",
+             "y"},
+        };
+        for (const auto &[input, expected] : tests)
+        {
+            INFO(input);
+            REQUIRE(runIsolated(input) == expected);
+        }
+    }
+
+    SECTION("Order is kept across workers")
+    {
+        auto module = compile("fn cat(a, b)\n"
+                              "    return a + b\n"
+                              "end;\n"
+                              "fn twice(x)\n"
+                              "    return x + x\n"
+                              "end;\n");
+        TExecutionContext context(module);
+        int cat = 0, twice = 0;
+        REQUIRE(context.globals().find("cat", cat));
+        REQUIRE(context.globals().find("twice", twice));
+
+        TRuntime runtime;
+        TRuntime::TScope scope(runtime);
+        TThreadPool pool(3);
+        auto *letters = TListObject::createObject();
+        std::string expected = ">";
+        for (int i = 0; i < 1000; ++i)
+        {
+            std::string letter(1, static_cast<char>('a' + i % 26));
+            letters->append(TStringObject::createStringObject(letter));
+            expected += letter;
+        }
+
+        TMachineStackRecord init;
+        init.setValue(TStringObject::createStringObject(std::string(">")));
+        auto folded = TParallelList::reduce(context, cat, letters, init, pool);
+        REQUIRE(folded.svalue()->value() == expected);
+
+        auto *doubled = TParallelList::map(context, twice, letters, pool);
+        REQUIRE(doubled->size() == 1000);
+        for (int i = 0; i < 1000; ++i)
+        {
+            REQUIRE(doubled->get(i).svalue()->value() ==
+                    std::string(2, static_cast<char>('a' + i % 26)));
+        }
+        REQUIRE(runtime.heap().getMemoryListSize() > 2000);
+    }
+
+    SECTION("Workers get copies of the caller's strings")
+    {
+        // Every element is the global p. Workers sharing it would race on
+        // its buffer.
+        auto module = compile("let p = \"a\" + \"b\";\n"
+                              "let l = {p} * 2000;\n"
+                              "fn tag(s)\n"
+                              "    return s + \"x\"\n"
+                              "end;\n");
+        TRuntime runtime;
+        TRuntime::TScope scope(runtime);
+        TExecutionContext context(module);
+        VM vm(runtime);
+        vm.runModule(context);
+        int tag = 0, p = 0, l = 0;
+        REQUIRE(context.globals().find("tag", tag));
+        REQUIRE(context.globals().find("p", p));
+        REQUIRE(context.globals().find("l", l));
+
+        TThreadPool pool(3);
+        const auto *list = context.globals().get(l).lvalue();
+        for (int round = 0; round < 5; ++round)
+        {
+            auto *tagged = TParallelList::map(context, tag, list, pool);
+            REQUIRE(tagged->size() == 2000);
+            for (int i = 0; i < 2000; ++i)
+            {
+                REQUIRE(tagged->get(i).svalue()->value() == "abx");
+            }
+        }
+        REQUIRE(context.globals().get(p).svalue()->value() == "ab");
+        REQUIRE(list->get(1999).svalue()->value() == "ab");
+    }
+
+    SECTION("Errors")
+    {
+        REQUIRE_THROWS(compile("pmap(sum, {1, 2})"));
+        REQUIRE_THROWS(compile("fn add(a, b)\n"
+                               "    return a + b\n"
+                               "end;\n"
+                               "pmap(add, {1, 2})"));
+
+        auto module = compile("fn bad(x)\n"
+                              "    return x - \"y\"\n"
+                              "end;\n"
+                              "pmap(bad, {1, 2} * 100)");
+        TRuntime runtime;
+        VM vm(runtime);
+        REQUIRE_THROWS(vm.runModule(module));
+    }
+}
+
+TEST_CASE("Test_VM_Channels", "[quick]")
+{
+    SECTION("Messages are copied")
+    {
+        TRuntime sender;
+        TRuntime receiver;
+        TChannel channel(4);
+        REQUIRE(channel.capacity() == 4);
+        {
+            TRuntime::TScope scope(sender);
+            auto *inner = TListObject::createObject();
+            inner->append(2.5);
+            auto *list = TListObject::createObject();
+            list->append(1);
+            list->append(TStringObject::createStringObject(std::string("x")));
+            list->append(inner);
+            TMachineStackRecord record;
+            record.setValue(list);
+            channel.send(TMessage::pack(record));
+        }
+        int nSent = sender.heap().getMemoryListSize();
+
+        TRuntime::TScope scope(receiver);
+        TMessage message;
+        REQUIRE(channel.recv(message));
+        auto record = message.unpack();
+        REQUIRE(record.type() == TStackRecordType::stList);
+        const auto *list = record.lvalue();
+        REQUIRE(list->get(0).ivalue() == 1);
+        REQUIRE(list->get(1).svalue()->value() == "x");
+        REQUIRE(list->get(2).lvalue()->get(0).dvalue() == 2.5);
+        REQUIRE(receiver.heap().getMemoryListSize() == 3);
+        REQUIRE(sender.heap().getMemoryListSize() == nSent);
+
+        channel.close();
+        REQUIRE(!channel.recv(message));
+        REQUIRE_THROWS(channel.send(TMessage::pack(record)));
+    }
+
+    SECTION("Many producers and consumers")
+    {
+        TChannel channel(16);
+        constexpr int nProducers = 4;
+        constexpr int nMessages = 5000;
+        std::atomic<long> total{0};
+        std::atomic<int> received{0};
+        std::vector<std::thread> threads;
+        for (int p = 0; p < nProducers; ++p)
+        {
+            threads.emplace_back([&channel] {
+                for (int i = 1; i <= nMessages; ++i)
+                {
+                    TMachineStackRecord record;
+                    record.setValue(i);
+                    channel.send(TMessage::pack(record));
+                }
+            });
+        }
+        for (int c = 0; c < 3; ++c)
+        {
+            threads.emplace_back([&channel, &total, &received] {
+                TMessage message;
+                while (channel.recv(message))
+                {
+                    total += message.unpack().ivalue();
+                    ++received;
+                }
+            });
+        }
+        for (int p = 0; p < nProducers; ++p)
+        {
+            threads[p].join();
+        }
+        channel.close();
+        for (size_t t = nProducers; t < threads.size(); ++t)
+        {
+            threads[t].join();
+        }
+        REQUIRE(received == nProducers * nMessages);
+        REQUIRE(total == nProducers * (nMessages * (nMessages + 1L) / 2));
+    }
+
+    SECTION("Close races with sends")
+    {
+        for (int round = 0; round < 200; ++round)
+        {
+            TChannel channel(8);
+            std::atomic<int> sent{0};
+            std::atomic<int> received{0};
+            std::vector<std::thread> threads;
+            for (int p = 0; p < 3; ++p)
+            {
+                threads.emplace_back([&channel, &sent] {
+                    try
+                    {
+                        while (true)
+                        {
+                            TMachineStackRecord record;
+                            record.setValue(1);
+                            channel.send(TMessage::pack(record));
+                            ++sent;
+                        }
+                    }
+                    catch (const std::runtime_error &)
+                    {
+                    }
+                });
+            }
+            for (int c = 0; c < 2; ++c)
+            {
+                threads.emplace_back([&channel, &received] {
+                    TMessage message;
+                    while (channel.recv(message))
+                    {
+                        ++received;
+                    }
+                });
+            }
+            for (int i = 0; i < round % 20; ++i)
+            {
+                std::this_thread::yield();
+            }
+            channel.close();
+            for (auto &thread : threads)
+            {
+                thread.join();
+            }
+            REQUIRE(received == sent);
+        }
+    }
+
+    SECTION("Pipeline of isolates")
+    {
+        std::string functions = "fn produce(out, n)\n"
+                                "    if n == 0 then\n"
+                                "        return close(out)\n"
+                                "    end\n"
+                                "    send(out, {n, \"x\"})\n"
+                                "    return produce(out, n - 1)\n"
+                                "end;\n"
+                                "fn consume(source, n, acc)\n"
+                                "    if n == 0 then\n"
+                                "        return acc\n"
+                                "    end\n"
+                                "    let m = recv(source)\n"
+                                "    return consume(source, n - 1, acc + m[0])\n"
+                                "end;\n"
+                                "fn fail(x)\n"
+                                "    return x - \"y\"\n"
+                                "end;\n";
+        REQUIRE(runIsolated(functions + "let c = channel(8);\n"
+                                        "let p = spawn(produce, c, 500);\n"
+                                        "let q = spawn(consume, c, 500, 0);\n"
+                                        "recv(q)") == "125250");
+        REQUIRE(runIsolated(functions + "let c = channel(2);\n"
+                                        "let p = spawn(produce, c, 3);\n"
+                                        "let a = recv(c); let b = recv(c);\n"
+                                        "a[0] + b[0]") == "5");
+        std::string error;
+        try
+        {
+            runIsolated(functions + "recv(spawn(fail, 1))");
+        }
+        catch (const std::exception &e)
+        {
+            error = e.what();
+        }
+        REQUIRE(error.find("cannot be used with the subtracting") !=
+                std::string::npos);
+    }
+
+    SECTION("Finished isolates are joined")
+    {
+        TInterpreter interpreter;
+        interpreter.load("fn one(x)\n"
+                         "    return x\n"
+                         "end;\n"
+                         "fn wait(x)\n"
+                         "    return recv(spawn(one, x))\n"
+                         "end;\n");
+        for (int i = 0; i < 50; ++i)
+        {
+            REQUIRE(interpreter.call("wait", {i}).ivalue() == i);
+            // Lets the isolate finish after it has sent its result.
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+        REQUIRE(interpreter.runtime().isolates() <= 5);
+    }
+}
+
+TEST_CASE("Test_VM_Interpreter", "[quick]")
+{
+    TInterpreter interpreter;
+    interpreter.load("fn total(xs)\n"
+                     "    return sum(xs)\n"
+                     "end;\n"
+                     "fn scale(xs, k)\n"
+                     "    return xs[1] * k\n"
+                     "end;\n"
+                     "fn greet(name, loud)\n"
+                     "    if loud then\n"
+                     "        return \"HI \" + name\n"
+                     "    end\n"
+                     "    return \"hi \" + name\n"
+                     "end;\n"
+                     "fn bump(xs)\n"
+                     "    xs[0] = 100\n"
+                     "    return xs[0]\n"
+                     "end;\n"
+                     "fn same(xs)\n"
+                     "    return xs\n"
+                     "end;\n");
+
+    SECTION("Typed arguments")
+    {
+        REQUIRE(interpreter.call("greet", {std::string("ann"), true})
+                    .svalue()
+                    ->value() == "HI ann");
+        REQUIRE(interpreter.call("greet", {std::string("bob"), false})
+                    .svalue()
+                    ->value() == "hi bob");
+        std::vector<double> xs = {1.5, 2.5};
+        REQUIRE(interpreter.call("scale", {std::span<const double>(xs), 2.0})
+                    .dvalue() == 5.0);
+    }
+
+    SECTION("Host arrays are read in place")
+    {
+        std::vector<int64_t> ints = {1, 2, 3, 4};
+        std::vector<double> doubles = {0.5, 0.25};
+        REQUIRE(interpreter.call("total", {std::span<const int64_t>(ints)})
+                    .ivalue() == 10);
+        REQUIRE(interpreter.call("total", {std::span<const double>(doubles)})
+                    .dvalue() == 0.75);
+
+        auto view =
+            interpreter.call("same", {std::span<const int64_t>(ints)}).lvalue();
+        REQUIRE(view->isView());
+        REQUIRE(view->intData() == ints.data());
+
+        // Writes go to a copy, the host array is left alone.
+        REQUIRE(interpreter.call("bump", {std::span<const int64_t>(ints)})
+                    .ivalue() == 100);
+        REQUIRE(ints[0] == 1);
+        TRuntime::TScope scope(interpreter.runtime());
+        auto *copy = view->clone();
+        copy->append(5);
+        REQUIRE(!copy->isView());
+        REQUIRE(copy->size() == 5);
+        REQUIRE(view->isView());
+    }
+
+    SECTION("Host integers must fit in an int")
+    {
+        std::vector<int64_t> large(8, 3000000000);
+        REQUIRE_THROWS_WITH(
+            interpreter.call("total", {std::span<const int64_t>(large)}),
+            "list view element out of integer range");
+        std::vector<int64_t> mixed(8, 1);
+        mixed[5] = -(int64_t(1) << 31) - 1;
+        REQUIRE_THROWS(
+            interpreter.call("total", {std::span<const int64_t>(mixed)}));
+        mixed[5] = std::numeric_limits<int>::max() - 7;
+        REQUIRE(interpreter.call("total", {std::span<const int64_t>(mixed)})
+                    .ivalue() == std::numeric_limits<int>::max());
+    }
+
+    SECTION("Batched calls")
+    {
+        interpreter.load("fn price(qty, unit)\n"
+                         "    if qty > 10 then\n"
+                         "        return qty * unit * 0.5\n"
+                         "    end\n"
+                         "    return qty * unit\n"
+                         "end;\n"
+                         "fn big(x)\n"
+                         "    return x > 2\n"
+                         "end;\n"
+                         "fn name(x)\n"
+                         "    return \"x\"\n"
+                         "end;\n");
+        auto price = interpreter.function("price");
+        REQUIRE(price.nArgs == 2);
+
+        std::vector<int64_t> qty = {1, 20, 3};
+        std::vector<double> unit = {2.0, 4.0, 0.5};
+        std::vector<TBatchColumn> columns = {std::span<const int64_t>(qty),
+                                             std::span<const double>(unit)};
+        REQUIRE(interpreter.callBatch(price, columns) ==
+                std::vector<double>{2.0, 40.0, 1.5});
+
+        std::vector<TBatchColumn> one = {std::span<const int64_t>(qty)};
+        REQUIRE(interpreter.callBatch(interpreter.function("big"), one) ==
+                std::vector<double>{0.0, 1.0, 1.0});
+        REQUIRE_THROWS_AS(interpreter.callBatch(interpreter.function("name"),
+                                                one),
+                          std::runtime_error);
+        REQUIRE_THROWS_WITH(interpreter.callBatch(price, one),
+                            "Function price expects 2 arguments");
+        std::vector<int64_t> large = {1, int64_t(1) << 32, 3};
+        std::vector<TBatchColumn> wide = {std::span<const int64_t>(large)};
+        REQUIRE_THROWS_WITH(interpreter.callBatch(interpreter.function("big"),
+                                                  wide, TBatchMode::Scalar),
+                            "Batch column value out of integer range");
+
+        std::vector<double> results(2);
+        REQUIRE_THROWS_AS(interpreter.callBatch(price, columns, results),
+                          std::runtime_error);
+        // The VM is reusable after a failed batch.
+        REQUIRE(interpreter.call(price, {2, 1.5}).dvalue() == 3.0);
+    }
+
+    SECTION("Vectorized batches")
+    {
+        auto module =
+            TInterpreter::compile("fn tier(x, n)\n"
+                                  "    let r = x * 2.5\n"
+                                  "    if x > 100.0 and not (n == 3) then\n"
+                                  "        r = r - n\n"
+                                  "    else\n"
+                                  "        if x < 0 or n >= 7 then\n"
+                                  "            return -x / 4\n"
+                                  "        end\n"
+                                  "    end\n"
+                                  "    return r + n * n\n"
+                                  "end;\n"
+                                  "fn ints(n)\n"
+                                  "    return n * 65536 * 65536 + n - 1\n"
+                                  "end;\n"
+                                  "fn half(n)\n"
+                                  "    return n / 2\n"
+                                  "end;\n"
+                                  "fn maybe(x)\n"
+                                  "    if x > 0.0 then\n"
+                                  "        return x\n"
+                                  "    end\n"
+                                  "end;\n");
+        interpreter.load(module);
+
+        // Longer than a block, so that the last block is partial.
+        size_t n = TVectorProgram::kBlockSize * 2 + 100;
+        std::vector<double> x(n);
+        std::vector<int64_t> k(n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            x[i] = (static_cast<double>(i % 301) - 50.0) * 1.25;
+            k[i] = static_cast<int64_t>(i % 11);
+        }
+        std::vector<TBatchColumn> both = {std::span<const double>(x),
+                                          std::span<const int64_t>(k)};
+        std::vector<TBatchColumn> ks = {std::span<const int64_t>(k)};
+
+        TExecutionContext context(module);
+        auto function = [&context](const std::string &name) {
+            int index = -1;
+            context.globals().find(name, index);
+            return context.globals().get(index).fvalue();
+        };
+        REQUIRE(TVectorProgram::compile(*function("tier"), both));
+        REQUIRE(TVectorProgram::compile(*function("ints"), ks));
+        REQUIRE(!TVectorProgram::compile(*function("half"), ks));
+
+        for (const char *name : {"tier", "ints", "half"})
+        {
+            auto handle = interpreter.function(name);
+            std::span<const TBatchColumn> columns(handle.nArgs == 2 ? both
+                                                                    : ks);
+            REQUIRE(interpreter.callBatch(handle, columns,
+                                          TBatchMode::Vectorized) ==
+                    interpreter.callBatch(handle, columns, TBatchMode::Scalar));
+        }
+        k[n - 1] = int64_t(1) << 31;
+        REQUIRE_THROWS_WITH(interpreter.callBatch(interpreter.function("ints"),
+                                                  ks, TBatchMode::Vectorized),
+                            "Batch column value out of integer range");
+        k[n - 1] = 0;
+
+        std::vector<TBatchColumn> xs = {std::span<const double>(x)};
+        REQUIRE_THROWS_AS(interpreter.callBatch(interpreter.function("maybe"),
+                                                xs),
+                          std::runtime_error);
+        std::vector<double> positive = {1.0, 2.0};
+        std::vector<TBatchColumn> ps = {std::span<const double>(positive)};
+        REQUIRE(interpreter.callBatch(interpreter.function("maybe"), ps) ==
+                positive);
+    }
+
+    SECTION("Errors")
+    {
+        REQUIRE_THROWS_AS(interpreter.call("missing", {}), std::runtime_error);
+        REQUIRE_THROWS_AS(interpreter.call("total", {1, 2}),
+                          std::runtime_error);
+        REQUIRE_THROWS_AS(TInterpreter::compile("let = 1"),
+                          std::runtime_error);
+
+        auto total = interpreter.function("total");
+        REQUIRE_THROWS_AS(interpreter.call(TFunctionHandle{-1, 1}, {1}),
+                          std::runtime_error);
+        REQUIRE_THROWS_AS(interpreter.call(TFunctionHandle{1 << 20, 1}, {1}),
+                          std::runtime_error);
+        std::vector<double> xs = {1.0};
+        std::vector<TBatchColumn> columns = {std::span<const double>(xs)};
+        REQUIRE_THROWS_AS(
+            interpreter.callBatch(TFunctionHandle{total.index + 1000, 1},
+                                  columns),
+            std::runtime_error);
+        TInterpreter empty;
+        REQUIRE_THROWS_WITH(empty.call(total, {1}), "No script is loaded");
+        REQUIRE_THROWS_WITH(empty.callBatch(total, columns),
+                            "No script is loaded");
+    }
+}
+
+static std::shared_ptr<TModule> buildModule(const std::string &input,
+                                            TThreadPool *pool)
+{
+    std::istringstream iss(input);
+    Scanner sc(iss);
+    SyntaxParser sp(sc);
+    checkSyntaxParserErrors(sp.syntaxCheck());
+    TByteCodeBuilder builder(sp.tokens());
+    auto module = std::make_shared<TModule>();
+    if (pool)
+    {
+        builder.build(module.get(), *pool);
+    }
+    else
+    {
+        builder.build(module.get());
+    }
+    return module;
+}
+
+static bool sameConstants(const TConstantValueTable &t1,
+                          const TConstantValueTable &t2)
+{
+    if (t1.size() != t2.size())
+    {
+        return false;
+    }
+    for (int i = 1; i <= static_cast<int>(t1.size()); ++i)
+    {
+        const auto &c1 = t1.get(i);
+        const auto &c2 = t2.get(i);
+        if (c1.type() != c2.type() ||
+            (c1.type() == TConstantValueType::Double &&
+             c1.dvalue() != c2.dvalue()) ||
+            (c1.type() == TConstantValueType::String &&
+             c1.svalue() != c2.svalue()))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool sameModules(const TModule &m1, const TModule &m2)
+{
+    if (!(m1.code() == m2.code()) ||
+        !sameConstants(m1.constants(), m2.constants()) ||
+        m1.symboltable().size() != m2.symboltable().size())
+    {
+        return false;
+    }
+    for (int i = 0; i < static_cast<int>(m1.symboltable().size()); ++i)
+    {
+        const auto &s1 = m1.symboltable().get(i);
+        const auto &s2 = m2.symboltable().get(i);
+        if (s1.name() != s2.name() || s1.type() != s2.type())
+        {
+            return false;
+        }
+        if (s1.type() == TSymbolElementType::symUserFunc &&
+            (!(s1.fvalue()->funcCode() == s2.fvalue()->funcCode()) ||
+             !sameConstants(s1.fvalue()->constantTable(),
+                            s2.fvalue()->constantTable())))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static std::string buildError(const std::string &input, TThreadPool *pool)
+{
+    try
+    {
+        buildModule(input, pool);
+    }
+    catch (const std::exception &e)
+    {
+        return e.what();
+    }
+    return "";
+}
+
+TEST_CASE("Test_VM_ParallelBuild", "[quick]")
+{
+    TThreadPool pool(3);
+
+    SECTION("Bytecode does not depend on the thread count")
+    {
+        std::string input = "let scale = 2;\n"
+                            "fn f0(x)\n"
+                            "    return x + 0.5\n"
+                            "end;\n";
+        for (int i = 1; i < 200; ++i)
+        {
+            auto n = std::to_string(i);
+            auto previous = std::to_string(i - 1);
+            input += "fn f" + n + "(x)\n"
+                     "    let s = \"f" + n + "\"\n"
+                     "    if x > " + n + ".25 then\n"
+                     "        return f" + previous + "(x - 1.5)\n"
+                     "    end\n"
+                     "    return x * " + n + ".75\n"
+                     "end;\n"
+                     "let g" + n + " = f" + n + "(" + n + ");\n";
+        }
+        input += "f199(400.0) + scale";
+
+        auto sequential = buildModule(input, nullptr);
+        auto parallel = buildModule(input, &pool);
+        TThreadPool single(0);
+        REQUIRE(sameModules(*sequential, *parallel));
+        REQUIRE(sameModules(*sequential, *buildModule(input, &single)));
+
+        TRuntime runtime;
+        VM vm(runtime);
+        vm.runModule(sequential);
+        auto expected = vm.top().dvalue();
+        vm.runModule(parallel);
+        REQUIRE(vm.top().dvalue() == expected);
+    }
+
+    SECTION("The first error in the source is reported")
+    {
+        std::string callsLater = "fn a(x)\n"
+                                 "    return b(x)\n"
+                                 "end;\n"
+                                 "fn b(x)\n"
+                                 "    return x\n"
+                                 "end;\n";
+        std::string badAssignment = "fn c(x)\n"
+                                    "    x + 1 = 2\n"
+                                    "    return x\n"
+                                    "end;\n";
+        for (const auto &input :
+             {callsLater, badAssignment + callsLater,
+              callsLater + badAssignment, "let q = 1 + 1;\n" + callsLater})
+        {
+            auto error = buildError(input, nullptr);
+            REQUIRE(!error.empty());
+            REQUIRE(buildError(input, &pool) == error);
+        }
+        REQUIRE(buildError(callsLater, &pool).find("[b]") !=
+                std::string::npos);
+    }
+
+    SECTION("Calls with the wrong number of arguments name the function")
+    {
+        REQUIRE(buildError("fn f(x)\n"
+                           "    return x\n"
+                           "end;\n"
+                           "f(1, 2);\n",
+                           nullptr) ==
+                "incorrect number of arguments in function call: [f]");
+    }
+}
+
+TEST_CASE("Test_VM_ModuleFile", "[quick]")
+{
+    std::string source = "let greeting = \"hi\";\n"
+                         "fn scale(x, y)\n"
+                         "    let k = 2.5;\n"
+                         "    if x > y then\n"
+                         "        return x * k\n"
+                         "    end;\n"
+                         "    return y * k\n"
+                         "end;\n"
+                         "fn name(s)\n"
+                         "    return s + \"!\"\n"
+                         "end;\n"
+                         "let r = scale(1.0, 4.0);\n";
+    auto path =
+        (std::filesystem::temp_directory_path() / "daewoo_module_file.dwc")
+            .string();
+    std::filesystem::remove(path);
+
+    SECTION("A saved module loads back unchanged")
+    {
+        auto compiled = TInterpreter::compile(source);
+        TModuleFile::save(*compiled, source, path);
+        auto loaded = TModuleFile::load(path, source);
+        REQUIRE(loaded != nullptr);
+        REQUIRE(loaded->code().isView());
+        REQUIRE(sameModules(*compiled, *loaded));
+
+        TInterpreter interpreter;
+        interpreter.load(loaded);
+        REQUIRE(interpreter.call("scale", {3.0, 2.0}).dvalue() == 7.5);
+        REQUIRE(interpreter.call("name", {std::string("bob")})
+                    .svalue()
+                    ->value() == "bob!");
+    }
+
+    SECTION("Stale and damaged files are not loaded")
+    {
+        REQUIRE(TModuleFile::load(path, source) == nullptr);
+        TModuleFile::save(*TInterpreter::compile(source), source, path);
+        REQUIRE(TModuleFile::load(path, source + "\n") == nullptr);
+
+        auto size = std::filesystem::file_size(path);
+        std::filesystem::resize_file(path, size - 1);
+        REQUIRE(TModuleFile::load(path, source) == nullptr);
+    }
+
+    SECTION("Files with bad operands are not loaded")
+    {
+        auto compiled = TInterpreter::compile(source);
+        TModuleFile::save(*compiled, source, path);
+        std::ifstream in(path, std::ios::binary);
+        std::string image((std::istreambuf_iterator<char>(in)),
+                          std::istreambuf_iterator<char>());
+        in.close();
+
+        // Code records are 8 byte aligned, an instruction is found by its
+        // bytes and its operand replaced.
+        auto loadsWith = [&](const TByteCode &original, int operand) {
+            std::string damaged = image;
+            for (size_t at = 0; at + sizeof(TByteCode) <= damaged.size();
+                 at += 8)
+            {
+                TByteCode code;
+                std::memcpy(&code, damaged.data() + at, sizeof(code));
+                if (code == original)
+                {
+                    code.index = operand;
+                    std::memcpy(damaged.data() + at, &code, sizeof(code));
+                    std::ofstream(path, std::ios::binary) << damaged;
+                    return TModuleFile::load(path, source) != nullptr;
+                }
+            }
+            FAIL("instruction not found in the file");
+            return true;
+        };
+        auto find = [](const TProgram &program, OpCode op) {
+            for (size_t i = 0; i < program.size(); ++i)
+            {
+                if (program[i].opCode == op)
+                {
+                    return i;
+                }
+            }
+            FAIL("no " + OpCodeToString(op));
+            return size_t(0);
+        };
+        int index = -1;
+        compiled->symboltable().find("scale", index);
+        const auto &scale =
+            compiled->symboltable().get(index).fvalue()->funcCode();
+        const auto &code = compiled->code();
+        auto pushd = code[find(code, OpCode::Pushd)];
+        auto call = find(code, OpCode::Call);
+        compiled->symboltable().find("greeting", index);
+
+        REQUIRE(loadsWith(pushd, pushd.index));
+        REQUIRE(!loadsWith(pushd, 1000));
+        REQUIRE(!loadsWith(code[find(code, OpCode::Pushs)], pushd.index));
+        REQUIRE(!loadsWith(code[find(code, OpCode::Store)], 1000));
+        REQUIRE(!loadsWith(code[call - 1], index));
+        REQUIRE(!loadsWith(scale[find(scale, OpCode::LoadLocal)], 2000));
+        REQUIRE(!loadsWith(scale[find(scale, OpCode::JmpIfFalse)], -100));
+        REQUIRE(!loadsWith(scale[find(scale, OpCode::JmpIfFalse)], 1000));
+    }
+
+    SECTION("loadOrCompile rewrites a stale file")
+    {
+        TModuleFile::save(*TInterpreter::compile("let a = 1;"), "let a = 1;",
+                          path);
+        auto module = TModuleFile::loadOrCompile(path, source);
+        REQUIRE(sameModules(*module, *TInterpreter::compile(source)));
+        REQUIRE(TModuleFile::load(path, source) != nullptr);
+    }
+
+    SECTION("Modules holding values are not saved")
+    {
+        TModule module;
+        module.symboltable().addSymbol("x");
+        module.symboltable().storeSymbolToTable(0, 1);
+        REQUIRE_THROWS(TModuleFile::save(module, "", path));
+    }
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Test_VM_LazyBuild", "[quick]")
+{
+    std::string source = "let offset = 10;\n"
+                         "fn square(x)\n"
+                         "    let y = x * x;\n"
+                         "    return y\n"
+                         "end;\n"
+                         "fn label(x)\n"
+                         "    if x > 2 then\n"
+                         "        return \"big\"\n"
+                         "    end;\n"
+                         "    return \"small\"\n"
+                         "end;\n"
+                         "fn twice(x)\n"
+                         "    return square(x) + square(x)\n"
+                         "end;\n"
+                         "let r = twice(3);\n";
+
+    auto function = [](const TModule &module, const std::string &name) {
+        for (size_t i = 0; i < module.symboltable().size(); ++i)
+        {
+            if (module.symboltable().get(i).name() == name)
+            {
+                return module.symboltable().get(i).fvalue();
+            }
+        }
+        return static_cast<TUserFunction *>(nullptr);
+    };
+
+    SECTION("Only called bodies are compiled")
+    {
+        auto lazy = TInterpreter::compile(source, TCompileMode::Lazy);
+        REQUIRE(function(*lazy, "twice")->funcCode().size() == 0);
+
+        TInterpreter interpreter;
+        interpreter.load(lazy);
+        REQUIRE(function(*lazy, "twice")->funcCode().size() > 0);
+        REQUIRE(function(*lazy, "square")->funcCode().size() > 0);
+        REQUIRE(function(*lazy, "label")->funcCode().size() == 0);
+        REQUIRE(interpreter.call("label", {5}).svalue()->value() == "big");
+
+        REQUIRE(sameModules(*lazy, *TInterpreter::compile(source)));
+    }
+
+    SECTION("Errors in a body are thrown by its calls")
+    {
+        std::string callsLater = "fn a(x)\n"
+                                 "    return b(x)\n"
+                                 "end;\n"
+                                 "fn b(x)\n"
+                                 "    return x\n"
+                                 "end;\n";
+        TInterpreter interpreter;
+        interpreter.load(callsLater, TCompileMode::Lazy);
+        REQUIRE(interpreter.call("b", {1}).ivalue() == 1);
+        for (int i = 0; i < 2; ++i)
+        {
+            try
+            {
+                interpreter.call("a", {1});
+                FAIL("no error");
+            }
+            catch (const std::runtime_error &e)
+            {
+                REQUIRE(std::string(e.what()).find("[b]") !=
+                        std::string::npos);
+            }
+        }
+    }
+
+    SECTION("Threads sharing a module race to the first call")
+    {
+        auto lazy = TInterpreter::compile(source, TCompileMode::Lazy);
+        std::vector<std::thread> threads;
+        std::atomic<int> correct = 0;
+        for (int t = 0; t < 4; ++t)
+        {
+            threads.emplace_back([&lazy, &correct, t] {
+                TInterpreter interpreter;
+                interpreter.load(lazy);
+                if (interpreter.call("label", {t}).svalue()->value() ==
+                    (t > 2 ? "big" : "small"))
+                {
+                    ++correct;
+                }
+            });
+        }
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+        REQUIRE(correct == 4);
+    }
+}